@@ -0,0 +1,260 @@
+#include <gflags/gflags.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+#include <core/common/Array2D.h>
+#include <core/common/ArrayUtils.h>
+#include <core/common/BasicTypes.h>
+#include <core/concurrency/ThreadPool.h>
+#include <core/geometry/RangeUtils.h>
+#include <core/imageproc/ColorMap.h>
+#include <core/imageproc/ColorUtils.h>
+#include <core/math/MathUtils.h>
+#include <core/vecmath/Range1f.h>
+#include <core/vecmath/Range1i.h>
+#include <core/vecmath/Vector4f.h>
+
+using libcgt::core::arrayutils::map;
+using libcgt::core::concurrency::ThreadPool;
+using libcgt::core::geometry::rescale;
+using libcgt::core::math::clamp;
+using libcgt::core::math::fraction;
+
+namespace imageproc = libcgt::core::imageproc;
+
+DEFINE_int32( width, 640, "Image width. Default: 640." );
+DEFINE_int32( height, 480, "Image height. Default: 480." );
+DEFINE_int32( iterations, 100,
+    "Number of times each function is run. Default: 100." );
+
+namespace
+{
+
+// Runs f() FLAGS_iterations times and returns the mean time in milliseconds.
+template< typename Func >
+double timeMilliseconds( Func f )
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < FLAGS_iterations; ++i )
+    {
+        f();
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration< double, std::milli >( t1 - t0 ).count() /
+        FLAGS_iterations;
+}
+
+template< typename T >
+int countMismatches( Array2DReadView< T > a, Array2DReadView< T > b )
+{
+    int count = 0;
+    for( int y = 0; y < a.height(); ++y )
+    {
+        for( int x = 0; x < a.width(); ++x )
+        {
+            if( std::memcmp( &a[ { x, y } ], &b[ { x, y } ], sizeof( T ) ) != 0 )
+            {
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+// Times the per-pixel reference "scalar" against "fast", which both write
+// to their argument, and prints the times and number of pixels that differ.
+template< typename TDst, typename ScalarFunc, typename FastFunc >
+void compare( const char* name, const Vector2i& size,
+    ScalarFunc scalar, FastFunc fast )
+{
+    Array2D< TDst > expected( size );
+    Array2D< TDst > actual( size );
+
+    double scalarMs = timeMilliseconds(
+        [&] () { scalar( expected.writeView() ); } );
+    double fastMs = timeMilliseconds(
+        [&] () { fast( actual.writeView() ); } );
+    int nMismatches = countMismatches( expected.readView(),
+        actual.readView() );
+
+    printf( "%-46s scalar: %8.3f ms, fast: %8.3f ms (%5.2fx), "
+        "%d pixels differ\n",
+        name, scalarMs, fastMs, scalarMs / fastMs, nMismatches );
+}
+
+Vector4f normalToRGBA( const Vector4f& normal )
+{
+    Vector4f rgba;
+    if( normal.w > 0 )
+    {
+        rgba.xyz = 0.5f * ( normal.xyz + Vector3f{ 1, 1, 1 } );
+        rgba.w = 1;
+    }
+    return rgba;
+}
+
+}
+
+int main( int argc, char* argv[] )
+{
+    gflags::SetUsageMessage( "Compares the imageproc::ColorMap functions "
+        "against a single-threaded, per-pixel implementation on random "
+        "images." );
+    gflags::ParseCommandLineFlags( &argc, &argv, true );
+
+    Vector2i size{ FLAGS_width, FLAGS_height };
+    if( size.x <= 0 || size.y <= 0 || FLAGS_iterations <= 0 )
+    {
+        fprintf( stderr, "width, height and iterations must be positive.\n" );
+        return 1;
+    }
+
+    printf( "%d x %d, %d iterations, %d threads.\n", size.x, size.y,
+        FLAGS_iterations, ThreadPool::global().numThreads() );
+
+    std::mt19937 rng( 0 );
+    std::uniform_real_distribution< float > depthDist( 0.0f, 5.0f );
+    std::uniform_real_distribution< float > normalDist( -1.0f, 1.0f );
+    std::uniform_int_distribution< int > rawDepthDist( 0, 65535 );
+
+    Array2D< float > depth( size );
+    Array2D< uint16_t > rawDepth( size );
+    Array2D< Vector4f > normals( size );
+    for( int y = 0; y < size.y; ++y )
+    {
+        for( int x = 0; x < size.x; ++x )
+        {
+            depth[ { x, y } ] = depthDist( rng );
+            rawDepth[ { x, y } ] =
+                static_cast< uint16_t >( rawDepthDist( rng ) );
+            Vector3f n = Vector3f( normalDist( rng ), normalDist( rng ),
+                normalDist( rng ) ).normalized();
+            normals[ { x, y } ] = Vector4f( n, ( x + y ) % 8 == 0 ? 0.0f : 1.0f );
+        }
+    }
+
+    const Range1f depthRange( 0.5f, 4.0f );
+    const Range1f lumaRange( 0.0f, 1.0f );
+    const Range1i rawDepthRange( 500, 4000 );
+    const Range1i rawLumaRange( 0, 256 );
+
+    compare< uint8x4 >( "jet( float -> uint8x4 )", size,
+        [&] ( Array2DWriteView< uint8x4 > dst )
+        {
+            map( depth.readView(), dst,
+                [&] ( float z )
+                {
+                    return imageproc::toUInt8( imageproc::jet(
+                        imageproc::saturate( fraction( z, depthRange ) ) ) );
+                }
+            );
+        },
+        [&] ( Array2DWriteView< uint8x4 > dst )
+        {
+            imageproc::jet( depth.readView(), depthRange, dst );
+        }
+    );
+
+    compare< Vector4f >( "jet( float -> Vector4f )", size,
+        [&] ( Array2DWriteView< Vector4f > dst )
+        {
+            map( depth.readView(), dst,
+                [&] ( float z )
+                {
+                    return imageproc::jet(
+                        imageproc::saturate( fraction( z, depthRange ) ) );
+                }
+            );
+        },
+        [&] ( Array2DWriteView< Vector4f > dst )
+        {
+            imageproc::jet( depth.readView(), depthRange, dst );
+        }
+    );
+
+    compare< uint8x4 >( "jet( uint16_t -> uint8x4 )", size,
+        [&] ( Array2DWriteView< uint8x4 > dst )
+        {
+            map( rawDepth.readView(), dst,
+                [&] ( uint16_t z )
+                {
+                    return imageproc::toUInt8( imageproc::jet(
+                        imageproc::saturate( fraction( z, rawDepthRange ) ) ) );
+                }
+            );
+        },
+        [&] ( Array2DWriteView< uint8x4 > dst )
+        {
+            imageproc::jet( rawDepth.readView(), rawDepthRange, dst );
+        }
+    );
+
+    compare< uint8_t >( "linearRemapToLuminance( float -> uint8_t )", size,
+        [&] ( Array2DWriteView< uint8_t > dst )
+        {
+            map( depth.readView(), dst,
+                [&] ( float z )
+                {
+                    return imageproc::toUInt8( imageproc::saturate(
+                        rescale( z, depthRange, lumaRange ) ) );
+                }
+            );
+        },
+        [&] ( Array2DWriteView< uint8_t > dst )
+        {
+            imageproc::linearRemapToLuminance( depth.readView(), depthRange,
+                lumaRange, dst );
+        }
+    );
+
+    compare< uint8_t >( "linearRemapToLuminance( uint16_t -> uint8_t )", size,
+        [&] ( Array2DWriteView< uint8_t > dst )
+        {
+            map( rawDepth.readView(), dst,
+                [&] ( uint16_t z )
+                {
+                    return static_cast< uint8_t >( clamp(
+                        rescale( z, rawDepthRange, rawLumaRange ),
+                        Range1i( 256 ) ) );
+                }
+            );
+        },
+        [&] ( Array2DWriteView< uint8_t > dst )
+        {
+            imageproc::linearRemapToLuminance( rawDepth.readView(),
+                rawDepthRange, rawLumaRange, dst );
+        }
+    );
+
+    compare< uint8x4 >( "normalsToRGBA( Vector4f -> uint8x4 )", size,
+        [&] ( Array2DWriteView< uint8x4 > dst )
+        {
+            map( normals.readView(), dst,
+                [&] ( const Vector4f& normal )
+                {
+                    return imageproc::toUInt8( normalToRGBA( normal ) );
+                }
+            );
+        },
+        [&] ( Array2DWriteView< uint8x4 > dst )
+        {
+            imageproc::normalsToRGBA( normals.readView(), dst );
+        }
+    );
+
+    compare< Vector4f >( "normalsToRGBA( Vector4f -> Vector4f )", size,
+        [&] ( Array2DWriteView< Vector4f > dst )
+        {
+            map( normals.readView(), dst, &normalToRGBA );
+        },
+        [&] ( Array2DWriteView< Vector4f > dst )
+        {
+            imageproc::normalsToRGBA( normals.readView(), dst );
+        }
+    );
+
+    return 0;
+}
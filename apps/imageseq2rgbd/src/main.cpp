@@ -22,6 +22,9 @@ DEFINE_double( depth_scale, 1.0,
 DEFINE_double( depth_offset, 0.0,
     "(Float output only)\n"
     "Offset 'b' to apply. zOut = a * zIn + b. Default: 0.0." );
+DEFINE_bool( compress_depth, false,
+    "(DEPTH_MM_U16 output only)\n"
+    "Losslessly compress the depth stream. Default: false." );
 
 int main( int argc, char* argv[] )
 {
@@ -63,7 +66,9 @@ int main( int argc, char* argv[] )
     {
         printf( "Output format is DEPTH_MM_U16.\n" );
         outputMetadata.push_back( StreamMetadata{ StreamType::DEPTH,
-            PixelFormat::DEPTH_MM_U16, resolution } );
+            PixelFormat::DEPTH_MM_U16, resolution,
+            FLAGS_compress_depth ?
+                StreamCompression::DEPTH_RICE_U16 : StreamCompression::NONE } );
     }
     else if( FLAGS_output_format == "DEPTH_M_F32" )
     {
@@ -1,16 +1,34 @@
+#include <gflags/gflags.h>
 #include <third_party/pystring/pystring.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
 #include <core/common/BasicTypes.h>
+#include <core/concurrency/BoundedMPMCQueue.h>
 #include <core/imageproc/ColorMap.h>
 #include <core/io/NumberedFilenameBuilder.h>
 #include <core/io/PNGIO.h>
 #include <core/vecmath/Range1i.h>
 #include <camera_wrappers/RGBDStream.h>
 
-using libcgt::camera_wrappers::RGBDInputStream;
+using libcgt::camera_wrappers::RGBDFrameIndexEntry;
+using libcgt::camera_wrappers::RGBDMappedInputStream;
 using libcgt::camera_wrappers::PixelFormat;
+using libcgt::camera_wrappers::StreamMetadata;
+using libcgt::core::concurrency::BoundedMPMCQueue;
 using libcgt::core::imageproc::linearRemapToLuminance;
 
+DEFINE_int32( threads, 0,
+    "Number of encode threads. Default: 0, one per hardware thread." );
+DEFINE_int32( queue_depth, 4,
+    "Number of frames queued per encode thread. Default: 4." );
+DEFINE_bool( verbose, false,
+    "Print the name of every file written. Default: false." );
+
 // --> libcgt::core.
 #include <iomanip>
 #include <sstream>
@@ -24,8 +42,138 @@ std::string toZeroFilledString( T x, int width )
     return stream.str();
 }
 
+namespace
+{
+
+// Sent to the encode workers, one per worker, after the last frame.
+const int END_OF_FRAMES = -1;
+
+typedef BoundedMPMCQueue< int > FrameQueue;
+
+struct ExportSettings
+{
+    int colorStream = -1;
+    int depthStream = -1;
+    int infraredStream = -1;
+
+    std::string colorRoot;
+    std::string depthRoot;
+    std::string infraredRoot;
+};
+
+struct ExportStats
+{
+    std::atomic< int > nFramesWritten{ 0 };
+    std::atomic< int > nFramesFailed{ 0 };
+    std::atomic< int64_t > nBytesRead{ 0 };
+};
+
+const int TIMESTAMP_FIELD_WIDTH = 20;
+
+// Decodes, tonemaps and writes the frames dequeued from "queue" (positions
+// in the index) until it dequeues END_OF_FRAMES. Each worker owns its
+// tonemapping and decompression buffers.
+void encodeWorker( const RGBDMappedInputStream& inputStream,
+    const ExportSettings& settings, FrameQueue& queue, ExportStats& stats )
+{
+    const std::vector< StreamMetadata >& metadata = inputStream.metadata();
+
+    NumberedFilenameBuilder colorNFB( settings.colorRoot + "_", "" );
+    NumberedFilenameBuilder depthNFB( settings.depthRoot + "_", "" );
+    NumberedFilenameBuilder infraredNFB( settings.infraredRoot + "_", "" );
+
+    Array2D< uint8_t > tonemappedDepth;
+    if( settings.depthStream != -1 )
+    {
+        tonemappedDepth.resize( metadata[ settings.depthStream ].size );
+    }
+
+    Array2D< uint8_t > tonemappedInfrared;
+    if( settings.infraredStream != -1 )
+    {
+        tonemappedInfrared.resize( metadata[ settings.infraredStream ].size );
+    }
+
+    Array1D< uint8_t > decompressed;
+
+    int i;
+    while( ( i = queue.dequeue() ) != END_OF_FRAMES )
+    {
+        const RGBDFrameIndexEntry& entry = inputStream.index()[ i ];
+        Array1DReadView< uint8_t > src = inputStream.frame( i, decompressed );
+        if( src.isNull() )
+        {
+            fprintf( stderr, "Error reading frame %d of stream %u.\n",
+                entry.frameIndex, entry.streamId );
+            ++stats.nFramesFailed;
+            continue;
+        }
+
+        std::string timestampSuffix = "_" +
+            toZeroFilledString( entry.timestamp, TIMESTAMP_FIELD_WIDTH ) +
+            ".png";
+
+        std::string outputFilename;
+        bool succeeded = false;
+        if( entry.streamId == settings.colorStream )
+        {
+            outputFilename = colorNFB.filenameForNumber( entry.frameIndex ) +
+                timestampSuffix;
+            Array2DReadView< uint8x3 > src2D( src.pointer(),
+                metadata[ settings.colorStream ].size );
+            succeeded = PNGIO::write( outputFilename, src2D );
+        }
+        else if( entry.streamId == settings.depthStream )
+        {
+            outputFilename = depthNFB.filenameForNumber( entry.frameIndex ) +
+                timestampSuffix;
+            Array2DReadView< uint16_t > src2D( src.pointer(),
+                metadata[ settings.depthStream ].size );
+
+            // TODO: dump depth to the right format
+            // TODO: source min max are not well specified...
+            Range1i srcRange = Range1i::fromMinMax( 800, 4000 );
+            Range1i dstRange = Range1i::fromMinMax( 51, 256 );
+            linearRemapToLuminance( src2D, srcRange, dstRange,
+                tonemappedDepth );
+            succeeded = PNGIO::write( outputFilename, tonemappedDepth );
+        }
+        else if( entry.streamId == settings.infraredStream )
+        {
+            outputFilename = infraredNFB.filenameForNumber(
+                entry.frameIndex ) + timestampSuffix;
+            Array2DReadView< uint16_t > src2D( src.pointer(),
+                metadata[ settings.infraredStream ].size );
+
+            Range1i srcRange( 1024 );
+            Range1i dstRange( 256 );
+            linearRemapToLuminance( src2D, srcRange, dstRange,
+                tonemappedInfrared );
+            succeeded = PNGIO::write( outputFilename, tonemappedInfrared );
+        }
+
+        if( succeeded )
+        {
+            if( FLAGS_verbose )
+            {
+                printf( "Wrote %s\n", outputFilename.c_str() );
+            }
+            ++stats.nFramesWritten;
+            stats.nBytesRead += static_cast< int64_t >( src.size() );
+        }
+        else
+        {
+            fprintf( stderr, "Error writing %s.\n", outputFilename.c_str() );
+            ++stats.nFramesFailed;
+        }
+    }
+}
+
+}
+
 int main( int argc, char* argv[] )
 {
+    gflags::ParseCommandLineFlags( &argc, &argv, true );
     if( argc < 3 )
     {
         printf( "Usage: %s <src.rgbd> <output_dir>\n", argv[ 0 ] );
@@ -42,14 +190,17 @@ int main( int argc, char* argv[] )
 
     // Make a new root for each stream: new dir + root + stream name
     // E.g. "/dst/recording_00003_color"
-    std::string colorRoot = pystring::os::path::join( argv[ 2 ],
+    ExportSettings settings;
+    settings.colorRoot = pystring::os::path::join( argv[ 2 ],
         root + "_color" );
-    std::string depthRoot = pystring::os::path::join( argv[ 2 ],
+    settings.depthRoot = pystring::os::path::join( argv[ 2 ],
         root + "_depth" );
-    std::string infraredRoot = pystring::os::path::join( argv[ 2 ],
+    settings.infraredRoot = pystring::os::path::join( argv[ 2 ],
         root + "_infrared" );
 
-    RGBDInputStream inputStream( argv[ 1 ] );
+    // Frames are read through a memory mapping so that the encode threads
+    // can access them concurrently without copies.
+    RGBDMappedInputStream inputStream( argv[ 1 ] );
     if( !inputStream.isValid() )
     {
         fprintf( stderr, "Error reading input %s.\n", argv[ 1 ] );
@@ -57,126 +208,135 @@ int main( int argc, char* argv[] )
     }
 
     // Find color stream.
-    int colorStream = -1;
     for( int i = 0; i < inputStream.metadata().size(); ++i )
     {
         // TODO: print "found color stream %d, format is ..."
         if( inputStream.metadata()[ i ].type == StreamType::COLOR )
         {
-            colorStream = i;
+            settings.colorStream = i;
             break;
         }
     }
 
     // Find depth stream.
-    int depthStream = -1;
     for( int i = 0; i < inputStream.metadata().size(); ++i )
     {
         if( inputStream.metadata()[ i ].type == StreamType::DEPTH )
         {
-            depthStream = i;
+            settings.depthStream = i;
             break;
         }
     }
 
     // Find infrared stream.
-    int infraredStream = -1;
     for( int i = 0; i < inputStream.metadata().size(); ++i )
     {
         if( inputStream.metadata()[ i ].type == StreamType::INFRARED )
         {
-            infraredStream = i;
+            settings.infraredStream = i;
             break;
         }
     }
 
-    if( colorStream == -1 && depthStream == -1 && infraredStream == -1 )
+    if( settings.colorStream == -1 && settings.depthStream == -1 &&
+        settings.infraredStream == -1 )
     {
         fprintf( stderr, "Could not find any streams to convert.\n" );
         return 3;
     }
 
-    const int TIMESTAMP_FIELD_WIDTH = 20;
-    NumberedFilenameBuilder colorNFB( colorRoot + "_", "" );
-    NumberedFilenameBuilder depthNFB( depthRoot + "_", "" );
-    NumberedFilenameBuilder infraredNFB( infraredRoot + "_", "" );
-    Array2D< uint8_t > tonemappedDepth;
-    if( depthStream != -1 )
+    int nFramesTotal = 0;
+    for( int s : { settings.colorStream, settings.depthStream,
+        settings.infraredStream } )
     {
-        tonemappedDepth.resize(
-            inputStream.metadata()[ depthStream ].size );
+        if( s != -1 )
+        {
+            nFramesTotal += inputStream.numFrames( s );
+        }
     }
 
-    Array2D< uint8_t > tonemappedInfrared;
-    if( infraredStream != -1 )
+    int nThreads = FLAGS_threads;
+    if( nThreads <= 0 )
     {
-        tonemappedInfrared.resize(
-            inputStream.metadata()[ infraredStream ].size );
+        nThreads = std::max( 1u, std::thread::hardware_concurrency() );
     }
+    FrameQueue queue( nThreads * std::max( 1, FLAGS_queue_depth ) );
+    ExportStats stats;
+
+    printf( "Exporting %d frames with %d threads.\n", nFramesTotal,
+        nThreads );
+    auto startTime = std::chrono::steady_clock::now();
 
-    uint32_t streamId;
-    int frameIndex;
-    int64_t timestamp;
-    Array1DReadView< uint8_t > src =
-        inputStream.read( streamId, frameIndex, timestamp );
-    while( src.notNull() )
+    // The reader walks the index in file order, so that pages of the mapping
+    // are faulted in roughly sequentially, and stays at most queue_depth
+    // frames per thread ahead of the encoders.
+    std::thread reader( [&]
     {
-        if( streamId == colorStream )
+        const std::vector< RGBDFrameIndexEntry >& index = inputStream.index();
+        for( int i = 0; i < static_cast< int >( index.size() ); ++i )
         {
-            std::string outputFilename = colorNFB.filenameForNumber(
-                frameIndex );
-            outputFilename += "_" +
-                toZeroFilledString( timestamp, TIMESTAMP_FIELD_WIDTH ) +
-                ".png";
-            Array2DReadView< uint8x3 > src2D( src.pointer(),
-                inputStream.metadata()[ colorStream ].size );
-            printf( "Writing color frame to %s\n", outputFilename.c_str() );
-            PNGIO::write( outputFilename, src2D );
+            int s = static_cast< int >( index[ i ].streamId );
+            if( s == settings.colorStream || s == settings.depthStream ||
+                s == settings.infraredStream )
+            {
+                queue.enqueue( i );
+            }
         }
-
-        if( streamId == depthStream )
+        for( int t = 0; t < nThreads; ++t )
         {
-            std::string outputFilename = depthNFB.filenameForNumber(
-                frameIndex );
-            outputFilename += "_" +
-                toZeroFilledString( timestamp, TIMESTAMP_FIELD_WIDTH ) +
-                ".png";
-
-            Array2DReadView< uint16_t > src2D( src.pointer(),
-                inputStream.metadata()[ depthStream ].size );
-
-            // TODO: dump depth to the right format
-            // TODO: source min max are not well specified...
-            Range1i srcRange = Range1i::fromMinMax( 800, 4000 );
-            Range1i dstRange = Range1i::fromMinMax( 51, 256 );
-            linearRemapToLuminance( src2D, srcRange, dstRange,
-                tonemappedDepth );
-
-            printf( "Writing depth frame to %s\n", outputFilename.c_str() );
-            PNGIO::write( outputFilename, tonemappedDepth );
+            queue.enqueue( END_OF_FRAMES );
         }
+    } );
 
-        if( streamId == infraredStream )
+    std::atomic< int > nWorkersRunning( nThreads );
+    std::vector< std::thread > workers;
+    for( int t = 0; t < nThreads; ++t )
+    {
+        workers.emplace_back( [&]
         {
-            std::string outputFilename = infraredNFB.filenameForNumber(
-                frameIndex );
-            outputFilename += "_" +
-                toZeroFilledString( timestamp, TIMESTAMP_FIELD_WIDTH ) +
-                ".png";
+            encodeWorker( inputStream, settings, queue, stats );
+            --nWorkersRunning;
+        } );
+    }
 
-            Array2DReadView< uint16_t > src2D( src.pointer(),
-                inputStream.metadata()[ infraredStream ].size );
+    // Report throughput about once a second until the workers are done.
+    const auto REPORT_INTERVAL = std::chrono::seconds( 1 );
+    auto lastReportTime = startTime;
+    int lastReportFrames = 0;
+    while( nWorkersRunning > 0 )
+    {
+        std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        auto now = std::chrono::steady_clock::now();
+        if( now - lastReportTime >= REPORT_INTERVAL )
+        {
+            int nWritten = stats.nFramesWritten;
+            double dt = std::chrono::duration< double >(
+                now - lastReportTime ).count();
+            printf( "%d / %d frames, %.1f frames/s\n", nWritten,
+                nFramesTotal, ( nWritten - lastReportFrames ) / dt );
+            lastReportTime = now;
+            lastReportFrames = nWritten;
+        }
+    }
 
-            Range1i srcRange( 1024 );
-            Range1i dstRange( 256 );
-            linearRemapToLuminance( src2D, srcRange, dstRange,
-                tonemappedInfrared );
+    reader.join();
+    for( std::thread& worker : workers )
+    {
+        worker.join();
+    }
 
-            printf( "Writing infrared frame to %s\n", outputFilename.c_str() );
-            PNGIO::write( outputFilename, tonemappedInfrared );
-        }
-        src =
-            inputStream.read( streamId, frameIndex, timestamp );
+    double seconds = std::chrono::duration< double >(
+        std::chrono::steady_clock::now() - startTime ).count();
+    int nWritten = stats.nFramesWritten;
+    printf( "Wrote %d frames in %.2f s: %.1f frames/s, %.1f MB/s of input.\n",
+        nWritten, seconds, nWritten / seconds,
+        stats.nBytesRead / ( 1024.0 * 1024.0 ) / seconds );
+
+    if( stats.nFramesFailed > 0 )
+    {
+        fprintf( stderr, "%d frames could not be exported.\n",
+            static_cast< int >( stats.nFramesFailed ) );
+        return 4;
     }
     return 0;
 }
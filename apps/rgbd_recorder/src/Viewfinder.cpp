@@ -26,6 +26,10 @@ using libcgt::qt_interop::viewGrayscale8;
 using libcgt::qt_interop::viewRGB32AsBGRX;
 using libcgt::qt_interop::viewRGB32AsBGR;
 
+// Frames are written to disk on a background thread. This is about 1 second
+// of frames for three streams at 30 Hz.
+const int WRITE_BEHIND_BUFFER_COUNT = 90;
+
 Viewfinder::Viewfinder( const std::vector< StreamConfig >& streamConfig,
     const std::string& dir, QWidget* parent ) :
     m_nfb( pystring::os::path::join( dir, "recording_" ), ".rgbd" ),
@@ -192,8 +196,8 @@ void Viewfinder::startWriting()
             filename = m_nfb.filenameForNumber( m_nextFileNumber );
         }
         m_filename = filename;
-        m_outputStream = RGBDOutputStream(
-            m_outputMetadata, m_filename.c_str() );
+        m_outputStream = RGBDOutputStream( m_outputMetadata,
+            m_filename.c_str(), WRITE_BEHIND_BUFFER_COUNT );
 
         emit statusChanged( QString( "Writing to: " ) +
             QString::fromStdString( m_filename ) );
@@ -203,6 +207,11 @@ void Viewfinder::startWriting()
 void Viewfinder::stopWriting()
 {
     m_filename = "";
+    if( m_outputStream.numFramesDropped() > 0 )
+    {
+        printf( "Dropped %lld frames.\n", static_cast< long long >(
+            m_outputStream.numFramesDropped() ) );
+    }
     m_outputStream.close();
     emit statusChanged( QString("Idle.") );
 }
@@ -269,5 +278,8 @@ void Viewfinder::writeFrame( OpenNI2Camera::FrameView frame )
         m_outputStream.write( m_infraredStreamIndex, frame.infraredFrameNumber,
             frame.infraredTimestampNS, view );
     }
+    status += QString( " (%1 pending, %2 dropped)" ).arg(
+        m_outputStream.numFramesPending() ).arg(
+        m_outputStream.numFramesDropped() );
     emit statusChanged( status );
 }
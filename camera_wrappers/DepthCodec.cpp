@@ -0,0 +1,413 @@
+#include "DepthCodec.h"
+
+#include <cstdlib>
+
+namespace libcgt { namespace camera_wrappers {
+
+namespace
+{
+
+// Residual contexts, chosen by quantizing the local gradient.
+const int NUM_RESIDUAL_CONTEXTS = 6;
+const int GRADIENT_THRESHOLDS[ NUM_RESIDUAL_CONTEXTS - 1 ] =
+    { 0, 4, 16, 64, 256 };
+
+// A Golomb-Rice code longer than this is escaped and written in raw bits.
+const int MAX_UNARY_LENGTH = 24;
+const int RAW_SYMBOL_BITS = 32;
+
+// Statistics are halved every RESET_INTERVAL symbols so that k keeps up with
+// changes in the image.
+const uint32_t RESET_INTERVAL = 64;
+
+// Adaptive Golomb-Rice parameter, as in JPEG-LS: k is the smallest integer
+// such that n * 2^k >= a, where a is the running sum of symbols and n is the
+// running count.
+struct RiceContext
+{
+    uint32_t a = 4;
+    uint32_t n = 1;
+
+    int k() const
+    {
+        int k = 0;
+        while( ( n << k ) < a && k < 24 )
+        {
+            ++k;
+        }
+        return k;
+    }
+
+    void update( uint32_t symbol )
+    {
+        a += symbol;
+        ++n;
+        if( n == RESET_INTERVAL )
+        {
+            a = ( a + 1 ) >> 1;
+            n >>= 1;
+        }
+    }
+};
+
+class BitWriter
+{
+public:
+
+    BitWriter( std::vector< uint8_t >& output ) :
+        m_output( output )
+    {
+
+    }
+
+    // Append the low "count" bits of "bits", count <= 32.
+    void put( uint32_t bits, int count )
+    {
+        m_accumulator |= static_cast< uint64_t >( bits ) << m_nBits;
+        m_nBits += count;
+        if( m_nBits >= 32 )
+        {
+            m_output.push_back( static_cast< uint8_t >( m_accumulator ) );
+            m_output.push_back( static_cast< uint8_t >( m_accumulator >> 8 ) );
+            m_output.push_back( static_cast< uint8_t >( m_accumulator >> 16 ) );
+            m_output.push_back( static_cast< uint8_t >( m_accumulator >> 24 ) );
+            m_accumulator >>= 32;
+            m_nBits -= 32;
+        }
+    }
+
+    void putRice( uint32_t symbol, int k )
+    {
+        uint32_t q = symbol >> k;
+        if( q < MAX_UNARY_LENGTH )
+        {
+            // q ones followed by a zero, then the low k bits.
+            put( ( 1u << q ) - 1, q + 1 );
+            if( k > 0 )
+            {
+                put( symbol & ( ( 1u << k ) - 1 ), k );
+            }
+        }
+        else
+        {
+            put( ( 1u << MAX_UNARY_LENGTH ) - 1, MAX_UNARY_LENGTH );
+            put( symbol, RAW_SYMBOL_BITS );
+        }
+    }
+
+    void flush()
+    {
+        while( m_nBits > 0 )
+        {
+            m_output.push_back( static_cast< uint8_t >( m_accumulator ) );
+            m_accumulator >>= 8;
+            m_nBits -= 8;
+        }
+        m_accumulator = 0;
+        m_nBits = 0;
+    }
+
+private:
+
+    std::vector< uint8_t >& m_output;
+    uint64_t m_accumulator = 0;
+    int m_nBits = 0;
+};
+
+class BitReader
+{
+public:
+
+    BitReader( const uint8_t* data, size_t size ) :
+        m_pointer( data ),
+        m_end( data + size )
+    {
+
+    }
+
+    // Read "count" bits, count <= 32.
+    uint32_t get( int count )
+    {
+        if( m_nBits < count )
+        {
+            refill();
+        }
+        uint32_t bits = static_cast< uint32_t >( m_accumulator &
+            ( ( static_cast< uint64_t >( 1 ) << count ) - 1 ) );
+        m_accumulator >>= count;
+        m_nBits -= count;
+        return bits;
+    }
+
+    uint32_t getRice( int k )
+    {
+        uint32_t q = 0;
+        while( q < MAX_UNARY_LENGTH && get( 1 ) != 0 )
+        {
+            ++q;
+        }
+
+        if( q < MAX_UNARY_LENGTH )
+        {
+            uint32_t r = ( k > 0 ) ? get( k ) : 0;
+            return ( q << k ) | r;
+        }
+        else
+        {
+            return get( RAW_SYMBOL_BITS );
+        }
+    }
+
+    // Returns true if more bits were consumed than were available.
+    bool overran() const
+    {
+        return( m_nPaddingBytes * 8 > m_nBits );
+    }
+
+private:
+
+    void refill()
+    {
+        while( m_nBits <= 56 )
+        {
+            uint64_t byte = 0;
+            if( m_pointer < m_end )
+            {
+                byte = *m_pointer;
+                ++m_pointer;
+            }
+            else
+            {
+                ++m_nPaddingBytes;
+            }
+            m_accumulator |= byte << m_nBits;
+            m_nBits += 8;
+        }
+    }
+
+    const uint8_t* m_pointer;
+    const uint8_t* m_end;
+    uint64_t m_accumulator = 0;
+    int m_nBits = 0;
+    int m_nPaddingBytes = 0;
+};
+
+// Map a residual in [-32768, 32767] to [0, 65535]: 0, -1, 1, -2, 2, ...
+inline uint32_t zigzag( int16_t residual )
+{
+    int32_t r = residual;
+    return static_cast< uint32_t >( ( r << 1 ) ^ ( r >> 31 ) ) & 0xffff;
+}
+
+inline int16_t unzigzag( uint32_t symbol )
+{
+    return static_cast< int16_t >(
+        static_cast< int32_t >( symbol >> 1 ) ^
+        -static_cast< int32_t >( symbol & 1 ) );
+}
+
+// Shared by the encoder and decoder: given the reconstructed neighbors of a
+// pixel, compute its prediction and context.
+//
+// row is the current row, up is the previous row (nullptr for the first row)
+// and lastValid is the last nonzero pixel in scan order.
+inline void predict( const uint16_t* row, const uint16_t* up, int x,
+    uint16_t lastValid, int& prediction, int& context )
+{
+    int a = ( x > 0 ) ? row[ x - 1 ] : ( up != nullptr ? up[ x ] : 0 );
+    int b = ( up != nullptr ) ? up[ x ] : a;
+    int c = ( up != nullptr && x > 0 ) ? up[ x - 1 ] : b;
+
+    // Zeros are invalid: substitute them with valid neighbors.
+    if( a == 0 )
+    {
+        a = ( b != 0 ) ? b : ( c != 0 ) ? c : lastValid;
+    }
+    if( b == 0 )
+    {
+        b = a;
+    }
+    if( c == 0 )
+    {
+        c = a;
+    }
+
+    // Median edge detector.
+    int minAB = a < b ? a : b;
+    int maxAB = a < b ? b : a;
+    if( c >= maxAB )
+    {
+        prediction = minAB;
+    }
+    else if( c <= minAB )
+    {
+        prediction = maxAB;
+    }
+    else
+    {
+        prediction = a + b - c;
+    }
+
+    int gradient = std::abs( a - c ) + std::abs( b - c );
+    context = 0;
+    while( context < NUM_RESIDUAL_CONTEXTS - 1 &&
+        gradient > GRADIENT_THRESHOLDS[ context ] )
+    {
+        ++context;
+    }
+}
+
+// Run mode is entered at pixel x when the previous pixel is invalid.
+inline bool isRunMode( const uint16_t* row, const uint16_t* up, int x )
+{
+    if( x > 0 )
+    {
+        return( row[ x - 1 ] == 0 );
+    }
+    return( up != nullptr && up[ 0 ] == 0 );
+}
+
+}
+
+bool compressDepth( Array2DReadView< uint16_t > src,
+    std::vector< uint8_t >& dst )
+{
+    dst.clear();
+    if( src.isNull() || !src.elementsArePacked() )
+    {
+        return false;
+    }
+
+    // Typical depth maps code to 3-5 bits per pixel.
+    dst.reserve( src.numElements() );
+
+    RiceContext residualContexts[ NUM_RESIDUAL_CONTEXTS ];
+    RiceContext runContext;
+    BitWriter writer( dst );
+    uint16_t lastValid = 0;
+
+    int width = src.width();
+    for( int y = 0; y < src.height(); ++y )
+    {
+        const uint16_t* row = src.rowPointer( y );
+        const uint16_t* up = ( y > 0 ) ? src.rowPointer( y - 1 ) : nullptr;
+
+        int x = 0;
+        while( x < width )
+        {
+            if( isRunMode( row, up, x ) )
+            {
+                int runLength = 0;
+                while( x + runLength < width && row[ x + runLength ] == 0 )
+                {
+                    ++runLength;
+                }
+
+                uint32_t symbol = static_cast< uint32_t >( runLength );
+                writer.putRice( symbol, runContext.k() );
+                runContext.update( symbol );
+
+                x += runLength;
+                if( x == width )
+                {
+                    break;
+                }
+            }
+
+            int prediction;
+            int context;
+            predict( row, up, x, lastValid, prediction, context );
+
+            uint16_t value = row[ x ];
+            uint32_t symbol = 0;
+            if( value != 0 )
+            {
+                symbol = zigzag( static_cast< int16_t >(
+                    value - prediction ) ) + 1;
+                lastValid = value;
+            }
+
+            writer.putRice( symbol, residualContexts[ context ].k() );
+            residualContexts[ context ].update( symbol );
+            ++x;
+        }
+    }
+
+    writer.flush();
+    return true;
+}
+
+bool decompressDepth( Array1DReadView< uint8_t > src,
+    Array2DWriteView< uint16_t > dst )
+{
+    if( src.isNull() || !src.packed() ||
+        dst.isNull() || !dst.elementsArePacked() )
+    {
+        return false;
+    }
+
+    RiceContext residualContexts[ NUM_RESIDUAL_CONTEXTS ];
+    RiceContext runContext;
+    BitReader reader( src.pointer(), src.size() );
+    uint16_t lastValid = 0;
+
+    int width = dst.width();
+    for( int y = 0; y < dst.height(); ++y )
+    {
+        uint16_t* row = dst.rowPointer( y );
+        const uint16_t* up = ( y > 0 ) ? dst.rowPointer( y - 1 ) : nullptr;
+
+        int x = 0;
+        while( x < width )
+        {
+            if( isRunMode( row, up, x ) )
+            {
+                uint32_t symbol = reader.getRice( runContext.k() );
+                runContext.update( symbol );
+
+                if( symbol > static_cast< uint32_t >( width - x ) )
+                {
+                    return false;
+                }
+
+                int runLength = static_cast< int >( symbol );
+                for( int i = 0; i < runLength; ++i )
+                {
+                    row[ x + i ] = 0;
+                }
+
+                x += runLength;
+                if( x == width )
+                {
+                    break;
+                }
+            }
+
+            int prediction;
+            int context;
+            predict( row, up, x, lastValid, prediction, context );
+
+            uint32_t symbol =
+                reader.getRice( residualContexts[ context ].k() );
+            residualContexts[ context ].update( symbol );
+            if( symbol > 0x10000 )
+            {
+                return false;
+            }
+
+            uint16_t value = 0;
+            if( symbol != 0 )
+            {
+                value = static_cast< uint16_t >(
+                    prediction + unzigzag( symbol - 1 ) );
+                lastValid = value;
+            }
+            row[ x ] = value;
+            ++x;
+        }
+    }
+
+    return !reader.overran();
+}
+
+} } // camera_wrappers, libcgt
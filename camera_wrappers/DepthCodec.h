@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <common/ArrayView.h>
+
+namespace libcgt { namespace camera_wrappers {
+
+// A fast lossless codec for 16-bit depth images.
+//
+// Each pixel is predicted from its left, upper and upper-left neighbors using
+// the median edge detector from JPEG-LS. The residual is Golomb-Rice coded
+// with a parameter that adapts to the local gradient. Since 0 is the invalid
+// depth value, runs of zeros are coded as a single run length.
+//
+// Rows are coded in order and the size of the image is not stored: the
+// decoder must be given a destination of the same size as the source.
+
+// Compress "src", replacing the contents of "dst".
+// Returns false if src is null or its elements are not packed.
+bool compressDepth( Array2DReadView< uint16_t > src,
+    std::vector< uint8_t >& dst );
+
+// Decompress "src" into "dst", which must have the same size as the image
+// that was compressed.
+// Returns false if src is null or not packed, if dst is null or its elements
+// are not packed, or if src is corrupt.
+bool decompressDepth( Array1DReadView< uint8_t > src,
+    Array2DWriteView< uint16_t > dst );
+
+} } // camera_wrappers, libcgt
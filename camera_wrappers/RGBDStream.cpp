@@ -1,10 +1,223 @@
 #include "RGBDStream.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cstring>
+#include <thread>
+
+#include <common/ArrayUtils.h>
+#include <concurrency/BoundedConcurrentQueue.h>
+
+#include "DepthCodec.h"
+
+using libcgt::core::concurrency::BoundedConcurrentQueue;
 
 namespace libcgt { namespace camera_wrappers {
 
-const uint32_t FORMAT_VERSION = 1;
+// Version 2 added StreamMetadata::compression and the payload size to every
+// frame header. Version 1 files can still be read.
+const uint32_t FORMAT_VERSION = 2;
+
+// Every frame is preceded by a header: streamId, frameIndex, timestamp and,
+// since version 2, the size of the frame's payload in bytes.
+const int64_t FRAME_HEADER_SIZE_V1 =
+    sizeof( uint32_t ) + sizeof( int32_t ) + sizeof( int64_t );
+const int64_t FRAME_HEADER_SIZE_V2 = FRAME_HEADER_SIZE_V1 + sizeof( uint32_t );
+
+// The optional index at the end of the file is laid out as:
+//   INDEX_MARKER (in place of a streamId, so that readers stop there)
+//   nEntries (uint32_t)
+//   RGBDFrameIndexEntry[ nEntries ]
+//   indexOffset (int64_t, the offset of INDEX_MARKER)
+//   "rgbi"
+const uint32_t INDEX_MARKER = 0xffffffff;
+const int64_t INDEX_FOOTER_SIZE = sizeof( int64_t ) + 4;
+
+namespace
+{
+
+int64_t frameHeaderSize( uint32_t version )
+{
+    return( version >= 2 ? FRAME_HEADER_SIZE_V2 : FRAME_HEADER_SIZE_V1 );
+}
+
+// The size of an uncompressed frame.
+size_t rawFrameSizeBytes( const StreamMetadata& metadata )
+{
+    return pixelSizeBytes( metadata.format ) *
+        metadata.size.x * metadata.size.y;
+}
+
+bool isSupported( const StreamMetadata& metadata )
+{
+    switch( metadata.compression )
+    {
+    case StreamCompression::NONE:
+        return true;
+    case StreamCompression::DEPTH_RICE_U16:
+        return( pixelSizeBytes( metadata.format ) == sizeof( uint16_t ) );
+    default:
+        return false;
+    }
+}
+
+// Returns the payload to store for the uncompressed frame "data". If the
+// stream is compressed, "scratch" holds the payload.
+Array1DReadView< uint8_t > encodeFrame( const StreamMetadata& metadata,
+    Array1DReadView< uint8_t > data, std::vector< uint8_t >& scratch )
+{
+    if( data.size() != rawFrameSizeBytes( metadata ) )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+
+    switch( metadata.compression )
+    {
+    case StreamCompression::NONE:
+        return data;
+    case StreamCompression::DEPTH_RICE_U16:
+        if( data.packed() && compressDepth(
+            Array2DReadView< uint16_t >( data.pointer(), metadata.size ),
+            scratch ) )
+        {
+            return Array1DReadView< uint8_t >( scratch.data(),
+                scratch.size() );
+        }
+        return Array1DReadView< uint8_t >();
+    default:
+        return Array1DReadView< uint8_t >();
+    }
+}
+
+// Decode the stored payload of a compressed frame into "dst", which has the
+// uncompressed size.
+bool decodeFrame( const StreamMetadata& metadata,
+    Array1DReadView< uint8_t > payload, Array1DWriteView< uint8_t > dst )
+{
+    switch( metadata.compression )
+    {
+    case StreamCompression::DEPTH_RICE_U16:
+        return decompressDepth( payload,
+            Array2DWriteView< uint16_t >( dst.pointer(), metadata.size ) );
+    default:
+        return false;
+    }
+}
+
+// For each stream, the positions in "index" of its frames.
+std::vector< std::vector< int > > buildStreamIndex(
+    const std::vector< RGBDFrameIndexEntry >& index, size_t nStreams )
+{
+    std::vector< std::vector< int > > streamIndex( nStreams );
+    for( int i = 0; i < static_cast< int >( index.size() ); ++i )
+    {
+        streamIndex[ index[ i ].streamId ].push_back( i );
+    }
+    return streamIndex;
+}
+
+// Returns the position in "index" of the entry in "entries" with frame index
+// "frameIndex", or -1 if there is none.
+int findFrame( const std::vector< RGBDFrameIndexEntry >& index,
+    const std::vector< int >& entries, int32_t frameIndex )
+{
+    auto itr = std::lower_bound( entries.begin(), entries.end(), frameIndex,
+        [&] ( int i, int32_t value )
+        {
+            return index[ i ].frameIndex < value;
+        }
+    );
+
+    if( itr == entries.end() || index[ *itr ].frameIndex != frameIndex )
+    {
+        return -1;
+    }
+    return *itr;
+}
+
+// Returns the position in "index" of the first entry in "entries" with a
+// timestamp >= "timestamp", or -1 if there is none.
+int findTimestamp( const std::vector< RGBDFrameIndexEntry >& index,
+    const std::vector< int >& entries, int64_t timestamp )
+{
+    auto itr = std::lower_bound( entries.begin(), entries.end(), timestamp,
+        [&] ( int i, int64_t value )
+        {
+            return index[ i ].timestamp < value;
+        }
+    );
+
+    if( itr == entries.end() )
+    {
+        return -1;
+    }
+    return *itr;
+}
+
+// Encode a frame, append it to "stream" and record it in "index".
+bool writeFrame( const BinaryFileOutputStream& stream,
+    std::vector< RGBDFrameIndexEntry >& index,
+    const StreamMetadata& metadata, std::vector< uint8_t >& scratch,
+    uint32_t streamId, int32_t frameIndex, int64_t timestamp,
+    Array1DReadView< uint8_t > data )
+{
+    Array1DReadView< uint8_t > payload =
+        encodeFrame( metadata, data, scratch );
+    if( payload.isNull() )
+    {
+        return false;
+    }
+
+    int64_t offset = stream.tell();
+    if( offset < 0 )
+    {
+        return false;
+    }
+
+    if( !stream.write( streamId ) )
+    {
+        return false;
+    }
+
+    if( !stream.write( frameIndex ) )
+    {
+        return false;
+    }
+
+    if( !stream.write( timestamp ) )
+    {
+        return false;
+    }
+
+    if( !stream.write( static_cast< uint32_t >( payload.size() ) ) )
+    {
+        return false;
+    }
+
+    if( !stream.writeArray( payload ) )
+    {
+        return false;
+    }
+
+    index.push_back(
+        RGBDFrameIndexEntry{ streamId, frameIndex, timestamp, offset } );
+    return true;
+}
+
+template< typename T >
+bool readAt( const MemoryMappedFile& file, int64_t offset, T& output )
+{
+    if( offset < 0 ||
+        static_cast< uint64_t >( offset ) + sizeof( T ) > file.size() )
+    {
+        return false;
+    }
+    memcpy( &output, file.data() + offset, sizeof( T ) );
+    return true;
+}
+
+}
 
 RGBDInputStream::RGBDInputStream( const char* filename ) :
     m_stream( filename )
@@ -20,8 +233,10 @@ RGBDInputStream::RGBDInputStream( const char* filename ) :
     ok = m_stream.read( magic[ 3 ] );
     ok = m_stream.read( version );
 
-    if( ok && strcmp( magic, "rgbd" ) == 0 && version == FORMAT_VERSION )
+    if( ok && strcmp( magic, "rgbd" ) == 0 &&
+        version >= 1 && version <= FORMAT_VERSION )
     {
+        m_version = version;
         uint32_t nStreams = 0;
         ok = m_stream.read( nStreams );
         if( ok && nStreams > 0 )
@@ -29,13 +244,23 @@ RGBDInputStream::RGBDInputStream( const char* filename ) :
             m_metadata.resize( nStreams );
             for( uint32_t i = 0; i < nStreams; ++i )
             {
-                ok = m_stream.read( m_metadata[ i ] );
+                StreamMetadata& md = m_metadata[ i ];
+                if( version >= 2 )
+                {
+                    ok = m_stream.read( md );
+                }
+                else
+                {
+                    ok = m_stream.read( md.type ) &&
+                        m_stream.read( md.format ) &&
+                        m_stream.read( md.size );
+                    md.compression = StreamCompression::NONE;
+                }
+                ok = ok && isSupported( md );
+
                 if( ok )
                 {
-                    uint32_t bufferSize =
-                        pixelSizeBytes( m_metadata[ i ].format ) *
-                        m_metadata[ i ].size.x * m_metadata[ i ].size.y;
-                    m_buffers.emplace_back( bufferSize );
+                    m_buffers.emplace_back( rawFrameSizeBytes( md ) );
                 }
 
                 if( !ok )
@@ -46,6 +271,24 @@ RGBDInputStream::RGBDInputStream( const char* filename ) :
             }
         }
     }
+    else
+    {
+        ok = false;
+    }
+
+    if( ok && m_metadata.size() > 0 )
+    {
+        m_firstFrameOffset = m_stream.tell();
+        int64_t fileSize = m_stream.seekToEnd();
+        if( !readIndex( fileSize ) )
+        {
+            rebuildIndex( fileSize );
+        }
+
+        m_streamIndex = buildStreamIndex( m_index, m_metadata.size() );
+
+        ok = m_stream.seek( m_firstFrameOffset );
+    }
 
     m_valid = ok;
 }
@@ -60,6 +303,20 @@ const std::vector< StreamMetadata>& RGBDInputStream::metadata() const
     return m_metadata;
 }
 
+const std::vector< RGBDFrameIndexEntry >& RGBDInputStream::index() const
+{
+    return m_index;
+}
+
+int RGBDInputStream::numFrames( uint32_t streamId ) const
+{
+    if( streamId >= m_streamIndex.size() )
+    {
+        return 0;
+    }
+    return static_cast< int >( m_streamIndex[ streamId ].size() );
+}
+
 Array1DReadView< uint8_t > RGBDInputStream::read( uint32_t& streamId,
     int32_t& frameIndex, int64_t& timestamp )
 {
@@ -73,10 +330,15 @@ Array1DReadView< uint8_t > RGBDInputStream::read( uint32_t& streamId,
             if( ok )
             {
                 ok = m_stream.read( timestamp );
+                uint32_t payloadSize =
+                    static_cast< uint32_t >( m_buffers[ streamId ].size() );
+                if( ok && m_version >= 2 )
+                {
+                    ok = m_stream.read( payloadSize );
+                }
                 if( ok )
                 {
-                    Array1DWriteView< uint8_t > wv = m_buffers[ streamId ];
-                    ok = m_stream.readArray( wv );
+                    ok = readPayload( streamId, payloadSize );
                     if( ok )
                     {
                         return m_buffers[ streamId ];
@@ -89,6 +351,525 @@ Array1DReadView< uint8_t > RGBDInputStream::read( uint32_t& streamId,
     return Array1DReadView< uint8_t >();
 }
 
+bool RGBDInputStream::readPayload( uint32_t streamId, uint32_t payloadSize )
+{
+    const StreamMetadata& md = m_metadata[ streamId ];
+    Array1DWriteView< uint8_t > wv = m_buffers[ streamId ];
+    if( md.compression == StreamCompression::NONE )
+    {
+        return( payloadSize == wv.size() && m_stream.readArray( wv ) );
+    }
+
+    if( m_compressed.size() < payloadSize )
+    {
+        m_compressed.resize( payloadSize );
+    }
+    Array1DWriteView< uint8_t > payload( m_compressed.data(), payloadSize );
+    return( m_stream.readArray( payload ) && decodeFrame( md, payload, wv ) );
+}
+
+bool RGBDInputStream::rewind()
+{
+    return isValid() && m_stream.seek( m_firstFrameOffset );
+}
+
+bool RGBDInputStream::seekToFrame( uint32_t streamId, int32_t frameIndex )
+{
+    if( !isValid() || streamId >= m_streamIndex.size() )
+    {
+        return false;
+    }
+
+    int i = findFrame( m_index, m_streamIndex[ streamId ], frameIndex );
+    return( i != -1 && m_stream.seek( m_index[ i ].offset ) );
+}
+
+bool RGBDInputStream::seekToTimestamp( uint32_t streamId, int64_t timestamp )
+{
+    if( !isValid() || streamId >= m_streamIndex.size() )
+    {
+        return false;
+    }
+
+    int i = findTimestamp( m_index, m_streamIndex[ streamId ], timestamp );
+    return( i != -1 && m_stream.seek( m_index[ i ].offset ) );
+}
+
+bool RGBDInputStream::readIndex( int64_t fileSize )
+{
+    if( fileSize < m_firstFrameOffset + INDEX_FOOTER_SIZE )
+    {
+        return false;
+    }
+
+    int64_t indexOffset;
+    char magic[ 5 ] = {};
+    bool ok = m_stream.seek( fileSize - INDEX_FOOTER_SIZE );
+    ok = ok && m_stream.read( indexOffset );
+    ok = ok && m_stream.read( magic[ 0 ] );
+    ok = ok && m_stream.read( magic[ 1 ] );
+    ok = ok && m_stream.read( magic[ 2 ] );
+    ok = ok && m_stream.read( magic[ 3 ] );
+    if( !ok || strcmp( magic, "rgbi" ) != 0 ||
+        indexOffset < m_firstFrameOffset ||
+        indexOffset > fileSize - INDEX_FOOTER_SIZE )
+    {
+        return false;
+    }
+
+    uint32_t marker;
+    uint32_t nEntries;
+    ok = m_stream.seek( indexOffset );
+    ok = ok && m_stream.read( marker );
+    ok = ok && m_stream.read( nEntries );
+    int64_t indexEnd = indexOffset +
+        static_cast< int64_t >( 2 * sizeof( uint32_t ) ) +
+        static_cast< int64_t >( nEntries ) *
+            static_cast< int64_t >( sizeof( RGBDFrameIndexEntry ) );
+    if( !ok || marker != INDEX_MARKER ||
+        indexEnd != fileSize - INDEX_FOOTER_SIZE )
+    {
+        return false;
+    }
+
+    std::vector< RGBDFrameIndexEntry > index( nEntries );
+    if( nEntries > 0 )
+    {
+        ok = m_stream.readArray( Array1DWriteView< RGBDFrameIndexEntry >(
+            index.data(), index.size() ) );
+    }
+
+    for( size_t i = 0; ok && i < index.size(); ++i )
+    {
+        ok = ( index[ i ].streamId < m_metadata.size() );
+    }
+
+    if( ok )
+    {
+        m_index = std::move( index );
+    }
+    return ok;
+}
+
+void RGBDInputStream::rebuildIndex( int64_t fileSize )
+{
+    m_index.clear();
+
+    int64_t headerSize = frameHeaderSize( m_version );
+    int64_t offset = m_firstFrameOffset;
+    while( offset + headerSize <= fileSize &&
+        m_stream.seek( offset ) )
+    {
+        RGBDFrameIndexEntry entry;
+        entry.offset = offset;
+        bool ok = m_stream.read( entry.streamId );
+        ok = ok && entry.streamId < m_buffers.size();
+        ok = ok && m_stream.read( entry.frameIndex );
+        ok = ok && m_stream.read( entry.timestamp );
+        uint32_t payloadSize = 0;
+        if( ok )
+        {
+            payloadSize = static_cast< uint32_t >(
+                m_buffers[ entry.streamId ].size() );
+        }
+        if( ok && m_version >= 2 )
+        {
+            ok = m_stream.read( payloadSize );
+        }
+        if( !ok )
+        {
+            break;
+        }
+
+        int64_t frameEnd = offset + headerSize + payloadSize;
+        // Drop a truncated final frame.
+        if( frameEnd > fileSize )
+        {
+            break;
+        }
+
+        m_index.push_back( entry );
+        offset = frameEnd;
+    }
+}
+
+RGBDMappedInputStream::RGBDMappedInputStream( const char* filename ) :
+    m_file( filename )
+{
+    bool ok = m_file.isValid();
+
+    // Read header.
+    char magic[ 5 ] = {};
+    uint32_t version = 0;
+    uint32_t nStreams = 0;
+    ok = ok && readAt( m_file, 0, magic[ 0 ] );
+    ok = ok && readAt( m_file, 1, magic[ 1 ] );
+    ok = ok && readAt( m_file, 2, magic[ 2 ] );
+    ok = ok && readAt( m_file, 3, magic[ 3 ] );
+    ok = ok && readAt( m_file, 4, version );
+    ok = ok && readAt( m_file, 8, nStreams );
+    int64_t offset = 12;
+
+    ok = ok && strcmp( magic, "rgbd" ) == 0 &&
+        version >= 1 && version <= FORMAT_VERSION && nStreams > 0;
+    if( ok )
+    {
+        m_version = version;
+        m_metadata.resize( nStreams );
+        for( uint32_t i = 0; ok && i < nStreams; ++i )
+        {
+            StreamMetadata& md = m_metadata[ i ];
+            if( version >= 2 )
+            {
+                ok = readAt( m_file, offset, md );
+                offset += sizeof( StreamMetadata );
+            }
+            else
+            {
+                ok = readAt( m_file, offset, md.type ) &&
+                    readAt( m_file, offset + 4, md.format ) &&
+                    readAt( m_file, offset + 8, md.size );
+                md.compression = StreamCompression::NONE;
+                offset += 8 + sizeof( Vector2i );
+            }
+            ok = ok && isSupported( md );
+            m_buffers.emplace_back( ok && md.compression !=
+                StreamCompression::NONE ? rawFrameSizeBytes( md ) : 0 );
+        }
+    }
+
+    if( ok )
+    {
+        m_firstFrameOffset = offset;
+        if( !readIndex() )
+        {
+            rebuildIndex();
+        }
+        m_streamIndex = buildStreamIndex( m_index, m_metadata.size() );
+    }
+    else
+    {
+        m_metadata.clear();
+    }
+
+    m_valid = ok;
+}
+
+bool RGBDMappedInputStream::isValid() const
+{
+    return m_valid && m_file.isValid();
+}
+
+const std::vector< StreamMetadata >& RGBDMappedInputStream::metadata() const
+{
+    return m_metadata;
+}
+
+const std::vector< RGBDFrameIndexEntry >&
+RGBDMappedInputStream::index() const
+{
+    return m_index;
+}
+
+int RGBDMappedInputStream::numFrames( uint32_t streamId ) const
+{
+    if( streamId >= m_streamIndex.size() )
+    {
+        return 0;
+    }
+    return static_cast< int >( m_streamIndex[ streamId ].size() );
+}
+
+Array1DReadView< uint8_t > RGBDMappedInputStream::read( uint32_t& streamId,
+    int32_t& frameIndex, int64_t& timestamp )
+{
+    if( !isValid() || m_nextEntry >= static_cast< int >( m_index.size() ) )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+
+    const RGBDFrameIndexEntry& entry = m_index[ m_nextEntry ];
+    ++m_nextEntry;
+
+    streamId = entry.streamId;
+    frameIndex = entry.frameIndex;
+    timestamp = entry.timestamp;
+    return frameData( entry, m_buffers[ entry.streamId ] );
+}
+
+Array1DReadView< uint8_t > RGBDMappedInputStream::frame( int i )
+{
+    if( !isValid() || i < 0 || i >= static_cast< int >( m_index.size() ) )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+    return frameData( m_index[ i ], m_buffers[ m_index[ i ].streamId ] );
+}
+
+Array1DReadView< uint8_t > RGBDMappedInputStream::frame( uint32_t streamId,
+    int32_t frameIndex )
+{
+    if( !isValid() || streamId >= m_streamIndex.size() )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+
+    int i = findFrame( m_index, m_streamIndex[ streamId ], frameIndex );
+    return frame( i );
+}
+
+Array1DReadView< uint8_t > RGBDMappedInputStream::frame( int i,
+    Array1D< uint8_t >& buffer ) const
+{
+    if( !isValid() || i < 0 || i >= static_cast< int >( m_index.size() ) )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+    return frameData( m_index[ i ], buffer );
+}
+
+bool RGBDMappedInputStream::rewind()
+{
+    m_nextEntry = 0;
+    return isValid();
+}
+
+bool RGBDMappedInputStream::seekToFrame( uint32_t streamId,
+    int32_t frameIndex )
+{
+    if( !isValid() || streamId >= m_streamIndex.size() )
+    {
+        return false;
+    }
+
+    int i = findFrame( m_index, m_streamIndex[ streamId ], frameIndex );
+    if( i == -1 )
+    {
+        return false;
+    }
+    m_nextEntry = i;
+    return true;
+}
+
+bool RGBDMappedInputStream::seekToTimestamp( uint32_t streamId,
+    int64_t timestamp )
+{
+    if( !isValid() || streamId >= m_streamIndex.size() )
+    {
+        return false;
+    }
+
+    int i = findTimestamp( m_index, m_streamIndex[ streamId ], timestamp );
+    if( i == -1 )
+    {
+        return false;
+    }
+    m_nextEntry = i;
+    return true;
+}
+
+bool RGBDMappedInputStream::payloadSizeBytes( int64_t offset,
+    uint32_t streamId, uint32_t& payloadSize ) const
+{
+    if( m_version >= 2 )
+    {
+        return readAt( m_file, offset + FRAME_HEADER_SIZE_V1, payloadSize );
+    }
+    payloadSize =
+        static_cast< uint32_t >( rawFrameSizeBytes( m_metadata[ streamId ] ) );
+    return true;
+}
+
+Array1DReadView< uint8_t > RGBDMappedInputStream::frameData(
+    const RGBDFrameIndexEntry& entry, Array1D< uint8_t >& buffer ) const
+{
+    uint32_t payloadSize;
+    if( !payloadSizeBytes( entry.offset, entry.streamId, payloadSize ) )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+
+    Array1DReadView< uint8_t > payload = m_file.view(
+        static_cast< size_t >( entry.offset + frameHeaderSize( m_version ) ),
+        payloadSize );
+
+    const StreamMetadata& md = m_metadata[ entry.streamId ];
+    if( md.compression == StreamCompression::NONE || payload.isNull() )
+    {
+        return payload;
+    }
+
+    size_t frameSize = rawFrameSizeBytes( md );
+    if( buffer.size() != frameSize )
+    {
+        buffer.resize( frameSize );
+    }
+
+    Array1DWriteView< uint8_t > wv = buffer;
+    if( !decodeFrame( md, payload, wv ) )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+    return wv;
+}
+
+bool RGBDMappedInputStream::readIndex()
+{
+    int64_t fileSize = static_cast< int64_t >( m_file.size() );
+    if( fileSize < m_firstFrameOffset + INDEX_FOOTER_SIZE )
+    {
+        return false;
+    }
+
+    int64_t footerOffset = fileSize - INDEX_FOOTER_SIZE;
+    int64_t indexOffset;
+    bool ok = readAt( m_file, footerOffset, indexOffset );
+    if( !ok || memcmp( m_file.data() + footerOffset + sizeof( int64_t ),
+        "rgbi", 4 ) != 0 ||
+        indexOffset < m_firstFrameOffset || indexOffset > footerOffset )
+    {
+        return false;
+    }
+
+    uint32_t marker;
+    uint32_t nEntries;
+    ok = readAt( m_file, indexOffset, marker );
+    ok = ok && readAt( m_file, indexOffset + sizeof( uint32_t ), nEntries );
+    int64_t entriesOffset = indexOffset +
+        static_cast< int64_t >( 2 * sizeof( uint32_t ) );
+    int64_t indexEnd = entriesOffset +
+        static_cast< int64_t >( nEntries ) *
+            static_cast< int64_t >( sizeof( RGBDFrameIndexEntry ) );
+    if( !ok || marker != INDEX_MARKER || indexEnd != footerOffset )
+    {
+        return false;
+    }
+
+    std::vector< RGBDFrameIndexEntry > index( nEntries );
+    if( nEntries > 0 )
+    {
+        memcpy( index.data(), m_file.data() + entriesOffset,
+            nEntries * sizeof( RGBDFrameIndexEntry ) );
+    }
+
+    for( size_t i = 0; i < index.size(); ++i )
+    {
+        if( index[ i ].streamId >= m_metadata.size() )
+        {
+            return false;
+        }
+    }
+
+    m_index = std::move( index );
+    return true;
+}
+
+void RGBDMappedInputStream::rebuildIndex()
+{
+    m_index.clear();
+
+    int64_t fileSize = static_cast< int64_t >( m_file.size() );
+    int64_t headerSize = frameHeaderSize( m_version );
+    int64_t offset = m_firstFrameOffset;
+    while( offset + headerSize <= fileSize )
+    {
+        RGBDFrameIndexEntry entry;
+        entry.offset = offset;
+        readAt( m_file, offset, entry.streamId );
+        if( entry.streamId >= m_metadata.size() )
+        {
+            break;
+        }
+        readAt( m_file, offset + sizeof( uint32_t ), entry.frameIndex );
+        readAt( m_file, offset + sizeof( uint32_t ) + sizeof( int32_t ),
+            entry.timestamp );
+
+        uint32_t payloadSize;
+        payloadSizeBytes( offset, entry.streamId, payloadSize );
+
+        int64_t frameEnd = offset + headerSize + payloadSize;
+        // Drop a truncated final frame.
+        if( frameEnd > fileSize )
+        {
+            break;
+        }
+
+        m_index.push_back( entry );
+        offset = frameEnd;
+    }
+}
+
+struct RGBDOutputStream::WriteBehind
+{
+    struct Frame
+    {
+        // INDEX_MARKER tells the writer thread to stop.
+        uint32_t streamId = 0;
+        int32_t frameIndex = 0;
+        int64_t timestamp = 0;
+        size_t sizeBytes = 0;
+        Array1D< uint8_t > data;
+    };
+
+    WriteBehind( BinaryFileOutputStream&& _stream,
+        const std::vector< StreamMetadata >& _metadata,
+        std::vector< Frame >&& _buffers, int _maxWaitMilliseconds ) :
+        stream( std::move( _stream ) ),
+        metadata( _metadata ),
+        queue( std::move( _buffers ) ),
+        maxWaitMilliseconds( _maxWaitMilliseconds )
+    {
+        thread = std::thread( &WriteBehind::run, this );
+    }
+
+    // The writer thread's main loop.
+    void run()
+    {
+        while( true )
+        {
+            Frame* frame = queue.beginDequeue();
+            if( frame->streamId == INDEX_MARKER )
+            {
+                queue.endDequeue();
+                break;
+            }
+
+            bool ok = writeFrame( stream, index,
+                metadata[ frame->streamId ], scratch, frame->streamId,
+                frame->frameIndex, frame->timestamp,
+                Array1DReadView< uint8_t >( frame->data.pointer(),
+                    frame->sizeBytes ) );
+            if( !ok )
+            {
+                writeFailed = true;
+            }
+            queue.endDequeue();
+        }
+    }
+
+    BinaryFileOutputStream stream;
+    std::vector< RGBDFrameIndexEntry > index;
+    std::vector< StreamMetadata > metadata;
+
+    // Compressed frames are encoded on the writer thread, into scratch.
+    std::vector< uint8_t > scratch;
+
+    // The ring buffer of the queue is the pool of frame buffers.
+    BoundedConcurrentQueue< Frame > queue;
+    int maxWaitMilliseconds;
+
+    std::atomic< bool > writeFailed{ false };
+    std::atomic< int64_t > nStalls{ 0 };
+    std::atomic< int64_t > nFramesDropped{ 0 };
+
+    std::thread thread;
+};
+
+RGBDOutputStream::RGBDOutputStream()
+{
+
+}
+
 RGBDOutputStream::RGBDOutputStream(
     const std::vector< StreamMetadata >& metadata,
     const char* filename ) :
@@ -97,7 +878,14 @@ RGBDOutputStream::RGBDOutputStream(
     uint32_t nStreams = static_cast< uint32_t >( metadata.size() );
     assert( nStreams > 0 );
 
-    if( nStreams > 0 )
+    bool supported = true;
+    for( size_t i = 0; i < metadata.size(); ++i )
+    {
+        supported = supported && isSupported( metadata[ i ] );
+    }
+    assert( supported );
+
+    if( nStreams > 0 && supported )
     {
         m_stream = BinaryFileOutputStream( filename );
         m_stream.write( 'r' );
@@ -115,6 +903,31 @@ RGBDOutputStream::RGBDOutputStream(
     }
 }
 
+RGBDOutputStream::RGBDOutputStream(
+    const std::vector< StreamMetadata >& metadata,
+    const char* filename, int nBuffers, int maxWaitMilliseconds ) :
+    RGBDOutputStream( metadata, filename )
+{
+    if( isValid() && nBuffers > 0 )
+    {
+        size_t bufferSize = 0;
+        for( size_t i = 0; i < metadata.size(); ++i )
+        {
+            bufferSize = std::max( bufferSize,
+                rawFrameSizeBytes( metadata[ i ] ) );
+        }
+
+        std::vector< WriteBehind::Frame > buffers( nBuffers );
+        for( size_t i = 0; i < buffers.size(); ++i )
+        {
+            buffers[ i ].data.resize( bufferSize );
+        }
+
+        m_writeBehind.reset( new WriteBehind( std::move( m_stream ),
+            m_metadata, std::move( buffers ), maxWaitMilliseconds ) );
+    }
+}
+
 // virtual
 RGBDOutputStream::~RGBDOutputStream()
 {
@@ -126,9 +939,12 @@ RGBDOutputStream::RGBDOutputStream( RGBDOutputStream&& move )
     close();
     m_stream = std::move( move.m_stream );
     m_metadata = std::move( move.m_metadata );
+    m_index = std::move( move.m_index );
+    m_writeBehind = std::move( move.m_writeBehind );
 
     move.m_stream = BinaryFileOutputStream();
     move.m_metadata = std::vector< StreamMetadata >();
+    move.m_index = std::vector< RGBDFrameIndexEntry >();
 }
 
 RGBDOutputStream& RGBDOutputStream::operator = ( RGBDOutputStream&& move )
@@ -138,47 +954,150 @@ RGBDOutputStream& RGBDOutputStream::operator = ( RGBDOutputStream&& move )
         close();
         m_stream = std::move( move.m_stream );
         m_metadata = std::move( move.m_metadata );
+        m_index = std::move( move.m_index );
+        m_writeBehind = std::move( move.m_writeBehind );
 
         move.m_stream = BinaryFileOutputStream();
         move.m_metadata = std::vector< StreamMetadata >();
+        move.m_index = std::vector< RGBDFrameIndexEntry >();
     }
     return *this;
 }
 
 bool RGBDOutputStream::isValid() const
 {
-    return m_stream.isOpen();
+    return( m_stream.isOpen() || m_writeBehind != nullptr );
+}
+
+bool RGBDOutputStream::isWriteBehind() const
+{
+    return( m_writeBehind != nullptr );
 }
 
 bool RGBDOutputStream::close()
 {
-    return m_stream.close();
+    bool framesWritten = true;
+    if( m_writeBehind != nullptr )
+    {
+        framesWritten = stopWriteBehind();
+    }
+
+    if( !m_stream.isOpen() )
+    {
+        return false;
+    }
+
+    bool indexWritten = writeIndex();
+    m_index.clear();
+    bool closed = m_stream.close();
+    return framesWritten && indexWritten && closed;
 }
 
 bool RGBDOutputStream::write( uint32_t streamId, int32_t frameIndex,
-    int64_t timestamp, Array1DReadView< uint8_t > data ) const
+    int64_t timestamp, Array1DReadView< uint8_t > data )
 {
     if( streamId >= m_metadata.size() )
     {
         return false;
     }
 
-    if( !m_stream.write( streamId ) )
+    if( m_writeBehind == nullptr )
     {
-        return false;
+        return writeFrame( m_stream, m_index, m_metadata[ streamId ],
+            m_scratch, streamId, frameIndex, timestamp, data );
     }
 
-    if( !m_stream.write( frameIndex ) )
+    WriteBehind& wb = *m_writeBehind;
+    if( wb.writeFailed || data.isNull() ||
+        data.size() != rawFrameSizeBytes( m_metadata[ streamId ] ) )
     {
         return false;
     }
 
-    if( !m_stream.write( timestamp ) )
+    WriteBehind::Frame* frame = wb.queue.tryBeginEnqueue( 0 );
+    if( frame == nullptr )
+    {
+        ++wb.nStalls;
+        frame = wb.queue.tryBeginEnqueue( wb.maxWaitMilliseconds );
+        if( frame == nullptr )
+        {
+            ++wb.nFramesDropped;
+            return false;
+        }
+    }
+
+    frame->streamId = streamId;
+    frame->frameIndex = frameIndex;
+    frame->timestamp = timestamp;
+    frame->sizeBytes = data.size();
+    libcgt::core::arrayutils::copy( data,
+        Array1DWriteView< uint8_t >( frame->data.pointer(), data.size() ) );
+    wb.queue.endEnqueue();
+    return true;
+}
+
+int RGBDOutputStream::numFramesPending() const
+{
+    if( m_writeBehind == nullptr )
+    {
+        return 0;
+    }
+    return m_writeBehind->queue.numEntriesFilled();
+}
+
+int64_t RGBDOutputStream::numStalls() const
+{
+    if( m_writeBehind == nullptr )
+    {
+        return 0;
+    }
+    return m_writeBehind->nStalls;
+}
+
+int64_t RGBDOutputStream::numFramesDropped() const
+{
+    if( m_writeBehind == nullptr )
+    {
+        return 0;
+    }
+    return m_writeBehind->nFramesDropped;
+}
+
+bool RGBDOutputStream::stopWriteBehind()
+{
+    WriteBehind::Frame* stop = m_writeBehind->queue.beginEnqueue();
+    stop->streamId = INDEX_MARKER;
+    m_writeBehind->queue.endEnqueue();
+    m_writeBehind->thread.join();
+
+    bool ok = !m_writeBehind->writeFailed;
+    m_stream = std::move( m_writeBehind->stream );
+    m_index = std::move( m_writeBehind->index );
+    m_writeBehind.reset();
+    return ok;
+}
+
+bool RGBDOutputStream::writeIndex()
+{
+    int64_t indexOffset = m_stream.tell();
+    if( indexOffset < 0 )
     {
         return false;
     }
 
-    return m_stream.writeArray( data );
+    bool ok = m_stream.write( INDEX_MARKER );
+    ok = ok && m_stream.write( static_cast< uint32_t >( m_index.size() ) );
+    if( ok && m_index.size() > 0 )
+    {
+        ok = m_stream.writeArray( Array1DReadView< RGBDFrameIndexEntry >(
+            m_index.data(), m_index.size() ) );
+    }
+    ok = ok && m_stream.write( indexOffset );
+    ok = ok && m_stream.write( 'r' );
+    ok = ok && m_stream.write( 'g' );
+    ok = ok && m_stream.write( 'b' );
+    ok = ok && m_stream.write( 'i' );
+    return ok;
 }
 
 } } // camera_wrappers, libcgt
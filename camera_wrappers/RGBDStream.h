@@ -8,9 +8,11 @@
 #include <common/Array2D.h>
 #include <io/BinaryFileInputStream.h>
 #include <io/BinaryFileOutputStream.h>
+#include <io/MemoryMappedFile.h>
 #include <vecmath/Vector2i.h>
 
 #include "PixelFormat.h"
+#include "StreamCompression.h"
 #include "StreamType.h"
 
 namespace libcgt { namespace camera_wrappers {
@@ -20,6 +22,22 @@ struct StreamMetadata
     StreamType type;
     PixelFormat format;
     Vector2i size; // width, height
+
+    // How frames are stored. RGBD streams decompress frames transparently.
+    // Only 16-bit formats support StreamCompression::DEPTH_RICE_U16.
+    StreamCompression compression;
+};
+
+// An entry in the frame index of a .rgbd file. The index is optionally stored
+// at the end of the file, after the last frame.
+struct RGBDFrameIndexEntry
+{
+    uint32_t streamId;
+    int32_t frameIndex;
+    int64_t timestamp;
+
+    // Offset of the frame's header, in bytes from the start of the file.
+    int64_t offset;
 };
 
 class RGBDInputStream
@@ -35,25 +53,192 @@ public:
 
     const std::vector< StreamMetadata >& metadata() const;
 
+    // The index of every frame in the file, in file order.
+    //
+    // If the file was written without an index, it is rebuilt when the stream
+    // is opened with a single pass over the frame headers.
+    const std::vector< RGBDFrameIndexEntry >& index() const;
+
+    // The number of frames in stream "streamId".
+    int numFrames( uint32_t streamId ) const;
+
+    // Reads the next frame in the file.
+    // Returns a null view on error or once the last frame has been read.
     Array1DReadView< uint8_t > read( uint32_t& streamId,
         int32_t& frameIndex, int64_t& timestamp );
 
+    // Seek such that the next call to read() returns the first frame.
+    bool rewind();
+
+    // Seek such that the next call to read() returns the frame in stream
+    // "streamId" with frame index "frameIndex".
+    //
+    // Frame indices within a stream are assumed to be increasing.
+    // Returns false if there is no such frame.
+    bool seekToFrame( uint32_t streamId, int32_t frameIndex );
+
+    // Seek such that the next call to read() returns the first frame in
+    // stream "streamId" whose timestamp is >= "timestamp".
+    //
+    // Timestamps within a stream are assumed to be increasing.
+    // Returns false if there is no such frame.
+    bool seekToTimestamp( uint32_t streamId, int64_t timestamp );
+
 private:
 
+    // Try to load the index stored at the end of the file.
+    bool readIndex( int64_t fileSize );
+
+    // Rebuild the index by walking the frame headers.
+    void rebuildIndex( int64_t fileSize );
+
+    // Read a frame's payload into m_buffers[ streamId ], decompressing it if
+    // needed.
+    bool readPayload( uint32_t streamId, uint32_t payloadSize );
+
     BinaryFileInputStream m_stream;
+    uint32_t m_version = 0;
     std::vector< StreamMetadata > m_metadata;
     std::vector< Array1D< uint8_t > > m_buffers;
+    std::vector< uint8_t > m_compressed;
     bool m_valid;
 
+    int64_t m_firstFrameOffset = 0;
+    std::vector< RGBDFrameIndexEntry > m_index;
+    // For each stream, the entries in m_index belonging to that stream.
+    std::vector< std::vector< int > > m_streamIndex;
+
+};
+
+// Reads a .rgbd file through a MemoryMappedFile. Frames are returned as views
+// directly into the mapped file: no copies are made and pages are shared with
+// the operating system's file cache. Views remain valid for the lifetime of
+// the stream.
+//
+// Frames of compressed streams are the exception: they are decompressed into
+// a buffer per stream, which is overwritten by the next access to a frame of
+// the same stream.
+//
+// Frame data is aligned only as well as the file layout allows. Every frame
+// starts 4-byte aligned as long as the frame sizes of all streams are
+// multiples of 4 bytes.
+class RGBDMappedInputStream
+{
+public:
+
+    RGBDMappedInputStream( const char* filename );
+
+    RGBDMappedInputStream( const RGBDMappedInputStream& copy ) = delete;
+    RGBDMappedInputStream& operator = (
+        const RGBDMappedInputStream& copy ) = delete;
+
+    bool isValid() const;
+
+    const std::vector< StreamMetadata >& metadata() const;
+
+    // The index of every frame in the file, in file order.
+    //
+    // If the file was written without an index, it is rebuilt when the stream
+    // is opened with a single pass over the frame headers.
+    const std::vector< RGBDFrameIndexEntry >& index() const;
+
+    // The number of frames in stream "streamId".
+    int numFrames( uint32_t streamId ) const;
+
+    // Reads the next frame in the file.
+    // Returns a null view on error or once the last frame has been read.
+    Array1DReadView< uint8_t > read( uint32_t& streamId,
+        int32_t& frameIndex, int64_t& timestamp );
+
+    // Same as read(), but interprets the frame as a 2D image with the
+    // dimensions of its stream. sizeof( T ) must equal the stream's pixel
+    // size, otherwise the returned view is null.
+    template< typename T >
+    Array2DReadView< T > read2D( uint32_t& streamId,
+        int32_t& frameIndex, int64_t& timestamp );
+
+    // Random access to the frame index()[ i ].
+    // Returns a null view if i is out of range.
+    Array1DReadView< uint8_t > frame( int i );
+
+    // Random access to the frame in stream "streamId" with frame index
+    // "frameIndex". Returns a null view if there is no such frame.
+    Array1DReadView< uint8_t > frame( uint32_t streamId,
+        int32_t frameIndex );
+
+    // Random access to the frame index()[ i ] that is safe to call from
+    // several threads at once. Compressed frames are decompressed into
+    // "buffer", which is resized as needed, instead of the stream's own
+    // buffer. Returns a null view if i is out of range.
+    Array1DReadView< uint8_t > frame( int i,
+        Array1D< uint8_t >& buffer ) const;
+
+    // Interprets "data", a frame from stream "streamId", as a 2D image.
+    // sizeof( T ) must equal the stream's pixel size, otherwise the returned
+    // view is null.
+    template< typename T >
+    Array2DReadView< T > view2D( uint32_t streamId,
+        Array1DReadView< uint8_t > data ) const;
+
+    // Seek such that the next call to read() returns the first frame.
+    bool rewind();
+
+    // Seek such that the next call to read() returns the frame in stream
+    // "streamId" with frame index "frameIndex".
+    bool seekToFrame( uint32_t streamId, int32_t frameIndex );
+
+    // Seek such that the next call to read() returns the first frame in
+    // stream "streamId" whose timestamp is >= "timestamp".
+    bool seekToTimestamp( uint32_t streamId, int64_t timestamp );
+
+private:
+
+    // The size of the payload of the frame whose header is at "offset".
+    bool payloadSizeBytes( int64_t offset, uint32_t streamId,
+        uint32_t& payloadSize ) const;
+    // The frame described by "entry". If its stream is compressed, it is
+    // decompressed into "buffer".
+    Array1DReadView< uint8_t > frameData( const RGBDFrameIndexEntry& entry,
+        Array1D< uint8_t >& buffer ) const;
+
+    bool readIndex();
+    void rebuildIndex();
+
+    MemoryMappedFile m_file;
+    uint32_t m_version = 0;
+    std::vector< StreamMetadata > m_metadata;
+    // Decompression buffers, for compressed streams only.
+    std::vector< Array1D< uint8_t > > m_buffers;
+    bool m_valid;
+
+    int64_t m_firstFrameOffset = 0;
+    std::vector< RGBDFrameIndexEntry > m_index;
+    std::vector< std::vector< int > > m_streamIndex;
+
+    // Position in m_index of the frame returned by the next call to read().
+    int m_nextEntry = 0;
 };
 
 class RGBDOutputStream
 {
 public:
 
-    RGBDOutputStream() = default;
+    RGBDOutputStream();
+
+    // If any stream requests a compression that its pixel format does not
+    // support, the output stream is invalid.
     RGBDOutputStream( const std::vector< StreamMetadata >& metadata,
         const char* filename );
+
+    // Create a write-behind RGBDOutputStream. write() copies each frame into
+    // one of "nBuffers" pre-allocated buffers, which a dedicated thread then
+    // writes to disk. If every buffer is in use, write() waits up to
+    // "maxWaitMilliseconds" for one to be freed, then drops the frame.
+    //
+    // If nBuffers is 0, this is the same as a regular RGBDOutputStream.
+    RGBDOutputStream( const std::vector< StreamMetadata >& metadata,
+        const char* filename, int nBuffers, int maxWaitMilliseconds = 0 );
+
     virtual ~RGBDOutputStream();
 
     RGBDOutputStream( const RGBDOutputStream& copy ) = delete;
@@ -63,17 +248,73 @@ public:
 
     bool isValid() const;
 
+    // Returns true if frames are written to disk by a background thread.
+    bool isWriteBehind() const;
+
+    // Writes the frame index to the end of the file, then closes it.
+    // In write-behind mode, first waits for all pending frames to be written.
     bool close();
 
     // TODO(jiawen): check that frameIndex and timestamp is monotonically
     // increasing.
+    //
+    // "data" is an uncompressed frame of exactly the size given by the
+    // stream's metadata. It is compressed as specified by the metadata.
+    //
+    // In write-behind mode, returns false if the frame was dropped, or if a
+    // previous frame failed to be written.
     bool write( uint32_t streamId, int32_t frameIndex, int64_t timestamp,
-        Array1DReadView< uint8_t > data ) const;
+        Array1DReadView< uint8_t > data );
+
+    // Write-behind statistics. They are all 0 for a regular stream and are
+    // reset when the stream is closed.
+
+    // The number of frames that have been copied but not yet written.
+    int numFramesPending() const;
+
+    // The number of calls to write() that found every buffer in use and had
+    // to wait.
+    int64_t numStalls() const;
+
+    // The number of frames dropped because no buffer was freed in time.
+    int64_t numFramesDropped() const;
 
 private:
 
+    struct WriteBehind;
+
+    bool writeIndex();
+    bool stopWriteBehind();
+
     BinaryFileOutputStream m_stream;
     std::vector< StreamMetadata > m_metadata;
+    std::vector< RGBDFrameIndexEntry > m_index;
+
+    // Compressed frames are encoded into m_scratch.
+    std::vector< uint8_t > m_scratch;
+
+    // In write-behind mode, the writer thread owns the file until close().
+    std::unique_ptr< WriteBehind > m_writeBehind;
 };
 
+template< typename T >
+Array2DReadView< T > RGBDMappedInputStream::read2D( uint32_t& streamId,
+    int32_t& frameIndex, int64_t& timestamp )
+{
+    Array1DReadView< uint8_t > data = read( streamId, frameIndex, timestamp );
+    return view2D< T >( streamId, data );
+}
+
+template< typename T >
+Array2DReadView< T > RGBDMappedInputStream::view2D( uint32_t streamId,
+    Array1DReadView< uint8_t > data ) const
+{
+    if( data.isNull() || streamId >= m_metadata.size() ||
+        pixelSizeBytes( m_metadata[ streamId ].format ) != sizeof( T ) )
+    {
+        return Array2DReadView< T >();
+    }
+    return Array2DReadView< T >( data.pointer(), m_metadata[ streamId ].size );
+}
+
 } } // camera_wrappers, libcgt
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+namespace libcgt { namespace camera_wrappers {
+
+enum class StreamCompression : uint32_t
+{
+    // Frames are stored as raw pixels.
+    NONE = 0,
+
+    // Lossless predictive coding for 16-bit single channel frames, such as
+    // DEPTH_MM_U16. See DepthCodec.h.
+    DEPTH_RICE_U16 = 1
+};
+
+} } // camera_wrappers, libcgt
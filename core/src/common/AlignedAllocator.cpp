@@ -0,0 +1,151 @@
+#include "AlignedAllocator.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+
+size_t roundUp( size_t x, size_t multiple )
+{
+    return ( x + multiple - 1 ) / multiple * multiple;
+}
+
+}
+
+AlignedAllocator::AlignedAllocator( size_t alignment, bool useHugePages ) :
+    m_alignment( std::max( alignment, sizeof( void* ) ) ),
+    m_useHugePages( useHugePages )
+{
+
+}
+
+// static
+AlignedAllocator* AlignedAllocator::instance()
+{
+    static AlignedAllocator s_singleton;
+    return &s_singleton;
+}
+
+// virtual
+void* AlignedAllocator::allocate( size_t bytes )
+{
+    void* pointer = nullptr;
+    size_t allocatedBytes = bytes;
+
+#ifdef _WIN32
+    if( isHuge( bytes ) )
+    {
+        size_t largePageBytes = GetLargePageMinimum();
+        if( largePageBytes > 0 )
+        {
+            pointer = VirtualAlloc( nullptr,
+                roundUp( bytes, largePageBytes ),
+                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+        }
+        if( pointer == nullptr )
+        {
+            pointer = VirtualAlloc( nullptr, bytes,
+                MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+        }
+    }
+    else
+    {
+        pointer = _aligned_malloc( bytes, m_alignment );
+    }
+#else
+    if( isHuge( bytes ) )
+    {
+        // Align to the huge page size, so that the whole buffer can be
+        // covered by huge pages.
+        allocatedBytes = roundUp( bytes, HUGE_PAGE_BYTES );
+        if( posix_memalign( &pointer, HUGE_PAGE_BYTES, allocatedBytes ) != 0 )
+        {
+            pointer = nullptr;
+        }
+#ifdef MADV_HUGEPAGE
+        else
+        {
+            madvise( pointer, allocatedBytes, MADV_HUGEPAGE );
+        }
+#endif
+    }
+    else if( posix_memalign( &pointer, m_alignment, bytes ) != 0 )
+    {
+        pointer = nullptr;
+    }
+#endif
+
+    if( pointer != nullptr )
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        ++m_statistics.nAllocations;
+        ++m_statistics.nBackingAllocations;
+        m_statistics.bytesInUse += bytes;
+        m_statistics.peakBytesInUse = std::max( m_statistics.peakBytesInUse,
+            m_statistics.bytesInUse );
+        m_statistics.bytesReserved += allocatedBytes;
+    }
+
+    return pointer;
+}
+
+// virtual
+void AlignedAllocator::deallocate( void* pointer, size_t bytes )
+{
+    if( pointer == nullptr )
+    {
+        return;
+    }
+
+    size_t allocatedBytes = bytes;
+#ifdef _WIN32
+    if( isHuge( bytes ) )
+    {
+        VirtualFree( pointer, 0, MEM_RELEASE );
+    }
+    else
+    {
+        _aligned_free( pointer );
+    }
+#else
+    if( isHuge( bytes ) )
+    {
+        allocatedBytes = roundUp( bytes, HUGE_PAGE_BYTES );
+    }
+    free( pointer );
+#endif
+
+    std::lock_guard< std::mutex > lock( m_mutex );
+    ++m_statistics.nDeallocations;
+    m_statistics.bytesInUse -= bytes;
+    m_statistics.bytesReserved -= allocatedBytes;
+}
+
+size_t AlignedAllocator::alignment() const
+{
+    return m_alignment;
+}
+
+bool AlignedAllocator::useHugePages() const
+{
+    return m_useHugePages;
+}
+
+AllocatorStatistics AlignedAllocator::statistics() const
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    return m_statistics;
+}
+
+bool AlignedAllocator::isHuge( size_t bytes ) const
+{
+    return m_useHugePages && bytes >= HUGE_PAGE_BYTES;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <mutex>
+
+#include "Allocator.h"
+
+// A thread-safe Allocator that returns memory aligned to a given boundary,
+// for SIMD loads and stores and to keep rows on separate cache lines.
+//
+// Optionally, allocations of at least HUGE_PAGE_BYTES are backed by huge
+// pages, which cuts page faults and TLB misses on large images and volumes.
+// On Linux, this uses transparent huge pages (madvise( MADV_HUGEPAGE )). On
+// Windows, this tries large pages, which requires the "Lock pages in memory"
+// privilege, and silently falls back to regular pages.
+class AlignedAllocator : public Allocator
+{
+public:
+
+    static const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+    // alignment must be a power of two, at most 4096 if useHugePages is true.
+    AlignedAllocator( size_t alignment = 64, bool useHugePages = false );
+
+    // Singleton instance with 64-byte alignment and no huge pages.
+    static AlignedAllocator* instance();
+
+    virtual void* allocate( size_t bytes ) override;
+    virtual void deallocate( void* pointer, size_t bytes ) override;
+
+    size_t alignment() const;
+    bool useHugePages() const;
+
+    AllocatorStatistics statistics() const;
+
+private:
+
+    bool isHuge( size_t bytes ) const;
+
+    const size_t m_alignment;
+    const bool m_useHugePages;
+
+    mutable std::mutex m_mutex;
+    AllocatorStatistics m_statistics;
+};
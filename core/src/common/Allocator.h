@@ -7,6 +7,30 @@ class Allocator
 {
 public:
 
+    virtual ~Allocator() = default;
+
     virtual void* allocate( size_t bytes ) = 0;
     virtual void deallocate( void* pointer, size_t bytes ) = 0;
-};
\ No newline at end of file
+};
+
+// Usage counters kept by the Allocators that track them.
+struct AllocatorStatistics
+{
+    // Number of calls to allocate() and deallocate().
+    size_t nAllocations = 0;
+    size_t nDeallocations = 0;
+
+    // Number of allocate() calls that had to get memory from the underlying
+    // allocator or the operating system, rather than from memory already
+    // held by this one.
+    size_t nBackingAllocations = 0;
+
+    // Bytes returned by allocate() and not yet deallocated, and the maximum
+    // that has ever been.
+    size_t bytesInUse = 0;
+    size_t peakBytesInUse = 0;
+
+    // Bytes currently held from the underlying allocator or the operating
+    // system, including any kept around for reuse.
+    size_t bytesReserved = 0;
+};
@@ -0,0 +1,126 @@
+#include "ArenaAllocator.h"
+
+#include <algorithm>
+
+#include "NewDeleteAllocator.h"
+
+namespace
+{
+
+uintptr_t alignUp( uintptr_t x, size_t alignment )
+{
+    return ( x + alignment - 1 ) &
+        ~( static_cast< uintptr_t >( alignment ) - 1 );
+}
+
+}
+
+ArenaAllocator::ArenaAllocator( size_t blockBytes, size_t alignment,
+    Allocator* backing ) :
+    m_blockBytes( blockBytes ),
+    m_alignment( alignment ),
+    m_backing( backing != nullptr ? backing : NewDeleteAllocator::instance() )
+{
+
+}
+
+// virtual
+ArenaAllocator::~ArenaAllocator()
+{
+    releaseBlocks();
+}
+
+// virtual
+void* ArenaAllocator::allocate( size_t bytes )
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+
+    uint8_t* p = nullptr;
+    if( !m_blocks.empty() )
+    {
+        const Block& block = m_blocks.back();
+        uintptr_t begin = reinterpret_cast< uintptr_t >( block.data );
+        uintptr_t aligned = alignUp( begin + m_offset, m_alignment );
+        if( aligned + bytes <= begin + block.bytes )
+        {
+            p = reinterpret_cast< uint8_t* >( aligned );
+        }
+    }
+
+    if( p == nullptr )
+    {
+        addBlock( std::max( bytes, m_blockBytes ) );
+        p = reinterpret_cast< uint8_t* >( alignUp(
+            reinterpret_cast< uintptr_t >( m_blocks.back().data ),
+            m_alignment ) );
+    }
+
+    m_offset = ( p + bytes ) - m_blocks.back().data;
+
+    ++m_statistics.nAllocations;
+    m_statistics.bytesInUse += bytes;
+    m_statistics.peakBytesInUse = std::max( m_statistics.peakBytesInUse,
+        m_statistics.bytesInUse );
+
+    return p;
+}
+
+// virtual
+void ArenaAllocator::deallocate( void* pointer, size_t bytes )
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+
+    ++m_statistics.nDeallocations;
+    m_statistics.bytesInUse -= std::min( bytes, m_statistics.bytesInUse );
+}
+
+void ArenaAllocator::reset()
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+
+    if( m_blocks.size() > 1 )
+    {
+        size_t totalBytes = 0;
+        for( const Block& block : m_blocks )
+        {
+            totalBytes += block.bytes - ( m_alignment - 1 );
+        }
+
+        releaseBlocks();
+        addBlock( totalBytes );
+    }
+
+    m_offset = 0;
+    m_statistics.bytesInUse = 0;
+}
+
+AllocatorStatistics ArenaAllocator::statistics() const
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    return m_statistics;
+}
+
+void ArenaAllocator::addBlock( size_t bytes )
+{
+    // Leave room to align the first allocation.
+    Block block;
+    block.bytes = bytes + m_alignment - 1;
+    block.data = reinterpret_cast< uint8_t* >(
+        m_backing->allocate( block.bytes ) );
+    m_blocks.push_back( block );
+    m_offset = 0;
+
+    ++m_statistics.nBackingAllocations;
+    m_statistics.bytesReserved += block.bytes;
+}
+
+void ArenaAllocator::releaseBlocks()
+{
+    for( const Block& block : m_blocks )
+    {
+        m_backing->deallocate( block.data, block.bytes );
+    }
+    m_blocks.clear();
+    m_offset = 0;
+    m_statistics.bytesReserved = 0;
+}
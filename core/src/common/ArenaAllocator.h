@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "Allocator.h"
+
+// A thread-safe Allocator that hands out memory by bumping a pointer through
+// large blocks, and frees everything at once with reset().
+//
+// deallocate() does not free anything. It is meant for scratch buffers that
+// all die together, such as the temporaries of one frame:
+//
+//   ArenaAllocator arena;
+//   while( running )
+//   {
+//       Array2D< float > tmp( size, &arena );
+//       ...
+//       // After every array using the arena is gone:
+//       arena.reset();
+//   }
+//
+// After a reset(), the blocks are kept and reused, so once the arena has
+// grown to the size of a frame, it no longer calls its backing allocator.
+class ArenaAllocator : public Allocator
+{
+public:
+
+    // blockBytes: the size of each block requested from "backing".
+    //   Allocations larger than that get a block of their own.
+    // alignment: every pointer returned is a multiple of this, which must be
+    //   a power of two.
+    // backing: where blocks come from (NewDeleteAllocator if null). Not
+    //   owned, and must outlive the arena.
+    ArenaAllocator( size_t blockBytes = 16 * 1024 * 1024,
+        size_t alignment = 64, Allocator* backing = nullptr );
+    virtual ~ArenaAllocator();
+
+    ArenaAllocator( const ArenaAllocator& copy ) = delete;
+    ArenaAllocator& operator = ( const ArenaAllocator& copy ) = delete;
+
+    virtual void* allocate( size_t bytes ) override;
+
+    // Only updates the statistics: memory is reclaimed by reset().
+    virtual void deallocate( void* pointer, size_t bytes ) override;
+
+    // Make all memory available again. Every pointer returned by allocate()
+    // since the last reset() becomes invalid.
+    //
+    // If more than one block was used, they are replaced by a single block
+    // large enough to hold all of them, so that the same sequence of
+    // allocations fits in one block next time.
+    void reset();
+
+    AllocatorStatistics statistics() const;
+
+private:
+
+    struct Block
+    {
+        uint8_t* data;
+        size_t bytes;
+    };
+
+    // Get a new block of at least "bytes" usable bytes, at the back of
+    // m_blocks.
+    void addBlock( size_t bytes );
+    void releaseBlocks();
+
+    const size_t m_blockBytes;
+    const size_t m_alignment;
+    Allocator* const m_backing;
+
+    mutable std::mutex m_mutex;
+
+    // Blocks in the order they were filled. The last one is the current one.
+    std::vector< Block > m_blocks;
+    size_t m_offset = 0;
+
+    AllocatorStatistics m_statistics;
+};
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <vector>
 
@@ -10,6 +12,7 @@
 #include "ArrayView.h"
 #include "BasicTypes.h" // TODO: uint8x4 --> Vector<4, uint8_t>
 
+#include <concurrency/ThreadPool.h>
 #include <vecmath/Box3i.h>
 #include <vecmath/Range1i.h>
 #include <vecmath/Rect2i.h>
@@ -21,6 +24,30 @@
 
 namespace libcgt { namespace core { namespace arrayutils {
 
+// Execution policies for the overloads of copy(), fill(), map() and
+// mapIndexed() that take one as their first argument, after the ones in
+// C++17's <execution>.
+namespace execution
+{
+
+// Runs on the calling thread.
+struct SequencedPolicy {};
+
+// Splits rows across the threads of ThreadPool::global(). Func must be safe
+// to call concurrently.
+struct ParallelPolicy {};
+
+// Like ParallelPolicy, and also lets the compiler vectorize within a row.
+// Func must not depend on the order in which elements are visited, and src
+// and dst must not overlap.
+struct ParallelUnsequencedPolicy {};
+
+const SequencedPolicy seq = {};
+const ParallelPolicy par = {};
+const ParallelUnsequencedPolicy par_unseq = {};
+
+} // execution
+
 // Cast from Array1DWriteView< TIn > --> Array1DWriteView< TOut >.
 // sizeof( TIn ) must be equal sizeof( TOut ).
 template< typename TOut, typename TIn >
@@ -74,6 +101,20 @@ bool copy( Array2DReadView< T > src, Array2DWriteView< T > dst );
 template< typename T >
 bool copy( Array3DReadView< T > src, Array3DWriteView< T > dst );
 
+// Copy between two 2D views, row by row, using "policy". Rows whose
+// elements are packed in both views are copied with memcpy.
+// Returns false if the dimensions don't match, or if either is null.
+template< typename Policy, typename T >
+bool copy( const Policy& policy,
+    Array2DReadView< T > src, Array2DWriteView< T > dst );
+
+// Copy between two 3D views, row by row, using "policy". Rows whose
+// elements are packed in both views are copied with memcpy.
+// Returns false if the dimensions don't match, or if either is null.
+template< typename Policy, typename T >
+bool copy( const Policy& policy,
+    Array3DReadView< T > src, Array3DWriteView< T > dst );
+
 // TODO: rename this to sliceChannel()?
 // Given an existing Array1DReadView< TIn >, returns a
 // Array1DReadView< TOut > with the same stride, but with elements of type
@@ -158,6 +199,14 @@ bool fill( Array1DWriteView< T > view, const T& value );
 template< typename T >
 bool fill( Array2DWriteView< T > view, const T& value );
 
+// Set every element of view to value, row by row, using "policy".
+template< typename Policy, typename T >
+bool fill( const Policy& policy, Array2DWriteView< T > view, const T& value );
+
+// Set every element of view to value, row by row, using "policy".
+template< typename Policy, typename T >
+bool fill( const Policy& policy, Array3DWriteView< T > view, const T& value );
+
 // Create a view that is flipped left <--> right from src.
 // Flipping twice is the identity.
 template< typename T >
@@ -261,6 +310,26 @@ template< typename TSrc, typename TDst, typename Func >
 bool mapIndexed( Array3DReadView< TSrc > src, Array3DWriteView< TDst > dst,
     Func f );
 
+// map() over 2D views, row by row, using "policy".
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool map( const Policy& policy,
+    Array2DReadView< TSrc > src, Array2DWriteView< TDst > dst, Func f );
+
+// map() over 3D views, row by row, using "policy".
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool map( const Policy& policy,
+    Array3DReadView< TSrc > src, Array3DWriteView< TDst > dst, Func f );
+
+// mapIndexed() over 2D views, row by row, using "policy".
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool mapIndexed( const Policy& policy,
+    Array2DReadView< TSrc > src, Array2DWriteView< TDst > dst, Func f );
+
+// mapIndexed() over 3D views, row by row, using "policy".
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool mapIndexed( const Policy& policy,
+    Array3DReadView< TSrc > src, Array3DWriteView< TDst > dst, Func f );
+
 template< typename T >
 Array1DWriteView< T > reshape( Array2DWriteView< T > src );
 
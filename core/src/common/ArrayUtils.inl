@@ -649,6 +649,348 @@ bool mapIndexed( Array3DReadView< TSrc > src, Array3DWriteView< TDst > dst,
     return true;
 }
 
+namespace detail
+{
+
+// Calls rowFunc( r ) for each r in [0, nRows).
+template< typename RowFunc >
+void forEachRow( const execution::SequencedPolicy&, int nRows,
+    const RowFunc& rowFunc )
+{
+    for( int r = 0; r < nRows; ++r )
+    {
+        rowFunc( r );
+    }
+}
+
+// Calls rowFunc( r ) for each r in [0, nRows), on contiguous blocks of rows
+// in parallel.
+template< typename RowFunc >
+void forEachRow( const execution::ParallelPolicy&, int nRows,
+    const RowFunc& rowFunc )
+{
+    concurrency::ThreadPool::global().parallelFor( 0, nRows, 0,
+        [&]( int begin, int end )
+        {
+            for( int r = begin; r < end; ++r )
+            {
+                rowFunc( r );
+            }
+        }
+    );
+}
+
+template< typename RowFunc >
+void forEachRow( const execution::ParallelUnsequencedPolicy&, int nRows,
+    const RowFunc& rowFunc )
+{
+    forEachRow( execution::par, nRows, rowFunc );
+}
+
+// Row r of a 3D view, where rows are numbered slice by slice.
+template< typename T >
+Array1DReadView< T > row( Array3DReadView< T > view, int r )
+{
+    return Array1DReadView< T >
+    (
+        view.rowPointer( { r % view.height(), r / view.height() } ),
+        view.width(), view.elementStrideBytes()
+    );
+}
+
+// Row r of a 3D view, where rows are numbered slice by slice.
+template< typename T >
+Array1DWriteView< T > row( Array3DWriteView< T > view, int r )
+{
+    return Array1DWriteView< T >
+    (
+        view.rowPointer( { r % view.height(), r / view.height() } ),
+        view.width(), view.elementStrideBytes()
+    );
+}
+
+// dst[ x ] = f( x, src[ x ] ) over n contiguous elements. The compiler may
+// vectorize this, but has to assume that src and dst alias.
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+void mapPacked( const Policy&, const TSrc* src, TDst* dst, int n,
+    const Func& f )
+{
+    for( int x = 0; x < n; ++x )
+    {
+        dst[ x ] = f( x, src[ x ] );
+    }
+}
+
+// Same as above, but promises the compiler that src and dst do not alias.
+template< typename TSrc, typename TDst, typename Func >
+void mapPacked( const execution::ParallelUnsequencedPolicy&,
+    const TSrc* __restrict src, TDst* __restrict dst, int n, const Func& f )
+{
+    for( int x = 0; x < n; ++x )
+    {
+        dst[ x ] = f( x, src[ x ] );
+    }
+}
+
+// dst[ x ] = f( x, src[ x ] ) over a row, using raw pointers if both rows are
+// packed.
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+void mapRow( const Policy& policy,
+    Array1DReadView< TSrc > src, Array1DWriteView< TDst > dst, const Func& f )
+{
+    int n = static_cast< int >( src.width() );
+    if( src.elementsArePacked() && dst.elementsArePacked() )
+    {
+        mapPacked( policy, src.pointer(), dst.pointer(), n, f );
+    }
+    else
+    {
+        for( int x = 0; x < n; ++x )
+        {
+            dst[ x ] = f( x, src[ x ] );
+        }
+    }
+}
+
+template< typename T >
+void copyRow( Array1DReadView< T > src, Array1DWriteView< T > dst )
+{
+    if( src.elementsArePacked() && dst.elementsArePacked() )
+    {
+        memcpy( dst.pointer(), src.pointer(), src.width() * sizeof( T ) );
+    }
+    else
+    {
+        for( size_t x = 0; x < src.width(); ++x )
+        {
+            dst[ x ] = src[ x ];
+        }
+    }
+}
+
+template< typename T >
+void fillRow( Array1DWriteView< T > dst, const T& value )
+{
+    if( dst.elementsArePacked() )
+    {
+        std::fill_n( dst.pointer(), dst.width(), value );
+    }
+    else
+    {
+        for( size_t x = 0; x < dst.width(); ++x )
+        {
+            dst[ x ] = value;
+        }
+    }
+}
+
+} // detail
+
+template< typename Policy, typename T >
+bool copy( const Policy& policy,
+    Array2DReadView< T > src, Array2DWriteView< T > dst )
+{
+    if( src.isNull() || dst.isNull() )
+    {
+        return false;
+    }
+
+    if( src.size() != dst.size() )
+    {
+        return false;
+    }
+
+    detail::forEachRow( policy, src.height(),
+        [&]( int y )
+        {
+            detail::copyRow( src.row( y ), dst.row( y ) );
+        }
+    );
+
+    return true;
+}
+
+template< typename Policy, typename T >
+bool copy( const Policy& policy,
+    Array3DReadView< T > src, Array3DWriteView< T > dst )
+{
+    if( src.isNull() || dst.isNull() )
+    {
+        return false;
+    }
+
+    if( src.size() != dst.size() )
+    {
+        return false;
+    }
+
+    detail::forEachRow( policy, src.height() * src.depth(),
+        [&]( int r )
+        {
+            detail::copyRow( detail::row( src, r ), detail::row( dst, r ) );
+        }
+    );
+
+    return true;
+}
+
+template< typename Policy, typename T >
+bool fill( const Policy& policy, Array2DWriteView< T > view, const T& value )
+{
+    if( view.isNull() )
+    {
+        return false;
+    }
+
+    detail::forEachRow( policy, view.height(),
+        [&]( int y )
+        {
+            detail::fillRow( view.row( y ), value );
+        }
+    );
+
+    return true;
+}
+
+template< typename Policy, typename T >
+bool fill( const Policy& policy, Array3DWriteView< T > view, const T& value )
+{
+    if( view.isNull() )
+    {
+        return false;
+    }
+
+    detail::forEachRow( policy, view.height() * view.depth(),
+        [&]( int r )
+        {
+            detail::fillRow( detail::row( view, r ), value );
+        }
+    );
+
+    return true;
+}
+
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool map( const Policy& policy,
+    Array2DReadView< TSrc > src, Array2DWriteView< TDst > dst, Func f )
+{
+    if( src.isNull() || dst.isNull() )
+    {
+        return false;
+    }
+
+    if( src.size() != dst.size() )
+    {
+        return false;
+    }
+
+    detail::forEachRow( policy, src.height(),
+        [&]( int y )
+        {
+            detail::mapRow( policy, src.row( y ), dst.row( y ),
+                [&]( int, const TSrc& s )
+                {
+                    return f( s );
+                }
+            );
+        }
+    );
+
+    return true;
+}
+
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool map( const Policy& policy,
+    Array3DReadView< TSrc > src, Array3DWriteView< TDst > dst, Func f )
+{
+    if( src.isNull() || dst.isNull() )
+    {
+        return false;
+    }
+
+    if( src.size() != dst.size() )
+    {
+        return false;
+    }
+
+    detail::forEachRow( policy, src.height() * src.depth(),
+        [&]( int r )
+        {
+            detail::mapRow( policy,
+                detail::row( src, r ), detail::row( dst, r ),
+                [&]( int, const TSrc& s )
+                {
+                    return f( s );
+                }
+            );
+        }
+    );
+
+    return true;
+}
+
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool mapIndexed( const Policy& policy,
+    Array2DReadView< TSrc > src, Array2DWriteView< TDst > dst, Func f )
+{
+    if( src.isNull() || dst.isNull() )
+    {
+        return false;
+    }
+
+    if( src.size() != dst.size() )
+    {
+        return false;
+    }
+
+    detail::forEachRow( policy, src.height(),
+        [&]( int y )
+        {
+            detail::mapRow( policy, src.row( y ), dst.row( y ),
+                [&]( int x, const TSrc& s )
+                {
+                    return f( Vector2i{ x, y }, s );
+                }
+            );
+        }
+    );
+
+    return true;
+}
+
+template< typename Policy, typename TSrc, typename TDst, typename Func >
+bool mapIndexed( const Policy& policy,
+    Array3DReadView< TSrc > src, Array3DWriteView< TDst > dst, Func f )
+{
+    if( src.isNull() || dst.isNull() )
+    {
+        return false;
+    }
+
+    if( src.size() != dst.size() )
+    {
+        return false;
+    }
+
+    int height = src.height();
+    detail::forEachRow( policy, height * src.depth(),
+        [&]( int r )
+        {
+            int y = r % height;
+            int z = r / height;
+            detail::mapRow( policy,
+                detail::row( src, r ), detail::row( dst, r ),
+                [&]( int x, const TSrc& s )
+                {
+                    return f( Vector3i{ x, y, z }, s );
+                }
+            );
+        }
+    );
+
+    return true;
+}
+
 template< typename T >
 Array1DWriteView< T > reshape( Array2DWriteView< T > src )
 {
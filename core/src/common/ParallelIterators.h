@@ -1,12 +1,25 @@
 #pragma once
 
-#ifdef WIN32
+#include <algorithm>
+#include <mutex>
+#include <string>
 
-#include <ppl.h>
+#include <concurrency/ThreadPool.h>
 #include <vecmath/Vector2i.h>
 #include <vecmath/Vector3i.h>
 #include "ProgressReporter.h"
 
+// Parallel versions of for2D() and for3D() in ForND.h, running on
+// ThreadPool::global().
+//
+// The iteration space is cut into tiles, which are the unit of work handed to
+// the threads. tileSize is in iterations (not in coordinates when step != 1).
+// By default, a tile is a block of whole rows (2D) or whole slices (3D), sized
+// so that there are about 8 tiles per thread. Pass a smaller tileSize when
+// iterations are expensive or uneven, and a larger one when they are cheap.
+//
+// func is called concurrently from several threads as func( x, y ) or
+// func( x, y, z ). Within a tile, x varies fastest.
 class ParallelIterators
 {
 public:
@@ -31,6 +44,17 @@ public:
                       const Vector2i& step, const std::string& progressPrefix,
                       const Function& func );
 
+    template< typename Function >
+    static void for2D( const Vector2i& first, const Vector2i& count,
+                      const Vector2i& step, const Vector2i& tileSize,
+                      const Function& func );
+
+    template< typename Function >
+    static void for2D( const Vector2i& first, const Vector2i& count,
+                      const Vector2i& step, const Vector2i& tileSize,
+                      const std::string& progressPrefix,
+                      const Function& func );
+
     template< typename Function >
     static void for3D( const Vector3i& count, const Function& func );
 
@@ -50,8 +74,58 @@ public:
     static void for3D( const Vector3i& first, const Vector3i& count,
                       const Vector3i& step, const std::string& progressPrefix,
                       const Function& func );
+
+    template< typename Function >
+    static void for3D( const Vector3i& first, const Vector3i& count,
+                      const Vector3i& step, const Vector3i& tileSize,
+                      const Function& func );
+
+    template< typename Function >
+    static void for3D( const Vector3i& first, const Vector3i& count,
+                      const Vector3i& step, const Vector3i& tileSize,
+                      const std::string& progressPrefix,
+                      const Function& func );
+
+private:
+
+    // The number of iterations of for( i = 0; i < count; i += step ).
+    static int numSteps( int count, int step );
+
+    // Whole rows (or slices), about 8 tiles per thread.
+    static int defaultTileExtent( int nOuterSteps );
+
+    // Runs the loop. If progressReporter is not null, it is notified once
+    // per completed tile.
+    template< typename Function >
+    static void tiledFor2D( const Vector2i& first, const Vector2i& count,
+                           const Vector2i& step, const Vector2i& tileSize,
+                           ProgressReporter* progressReporter,
+                           const Function& func );
+
+    template< typename Function >
+    static void tiledFor3D( const Vector3i& first, const Vector3i& count,
+                           const Vector3i& step, const Vector3i& tileSize,
+                           ProgressReporter* progressReporter,
+                           const Function& func );
 };
 
+// static
+inline int ParallelIterators::numSteps( int count, int step )
+{
+    if( count <= 0 || step <= 0 )
+    {
+        return 0;
+    }
+    return ( count + step - 1 ) / step;
+}
+
+// static
+inline int ParallelIterators::defaultTileExtent( int nOuterSteps )
+{
+    int nTiles = 8 * libcgt::core::concurrency::ThreadPool::global().numThreads();
+    return std::max( 1, nOuterSteps / nTiles );
+}
+
 // static
 template< typename Function >
 inline void ParallelIterators::for2D( const Vector2i& count,
@@ -86,20 +160,34 @@ inline void ParallelIterators::for2D( const Vector2i& first,
                                      const Vector2i& step,
                                      const Function& func )
 {
-    Concurrency::parallel_for
-    (
-        0, count.y, step.y,
-        [&]( int j )
-        {
-            int y = first.y + j;
-            for( int i = 0; i < count.x; i += step.x )
-            {
-                int x = first.x + i;
+    Vector2i tileSize{ numSteps( count.x, step.x ),
+        defaultTileExtent( numSteps( count.y, step.y ) ) };
+    tiledFor2D( first, count, step, tileSize, nullptr, func );
+}
 
-                func( x, y );
-            }
-        }
-    );
+// static
+template< typename Function >
+inline void ParallelIterators::for2D( const Vector2i& first,
+                                     const Vector2i& count,
+                                     const Vector2i& step,
+                                     const std::string& progressPrefix,
+                                     const Function& func )
+{
+    Vector2i tileSize{ numSteps( count.x, step.x ),
+        defaultTileExtent( numSteps( count.y, step.y ) ) };
+    ParallelIterators::for2D( first, count, step, tileSize, progressPrefix,
+                             func );
+}
+
+// static
+template< typename Function >
+inline void ParallelIterators::for2D( const Vector2i& first,
+                                     const Vector2i& count,
+                                     const Vector2i& step,
+                                     const Vector2i& tileSize,
+                                     const Function& func )
+{
+    tiledFor2D( first, count, step, tileSize, nullptr, func );
 }
 
 // static
@@ -107,24 +195,72 @@ template< typename Function >
 inline void ParallelIterators::for2D( const Vector2i& first,
                                      const Vector2i& count,
                                      const Vector2i& step,
+                                     const Vector2i& tileSize,
                                      const std::string& progressPrefix,
                                      const Function& func )
 {
-    ProgressReporter pr( progressPrefix, count.y / step.y );
+    int nx = numSteps( count.x, step.x );
+    int ny = numSteps( count.y, step.y );
+    int tx = std::max( 1, std::min( tileSize.x, nx ) );
+    int ty = std::max( 1, std::min( tileSize.y, ny ) );
+    int nTiles = numSteps( nx, tx ) * numSteps( ny, ty );
 
-    Concurrency::parallel_for
-    (
-        0, count.y, step.y,
-        [&]( int j )
+    ProgressReporter pr( progressPrefix, nTiles );
+    tiledFor2D( first, count, step, tileSize, &pr, func );
+}
+
+// static
+template< typename Function >
+inline void ParallelIterators::tiledFor2D( const Vector2i& first,
+                                          const Vector2i& count,
+                                          const Vector2i& step,
+                                          const Vector2i& tileSize,
+                                          ProgressReporter* progressReporter,
+                                          const Function& func )
+{
+    int nx = numSteps( count.x, step.x );
+    int ny = numSteps( count.y, step.y );
+    if( nx == 0 || ny == 0 )
+    {
+        return;
+    }
+
+    int tx = std::max( 1, std::min( tileSize.x, nx ) );
+    int ty = std::max( 1, std::min( tileSize.y, ny ) );
+    int nTilesX = numSteps( nx, tx );
+    int nTilesY = numSteps( ny, ty );
+
+    // ProgressReporter is not thread safe.
+    std::mutex progressMutex;
+
+    libcgt::core::concurrency::ThreadPool::global().parallelFor(
+        0, nTilesX * nTilesY, 1,
+        [&]( int begin, int end )
         {
-            int y = first.y + j;
-            for( int i = 0; i < count.x; i += step.x )
+            for( int t = begin; t < end; ++t )
             {
-                int x = first.x + i;
+                int j0 = ( t / nTilesX ) * ty;
+                int j1 = std::min( j0 + ty, ny );
+                int i0 = ( t % nTilesX ) * tx;
+                int i1 = std::min( i0 + tx, nx );
+
+                for( int j = j0; j < j1; ++j )
+                {
+                    int y = first.y + j * step.y;
+                    for( int i = i0; i < i1; ++i )
+                    {
+                        int x = first.x + i * step.x;
 
-                func( x, y );
+                        func( x, y );
+                    }
+                }
+
+                if( progressReporter != nullptr )
+                {
+                    std::lock_guard< std::mutex > lock( progressMutex );
+                    progressReporter->notifyAndPrintProgressString();
+                }
             }
-            pr.notifyAndPrintProgressString();
         }
     );
 }
@@ -162,24 +298,25 @@ inline void ParallelIterators::for3D( const Vector3i& first,
                                      const Vector3i& step,
                                      const Function& func )
 {
-    Concurrency::parallel_for
-    (
-        0, count.z, step.z,
-        [&]( int k )
-        {
-            int z = first.z + k;
-            for( int j = 0; j < count.y; j += step.y )
-            {
-                int y = first.y + j;
-                for( int i = 0; i < count.x; i += step.x )
-                {
-                    int x = first.x + i;
+    Vector3i tileSize{ numSteps( count.x, step.x ),
+        numSteps( count.y, step.y ),
+        defaultTileExtent( numSteps( count.z, step.z ) ) };
+    tiledFor3D( first, count, step, tileSize, nullptr, func );
+}
 
-                    func( x, y, z );
-                }
-            }
-        }
-    );
+// static
+template< typename Function >
+inline void ParallelIterators::for3D( const Vector3i& first,
+                                     const Vector3i& count,
+                                     const Vector3i& step,
+                                     const std::string& progressPrefix,
+                                     const Function& func )
+{
+    Vector3i tileSize{ numSteps( count.x, step.x ),
+        numSteps( count.y, step.y ),
+        defaultTileExtent( numSteps( count.z, step.z ) ) };
+    ParallelIterators::for3D( first, count, step, tileSize, progressPrefix,
+                             func );
 }
 
 // static
@@ -187,31 +324,94 @@ template< typename Function >
 inline void ParallelIterators::for3D( const Vector3i& first,
                                      const Vector3i& count,
                                      const Vector3i& step,
+                                     const Vector3i& tileSize,
+                                     const Function& func )
+{
+    tiledFor3D( first, count, step, tileSize, nullptr, func );
+}
+
+// static
+template< typename Function >
+inline void ParallelIterators::for3D( const Vector3i& first,
+                                     const Vector3i& count,
+                                     const Vector3i& step,
+                                     const Vector3i& tileSize,
                                      const std::string& progressPrefix,
                                      const Function& func )
 {
-    ProgressReporter pr( progressPrefix, count.z / step.z );
+    int nx = numSteps( count.x, step.x );
+    int ny = numSteps( count.y, step.y );
+    int nz = numSteps( count.z, step.z );
+    int tx = std::max( 1, std::min( tileSize.x, nx ) );
+    int ty = std::max( 1, std::min( tileSize.y, ny ) );
+    int tz = std::max( 1, std::min( tileSize.z, nz ) );
+    int nTiles = numSteps( nx, tx ) * numSteps( ny, ty ) * numSteps( nz, tz );
+
+    ProgressReporter pr( progressPrefix, nTiles );
+    tiledFor3D( first, count, step, tileSize, &pr, func );
+}
+
+// static
+template< typename Function >
+inline void ParallelIterators::tiledFor3D( const Vector3i& first,
+                                          const Vector3i& count,
+                                          const Vector3i& step,
+                                          const Vector3i& tileSize,
+                                          ProgressReporter* progressReporter,
+                                          const Function& func )
+{
+    int nx = numSteps( count.x, step.x );
+    int ny = numSteps( count.y, step.y );
+    int nz = numSteps( count.z, step.z );
+    if( nx == 0 || ny == 0 || nz == 0 )
+    {
+        return;
+    }
+
+    int tx = std::max( 1, std::min( tileSize.x, nx ) );
+    int ty = std::max( 1, std::min( tileSize.y, ny ) );
+    int tz = std::max( 1, std::min( tileSize.z, nz ) );
+    int nTilesX = numSteps( nx, tx );
+    int nTilesY = numSteps( ny, ty );
+    int nTilesZ = numSteps( nz, tz );
+
+    // ProgressReporter is not thread safe.
+    std::mutex progressMutex;
 
-    Concurrency::parallel_for
-    (
-        0, count.z, step.z,
-        [&]( int k )
+    libcgt::core::concurrency::ThreadPool::global().parallelFor(
+        0, nTilesX * nTilesY * nTilesZ, 1,
+        [&]( int begin, int end )
         {
-            int z = first.z + k;
-            for( int j = 0; j < count.y; j += step.y )
+            for( int t = begin; t < end; ++t )
             {
-                int y = first.y + j;
-                for( int i = 0; i < count.x; i += step.x )
+                int k0 = ( t / ( nTilesX * nTilesY ) ) * tz;
+                int k1 = std::min( k0 + tz, nz );
+                int j0 = ( ( t / nTilesX ) % nTilesY ) * ty;
+                int j1 = std::min( j0 + ty, ny );
+                int i0 = ( t % nTilesX ) * tx;
+                int i1 = std::min( i0 + tx, nx );
+
+                for( int k = k0; k < k1; ++k )
                 {
-                    int x = first.x + i;
+                    int z = first.z + k * step.z;
+                    for( int j = j0; j < j1; ++j )
+                    {
+                        int y = first.y + j * step.y;
+                        for( int i = i0; i < i1; ++i )
+                        {
+                            int x = first.x + i * step.x;
 
-                    func( x, y, z );
+                            func( x, y, z );
+                        }
+                    }
                 }
-            }
 
-            pr.notifyAndPrintProgressString();
+                if( progressReporter != nullptr )
+                {
+                    std::lock_guard< std::mutex > lock( progressMutex );
+                    progressReporter->notifyAndPrintProgressString();
+                }
+            }
         }
     );
 }
-
-#endif
@@ -0,0 +1,118 @@
+#include "PoolAllocator.h"
+
+#include <algorithm>
+
+#include "NewDeleteAllocator.h"
+
+PoolAllocator::PoolAllocator( Allocator* backing, size_t maxCachedBytes ) :
+    m_backing( backing != nullptr ? backing : NewDeleteAllocator::instance() ),
+    m_maxCachedBytes( maxCachedBytes )
+{
+
+}
+
+// virtual
+PoolAllocator::~PoolAllocator()
+{
+    trimLocked();
+}
+
+// virtual
+void* PoolAllocator::allocate( size_t bytes )
+{
+    size_t classBytes = sizeClass( bytes );
+    void* pointer = nullptr;
+
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+
+        ++m_statistics.nAllocations;
+        m_statistics.bytesInUse += classBytes;
+        m_statistics.peakBytesInUse = std::max( m_statistics.peakBytesInUse,
+            m_statistics.bytesInUse );
+
+        auto itr = m_freeLists.find( classBytes );
+        if( itr != m_freeLists.end() && !itr->second.empty() )
+        {
+            pointer = itr->second.back();
+            itr->second.pop_back();
+            m_cachedBytes -= classBytes;
+            return pointer;
+        }
+
+        ++m_statistics.nBackingAllocations;
+        m_statistics.bytesReserved += classBytes;
+    }
+
+    // Don't hold the lock while the backing allocator works.
+    return m_backing->allocate( classBytes );
+}
+
+// virtual
+void PoolAllocator::deallocate( void* pointer, size_t bytes )
+{
+    size_t classBytes = sizeClass( bytes );
+
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+
+        ++m_statistics.nDeallocations;
+        m_statistics.bytesInUse -= classBytes;
+
+        if( m_cachedBytes + classBytes <= m_maxCachedBytes )
+        {
+            m_freeLists[ classBytes ].push_back( pointer );
+            m_cachedBytes += classBytes;
+            return;
+        }
+
+        m_statistics.bytesReserved -= classBytes;
+    }
+
+    m_backing->deallocate( pointer, classBytes );
+}
+
+void PoolAllocator::trim()
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    trimLocked();
+}
+
+AllocatorStatistics PoolAllocator::statistics() const
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+    return m_statistics;
+}
+
+// static
+size_t PoolAllocator::sizeClass( size_t bytes )
+{
+    if( bytes <= 256 )
+    {
+        return std::max< size_t >( 16, ( bytes + 15 ) & ~size_t( 15 ) );
+    }
+
+    // Find the largest power of two less than bytes, and round up to a
+    // multiple of a quarter of it.
+    size_t p = 256;
+    while( 2 * p < bytes )
+    {
+        p *= 2;
+    }
+    size_t step = p / 4;
+    return ( bytes + step - 1 ) / step * step;
+}
+
+void PoolAllocator::trimLocked()
+{
+    for( auto& kvp : m_freeLists )
+    {
+        for( void* pointer : kvp.second )
+        {
+            m_backing->deallocate( pointer, kvp.first );
+        }
+        m_statistics.bytesReserved -= kvp.first * kvp.second.size();
+    }
+    m_freeLists.clear();
+    m_cachedBytes = 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "Allocator.h"
+
+// A thread-safe Allocator that recycles buffers instead of freeing them.
+//
+// Sizes are rounded up to a size class: deallocate() keeps the buffer on the
+// free list of its class, and the next allocate() in the same class reuses it
+// without going to the backing allocator. This suits pipelines that allocate
+// and free the same few image sizes over and over: after the first frame,
+// every buffer comes from the pool and its pages are already mapped.
+//
+// Size classes are multiples of 16 bytes up to 256 bytes, then four per power
+// of two, so rounding wastes at most 25% (and much less for large images).
+class PoolAllocator : public Allocator
+{
+public:
+
+    // backing: where buffers come from (NewDeleteAllocator if null). Not
+    //   owned, and must outlive the pool.
+    // maxCachedBytes: once this many bytes sit on the free lists,
+    //   deallocate() returns buffers to "backing" instead.
+    PoolAllocator( Allocator* backing = nullptr,
+        size_t maxCachedBytes = SIZE_MAX );
+
+    // Returns the cached buffers to the backing allocator. Every buffer
+    // allocated from the pool must have been deallocated.
+    virtual ~PoolAllocator();
+
+    PoolAllocator( const PoolAllocator& copy ) = delete;
+    PoolAllocator& operator = ( const PoolAllocator& copy ) = delete;
+
+    virtual void* allocate( size_t bytes ) override;
+    virtual void deallocate( void* pointer, size_t bytes ) override;
+
+    // Return every cached buffer to the backing allocator.
+    void trim();
+
+    AllocatorStatistics statistics() const;
+
+    // The number of bytes actually allocated for a request of "bytes".
+    static size_t sizeClass( size_t bytes );
+
+private:
+
+    void trimLocked();
+
+    Allocator* const m_backing;
+    const size_t m_maxCachedBytes;
+
+    mutable std::mutex m_mutex;
+
+    // Size class --> free buffers of that size.
+    std::unordered_map< size_t, std::vector< void* > > m_freeLists;
+    size_t m_cachedBytes = 0;
+
+    AllocatorStatistics m_statistics;
+};
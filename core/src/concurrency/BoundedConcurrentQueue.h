@@ -11,10 +11,9 @@ namespace libcgt { namespace core { namespace concurrency {
 // producer and consumer to "check out" subsets of the the underlying buffer
 // and fill or read from them.
 //
-// TODO(jiawen): make another type of queue, where you own the buffers and send
-// them around.
+// To own a set of Array2D buffers and send them around, use FramePool.
 //
-// TODO(jiawen): relax the single consumer assumption.
+// For multiple producers or consumers, use BoundedMPMCQueue.
 template< typename T >
 class BoundedConcurrentQueue
 {
@@ -16,9 +16,11 @@ BoundedConcurrentQueue< T >::BoundedConcurrentQueue( int bufferSize,
 template< typename T >
 BoundedConcurrentQueue< T >::BoundedConcurrentQueue(
     std::vector< T >&& ringBuffer ) :
-    m_nSlotsFree( static_cast< int >( ringBuffer.size() ) ),
-    m_nSlotsFilled( 0 ),
+    // m_buffer is declared (and therefore initialized) first: ringBuffer is
+    // empty by the time the semaphores are initialized.
     m_buffer( std::move( ringBuffer ) ),
+    m_nSlotsFree( static_cast< int >( m_buffer.size() ) ),
+    m_nSlotsFilled( 0 ),
 
     m_headIndex( 0 ),
     m_tailIndex( 0 )
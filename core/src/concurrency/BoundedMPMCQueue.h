@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <common/ArrayView.h>
+
+namespace libcgt { namespace core { namespace concurrency {
+
+// A bounded concurrent FIFO queue for any number of producer and consumer
+// threads. Like BoundedConcurrentQueue, the queue is backed by a fixed-length
+// array and producers and consumers can "check out" entries of the
+// underlying buffer to fill or read in place.
+//
+// Each entry has a sequence number that says whether it is free or filled
+// for the current lap around the ring, so that claiming an entry is a single
+// compare-and-swap: there are no locks or system calls unless a thread has to
+// wait. Waiting threads first spin, then block on a condition variable, which
+// is only signaled if some thread is blocked.
+//
+// Items checked out by different threads may be filled (or read) in any
+// order. An item becomes visible to consumers once its endEnqueue() is
+// called, but items are always dequeued in the order in which their entries
+// were claimed.
+template< typename T >
+class BoundedMPMCQueue
+{
+public:
+
+    // Create a BoundedMPMCQueue with a fixed size "bufferSize" and each
+    // filled with "fill". bufferSize must be positive.
+    BoundedMPMCQueue( int bufferSize, const T& fill = T() );
+
+    // Create a BoundedMPMCQueue with a pre-initialized fixed-sized backing
+    // store called "ringBuffer". ringBuffer must not be empty.
+    BoundedMPMCQueue( std::vector< T >&& ringBuffer );
+
+    BoundedMPMCQueue( const BoundedMPMCQueue& copy ) = delete;
+    BoundedMPMCQueue& operator = ( const BoundedMPMCQueue& copy ) = delete;
+
+    size_t bufferSize() const;
+
+    // Blocks until an entry is available then copies the item into the ring
+    // buffer.
+    void enqueue( const T& item );
+
+    // Attempt to enqueue an item, waiting up to "milliseconds" milliseconds.
+    // Returns whether it succeeded.
+    bool tryEnqueue( const T& item, int milliseconds = 0 );
+
+    // Blocks until an entry is available, then returns a pointer to the
+    // entry.
+    //
+    // The producer must call endEnqueue() with the pointer once it has
+    // filled the entry.
+    T* beginEnqueue();
+
+    // Attempt to acquire an entry into which the producer can write, waiting
+    // up to "milliseconds" milliseconds. Returns a pointer to the entry on
+    // success, and nullptr on timeout.
+    //
+    // On success, the producer must call endEnqueue() with the pointer.
+    T* tryBeginEnqueue( int milliseconds = 0 );
+
+    // Publishes an entry returned by beginEnqueue() or tryBeginEnqueue().
+    void endEnqueue( T* entry );
+
+    // Blocks until all of "items" have been enqueued. Entries are claimed in
+    // contiguous runs with one compare-and-swap per run, and consumers are
+    // woken up once per run.
+    void enqueue( Array1DReadView< T > items );
+
+    // Enqueues as many of "items" as there are free entries, without
+    // waiting. Returns the number enqueued.
+    size_t tryEnqueue( Array1DReadView< T > items );
+
+    // Blocks until an entry is available, then returns a copy of the item.
+    T dequeue();
+
+    // Attempt to dequeue an item, waiting up to "milliseconds" milliseconds.
+    // On success, writes the output into "output".
+    //
+    // Returns whether the operation succeeded.
+    bool tryDequeue( T& output, int milliseconds = 0 );
+
+    // Blocks until an entry is available, then returns a pointer to the
+    // entry. The consumer must call endDequeue() with the pointer once it is
+    // done reading.
+    T* beginDequeue();
+
+    // Attempt to acquire an entry from which the consumer can read, waiting
+    // up to "milliseconds" milliseconds. Returns a pointer to the entry on
+    // success, and nullptr on timeout.
+    //
+    // On success, the consumer must call endDequeue() with the pointer.
+    T* tryBeginDequeue( int milliseconds = 0 );
+
+    // Releases an entry returned by beginDequeue() or tryBeginDequeue().
+    void endDequeue( T* entry );
+
+    // Blocks until at least one item is available, then dequeues up to
+    // output.size() items into "output". Returns the number dequeued.
+    size_t dequeue( Array1DWriteView< T > output );
+
+    // Dequeues up to output.size() items into "output", without waiting.
+    // Returns the number dequeued.
+    size_t tryDequeue( Array1DWriteView< T > output );
+
+    // Returns true if there is at least one slot available for reading.
+    bool availableForReading() const;
+
+    // Returns the number of entries claimed by producers and not yet by
+    // consumers. Only a snapshot while other threads are running.
+    int numEntriesFilled() const;
+
+    // Returns true if there is at least one slot available for writing.
+    bool availableForWriting() const;
+
+    // Returns the number of slots available for writing. Only a snapshot
+    // while other threads are running.
+    int numEntriesFree() const;
+
+private:
+
+    struct Waiters
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::atomic< int > nWaiting{ 0 };
+    };
+
+    // Number of attempts to claim entries before blocking.
+    static const int SPIN_COUNT = 64;
+
+    // Claims up to "maxCount" consecutive entries without waiting, returning
+    // the number claimed, and the position of the first in "position".
+    size_t claimForEnqueue( size_t maxCount, size_t& position );
+    size_t claimForDequeue( size_t maxCount, size_t& position );
+
+    // Calls "tryClaim" until it returns true: spinning, then blocking on
+    // "waiters" for up to "milliseconds" milliseconds (forever if negative).
+    // Returns whether it succeeded.
+    template< typename F >
+    bool waitUntil( Waiters& waiters, F tryClaim, int milliseconds );
+
+    void notify( Waiters& waiters );
+
+    size_t indexOf( size_t position ) const;
+
+    std::vector< T > m_buffer;
+
+    // Entry i is free for the producer at position p when its sequence is
+    // 2p, and filled for the consumer at position p when it is 2p + 1. (With
+    // p and p + 1, "filled" would be indistinguishable from "free for the
+    // next lap" in a one-entry buffer.)
+    std::vector< std::atomic< size_t > > m_sequences;
+
+    // Kept on separate cache lines, since producers and consumers update
+    // them independently.
+    alignas( 64 ) std::atomic< size_t > m_enqueuePosition;
+    alignas( 64 ) std::atomic< size_t > m_dequeuePosition;
+
+    // Consumers waiting for items, and producers waiting for free entries.
+    Waiters m_notEmpty;
+    Waiters m_notFull;
+};
+
+} } } // concurrency, core, libcgt
+
+#include "BoundedMPMCQueue.inl"
@@ -0,0 +1,442 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+namespace libcgt { namespace core { namespace concurrency {
+
+template< typename T >
+BoundedMPMCQueue< T >::BoundedMPMCQueue( int bufferSize, const T& fill ) :
+    BoundedMPMCQueue( std::vector< T >( bufferSize, fill ) )
+{
+
+}
+
+template< typename T >
+BoundedMPMCQueue< T >::BoundedMPMCQueue( std::vector< T >&& ringBuffer ) :
+    m_buffer( std::move( ringBuffer ) ),
+    m_sequences( m_buffer.size() ),
+    m_enqueuePosition( 0 ),
+    m_dequeuePosition( 0 )
+{
+    assert( !m_buffer.empty() );
+    for( size_t i = 0; i < m_sequences.size(); ++i )
+    {
+        m_sequences[ i ].store( 2 * i, std::memory_order_relaxed );
+    }
+}
+
+template< typename T >
+size_t BoundedMPMCQueue< T >::bufferSize() const
+{
+    return m_buffer.size();
+}
+
+template< typename T >
+void BoundedMPMCQueue< T >::enqueue( const T& item )
+{
+    T* pEntry = beginEnqueue();
+    *pEntry = item;
+    endEnqueue( pEntry );
+}
+
+template< typename T >
+bool BoundedMPMCQueue< T >::tryEnqueue( const T& item, int milliseconds )
+{
+    T* pEntry = tryBeginEnqueue( milliseconds );
+    bool success = ( pEntry != nullptr );
+    if( success )
+    {
+        *pEntry = item;
+        endEnqueue( pEntry );
+    }
+    return success;
+}
+
+template< typename T >
+T* BoundedMPMCQueue< T >::beginEnqueue()
+{
+    size_t position;
+    waitUntil( m_notFull,
+        [&] { return claimForEnqueue( 1, position ) == 1; }, -1 );
+    return &( m_buffer[ indexOf( position ) ] );
+}
+
+template< typename T >
+T* BoundedMPMCQueue< T >::tryBeginEnqueue( int milliseconds )
+{
+    size_t position;
+    if( waitUntil( m_notFull,
+        [&] { return claimForEnqueue( 1, position ) == 1; },
+        std::max( milliseconds, 0 ) ) )
+    {
+        return &( m_buffer[ indexOf( position ) ] );
+    }
+    return nullptr;
+}
+
+template< typename T >
+void BoundedMPMCQueue< T >::endEnqueue( T* entry )
+{
+    std::atomic< size_t >& sequence = m_sequences[ entry - m_buffer.data() ];
+    sequence.store( sequence.load( std::memory_order_relaxed ) + 1,
+        std::memory_order_release );
+    notify( m_notEmpty );
+}
+
+template< typename T >
+void BoundedMPMCQueue< T >::enqueue( Array1DReadView< T > items )
+{
+    size_t i = 0;
+    while( i < items.size() )
+    {
+        size_t position;
+        size_t n = 0;
+        waitUntil( m_notFull,
+            [&]
+            {
+                n = claimForEnqueue( items.size() - i, position );
+                return n > 0;
+            },
+            -1 );
+
+        for( size_t k = 0; k < n; ++k )
+        {
+            size_t index = indexOf( position + k );
+            m_buffer[ index ] = items[ i + k ];
+            m_sequences[ index ].store( 2 * ( position + k ) + 1,
+                std::memory_order_release );
+        }
+        notify( m_notEmpty );
+        i += n;
+    }
+}
+
+template< typename T >
+size_t BoundedMPMCQueue< T >::tryEnqueue( Array1DReadView< T > items )
+{
+    size_t i = 0;
+    while( i < items.size() )
+    {
+        size_t position;
+        size_t n = claimForEnqueue( items.size() - i, position );
+        if( n == 0 )
+        {
+            break;
+        }
+
+        for( size_t k = 0; k < n; ++k )
+        {
+            size_t index = indexOf( position + k );
+            m_buffer[ index ] = items[ i + k ];
+            m_sequences[ index ].store( 2 * ( position + k ) + 1,
+                std::memory_order_release );
+        }
+        i += n;
+    }
+
+    if( i > 0 )
+    {
+        notify( m_notEmpty );
+    }
+    return i;
+}
+
+template< typename T >
+T BoundedMPMCQueue< T >::dequeue()
+{
+    T* pEntry = beginDequeue();
+    T output = *pEntry;
+    endDequeue( pEntry );
+    return output;
+}
+
+template< typename T >
+bool BoundedMPMCQueue< T >::tryDequeue( T& output, int milliseconds )
+{
+    T* pEntry = tryBeginDequeue( milliseconds );
+    bool success = ( pEntry != nullptr );
+    if( success )
+    {
+        output = *pEntry;
+        endDequeue( pEntry );
+    }
+    return success;
+}
+
+template< typename T >
+T* BoundedMPMCQueue< T >::beginDequeue()
+{
+    size_t position;
+    waitUntil( m_notEmpty,
+        [&] { return claimForDequeue( 1, position ) == 1; }, -1 );
+    return &( m_buffer[ indexOf( position ) ] );
+}
+
+template< typename T >
+T* BoundedMPMCQueue< T >::tryBeginDequeue( int milliseconds )
+{
+    size_t position;
+    if( waitUntil( m_notEmpty,
+        [&] { return claimForDequeue( 1, position ) == 1; },
+        std::max( milliseconds, 0 ) ) )
+    {
+        return &( m_buffer[ indexOf( position ) ] );
+    }
+    return nullptr;
+}
+
+template< typename T >
+void BoundedMPMCQueue< T >::endDequeue( T* entry )
+{
+    // The sequence is 2 * position + 1: free it for the producer one lap
+    // later.
+    std::atomic< size_t >& sequence = m_sequences[ entry - m_buffer.data() ];
+    sequence.store(
+        sequence.load( std::memory_order_relaxed ) - 1 + 2 * m_buffer.size(),
+        std::memory_order_release );
+    notify( m_notFull );
+}
+
+template< typename T >
+size_t BoundedMPMCQueue< T >::dequeue( Array1DWriteView< T > output )
+{
+    if( output.size() == 0 )
+    {
+        return 0;
+    }
+
+    size_t position;
+    size_t n = 0;
+    waitUntil( m_notEmpty,
+        [&]
+        {
+            n = claimForDequeue( output.size(), position );
+            return n > 0;
+        },
+        -1 );
+
+    for( size_t k = 0; k < n; ++k )
+    {
+        size_t index = indexOf( position + k );
+        output[ k ] = m_buffer[ index ];
+        m_sequences[ index ].store( 2 * ( position + k + m_buffer.size() ),
+            std::memory_order_release );
+    }
+    notify( m_notFull );
+    return n;
+}
+
+template< typename T >
+size_t BoundedMPMCQueue< T >::tryDequeue( Array1DWriteView< T > output )
+{
+    size_t i = 0;
+    while( i < output.size() )
+    {
+        size_t position;
+        size_t n = claimForDequeue( output.size() - i, position );
+        if( n == 0 )
+        {
+            break;
+        }
+
+        for( size_t k = 0; k < n; ++k )
+        {
+            size_t index = indexOf( position + k );
+            output[ i + k ] = m_buffer[ index ];
+            m_sequences[ index ].store( 2 * ( position + k + m_buffer.size() ),
+                std::memory_order_release );
+        }
+        i += n;
+    }
+
+    if( i > 0 )
+    {
+        notify( m_notFull );
+    }
+    return i;
+}
+
+template< typename T >
+bool BoundedMPMCQueue< T >::availableForReading() const
+{
+    return numEntriesFilled() > 0;
+}
+
+template< typename T >
+int BoundedMPMCQueue< T >::numEntriesFilled() const
+{
+    size_t dequeuePosition =
+        m_dequeuePosition.load( std::memory_order_acquire );
+    size_t enqueuePosition =
+        m_enqueuePosition.load( std::memory_order_acquire );
+    ptrdiff_t n = static_cast< ptrdiff_t >( enqueuePosition - dequeuePosition );
+    n = std::max< ptrdiff_t >( 0,
+        std::min< ptrdiff_t >( n, m_buffer.size() ) );
+    return static_cast< int >( n );
+}
+
+template< typename T >
+bool BoundedMPMCQueue< T >::availableForWriting() const
+{
+    return numEntriesFree() > 0;
+}
+
+template< typename T >
+int BoundedMPMCQueue< T >::numEntriesFree() const
+{
+    return static_cast< int >( m_buffer.size() ) - numEntriesFilled();
+}
+
+template< typename T >
+size_t BoundedMPMCQueue< T >::claimForEnqueue( size_t maxCount,
+    size_t& position )
+{
+    maxCount = std::min( maxCount, m_buffer.size() );
+    size_t pos = m_enqueuePosition.load( std::memory_order_relaxed );
+    while( true )
+    {
+        // Count the free entries starting at pos. No other producer can
+        // change them unless it first moves m_enqueuePosition past pos, in
+        // which case the compare-and-swap below fails.
+        size_t n = 0;
+        while( n < maxCount &&
+            m_sequences[ indexOf( pos + n ) ].load(
+                std::memory_order_acquire ) == 2 * ( pos + n ) )
+        {
+            ++n;
+        }
+
+        if( n == 0 )
+        {
+            size_t sequence =
+                m_sequences[ indexOf( pos ) ].load( std::memory_order_acquire );
+            if( static_cast< intptr_t >( sequence - 2 * pos ) < 0 )
+            {
+                // Still filled from the previous lap: the queue is full.
+                return 0;
+            }
+            // Another producer claimed pos.
+            pos = m_enqueuePosition.load( std::memory_order_relaxed );
+        }
+        else if( m_enqueuePosition.compare_exchange_weak( pos, pos + n,
+            std::memory_order_relaxed ) )
+        {
+            position = pos;
+            return n;
+        }
+    }
+}
+
+template< typename T >
+size_t BoundedMPMCQueue< T >::claimForDequeue( size_t maxCount,
+    size_t& position )
+{
+    maxCount = std::min( maxCount, m_buffer.size() );
+    size_t pos = m_dequeuePosition.load( std::memory_order_relaxed );
+    while( true )
+    {
+        size_t n = 0;
+        while( n < maxCount &&
+            m_sequences[ indexOf( pos + n ) ].load(
+                std::memory_order_acquire ) == 2 * ( pos + n ) + 1 )
+        {
+            ++n;
+        }
+
+        if( n == 0 )
+        {
+            size_t sequence =
+                m_sequences[ indexOf( pos ) ].load( std::memory_order_acquire );
+            if( static_cast< intptr_t >( sequence - ( 2 * pos + 1 ) ) < 0 )
+            {
+                // Not yet filled: the queue is empty.
+                return 0;
+            }
+            // Another consumer claimed pos.
+            pos = m_dequeuePosition.load( std::memory_order_relaxed );
+        }
+        else if( m_dequeuePosition.compare_exchange_weak( pos, pos + n,
+            std::memory_order_relaxed ) )
+        {
+            position = pos;
+            return n;
+        }
+    }
+}
+
+template< typename T >
+template< typename F >
+bool BoundedMPMCQueue< T >::waitUntil( Waiters& waiters, F tryClaim,
+    int milliseconds )
+{
+    // Spin briefly, yielding the processor after the first few attempts.
+    for( int i = 0; i < SPIN_COUNT; ++i )
+    {
+        if( tryClaim() )
+        {
+            return true;
+        }
+        if( milliseconds == 0 )
+        {
+            return false;
+        }
+        if( i >= SPIN_COUNT / 2 )
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    // Announce that we are waiting before checking again under the lock:
+    // either the check sees an entry published after this point, or its
+    // publisher sees nWaiting > 0 and signals.
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds( std::max( milliseconds, 0 ) );
+    waiters.nWaiting.fetch_add( 1 );
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    bool success;
+    {
+        std::unique_lock< std::mutex > lock( waiters.mutex );
+        while( !( success = tryClaim() ) )
+        {
+            if( milliseconds < 0 )
+            {
+                waiters.cv.wait( lock );
+            }
+            else if( waiters.cv.wait_until( lock, deadline ) ==
+                std::cv_status::timeout )
+            {
+                success = tryClaim();
+                break;
+            }
+        }
+    }
+    waiters.nWaiting.fetch_sub( 1 );
+    return success;
+}
+
+template< typename T >
+void BoundedMPMCQueue< T >::notify( Waiters& waiters )
+{
+    // Pairs with the fetch_add in waitUntil().
+    std::atomic_thread_fence( std::memory_order_seq_cst );
+    if( waiters.nWaiting.load( std::memory_order_relaxed ) > 0 )
+    {
+        // Acquiring the lock ensures that a waiter is either before its
+        // check or already blocked on the condition variable.
+        {
+            std::lock_guard< std::mutex > lock( waiters.mutex );
+        }
+        waiters.cv.notify_all();
+    }
+}
+
+template< typename T >
+size_t BoundedMPMCQueue< T >::indexOf( size_t position ) const
+{
+    return position % m_buffer.size();
+}
+
+} } } // concurrency, core, libcgt
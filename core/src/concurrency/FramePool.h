@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <common/Array2D.h>
+#include <vecmath/Vector2i.h>
+
+#include "BoundedMPMCQueue.h"
+
+namespace libcgt { namespace core { namespace concurrency {
+
+// A fixed set of Array2D< T > frames, allocated once, that are passed by
+// pointer through a pipeline of stages (e.g., camera -> filter -> encoder)
+// instead of being copied.
+//
+// A producer lease()s a free frame, fills it, and submit()s it to stage 0.
+// Consumers at stage s receive( s ) frames in the order they were
+// submitted, and either submit() them to the next stage or recycle() them
+// back into the pool. Whoever holds a frame pointer owns it until it is
+// passed on, and any number of threads may run each stage.
+//
+// Since each stage's channel can hold every frame, submit() and recycle()
+// never block: only lease() and receive() wait.
+template< typename T >
+class FramePool
+{
+public:
+
+    struct Statistics
+    {
+        // Number of frames leased.
+        int64_t nLeases;
+
+        // Number of leases that found the pool empty and had to wait.
+        int64_t nStarvedLeases;
+
+        // Total time spent waiting in starved leases, in milliseconds.
+        double starvedMilliseconds;
+
+        // The fewest frames that were left in the pool after a lease.
+        int minFreeFrames;
+    };
+
+    // Allocates "nFrames" frames of size "size", each filled with "fill", for
+    // a pipeline with "nStages" stages.
+    FramePool( int nFrames, const Vector2i& size, int nStages = 1,
+        const T& fill = T() );
+
+    FramePool( const FramePool& copy ) = delete;
+    FramePool& operator = ( const FramePool& copy ) = delete;
+
+    int numFrames() const;
+    int numStages() const;
+    Vector2i frameSize() const;
+
+    // The number of frames currently in the pool. Only a snapshot while
+    // other threads are running.
+    int numFreeFrames() const;
+
+    // Blocks until a frame is free, then returns it. The caller owns it until
+    // it calls submit() or recycle().
+    Array2D< T >* lease();
+
+    // Attempts to lease a frame, waiting up to "milliseconds" milliseconds.
+    // Returns nullptr on timeout.
+    Array2D< T >* tryLease( int milliseconds = 0 );
+
+    // Passes ownership of "frame" to the consumers of stage "stage".
+    void submit( Array2D< T >* frame, int stage = 0 );
+
+    // Blocks until a frame has been submitted to "stage", then returns it.
+    // The caller owns it until it calls submit() or recycle().
+    Array2D< T >* receive( int stage = 0 );
+
+    // Attempts to receive a frame from "stage", waiting up to "milliseconds"
+    // milliseconds. Returns nullptr on timeout.
+    Array2D< T >* tryReceive( int stage = 0, int milliseconds = 0 );
+
+    // Returns "frame" to the pool.
+    void recycle( Array2D< T >* frame );
+
+    // Returns counters since construction or the last resetStatistics().
+    Statistics statistics() const;
+    void resetStatistics();
+
+private:
+
+    // Updates the counters after a lease. "waitTicks" is in
+    // std::chrono::steady_clock ticks.
+    void recordLease( bool starved, int64_t waitTicks );
+
+    std::vector< Array2D< T > > m_frames;
+
+    // The free frames, and the frames submitted to each stage.
+    BoundedMPMCQueue< Array2D< T >* > m_free;
+    std::vector< std::unique_ptr< BoundedMPMCQueue< Array2D< T >* > > >
+        m_stages;
+
+    std::atomic< int64_t > m_nLeases;
+    std::atomic< int64_t > m_nStarvedLeases;
+    std::atomic< int64_t > m_starvedTicks;
+    std::atomic< int > m_minFreeFrames;
+};
+
+} } } // concurrency, core, libcgt
+
+#include "FramePool.inl"
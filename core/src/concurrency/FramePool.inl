@@ -0,0 +1,177 @@
+#include <cassert>
+#include <chrono>
+
+namespace libcgt { namespace core { namespace concurrency {
+
+template< typename T >
+FramePool< T >::FramePool( int nFrames, const Vector2i& size, int nStages,
+    const T& fill ) :
+    m_free( nFrames, nullptr ),
+    m_nLeases( 0 ),
+    m_nStarvedLeases( 0 ),
+    m_starvedTicks( 0 ),
+    m_minFreeFrames( nFrames )
+{
+    assert( nFrames > 0 );
+    assert( nStages > 0 );
+
+    // Allocate everything up front: the frames are never moved after this.
+    m_frames.reserve( nFrames );
+    for( int i = 0; i < nFrames; ++i )
+    {
+        m_frames.emplace_back( size, fill );
+    }
+    for( int i = 0; i < nFrames; ++i )
+    {
+        m_free.enqueue( &( m_frames[ i ] ) );
+    }
+
+    for( int s = 0; s < nStages; ++s )
+    {
+        m_stages.emplace_back(
+            new BoundedMPMCQueue< Array2D< T >* >( nFrames, nullptr ) );
+    }
+}
+
+template< typename T >
+int FramePool< T >::numFrames() const
+{
+    return static_cast< int >( m_frames.size() );
+}
+
+template< typename T >
+int FramePool< T >::numStages() const
+{
+    return static_cast< int >( m_stages.size() );
+}
+
+template< typename T >
+Vector2i FramePool< T >::frameSize() const
+{
+    return m_frames[ 0 ].size();
+}
+
+template< typename T >
+int FramePool< T >::numFreeFrames() const
+{
+    return m_free.numEntriesFilled();
+}
+
+template< typename T >
+Array2D< T >* FramePool< T >::lease()
+{
+    Array2D< T >* frame;
+    if( m_free.tryDequeue( frame ) )
+    {
+        recordLease( false, 0 );
+        return frame;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    frame = m_free.dequeue();
+    recordLease( true, ( std::chrono::steady_clock::now() - t0 ).count() );
+    return frame;
+}
+
+template< typename T >
+Array2D< T >* FramePool< T >::tryLease( int milliseconds )
+{
+    Array2D< T >* frame;
+    if( m_free.tryDequeue( frame ) )
+    {
+        recordLease( false, 0 );
+        return frame;
+    }
+    if( milliseconds <= 0 )
+    {
+        return nullptr;
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    bool succeeded = m_free.tryDequeue( frame, milliseconds );
+    int64_t waitTicks = ( std::chrono::steady_clock::now() - t0 ).count();
+    if( succeeded )
+    {
+        recordLease( true, waitTicks );
+        return frame;
+    }
+    // Count the wait even though it timed out.
+    m_starvedTicks.fetch_add( waitTicks, std::memory_order_relaxed );
+    return nullptr;
+}
+
+template< typename T >
+void FramePool< T >::submit( Array2D< T >* frame, int stage )
+{
+    assert( frame != nullptr );
+    m_stages[ stage ]->enqueue( frame );
+}
+
+template< typename T >
+Array2D< T >* FramePool< T >::receive( int stage )
+{
+    return m_stages[ stage ]->dequeue();
+}
+
+template< typename T >
+Array2D< T >* FramePool< T >::tryReceive( int stage, int milliseconds )
+{
+    Array2D< T >* frame;
+    if( m_stages[ stage ]->tryDequeue( frame, milliseconds ) )
+    {
+        return frame;
+    }
+    return nullptr;
+}
+
+template< typename T >
+void FramePool< T >::recycle( Array2D< T >* frame )
+{
+    assert( frame != nullptr );
+    m_free.enqueue( frame );
+}
+
+template< typename T >
+typename FramePool< T >::Statistics FramePool< T >::statistics() const
+{
+    using Milliseconds = std::chrono::duration< double, std::milli >;
+
+    Statistics stats;
+    stats.nLeases = m_nLeases.load( std::memory_order_relaxed );
+    stats.nStarvedLeases = m_nStarvedLeases.load( std::memory_order_relaxed );
+    stats.starvedMilliseconds = std::chrono::duration_cast< Milliseconds >(
+        std::chrono::steady_clock::duration(
+            m_starvedTicks.load( std::memory_order_relaxed ) ) ).count();
+    stats.minFreeFrames = m_minFreeFrames.load( std::memory_order_relaxed );
+    return stats;
+}
+
+template< typename T >
+void FramePool< T >::resetStatistics()
+{
+    m_nLeases.store( 0, std::memory_order_relaxed );
+    m_nStarvedLeases.store( 0, std::memory_order_relaxed );
+    m_starvedTicks.store( 0, std::memory_order_relaxed );
+    m_minFreeFrames.store( numFreeFrames(), std::memory_order_relaxed );
+}
+
+template< typename T >
+void FramePool< T >::recordLease( bool starved, int64_t waitTicks )
+{
+    m_nLeases.fetch_add( 1, std::memory_order_relaxed );
+    if( starved )
+    {
+        m_nStarvedLeases.fetch_add( 1, std::memory_order_relaxed );
+        m_starvedTicks.fetch_add( waitTicks, std::memory_order_relaxed );
+    }
+
+    int nFree = numFreeFrames();
+    int minFree = m_minFreeFrames.load( std::memory_order_relaxed );
+    while( nFree < minFree &&
+        !m_minFreeFrames.compare_exchange_weak( minFree, nFree,
+            std::memory_order_relaxed ) )
+    {
+    }
+}
+
+} } } // concurrency, core, libcgt
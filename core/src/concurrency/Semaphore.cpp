@@ -10,8 +10,10 @@ Semaphore::Semaphore( int count ) : m_count( count )
 void Semaphore::signal( int n )
 {
     std::unique_lock< std::mutex > lock( m_mutex );
-    ++m_count;
-    m_cv.notify_one();
+    m_count += n;
+    // Waiters may want different counts, so the one notify_one() wakes may
+    // not be able to proceed while another could.
+    m_cv.notify_all();
 }
 
 void Semaphore::wait( int n )
@@ -50,11 +52,16 @@ bool Semaphore::tryWait( int n, int milliseconds )
             return ( m_count >= n );
         }
     );
+    if( acquired )
+    {
+        m_count -= n;
+    }
     return acquired;
 }
 
 int Semaphore::count() const
 {
+    std::lock_guard< std::mutex > lock( m_mutex );
     return m_count;
 }
 
@@ -17,7 +17,8 @@ public:
     Semaphore( int count = 0 );
 
     // Atomically increment the counter by n (indicating that n resources are
-    // are now available). Then wake up *one* thread that may be waiting.
+    // are now available). Then wake up all waiting threads: each one
+    // proceeds only if enough resources are left for it.
     void signal( int n = 1 );
 
     // Attempt to decrement the counter by n (acquiring n resources).
@@ -43,12 +44,13 @@ public:
     // If milliseconds < 0, will be equivalent to tryWait( n ).
     bool tryWait( int n, int milliseconds );
 
-    // Return the current number of resources available.
+    // Return the current number of resources available. Safe to call from
+    // any thread, but the count may change as soon as it returns.
     int count() const;
 
 private:
 
-    std::mutex m_mutex;
+    mutable std::mutex m_mutex;
     std::condition_variable m_cv;
     int m_count;
 };
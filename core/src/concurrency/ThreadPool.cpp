@@ -0,0 +1,284 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <deque>
+
+namespace libcgt { namespace core { namespace concurrency {
+
+namespace
+{
+
+// Set for the workers of a pool: the pool that owns the thread and the index
+// of its deque.
+thread_local const ThreadPool* t_pool = nullptr;
+thread_local int t_queueIndex = -1;
+
+// The number of times an idle worker yields before going to sleep.
+const int IDLE_SPIN_COUNT = 64;
+
+}
+
+// One call to parallelFor().
+struct ThreadPool::Loop
+{
+    const RangeFunction* body;
+    int grainSize;
+
+    // The number of iterations not yet completed.
+    std::atomic< int > nRemaining;
+};
+
+struct ThreadPool::Task
+{
+    Loop* loop;
+    int begin;
+    int end;
+};
+
+class ThreadPool::WorkDeque
+{
+public:
+
+    void pushBack( const Task& task )
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_tasks.push_back( task );
+    }
+
+    bool popBack( Task& task )
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        if( m_tasks.empty() )
+        {
+            return false;
+        }
+        task = m_tasks.back();
+        m_tasks.pop_back();
+        return true;
+    }
+
+    bool popFront( Task& task )
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        if( m_tasks.empty() )
+        {
+            return false;
+        }
+        task = m_tasks.front();
+        m_tasks.pop_front();
+        return true;
+    }
+
+private:
+
+    std::mutex m_mutex;
+    std::deque< Task > m_tasks;
+};
+
+ThreadPool::ThreadPool( int nThreads ) :
+    m_nQueuedTasks( 0 ),
+    m_nSleepingWorkers( 0 ),
+    m_stopping( false )
+{
+    if( nThreads <= 0 )
+    {
+        nThreads = std::max( 1,
+            static_cast< int >( std::thread::hardware_concurrency() ) );
+    }
+
+    // The calling thread is one of the nThreads.
+    int nWorkers = nThreads - 1;
+    for( int i = 0; i < nWorkers + 1; ++i )
+    {
+        m_deques.emplace_back( new WorkDeque );
+    }
+    for( int i = 0; i < nWorkers; ++i )
+    {
+        m_workers.emplace_back( &ThreadPool::workerMain, this, i );
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard< std::mutex > lock( m_sleepMutex );
+        m_stopping = true;
+    }
+    m_wakeUp.notify_all();
+
+    for( std::thread& worker : m_workers )
+    {
+        worker.join();
+    }
+}
+
+// static
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+int ThreadPool::numThreads() const
+{
+    return static_cast< int >( m_workers.size() ) + 1;
+}
+
+int ThreadPool::defaultGrainSize( int n ) const
+{
+    return std::max( 1, n / ( 8 * numThreads() ) );
+}
+
+void ThreadPool::parallelFor( int begin, int end, int grainSize,
+    const RangeFunction& body )
+{
+    int n = end - begin;
+    if( n <= 0 )
+    {
+        return;
+    }
+
+    if( grainSize <= 0 )
+    {
+        grainSize = defaultGrainSize( n );
+    }
+
+    if( n <= grainSize || m_workers.empty() )
+    {
+        body( begin, end );
+        return;
+    }
+
+    Loop loop;
+    loop.body = &body;
+    loop.grainSize = grainSize;
+    loop.nRemaining = n;
+
+    // Run the first piece here, then help out with whatever is queued
+    // (possibly tasks of other loops) until every iteration is done.
+    int queueIndex = currentQueueIndex();
+    runTask( Task{ &loop, begin, end }, queueIndex );
+
+    while( loop.nRemaining.load( std::memory_order_acquire ) > 0 )
+    {
+        Task task;
+        if( tryTake( queueIndex, task ) )
+        {
+            runTask( task, queueIndex );
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ThreadPool::workerMain( int queueIndex )
+{
+    t_pool = this;
+    t_queueIndex = queueIndex;
+
+    int nIdleSpins = 0;
+    while( true )
+    {
+        Task task;
+        if( tryTake( queueIndex, task ) )
+        {
+            runTask( task, queueIndex );
+            nIdleSpins = 0;
+        }
+        else if( nIdleSpins < IDLE_SPIN_COUNT )
+        {
+            std::this_thread::yield();
+            ++nIdleSpins;
+        }
+        else
+        {
+            std::unique_lock< std::mutex > lock( m_sleepMutex );
+            ++m_nSleepingWorkers;
+            m_wakeUp.wait
+            (
+                lock,
+                [&]
+                {
+                    return( m_nQueuedTasks > 0 || m_stopping );
+                }
+            );
+            --m_nSleepingWorkers;
+
+            if( m_stopping && m_nQueuedTasks == 0 )
+            {
+                return;
+            }
+            nIdleSpins = 0;
+        }
+    }
+}
+
+void ThreadPool::runTask( Task task, int queueIndex )
+{
+    Loop* loop = task.loop;
+    while( task.end - task.begin > loop->grainSize )
+    {
+        int mid = task.begin + ( task.end - task.begin ) / 2;
+        push( Task{ loop, mid, task.end }, queueIndex );
+        task.end = mid;
+    }
+
+    ( *loop->body )( task.begin, task.end );
+
+    // The loop may be destroyed as soon as nRemaining reaches 0.
+    loop->nRemaining.fetch_sub( task.end - task.begin,
+        std::memory_order_release );
+}
+
+void ThreadPool::push( const Task& task, int queueIndex )
+{
+    m_deques[ queueIndex ]->pushBack( task );
+    ++m_nQueuedTasks;
+
+    if( m_nSleepingWorkers > 0 )
+    {
+        // Taking the lock guarantees that a worker that has just decided to
+        // sleep is already waiting, and therefore sees the notification.
+        std::lock_guard< std::mutex > lock( m_sleepMutex );
+        m_wakeUp.notify_one();
+    }
+}
+
+bool ThreadPool::tryTake( int queueIndex, Task& task )
+{
+    if( m_nQueuedTasks == 0 )
+    {
+        return false;
+    }
+
+    if( m_deques[ queueIndex ]->popBack( task ) )
+    {
+        --m_nQueuedTasks;
+        return true;
+    }
+
+    int nDeques = static_cast< int >( m_deques.size() );
+    for( int i = 1; i < nDeques; ++i )
+    {
+        int victim = ( queueIndex + i ) % nDeques;
+        if( m_deques[ victim ]->popFront( task ) )
+        {
+            --m_nQueuedTasks;
+            return true;
+        }
+    }
+    return false;
+}
+
+int ThreadPool::currentQueueIndex() const
+{
+    if( t_pool == this )
+    {
+        return t_queueIndex;
+    }
+    return static_cast< int >( m_deques.size() ) - 1;
+}
+
+} } } // concurrency, core, libcgt
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libcgt { namespace core { namespace concurrency {
+
+// A fixed-size pool of worker threads that execute parallel loops using work
+// stealing.
+//
+// parallelFor() splits its range recursively: a thread that picks up a range
+// larger than the grain size pushes one half onto its own deque and keeps
+// working on the other. Each thread pops work from the back of its own deque
+// (newest and smallest first, for locality) and, when it runs dry, steals
+// from the front of another thread's deque (oldest and largest first). The
+// calling thread participates until the loop is done, so parallelFor() may be
+// called from inside a loop body.
+class ThreadPool
+{
+public:
+
+    // The body of a parallel loop, which processes iterations [begin, end).
+    using RangeFunction = std::function< void( int begin, int end ) >;
+
+    // Create a pool with "nThreads" worker threads.
+    // If nThreads <= 0, uses one per hardware thread.
+    ThreadPool( int nThreads = 0 );
+
+    // Waits for the workers to finish what they are doing and joins them.
+    ~ThreadPool();
+
+    ThreadPool( const ThreadPool& copy ) = delete;
+    ThreadPool& operator = ( const ThreadPool& copy ) = delete;
+
+    // The pool shared by the parallel iterators, created on first use with
+    // one thread per hardware thread.
+    static ThreadPool& global();
+
+    int numThreads() const;
+
+    // A grain size that splits "n" iterations into about 8 ranges per
+    // thread.
+    int defaultGrainSize( int n ) const;
+
+    // Calls "body" on disjoint subranges of [begin, end) that together cover
+    // it, in parallel, and returns when all of them are done. No subrange is
+    // split if it is "grainSize" iterations or shorter. If grainSize <= 0,
+    // uses defaultGrainSize().
+    void parallelFor( int begin, int end, int grainSize,
+        const RangeFunction& body );
+
+private:
+
+    struct Loop;
+    struct Task;
+    class WorkDeque;
+
+    void workerMain( int queueIndex );
+
+    // Split "task" until it is at most its loop's grain size, pushing the
+    // other halves onto "queueIndex", then run it.
+    void runTask( Task task, int queueIndex );
+
+    void push( const Task& task, int queueIndex );
+
+    // Pop from the back of deque "queueIndex", otherwise steal from the front
+    // of another one.
+    bool tryTake( int queueIndex, Task& task );
+
+    // The deque used by the calling thread.
+    int currentQueueIndex() const;
+
+    // One deque per worker, followed by one shared by all other threads.
+    std::vector< std::unique_ptr< WorkDeque > > m_deques;
+    std::vector< std::thread > m_workers;
+
+    // Total number of tasks in all deques, so that idle workers know when to
+    // sleep.
+    std::atomic< int > m_nQueuedTasks;
+    std::atomic< int > m_nSleepingWorkers;
+    std::atomic< bool > m_stopping;
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+};
+
+} } } // concurrency, core, libcgt
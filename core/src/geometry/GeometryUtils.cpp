@@ -5,8 +5,8 @@
 #define _USE_MATH_DEFINES
 #include <cmath>
 
-#include "common/ForND.h"
 #include "geometry/Plane3f.h"
+#include "geometry/TriangleRasterizer.h"
 #include "math/Arithmetic.h"
 #include "math/MathUtils.h"
 #include "vecmath/Box3f.h"
@@ -19,12 +19,48 @@
 #include "vecmath/Vector3f.h"
 #include "vecmath/Vector4f.h"
 
-using libcgt::core::for2D;
+using libcgt::core::geometry::MAX_RASTER_COORDINATE;
+using libcgt::core::geometry::RasterMode;
+using libcgt::core::geometry::RasterTriangle;
+using libcgt::core::geometry::rasterizeTriangle;
+using libcgt::core::geometry::setupTriangle;
 using std::abs;
 using std::max;
 using std::min;
 using std::swap;
 
+namespace
+{
+
+// Rasterizes the triangle with no clipping (beyond MAX_RASTER_COORDINATE),
+// returning the centers of the covered pixels.
+std::vector< Vector2f > rasterize( const Vector2f& v0, const Vector2f& v1,
+    const Vector2f& v2, RasterMode mode )
+{
+    const int maxCoordinate = static_cast< int >( MAX_RASTER_COORDINATE );
+    Rect2i clipRect( Vector2i( -maxCoordinate ),
+        Vector2i( 2 * maxCoordinate ) );
+
+    std::vector< Vector2f > pointsInside;
+    RasterTriangle triangle;
+    if( setupTriangle( v0, v1, v2, clipRect, triangle, mode ) )
+    {
+        pointsInside.reserve(
+            static_cast< size_t >( triangle.x1 - triangle.x0 ) *
+            ( triangle.y1 - triangle.y0 ) );
+        rasterizeTriangle( triangle, [&]( int y, int xBegin, int xEnd )
+        {
+            for( int x = xBegin; x < xEnd; ++x )
+            {
+                pointsInside.push_back( Vector2f( x + 0.5f, y + 0.5f ) );
+            }
+        } );
+    }
+    return pointsInside;
+}
+
+}
+
 // static
 const float GeometryUtils::EPSILON = 0.0001f;
 
@@ -96,22 +132,7 @@ Vector2f GeometryUtils::triangleCentroid( const Vector2f& v0, const Vector2f& v1
 // static
 std::vector< Vector2f > GeometryUtils::pixelsInTriangle( const Vector2f& v0, const Vector2f& v1, const Vector2f& v2 )
 {
-    Rect2i bbox = triangleBoundingBox( v0, v1, v2 ).enlargedToInt();
-
-    std::vector< Vector2f > pointsInside;
-    pointsInside.reserve( bbox.area() );
-
-    for2D( bbox.minimum(), bbox.size, [&]( const Vector2i& xy )
-    {
-        Vector2f p = xy + 0.5f;
-
-        if( pointInTriangle( p, v0, v1, v2 ) )
-        {
-            pointsInside.push_back( p );
-        }
-    });
-
-    return pointsInside;
+    return rasterize( v0, v1, v2, RasterMode::CENTER );
 }
 
 // static
@@ -144,38 +165,7 @@ float GeometryUtils::edgeTestConservative( const Vector2f& edgeNormal, const Vec
 std::vector< Vector2f > GeometryUtils::pixelsInTriangleConservative(
     const Vector2f& v0, const Vector2f& v1, const Vector2f& v2 )
 {
-    // set up edges
-    Vector2f edge01 = v1 - v0;
-    Vector2f edge12 = v2 - v1;
-    Vector2f edge20 = v0 - v2;
-
-    // get edge normals
-    Vector2f normal01 = edge01.normal();
-    Vector2f normal12 = edge12.normal();
-    Vector2f normal20 = edge20.normal();
-
-    Rect2i bbox = triangleBoundingBox( v0, v1, v2 ).enlargedToInt();
-
-    std::vector< Vector2f > pointsInside;
-    pointsInside.reserve( bbox.area() );
-
-    for2D( bbox.minimum(), bbox.size, [&]( const Vector2i& xy )
-    {
-        Vector2f p = xy + 0.5f;
-
-        float passed01 = edgeTestConservative( normal01, v0, p );
-        float passed12 = edgeTestConservative( normal12, v1, p );
-        float passed20 = edgeTestConservative( normal20, v2, p );
-
-        if( ( passed01 > 0 ) &&
-            ( passed12 > 0 ) &&
-            ( passed20 > 0 ) )
-        {
-            pointsInside.push_back( p );
-        }
-    });
-
-    return pointsInside;
+    return rasterize( v0, v1, v2, RasterMode::CONSERVATIVE );
 }
 
 // static
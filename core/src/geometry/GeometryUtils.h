@@ -28,6 +28,10 @@ public:
     static Vector2f triangleCentroid( const Vector2f& v0, const Vector2f& v1, const Vector2f& v2 );
 
     // pixels are centered at half-integer coordinates
+    // returns the centers of the pixels inside the triangle, using
+    // libcgt::core::geometry::rasterizeTriangle(): pixels on a shared edge
+    // belong to exactly one triangle (the top-left rule)
+    // either winding is accepted
     static std::vector< Vector2f > pixelsInTriangle( const Vector2f& v0,
         const Vector2f& v1, const Vector2f& v2 );
 
@@ -41,8 +45,9 @@ public:
     static float edgeTestConservative( const Vector2f& edgeNormal,
         const Vector2f& edgeOrigin, const Vector2f& point );
 
-    // Conservative rasterization:
-    // v0, v1, v2 must be counterclockwise oriented
+    // Conservative rasterization: every pixel whose square touches the
+    // triangle, using libcgt::core::geometry::rasterizeTriangle()
+    // either winding is accepted
     // pixel centers are at half-integer coordinates
     static std::vector< Vector2f > pixelsInTriangleConservative(
         const Vector2f& v0, const Vector2f& v1, const Vector2f& v2 );
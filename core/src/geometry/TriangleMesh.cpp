@@ -3,16 +3,118 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <functional>
 #include <numeric>
-#include <stack>
 
 #include "common/ArrayUtils.h"
 #include "common/ProgressReporter.h"
+#include "concurrency/ThreadPool.h"
 #include "geometry/GeometryUtils.h"
+#include "geometry/TriangleMeshTopology.h"
 #include "math/MathUtils.h"
 
 using libcgt::core::arrayutils::copy;
 using libcgt::core::arrayutils::writeViewOf;
+using libcgt::core::concurrency::ThreadPool;
+
+namespace
+{
+
+// consolidateFaces() uses a table over all vertices when a component has at
+// least 1 / DENSE_CONSOLIDATE_RATIO as many corners as the mesh has vertices.
+const int DENSE_CONSOLIDATE_RATIO = 16;
+
+// Returns a mesh with the faces faceIndices of "mesh", and only the vertices
+// they use. The vertices keep their relative order.
+TriangleMesh consolidateFaces( const TriangleMesh& mesh,
+    const std::vector< int >& faceIndices )
+{
+    int nFaces = static_cast< int >( faceIndices.size() );
+
+    // the sorted list of used vertices: the new index of a vertex is its
+    // position in the list
+    std::vector< int > usedVertices;
+    std::vector< int > denseNewIndices;
+    std::function< int( int ) > newIndex;
+
+    if( 3 * nFaces >= mesh.numVertices() / DENSE_CONSOLIDATE_RATIO )
+    {
+        // a large component: mark the used vertices in a table
+        denseNewIndices.assign( mesh.numVertices(), -1 );
+        for( int i = 0; i < nFaces; ++i )
+        {
+            Vector3i face = mesh.m_faces[ faceIndices[ i ] ];
+            denseNewIndices[ face.x ] = 0;
+            denseNewIndices[ face.y ] = 0;
+            denseNewIndices[ face.z ] = 0;
+        }
+        for( int v = 0; v < mesh.numVertices(); ++v )
+        {
+            if( denseNewIndices[ v ] == 0 )
+            {
+                denseNewIndices[ v ] = static_cast< int >( usedVertices.size() );
+                usedVertices.push_back( v );
+            }
+        }
+        newIndex = [&]( int v )
+        {
+            return denseNewIndices[ v ];
+        };
+    }
+    else
+    {
+        // a small component: sort its vertices instead of touching a table
+        // as large as the mesh
+        usedVertices.reserve( 3 * nFaces );
+        for( int i = 0; i < nFaces; ++i )
+        {
+            Vector3i face = mesh.m_faces[ faceIndices[ i ] ];
+            usedVertices.push_back( face.x );
+            usedVertices.push_back( face.y );
+            usedVertices.push_back( face.z );
+        }
+        std::sort( usedVertices.begin(), usedVertices.end() );
+        usedVertices.erase(
+            std::unique( usedVertices.begin(), usedVertices.end() ),
+            usedVertices.end() );
+
+        newIndex = [&]( int v )
+        {
+            return static_cast< int >( std::lower_bound( usedVertices.begin(),
+                usedVertices.end(), v ) - usedVertices.begin() );
+        };
+    }
+
+    int nUsedVertices = static_cast< int >( usedVertices.size() );
+    bool hasNormals = !( mesh.m_normals.empty() );
+
+    TriangleMesh output;
+    output.m_positions.resize( nUsedVertices );
+    if( hasNormals )
+    {
+        output.m_normals.resize( nUsedVertices );
+    }
+    for( int j = 0; j < nUsedVertices; ++j )
+    {
+        output.m_positions[ j ] = mesh.m_positions[ usedVertices[ j ] ];
+        if( hasNormals )
+        {
+            output.m_normals[ j ] = mesh.m_normals[ usedVertices[ j ] ];
+        }
+    }
+
+    output.m_faces.resize( nFaces );
+    for( int i = 0; i < nFaces; ++i )
+    {
+        Vector3i face = mesh.m_faces[ faceIndices[ i ] ];
+        output.m_faces[ i ] =
+            { newIndex( face.x ), newIndex( face.y ), newIndex( face.z ) };
+    }
+
+    return output;
+}
+
+}
 
 TriangleMesh::TriangleMesh( Array1DReadView< Vector3f > positions,
     Array1DReadView< Vector3i > faces ) :
@@ -213,10 +315,9 @@ int TriangleMesh::vertexOppositeEdge( const Vector2i& ij ) const
 float TriangleMesh::meanEdgeLength() const
 {
     float sum = 0;
-    for( auto itr = m_edgeLengths.begin(); itr != m_edgeLengths.end(); ++itr )
+    for( size_t i = 0; i < m_edgeLengths.size(); ++i )
     {
-        float len = itr->second;
-        sum += len;
+        sum += m_edgeLengths[ i ];
     }
     return sum / m_edgeLengths.size();
 }
@@ -323,75 +424,29 @@ Vector3f TriangleMesh::barycentricInterpolateNormal( int faceIndex,
 
 TriangleMesh TriangleMesh::consolidate( const std::vector< int >& connectedComponent )
 {
-    TriangleMesh output;
-
-    int nVertices = static_cast< int >( m_positions.size() );
-    std::vector< bool > touchedVertices( nVertices, false );
-
-    // walk over all faces in the component
-    // and mark all vertices that are used
-    int nFaces = static_cast< int >( connectedComponent.size() );
-    for( int i = 0; i < nFaces; ++i )
-    {
-        int f = connectedComponent[ i ];
-        Vector3i face = m_faces[f];
-
-        touchedVertices[ face.x ] = true;
-        touchedVertices[ face.y ] = true;
-        touchedVertices[ face.z ] = true;
-    }
-
-    // walk over all used vertices and assign them new indices [0, nUsedVertices)
-    // -1 is unused
-    std::vector< int > oldVertexToNewVertexMap( nVertices, -1 );
-    int nUsedVertices = 0;
-    for( int i = 0; i < nVertices; ++i )
-    {
-        if( touchedVertices[i] )
-        {
-            oldVertexToNewVertexMap[i] = nUsedVertices;
-            ++nUsedVertices;
-        }
-    }
+    return consolidateFaces( *this, connectedComponent );
+}
 
-    // now that we know how many used vertices there are
-    // resize output arrays
-    output.m_positions.resize( nUsedVertices );
-    output.m_normals.resize( nUsedVertices );
-    output.m_faces.resize( nFaces );
+std::vector< TriangleMesh > TriangleMesh::consolidate(
+    const std::vector< std::vector< int > >& connectedComponents ) const
+{
+    int nComponents = static_cast< int >( connectedComponents.size() );
+    std::vector< TriangleMesh > outputs( nComponents );
 
-    // walk over all used vertices and copy them onto the output
-    for( int i = 0; i < nVertices; ++i )
-    {
-        if( touchedVertices[i] )
+    // components can differ in size by orders of magnitude:
+    // let the pool balance them one at a time
+    ThreadPool::global().parallelFor( 0, nComponents, 1,
+        [&]( int begin, int end )
         {
-            Vector3f p = m_positions[i];
-            Vector3f n = m_normals[i];
-
-            int j = oldVertexToNewVertexMap[i];
-
-            output.m_positions[j] = p;
-            output.m_normals[j] = n;
+            for( int c = begin; c < end; ++c )
+            {
+                outputs[ c ] = consolidateFaces( *this,
+                    connectedComponents[ c ] );
+            }
         }
-    }
-
-    // walk over faces and assign them their new indices
-    for( int i = 0; i < nFaces; ++i )
-    {
-        int f = connectedComponent[i];
-        Vector3i face = m_faces[ f ];
-
-        Vector3i newFace
-        {
-            oldVertexToNewVertexMap[ face.x ],
-            oldVertexToNewVertexMap[ face.y ],
-            oldVertexToNewVertexMap[ face.z ]
-        };
-
-        output.m_faces.push_back( newFace );
-    }
+    );
 
-    return output;
+    return outputs;
 }
 
 int TriangleMesh::pruneInvalidFaces( std::map< Vector2i, int >& edgeToFace )
@@ -637,82 +692,80 @@ void TriangleMesh::invalidateAdjancency()
 
 void TriangleMesh::computeConnectedComponents()
 {
-    m_connectedComponents.clear();
+    // Faces are connected through their twin half edges, which doesn't need
+    // buildAdjacency().
+    m_connectedComponents = TriangleMeshTopology( *this ).connectedComponents();
+}
 
-    // build a bit vector of length nFaces
-    // set them all to true for now
+void TriangleMesh::computeAreas()
+{
     int nFaces = numFaces();
-    std::vector< bool > remainingFaces( nFaces, true );
+    m_areas.resize( nFaces );
 
-    // loop until out of faces
-    auto rootItr = std::find( remainingFaces.begin(), remainingFaces.end(), true );
-    while( rootItr != remainingFaces.end() )
-    {
-        int rootFaceIndex = static_cast< int >( rootItr - remainingFaces.begin() );
-        std::vector< int > connectedComponent;
-
-        // start with a root face and push it onto the stack
-        // while the stack is not empty
-        //    pop a face off the stack and add it to the component
-        //    mark it as taken
-        //    then add its adjacent faces onto the stack
-        std::stack< int > adjStack;
-        adjStack.push( rootFaceIndex );
-        remainingFaces[ rootFaceIndex ] = false;
-        while( !( adjStack.empty() ) )
+    ThreadPool::global().parallelFor( 0, nFaces, 0,
+        [&]( int begin, int end )
         {
-            int currentFaceIndex = adjStack.top();
-            adjStack.pop();
+            for( int f = begin; f < end; ++f )
+            {
+                Vector3i face = m_faces[ f ];
+                Vector3f p0 = m_positions[ face.x ];
+                Vector3f p1 = m_positions[ face.y ];
+                Vector3f p2 = m_positions[ face.z ];
 
-            connectedComponent.push_back( currentFaceIndex );
+                Vector3f e0 = p1 - p0;
+                Vector3f e1 = p2 - p0;
 
-            for( int i = 0; i < m_faceToFace[ currentFaceIndex ].size(); ++i )
-            {
-                int adjacentFaceIndex = m_faceToFace[ currentFaceIndex ][ i ];
-                if( remainingFaces[ adjacentFaceIndex ] )
-                {
-                    adjStack.push( adjacentFaceIndex );
-                    remainingFaces[ adjacentFaceIndex ] = false;
-                }
+                float area = 0.5f * Vector3f::cross( e0, e1 ).norm();
+                m_areas[ f ] = area;
             }
         }
-
-        m_connectedComponents.push_back( connectedComponent );
-        rootItr = std::find( remainingFaces.begin(), remainingFaces.end(), true );
-    }
+    );
 }
 
-void TriangleMesh::computeAreas()
+void TriangleMesh::computeFaceNormals()
 {
     int nFaces = numFaces();
-    m_areas.resize( nFaces );
+    m_faceNormals.resize( nFaces );
 
-    for( int f = 0; f < nFaces; ++f )
-    {
-        Vector3i face = m_faces[ f ];
-        Vector3f p0 = m_positions[ face.x ];
-        Vector3f p1 = m_positions[ face.y ];
-        Vector3f p2 = m_positions[ face.z ];
-
-        Vector3f e0 = p1 - p0;
-        Vector3f e1 = p2 - p0;
-
-        float area = 0.5f * Vector3f::cross( e0, e1 ).norm();
-        m_areas[ f ] = area;
-    }
+    ThreadPool::global().parallelFor( 0, nFaces, 0,
+        [&]( int begin, int end )
+        {
+            for( int f = begin; f < end; ++f )
+            {
+                Vector3i face = m_faces[ f ];
+                Vector3f p0 = m_positions[ face.x ];
+                Vector3f p1 = m_positions[ face.y ];
+                Vector3f p2 = m_positions[ face.z ];
+
+                Vector3f n = Vector3f::cross( p1 - p0, p2 - p0 );
+                float norm = n.norm();
+                m_faceNormals[ f ] = ( norm > 0 ) ? n / norm : Vector3f( 0 );
+            }
+        }
+    );
 }
 
 void TriangleMesh::computeEdgeLengths()
 {
-    for( auto itr = m_edgeToFace.begin(); itr != m_edgeToFace.end(); ++itr )
-    {
-        Vector2i vertexIndices = itr->first;
-
-        Vector3f p0 = m_positions[ vertexIndices.x ];
-        Vector3f p1 = m_positions[ vertexIndices.y ];
+    int nFaces = numFaces();
+    m_edgeLengths.resize( 3 * nFaces );
 
-        m_edgeLengths[ vertexIndices ] = ( p1 - p0 ).norm();
-    }
+    ThreadPool::global().parallelFor( 0, nFaces, 0,
+        [&]( int begin, int end )
+        {
+            for( int f = begin; f < end; ++f )
+            {
+                Vector3i face = m_faces[ f ];
+                Vector3f p0 = m_positions[ face.x ];
+                Vector3f p1 = m_positions[ face.y ];
+                Vector3f p2 = m_positions[ face.z ];
+
+                m_edgeLengths[ 3 * f ] = ( p1 - p0 ).norm();
+                m_edgeLengths[ 3 * f + 1 ] = ( p2 - p1 ).norm();
+                m_edgeLengths[ 3 * f + 2 ] = ( p0 - p2 ).norm();
+            }
+        }
+    );
 }
 
 bool TriangleMesh::isBoundaryEdge( const Vector2i& edge )
@@ -74,6 +74,8 @@ public:
 
     bool obtuse( int faceIndex ) const;
 
+    // Tests the ray against every face: for repeated queries, build a
+    // TriangleMeshBVH.
     bool intersectRay( const Vector3f& origin, const Vector3f& direction,
         float& t, Vector3f& barycentrics, int& faceIndex,
         float tMin = 0 ) const;
@@ -89,6 +91,12 @@ public:
     // and faces index vertices from [0,nVertices)
     TriangleMesh consolidate( const std::vector< int >& connectedComponent );
 
+    // Consolidates every component at once, in parallel: the same as calling
+    // consolidate() on each element of connectedComponents (for example,
+    // m_connectedComponents).
+    std::vector< TriangleMesh > consolidate(
+        const std::vector< std::vector< int > >& connectedComponents ) const;
+
     // checks that each edge is shared by at most 2 triangles (1 in each direction)
     // if an edge (v0,v1) is touched more than once, the second face is discarded
     //   (TODO: split the edge?)
@@ -98,14 +106,31 @@ public:
     // replaces m_faces with a set of valid faces
     int pruneInvalidFaces( std::map< Vector2i, int >& edgeToFace );
 
+    // Builds the map-based adjacency below. For large meshes, prefer
+    // TriangleMeshTopology, which is flat and builds in linear time.
     void buildAdjacency();
     void invalidateAdjancency();
 
-
+    // Fills m_connectedComponents using a TriangleMeshTopology. Does not need
+    // buildAdjacency().
+    //
+    // Two faces are connected if they share an edge, whether or not it is
+    // manifold or consistently oriented, as with the old m_faceToFace-based
+    // version. The faces in each component are in ascending order (not
+    // depth-first order), and components are in order of their smallest
+    // face.
     void computeConnectedComponents();
 
+    // The per-face kernels below run in parallel on ThreadPool::global() and
+    // don't need buildAdjacency().
+
+    // Fills m_areas.
     void computeAreas();
 
+    // Fills m_faceNormals.
+    void computeFaceNormals();
+
+    // Fills m_edgeLengths.
     void computeEdgeLengths();
 
     // e = (v0,v1) is a boundary edge if it there is no twin edge (v1,v0)
@@ -125,7 +150,14 @@ public:
 
     std::vector< float > m_areas;
 
-    std::map< Vector2i, float > m_edgeLengths;
+    // unit normal of each face (0 if the face is degenerate)
+    std::vector< Vector3f > m_faceNormals;
+
+    // length of each half edge:
+    // m_edgeLengths[ 3 * f + k ] is the length of edge k of face f,
+    // from m_faces[ f ][ k ] to m_faces[ f ][ ( k + 1 ) % 3 ]
+    // (see TriangleMeshTopology)
+    std::vector< float > m_edgeLengths;
 
     bool saveOBJ( const std::string& filename );
 
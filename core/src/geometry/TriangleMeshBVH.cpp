@@ -0,0 +1,509 @@
+#include "geometry/TriangleMeshBVH.h"
+
+#include <algorithm>
+
+#include "concurrency/ThreadPool.h"
+#include "geometry/GeometryUtils.h"
+#include "geometry/TriangleMesh.h"
+#include "vecmath/Vector3i.h"
+
+namespace
+{
+
+// Number of buckets along the split axis when evaluating the SAH.
+const int NUM_SAH_BINS = 16;
+
+// Relative cost of visiting a node vs intersecting a triangle.
+const float TRAVERSAL_COST = 1.0f;
+const float INTERSECTION_COST = 1.0f;
+
+// Past this depth, nodes are split at the median, so that the traversal
+// stack can never overflow.
+const int MAX_SAH_DEPTH = 64;
+const int TRAVERSAL_STACK_SIZE = 128;
+
+Vector3f minimum( const Vector3f& a, const Vector3f& b )
+{
+    return{ std::min( a.x, b.x ), std::min( a.y, b.y ),
+        std::min( a.z, b.z ) };
+}
+
+Vector3f maximum( const Vector3f& a, const Vector3f& b )
+{
+    return{ std::max( a.x, b.x ), std::max( a.y, b.y ),
+        std::max( a.z, b.z ) };
+}
+
+const Vector3f EMPTY_MIN( std::numeric_limits< float >::infinity() );
+const Vector3f EMPTY_MAX( -std::numeric_limits< float >::infinity() );
+
+float halfSurfaceArea( const Vector3f& boundsMin, const Vector3f& boundsMax )
+{
+    Vector3f d = boundsMax - boundsMin;
+    if( d.x < 0 || d.y < 0 || d.z < 0 )
+    {
+        return 0;
+    }
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+// Slab test against [ boundsMin, boundsMax ] for t in [ tNear, tFar ].
+// Comparisons are written so that NaNs (0 * inf, when the origin is on a
+// slab and the direction is parallel to it) leave the interval unchanged.
+bool intersectBounds( const Vector3f& boundsMin, const Vector3f& boundsMax,
+    const Vector3f& origin, const Vector3f& inverseDirection,
+    float tNear, float tFar )
+{
+    for( int i = 0; i < 3; ++i )
+    {
+        float t0 = ( boundsMin[ i ] - origin[ i ] ) * inverseDirection[ i ];
+        float t1 = ( boundsMax[ i ] - origin[ i ] ) * inverseDirection[ i ];
+        if( t0 > t1 )
+        {
+            std::swap( t0, t1 );
+        }
+
+        // Pad the far distance to be conservative under rounding.
+        t1 *= 1.0f + 4 * std::numeric_limits< float >::epsilon();
+
+        tNear = t0 > tNear ? t0 : tNear;
+        tFar = t1 < tFar ? t1 : tFar;
+        if( tNear > tFar )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+struct TriangleMeshBVH::BuildTriangle
+{
+    Vector3f boundsMin;
+    Vector3f boundsMax;
+    Vector3f centroid;
+    int faceIndex;
+};
+
+TriangleMeshBVH::TriangleMeshBVH( const TriangleMesh& mesh,
+    int maxTrianglesPerLeaf ) :
+    m_mesh( &mesh ),
+    m_maxTrianglesPerLeaf(
+        std::max( 1, std::min( maxTrianglesPerLeaf, 0xffff ) ) )
+{
+    const std::vector< Vector3f >& positions = mesh.positions();
+    const std::vector< Vector3i >& faces = mesh.faces();
+
+    int nFaces = mesh.numFaces();
+    if( nFaces == 0 )
+    {
+        return;
+    }
+
+    std::vector< BuildTriangle > triangles( nFaces );
+    for( int f = 0; f < nFaces; ++f )
+    {
+        const Vector3f& v0 = positions[ faces[ f ][ 0 ] ];
+        const Vector3f& v1 = positions[ faces[ f ][ 1 ] ];
+        const Vector3f& v2 = positions[ faces[ f ][ 2 ] ];
+
+        BuildTriangle& tri = triangles[ f ];
+        tri.boundsMin = minimum( minimum( v0, v1 ), v2 );
+        tri.boundsMax = maximum( maximum( v0, v1 ), v2 );
+        tri.centroid = 0.5f * ( tri.boundsMin + tri.boundsMax );
+        tri.faceIndex = f;
+    }
+
+    // A binary tree with n leaves has 2n - 1 nodes.
+    m_nodes.reserve( 2 * ( nFaces / m_maxTrianglesPerLeaf + 1 ) );
+    m_faceIndices.reserve( nFaces );
+    build( triangles, 0, nFaces, 0 );
+}
+
+int TriangleMeshBVH::numNodes() const
+{
+    return static_cast< int >( m_nodes.size() );
+}
+
+Box3f TriangleMeshBVH::boundingBox() const
+{
+    if( m_nodes.empty() )
+    {
+        return Box3f();
+    }
+    const Node& root = m_nodes[ 0 ];
+    return Box3f( root.boundsMin, root.boundsMax - root.boundsMin );
+}
+
+void TriangleMeshBVH::refit()
+{
+    if( m_mesh == nullptr )
+    {
+        return;
+    }
+
+    const std::vector< Vector3f >& positions = m_mesh->positions();
+    const std::vector< Vector3i >& faces = m_mesh->faces();
+
+    // Children always come after their parent.
+    for( int i = static_cast< int >( m_nodes.size() ) - 1; i >= 0; --i )
+    {
+        Node& node = m_nodes[ i ];
+        if( node.nTriangles > 0 )
+        {
+            node.boundsMin = EMPTY_MIN;
+            node.boundsMax = EMPTY_MAX;
+            for( int k = 0; k < node.nTriangles; ++k )
+            {
+                const Vector3i& face =
+                    faces[ m_faceIndices[ node.offset + k ] ];
+                for( int j = 0; j < 3; ++j )
+                {
+                    node.boundsMin = minimum( node.boundsMin,
+                        positions[ face[ j ] ] );
+                    node.boundsMax = maximum( node.boundsMax,
+                        positions[ face[ j ] ] );
+                }
+            }
+        }
+        else
+        {
+            const Node& first = m_nodes[ i + 1 ];
+            const Node& second = m_nodes[ node.offset ];
+            node.boundsMin = minimum( first.boundsMin, second.boundsMin );
+            node.boundsMax = maximum( first.boundsMax, second.boundsMax );
+        }
+    }
+}
+
+bool TriangleMeshBVH::intersectRay( const Vector3f& origin,
+    const Vector3f& direction, float& t, Vector3f& barycentrics,
+    int& faceIndex, float tMin ) const
+{
+    bool hit = false;
+    t = std::numeric_limits< float >::infinity();
+    if( m_nodes.empty() )
+    {
+        return false;
+    }
+
+    const std::vector< Vector3f >& positions = m_mesh->positions();
+    const std::vector< Vector3i >& faces = m_mesh->faces();
+
+    Vector3f inverseDirection( 1.0f / direction.x, 1.0f / direction.y,
+        1.0f / direction.z );
+    bool directionIsNegative[ 3 ] =
+        { direction.x < 0, direction.y < 0, direction.z < 0 };
+
+    int stack[ TRAVERSAL_STACK_SIZE ];
+    int stackSize = 0;
+    stack[ stackSize++ ] = 0;
+
+    while( stackSize > 0 )
+    {
+        int index = stack[ --stackSize ];
+        const Node& node = m_nodes[ index ];
+        if( !intersectBounds( node.boundsMin, node.boundsMax,
+            origin, inverseDirection, tMin, t ) )
+        {
+            continue;
+        }
+
+        if( node.nTriangles > 0 )
+        {
+            for( int k = 0; k < node.nTriangles; ++k )
+            {
+                int f = m_faceIndices[ node.offset + k ];
+                const Vector3i& face = faces[ f ];
+
+                float faceT;
+                Vector3f lambda;
+                bool faceHit = GeometryUtils::rayTriangleIntersection(
+                    origin, direction,
+                    positions[ face[ 0 ] ], positions[ face[ 1 ] ],
+                    positions[ face[ 2 ] ],
+                    faceT, lambda );
+                if( faceHit && faceT > tMin && faceT < t )
+                {
+                    hit = true;
+                    t = faceT;
+                    barycentrics = lambda;
+                    faceIndex = f;
+                }
+            }
+        }
+        else
+        {
+            // Visit the child nearer to the origin first: push it last.
+            if( directionIsNegative[ node.axis ] )
+            {
+                stack[ stackSize++ ] = index + 1;
+                stack[ stackSize++ ] = node.offset;
+            }
+            else
+            {
+                stack[ stackSize++ ] = node.offset;
+                stack[ stackSize++ ] = index + 1;
+            }
+        }
+    }
+
+    return hit;
+}
+
+bool TriangleMeshBVH::intersectsRay( const Vector3f& origin,
+    const Vector3f& direction, float tMin, float tMax ) const
+{
+    if( m_nodes.empty() )
+    {
+        return false;
+    }
+
+    const std::vector< Vector3f >& positions = m_mesh->positions();
+    const std::vector< Vector3i >& faces = m_mesh->faces();
+
+    Vector3f inverseDirection( 1.0f / direction.x, 1.0f / direction.y,
+        1.0f / direction.z );
+
+    int stack[ TRAVERSAL_STACK_SIZE ];
+    int stackSize = 0;
+    stack[ stackSize++ ] = 0;
+
+    while( stackSize > 0 )
+    {
+        int index = stack[ --stackSize ];
+        const Node& node = m_nodes[ index ];
+        if( !intersectBounds( node.boundsMin, node.boundsMax,
+            origin, inverseDirection, tMin, tMax ) )
+        {
+            continue;
+        }
+
+        if( node.nTriangles > 0 )
+        {
+            for( int k = 0; k < node.nTriangles; ++k )
+            {
+                const Vector3i& face =
+                    faces[ m_faceIndices[ node.offset + k ] ];
+
+                float faceT;
+                Vector3f lambda;
+                bool faceHit = GeometryUtils::rayTriangleIntersection(
+                    origin, direction,
+                    positions[ face[ 0 ] ], positions[ face[ 1 ] ],
+                    positions[ face[ 2 ] ],
+                    faceT, lambda );
+                if( faceHit && faceT > tMin && faceT < tMax )
+                {
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            stack[ stackSize++ ] = node.offset;
+            stack[ stackSize++ ] = index + 1;
+        }
+    }
+
+    return false;
+}
+
+bool TriangleMeshBVH::intersectRays( Array1DReadView< Vector3f > origins,
+    Array1DReadView< Vector3f > directions,
+    Array1DWriteView< Hit > hits, float tMin ) const
+{
+    if( origins.size() != directions.size() ||
+        origins.size() != hits.size() )
+    {
+        return false;
+    }
+
+    libcgt::core::concurrency::ThreadPool::global().parallelFor(
+        0, static_cast< int >( origins.size() ), 0,
+        [&]( int begin, int end )
+        {
+            for( int i = begin; i < end; ++i )
+            {
+                Hit& hit = hits[ i ];
+                if( !intersectRay( origins[ i ], directions[ i ],
+                    hit.t, hit.barycentrics, hit.faceIndex, tMin ) )
+                {
+                    hit.faceIndex = -1;
+                }
+            }
+        }
+    );
+
+    return true;
+}
+
+int TriangleMeshBVH::build( std::vector< BuildTriangle >& triangles,
+    int begin, int end, int depth )
+{
+    int nodeIndex = static_cast< int >( m_nodes.size() );
+    m_nodes.push_back( Node() );
+
+    Vector3f boundsMin = EMPTY_MIN;
+    Vector3f boundsMax = EMPTY_MAX;
+    Vector3f centroidMin = EMPTY_MIN;
+    Vector3f centroidMax = EMPTY_MAX;
+    for( int i = begin; i < end; ++i )
+    {
+        boundsMin = minimum( boundsMin, triangles[ i ].boundsMin );
+        boundsMax = maximum( boundsMax, triangles[ i ].boundsMax );
+        centroidMin = minimum( centroidMin, triangles[ i ].centroid );
+        centroidMax = maximum( centroidMax, triangles[ i ].centroid );
+    }
+    m_nodes[ nodeIndex ].boundsMin = boundsMin;
+    m_nodes[ nodeIndex ].boundsMax = boundsMax;
+
+    int n = end - begin;
+    if( n == 1 )
+    {
+        makeLeaf( nodeIndex, triangles, begin, end );
+        return nodeIndex;
+    }
+
+    // Split along the axis where the centroids are most spread out.
+    Vector3f extent = centroidMax - centroidMin;
+    int axis = 0;
+    if( extent.y > extent[ axis ] )
+    {
+        axis = 1;
+    }
+    if( extent.z > extent[ axis ] )
+    {
+        axis = 2;
+    }
+
+    int mid = begin;
+    if( extent[ axis ] > 0 && depth < MAX_SAH_DEPTH )
+    {
+        // Bin the centroids and evaluate the SAH at each bin boundary.
+        int binCounts[ NUM_SAH_BINS ] = {};
+        Vector3f binMin[ NUM_SAH_BINS ];
+        Vector3f binMax[ NUM_SAH_BINS ];
+        std::fill( binMin, binMin + NUM_SAH_BINS, EMPTY_MIN );
+        std::fill( binMax, binMax + NUM_SAH_BINS, EMPTY_MAX );
+
+        float binScale = NUM_SAH_BINS / extent[ axis ];
+        auto binIndex = [&]( const BuildTriangle& tri )
+        {
+            int b = static_cast< int >(
+                ( tri.centroid[ axis ] - centroidMin[ axis ] ) * binScale );
+            return std::min( b, NUM_SAH_BINS - 1 );
+        };
+
+        for( int i = begin; i < end; ++i )
+        {
+            int b = binIndex( triangles[ i ] );
+            ++binCounts[ b ];
+            binMin[ b ] = minimum( binMin[ b ], triangles[ i ].boundsMin );
+            binMax[ b ] = maximum( binMax[ b ], triangles[ i ].boundsMax );
+        }
+
+        // Sweep from the right to get the area and count right of each
+        // boundary, then from the left to evaluate the cost.
+        float rightArea[ NUM_SAH_BINS ];
+        int rightCount[ NUM_SAH_BINS ];
+        Vector3f sweepMin = EMPTY_MIN;
+        Vector3f sweepMax = EMPTY_MAX;
+        int count = 0;
+        for( int b = NUM_SAH_BINS - 1; b > 0; --b )
+        {
+            sweepMin = minimum( sweepMin, binMin[ b ] );
+            sweepMax = maximum( sweepMax, binMax[ b ] );
+            count += binCounts[ b ];
+            rightArea[ b ] = halfSurfaceArea( sweepMin, sweepMax );
+            rightCount[ b ] = count;
+        }
+
+        int bestSplit = -1;
+        float bestCost = std::numeric_limits< float >::infinity();
+        sweepMin = EMPTY_MIN;
+        sweepMax = EMPTY_MAX;
+        count = 0;
+        for( int b = 1; b < NUM_SAH_BINS; ++b )
+        {
+            sweepMin = minimum( sweepMin, binMin[ b - 1 ] );
+            sweepMax = maximum( sweepMax, binMax[ b - 1 ] );
+            count += binCounts[ b - 1 ];
+            if( count == 0 || rightCount[ b ] == 0 )
+            {
+                continue;
+            }
+            float cost = count * halfSurfaceArea( sweepMin, sweepMax ) +
+                rightCount[ b ] * rightArea[ b ];
+            if( cost < bestCost )
+            {
+                bestCost = cost;
+                bestSplit = b;
+            }
+        }
+
+        float parentArea = halfSurfaceArea( boundsMin, boundsMax );
+        float splitCost = TRAVERSAL_COST + ( parentArea > 0 ?
+            INTERSECTION_COST * bestCost / parentArea : 0 );
+        float leafCost = INTERSECTION_COST * n;
+        if( n <= m_maxTrianglesPerLeaf &&
+            ( bestSplit < 0 || leafCost <= splitCost ) )
+        {
+            makeLeaf( nodeIndex, triangles, begin, end );
+            return nodeIndex;
+        }
+
+        if( bestSplit > 0 )
+        {
+            mid = static_cast< int >( std::partition(
+                triangles.begin() + begin, triangles.begin() + end,
+                [&]( const BuildTriangle& tri )
+                {
+                    return binIndex( tri ) < bestSplit;
+                }
+            ) - triangles.begin() );
+        }
+    }
+    else if( n <= m_maxTrianglesPerLeaf )
+    {
+        makeLeaf( nodeIndex, triangles, begin, end );
+        return nodeIndex;
+    }
+
+    // Fall back to a median split if the SAH did not separate anything.
+    if( mid == begin || mid == end )
+    {
+        mid = begin + n / 2;
+        std::nth_element(
+            triangles.begin() + begin, triangles.begin() + mid,
+            triangles.begin() + end,
+            [&]( const BuildTriangle& a, const BuildTriangle& b )
+            {
+                return a.centroid[ axis ] < b.centroid[ axis ];
+            }
+        );
+    }
+
+    // The first child is built immediately after this node.
+    build( triangles, begin, mid, depth + 1 );
+    int second = build( triangles, mid, end, depth + 1 );
+
+    m_nodes[ nodeIndex ].offset = second;
+    m_nodes[ nodeIndex ].nTriangles = 0;
+    m_nodes[ nodeIndex ].axis = static_cast< uint16_t >( axis );
+    return nodeIndex;
+}
+
+void TriangleMeshBVH::makeLeaf( int nodeIndex,
+    const std::vector< BuildTriangle >& triangles, int begin, int end )
+{
+    Node& node = m_nodes[ nodeIndex ];
+    node.offset = static_cast< int32_t >( m_faceIndices.size() );
+    node.nTriangles = static_cast< uint16_t >( end - begin );
+    node.axis = 0;
+    for( int i = begin; i < end; ++i )
+    {
+        m_faceIndices.push_back( triangles[ i ].faceIndex );
+    }
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "common/ArrayView.h"
+#include "vecmath/Box3f.h"
+#include "vecmath/Vector3f.h"
+
+class TriangleMesh;
+
+// A bounding volume hierarchy over the faces of a TriangleMesh, for ray
+// queries in O(log F) instead of TriangleMesh::intersectRay()'s O(F).
+//
+// The tree is built top down, splitting each node where the surface area
+// heuristic (SAH) estimates the cheapest traversal, and stored as a flat
+// array of 32-byte nodes in depth-first order: the first child of a node
+// immediately follows it.
+//
+// The BVH refers to the mesh, which must outlive it. If the mesh's positions
+// change but its faces don't, call refit(). If its faces change, rebuild it.
+//
+// Hits follow TriangleMesh::intersectRay(): only front faces are hit, at a
+// distance t > tMin.
+class TriangleMeshBVH
+{
+public:
+
+    struct Hit
+    {
+        // Parametric distance along the ray.
+        float t;
+
+        Vector3f barycentrics;
+
+        // -1 if the ray missed.
+        int faceIndex;
+    };
+
+    // The null BVH: every query misses.
+    TriangleMeshBVH() = default;
+
+    // Build a BVH over all faces of "mesh", with at most
+    // "maxTrianglesPerLeaf" faces in each leaf.
+    TriangleMeshBVH( const TriangleMesh& mesh, int maxTrianglesPerLeaf = 4 );
+
+    int numNodes() const;
+
+    // The bounding box of the entire mesh.
+    Box3f boundingBox() const;
+
+    // Recompute the bounding boxes of every node from the current vertex
+    // positions of the mesh, keeping the tree structure. This is much
+    // faster than a rebuild, but the tree gets less efficient as the mesh
+    // moves away from the positions it was built with.
+    void refit();
+
+    // Find the closest hit along the ray, same as
+    // TriangleMesh::intersectRay().
+    bool intersectRay( const Vector3f& origin, const Vector3f& direction,
+        float& t, Vector3f& barycentrics, int& faceIndex,
+        float tMin = 0 ) const;
+
+    // Returns true if the ray hits any face at a distance in (tMin, tMax).
+    // Stops at the first hit it finds, which makes it cheaper than
+    // intersectRay() for shadow and visibility rays.
+    bool intersectsRay( const Vector3f& origin, const Vector3f& direction,
+        float tMin = 0,
+        float tMax = std::numeric_limits< float >::infinity() ) const;
+
+    // Closest-hit queries for a batch of rays, in parallel on
+    // ThreadPool::global(). origins, directions, and hits must have the same
+    // size. Returns false if they don't.
+    bool intersectRays( Array1DReadView< Vector3f > origins,
+        Array1DReadView< Vector3f > directions,
+        Array1DWriteView< Hit > hits, float tMin = 0 ) const;
+
+private:
+
+    struct Node
+    {
+        Vector3f boundsMin;
+
+        // Leaf: index of the first face in m_faceIndices.
+        // Interior: index of the second child.
+        int32_t offset;
+
+        Vector3f boundsMax;
+
+        // 0 for interior nodes.
+        uint16_t nTriangles;
+
+        // Interior: the axis along which the children were split.
+        uint16_t axis;
+    };
+
+    struct BuildTriangle;
+
+    // Builds the subtree over triangles[ begin, end ), appending it to
+    // m_nodes. Returns the index of its root.
+    int build( std::vector< BuildTriangle >& triangles, int begin, int end,
+        int depth );
+
+    void makeLeaf( int nodeIndex,
+        const std::vector< BuildTriangle >& triangles,
+        int begin, int end );
+
+    const TriangleMesh* m_mesh = nullptr;
+    int m_maxTrianglesPerLeaf = 4;
+
+    std::vector< Node > m_nodes;
+
+    // Leaves index into this array of mesh face indices.
+    std::vector< int > m_faceIndices;
+};
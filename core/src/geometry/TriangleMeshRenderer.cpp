@@ -0,0 +1,542 @@
+#include "geometry/TriangleMeshRenderer.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "cameras/Camera.h"
+#include "common/ArrayUtils.h"
+#include "concurrency/ThreadPool.h"
+#include "geometry/TriangleMesh.h"
+
+using libcgt::core::arrayutils::fill;
+using libcgt::core::arrayutils::readViewOf;
+using libcgt::core::concurrency::ThreadPool;
+
+namespace execution = libcgt::core::arrayutils::execution;
+
+namespace
+{
+
+// Planes of the clipping volume, in the order of the bits of the vertex
+// codes.
+const int NUM_CLIP_PLANES = 6;
+const int NEAR_PLANE = 4;
+const int FAR_PLANE = 5;
+
+// The signed distance from clip to plane i of the volume
+// |x| <= guardBand.x * w, |y| <= guardBand.y * w, between near and far.
+// Inside is positive.
+float clipDistance( int i, const Vector4f& clip, const Vector2f& guardBand,
+    bool directX )
+{
+    switch( i )
+    {
+    case 0:
+        return guardBand.x * clip.w + clip.x;
+    case 1:
+        return guardBand.x * clip.w - clip.x;
+    case 2:
+        return guardBand.y * clip.w + clip.y;
+    case 3:
+        return guardBand.y * clip.w - clip.y;
+    case NEAR_PLANE:
+        // In Direct3D, ndc.z is in [0, 1], in OpenGL, [-1, 1].
+        return directX ? clip.z : clip.z + clip.w;
+    case FAR_PLANE:
+    default:
+        return clip.w - clip.z;
+    }
+}
+
+uint8_t clipCodes( const Vector4f& clip, const Vector2f& guardBand,
+    bool directX )
+{
+    uint8_t codes = 0;
+    for( int i = 0; i < NUM_CLIP_PLANES; ++i )
+    {
+        if( clipDistance( i, clip, guardBand, directX ) < 0 )
+        {
+            codes |= static_cast< uint8_t >( 1 << i );
+        }
+    }
+    return codes;
+}
+
+// Twice the signed area of the triangle ( s0, s1, s2 ).
+float signedArea( const Vector2f& s0, const Vector2f& s1, const Vector2f& s2 )
+{
+    return ( s1.x - s0.x ) * ( s2.y - s0.y ) -
+        ( s1.y - s0.y ) * ( s2.x - s0.x );
+}
+
+}
+
+namespace libcgt { namespace core { namespace geometry {
+
+TriangleMeshRenderer::TriangleMeshRenderer( const Vector2i& viewportSize,
+    CullMode cullMode ) :
+    m_cullMode( cullMode ),
+    m_rasterizer( viewportSize )
+{
+    setViewportSize( viewportSize );
+}
+
+Vector2i TriangleMeshRenderer::viewportSize() const
+{
+    return m_viewportSize;
+}
+
+void TriangleMeshRenderer::setViewportSize( const Vector2i& viewportSize )
+{
+    m_viewportSize = viewportSize;
+    m_rasterizer.setViewportSize( viewportSize );
+
+    // Keep screen coordinates within half of MAX_RASTER_COORDINATE:
+    // x_screen = 0.5 * width * ( x_ndc + 1 ).
+    m_guardBand = Vector2f
+    (
+        std::max( MAX_RASTER_COORDINATE / std::max( viewportSize.x, 1 ) -
+            1.0f, 1.0f ),
+        std::max( MAX_RASTER_COORDINATE / std::max( viewportSize.y, 1 ) -
+            1.0f, 1.0f )
+    );
+}
+
+CullMode TriangleMeshRenderer::cullMode() const
+{
+    return m_cullMode;
+}
+
+void TriangleMeshRenderer::setCullMode( CullMode cullMode )
+{
+    m_cullMode = cullMode;
+}
+
+bool TriangleMeshRenderer::render( const TriangleMesh& mesh,
+    const Camera& camera, Array2DWriteView< float > depth,
+    Array2DWriteView< int > faceIndex,
+    Array2DWriteView< Vector3f > barycentrics )
+{
+    return render( readViewOf( mesh.positions() ), readViewOf( mesh.faces() ),
+        camera, depth, faceIndex, barycentrics );
+}
+
+bool TriangleMeshRenderer::render( Array1DReadView< Vector3f > positions,
+    Array1DReadView< Vector3i > faces, const Camera& camera,
+    Array2DWriteView< float > depth,
+    Array2DWriteView< int > faceIndex,
+    Array2DWriteView< Vector3f > barycentrics )
+{
+    if( ( depth.notNull() && depth.size() != m_viewportSize ) ||
+        ( faceIndex.notNull() && faceIndex.size() != m_viewportSize ) ||
+        ( barycentrics.notNull() && barycentrics.size() != m_viewportSize ) )
+    {
+        return false;
+    }
+
+    if( depth.isNull() )
+    {
+        m_depth.resize( m_viewportSize );
+        depth = m_depth.writeView();
+    }
+
+    fill( execution::par, depth, std::numeric_limits< float >::infinity() );
+    if( faceIndex.notNull() )
+    {
+        fill( execution::par, faceIndex, -1 );
+    }
+    if( barycentrics.notNull() )
+    {
+        fill( execution::par, barycentrics, Vector3f( 0.0f ) );
+    }
+
+    transformVertices( positions, camera );
+    setupFaces( faces );
+
+    bool writeFaceIndex = faceIndex.notNull();
+    bool writeBarycentrics = barycentrics.notNull();
+    m_rasterizer.rasterize( readViewOf( m_screenPositions ),
+        readViewOf( m_triangles ),
+        [&]( int t, int y, int xBegin, int xEnd )
+        {
+            const TriangleSetup& setup = m_setups[ t ];
+
+            // Planes evaluated at the start of this row.
+            float dy = y + 0.5f - setup.origin.y;
+            auto atRow = [&]( const Plane& plane )
+            {
+                return plane.value + dy * plane.dy;
+            };
+            float invW0 = atRow( setup.invW );
+            float eyeDepthOverW0 = atRow( setup.eyeDepthOverW );
+
+            for( int x = xBegin; x < xEnd; ++x )
+            {
+                float dx = x + 0.5f - setup.origin.x;
+                float invW = invW0 + dx * setup.invW.dx;
+                float z = ( eyeDepthOverW0 + dx * setup.eyeDepthOverW.dx ) /
+                    invW;
+
+                float& zBuffer = depth[ { x, y } ];
+                if( z < zBuffer )
+                {
+                    zBuffer = z;
+                    if( writeFaceIndex )
+                    {
+                        faceIndex[ { x, y } ] = setup.face;
+                    }
+                    if( writeBarycentrics )
+                    {
+                        float b0 = ( atRow( setup.barycentric0OverW ) +
+                            dx * setup.barycentric0OverW.dx ) / invW;
+                        float b1 = ( atRow( setup.barycentric1OverW ) +
+                            dx * setup.barycentric1OverW.dx ) / invW;
+                        barycentrics[ { x, y } ] =
+                            Vector3f( b0, b1, 1.0f - b0 - b1 );
+                    }
+                }
+            }
+        }
+    );
+
+    return true;
+}
+
+void TriangleMeshRenderer::transformVertices(
+    Array1DReadView< Vector3f > positions, const Camera& camera )
+{
+    int nVertices = static_cast< int >( positions.size() );
+    m_clipPositions.resize( nVertices );
+    m_eyeDepths.resize( nVertices );
+    m_outCodes.resize( nVertices );
+    m_clipCodes.resize( nVertices );
+    m_screenPositions.resize( nVertices );
+
+    m_directX = camera.isDirectX();
+    Matrix4f clipFromWorld = camera.viewProjectionMatrix();
+    // Depth is -z in eye space.
+    Vector4f eyeDepthFromWorld = -camera.viewMatrix().getRow( 2 );
+
+    ThreadPool::global().parallelFor( 0, nVertices, 0,
+        [&]( int begin, int end )
+        {
+            for( int v = begin; v < end; ++v )
+            {
+                Vector4f world( positions[ v ], 1.0f );
+                Vector4f clip = clipFromWorld * world;
+
+                m_clipPositions[ v ] = clip;
+                m_eyeDepths[ v ] = Vector4f::dot( eyeDepthFromWorld, world );
+                m_outCodes[ v ] = clipCodes( clip, Vector2f( 1.0f ),
+                    m_directX );
+                m_clipCodes[ v ] = clipCodes( clip, m_guardBand, m_directX );
+
+                // Only used if the vertex is inside the clipping volume.
+                if( m_clipCodes[ v ] == 0 )
+                {
+                    m_screenPositions[ v ] = screenFromClip( clip );
+                }
+            }
+        }
+    );
+}
+
+void TriangleMeshRenderer::setupFaces( Array1DReadView< Vector3i > faces )
+{
+    int nFaces = static_cast< int >( faces.size() );
+    int nVertices = static_cast< int >( m_clipPositions.size() );
+    int nChunks = std::min( nFaces,
+        8 * ThreadPool::global().numThreads() );
+    auto chunkRange = [&]( int c, int& begin, int& end )
+    {
+        begin = static_cast< int >( int64_t( nFaces ) * c / nChunks );
+        end = static_cast< int >( int64_t( nFaces ) * ( c + 1 ) / nChunks );
+    };
+
+    // Count the triangles and new vertices made by each chunk of faces.
+    m_chunkTriangleCounts.assign( nChunks + 1, 0 );
+    m_chunkVertexCounts.assign( nChunks + 1, 0 );
+    ThreadPool::global().parallelFor( 0, nChunks, 1,
+        [&]( int chunkBegin, int chunkEnd )
+        {
+            for( int c = chunkBegin; c < chunkEnd; ++c )
+            {
+                int begin;
+                int end;
+                chunkRange( c, begin, end );
+                for( int f = begin; f < end; ++f )
+                {
+                    int nNewVertices;
+                    m_chunkTriangleCounts[ c ] += setupFace( f, faces[ f ],
+                        nNewVertices, nullptr, nullptr, nullptr, 0 );
+                    m_chunkVertexCounts[ c ] += nNewVertices;
+                }
+            }
+        }
+    );
+
+    // Exclusive prefix sums.
+    int nTriangles = 0;
+    int nNewVertices = 0;
+    for( int c = 0; c <= nChunks; ++c )
+    {
+        int nChunkTriangles = m_chunkTriangleCounts[ c ];
+        int nChunkVertices = m_chunkVertexCounts[ c ];
+        m_chunkTriangleCounts[ c ] = nTriangles;
+        m_chunkVertexCounts[ c ] = nVertices + nNewVertices;
+        nTriangles += nChunkTriangles;
+        nNewVertices += nChunkVertices;
+    }
+
+    m_triangles.resize( nTriangles );
+    m_setups.resize( nTriangles );
+    m_screenPositions.resize( nVertices + nNewVertices );
+
+    // Write them, in order.
+    ThreadPool::global().parallelFor( 0, nChunks, 1,
+        [&]( int chunkBegin, int chunkEnd )
+        {
+            for( int c = chunkBegin; c < chunkEnd; ++c )
+            {
+                int begin;
+                int end;
+                chunkRange( c, begin, end );
+                int t = m_chunkTriangleCounts[ c ];
+                int v = m_chunkVertexCounts[ c ];
+                for( int f = begin; f < end; ++f )
+                {
+                    int nFaceVertices;
+                    t += setupFace( f, faces[ f ], nFaceVertices,
+                        &( m_triangles[ t ] ), &( m_setups[ t ] ),
+                        m_screenPositions.data(), v );
+                    v += nFaceVertices;
+                }
+            }
+        }
+    );
+}
+
+int TriangleMeshRenderer::setupFace( int f, const Vector3i& face,
+    int& nNewVertices, Vector3i* triangles, TriangleSetup* setups,
+    Vector2f* screenPositions, int firstNewVertex ) const
+{
+    nNewVertices = 0;
+
+    // Entirely outside one plane of the view frustum.
+    if( ( m_outCodes[ face[ 0 ] ] & m_outCodes[ face[ 1 ] ] &
+        m_outCodes[ face[ 2 ] ] ) != 0 )
+    {
+        return 0;
+    }
+
+    uint8_t codes = m_clipCodes[ face[ 0 ] ] | m_clipCodes[ face[ 1 ] ] |
+        m_clipCodes[ face[ 2 ] ];
+    if( codes == 0 )
+    {
+        const Vector2f& s0 = m_screenPositions[ face[ 0 ] ];
+        const Vector2f& s1 = m_screenPositions[ face[ 1 ] ];
+        const Vector2f& s2 = m_screenPositions[ face[ 2 ] ];
+        if( isCulled( signedArea( s0, s1, s2 ) ) )
+        {
+            return 0;
+        }
+
+        if( triangles != nullptr )
+        {
+            ClipVertex v[ 3 ];
+            for( int k = 0; k < 3; ++k )
+            {
+                v[ k ].clip = m_clipPositions[ face[ k ] ];
+                v[ k ].eyeDepth = m_eyeDepths[ face[ k ] ];
+                v[ k ].barycentrics = Vector3f( 0.0f );
+                v[ k ].barycentrics[ k ] = 1.0f;
+            }
+            triangles[ 0 ] = face;
+            setups[ 0 ] = triangleSetup( f, v[ 0 ], v[ 1 ], v[ 2 ],
+                s0, s1, s2 );
+        }
+        return 1;
+    }
+
+    ClipVertex polygon[ MAX_CLIPPED_VERTICES ];
+    int nPolygonVertices = clipFace( face, codes, polygon );
+    if( nPolygonVertices < 3 )
+    {
+        return 0;
+    }
+
+    Vector2f screen[ MAX_CLIPPED_VERTICES ];
+    float area = 0;
+    for( int i = 0; i < nPolygonVertices; ++i )
+    {
+        screen[ i ] = screenFromClip( polygon[ i ].clip );
+    }
+    for( int i = 1; i + 1 < nPolygonVertices; ++i )
+    {
+        area += signedArea( screen[ 0 ], screen[ i ], screen[ i + 1 ] );
+    }
+    if( isCulled( area ) )
+    {
+        return 0;
+    }
+
+    // Triangulate the polygon as a fan around vertex 0, skipping slivers
+    // that have no area.
+    nNewVertices = nPolygonVertices;
+    if( triangles != nullptr )
+    {
+        std::copy( screen, screen + nPolygonVertices,
+            screenPositions + firstNewVertex );
+    }
+    int nTriangles = 0;
+    for( int i = 1; i + 1 < nPolygonVertices; ++i )
+    {
+        if( signedArea( screen[ 0 ], screen[ i ], screen[ i + 1 ] ) == 0 )
+        {
+            continue;
+        }
+        if( triangles != nullptr )
+        {
+            triangles[ nTriangles ] = Vector3i( firstNewVertex,
+                firstNewVertex + i, firstNewVertex + i + 1 );
+            setups[ nTriangles ] = triangleSetup( f,
+                polygon[ 0 ], polygon[ i ], polygon[ i + 1 ],
+                screen[ 0 ], screen[ i ], screen[ i + 1 ] );
+        }
+        ++nTriangles;
+    }
+    return nTriangles;
+}
+
+int TriangleMeshRenderer::clipFace( const Vector3i& face, uint8_t clipCodes,
+    ClipVertex polygon[] ) const
+{
+    // Sutherland-Hodgman: each plane adds at most one vertex to a convex
+    // polygon. Rounding can make the polygon slightly nonconvex, so the
+    // buffers have room to spare, and the output is still bounded.
+    ClipVertex scratch[ MAX_CLIPPED_VERTICES ];
+    ClipVertex* input = polygon;
+    ClipVertex* output = scratch;
+
+    int n = 3;
+    for( int k = 0; k < 3; ++k )
+    {
+        input[ k ].clip = m_clipPositions[ face[ k ] ];
+        input[ k ].eyeDepth = m_eyeDepths[ face[ k ] ];
+        input[ k ].barycentrics = Vector3f( 0.0f );
+        input[ k ].barycentrics[ k ] = 1.0f;
+    }
+
+    for( int i = 0; i < NUM_CLIP_PLANES && n > 0; ++i )
+    {
+        if( ( clipCodes & ( 1 << i ) ) == 0 )
+        {
+            continue;
+        }
+
+        int nOutput = 0;
+        for( int k = 0; k < n; ++k )
+        {
+            const ClipVertex& a = input[ k ];
+            const ClipVertex& b = input[ ( k + 1 ) % n ];
+            float da = clipDistance( i, a.clip, m_guardBand, m_directX );
+            float db = clipDistance( i, b.clip, m_guardBand, m_directX );
+
+            if( da >= 0 )
+            {
+                if( nOutput == MAX_CLIPPED_VERTICES )
+                {
+                    return 0;
+                }
+                output[ nOutput++ ] = a;
+            }
+            if( ( da >= 0 ) != ( db >= 0 ) )
+            {
+                if( nOutput == MAX_CLIPPED_VERTICES )
+                {
+                    return 0;
+                }
+                float t = da / ( da - db );
+                ClipVertex& c = output[ nOutput++ ];
+                c.clip = a.clip + t * ( b.clip - a.clip );
+                c.eyeDepth = a.eyeDepth + t * ( b.eyeDepth - a.eyeDepth );
+                c.barycentrics = a.barycentrics +
+                    t * ( b.barycentrics - a.barycentrics );
+            }
+        }
+
+        std::swap( input, output );
+        n = nOutput;
+    }
+
+    if( input != polygon )
+    {
+        std::copy( input, input + n, polygon );
+    }
+    return n;
+}
+
+bool TriangleMeshRenderer::isCulled( float area ) const
+{
+    switch( m_cullMode )
+    {
+    case CullMode::BACK:
+        return area <= 0;
+    case CullMode::FRONT:
+        return area >= 0;
+    default:
+        return area == 0;
+    }
+}
+
+Vector2f TriangleMeshRenderer::screenFromClip( const Vector4f& clip ) const
+{
+    // Same as Camera::screenFromNDC().
+    float invW = 1.0f / clip.w;
+    return Vector2f
+    (
+        0.5f * m_viewportSize.x * ( clip.x * invW + 1.0f ),
+        0.5f * m_viewportSize.y * ( clip.y * invW + 1.0f )
+    );
+}
+
+TriangleMeshRenderer::TriangleSetup TriangleMeshRenderer::triangleSetup(
+    int f, const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2,
+    const Vector2f& s0, const Vector2f& s1, const Vector2f& s2 ) const
+{
+    // Solve for the gradient in double: screen coordinates can be large.
+    double x1 = s1.x - s0.x;
+    double y1 = s1.y - s0.y;
+    double x2 = s2.x - s0.x;
+    double y2 = s2.y - s0.y;
+    double invArea = 1.0 / ( x1 * y2 - x2 * y1 );
+
+    auto plane = [&]( double f0, double f1, double f2 )
+    {
+        double df1 = f1 - f0;
+        double df2 = f2 - f0;
+        Plane p;
+        p.value = static_cast< float >( f0 );
+        p.dx = static_cast< float >( ( df1 * y2 - df2 * y1 ) * invArea );
+        p.dy = static_cast< float >( ( df2 * x1 - df1 * x2 ) * invArea );
+        return p;
+    };
+
+    double invW0 = 1.0 / v0.clip.w;
+    double invW1 = 1.0 / v1.clip.w;
+    double invW2 = 1.0 / v2.clip.w;
+
+    TriangleSetup setup;
+    setup.face = f;
+    setup.origin = s0;
+    setup.invW = plane( invW0, invW1, invW2 );
+    setup.eyeDepthOverW = plane( v0.eyeDepth * invW0, v1.eyeDepth * invW1,
+        v2.eyeDepth * invW2 );
+    setup.barycentric0OverW = plane( v0.barycentrics.x * invW0,
+        v1.barycentrics.x * invW1, v2.barycentrics.x * invW2 );
+    setup.barycentric1OverW = plane( v0.barycentrics.y * invW0,
+        v1.barycentrics.y * invW1, v2.barycentrics.y * invW2 );
+    return setup;
+}
+
+} } } // geometry, core, libcgt
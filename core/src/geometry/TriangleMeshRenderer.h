@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <common/Array2D.h>
+#include <common/ArrayView.h>
+#include <vecmath/Matrix4f.h>
+#include <vecmath/Vector2f.h>
+#include <vecmath/Vector2i.h>
+#include <vecmath/Vector3f.h>
+#include <vecmath/Vector3i.h>
+#include <vecmath/Vector4f.h>
+
+#include "geometry/TriangleRasterizer.h"
+
+class Camera;
+class TriangleMesh;
+
+namespace libcgt { namespace core { namespace geometry {
+
+enum class CullMode
+{
+    NONE,
+
+    // Cull faces that are clockwise on screen.
+    BACK,
+
+    // Cull faces that are counterclockwise on screen.
+    FRONT
+};
+
+// A multi-threaded software renderer for depth, face index and barycentric
+// buffers, for when there is no GPU.
+//
+// The pipeline is:
+// - Vertex transform: each vertex is transformed to clip space by
+//   Camera::viewProjectionMatrix().
+// - Clipping: faces entirely outside the view frustum are discarded. Faces
+//   crossing the near or far plane, or reaching far outside the viewport (the
+//   guard band), are clipped in clip space. Other faces are not clipped: the
+//   rasterizer only visits pixels inside the viewport.
+// - Culling, by CullMode.
+// - Rasterization with TiledRasterizer (the top-left fill rule) and a depth
+//   test, in parallel over screen bins.
+//
+// The outputs follow Camera::screenFromNDC(): pixel (x, y) is centered at
+// ( x + 0.5, y + 0.5 ) in screen coordinates, so row 0 is the bottom of the
+// image. Depth is the orthogonal distance from the eye (the same depth as
+// Camera::eyeFromScreen()), interpolated with perspective correction.
+//
+// Results are deterministic: when two faces have the same depth at a pixel,
+// the one with the smaller index wins.
+//
+// Intermediate buffers are kept between calls to avoid reallocating them.
+class TriangleMeshRenderer
+{
+public:
+
+    TriangleMeshRenderer( const Vector2i& viewportSize,
+        CullMode cullMode = CullMode::NONE );
+
+    Vector2i viewportSize() const;
+    void setViewportSize( const Vector2i& viewportSize );
+
+    CullMode cullMode() const;
+    void setCullMode( CullMode cullMode );
+
+    // Renders mesh from camera. Each output may be null, to skip it, and
+    // otherwise must have size viewportSize(). Outputs are cleared first:
+    // - depth, to +infinity.
+    // - faceIndex, to -1.
+    // - barycentrics, to (0, 0, 0). Otherwise, pixel (x, y) is at
+    //   barycentrics[ x, y ] with respect to the vertices of face
+    //   faceIndex[ x, y ].
+    //
+    // Returns false if an output has the wrong size.
+    bool render( const TriangleMesh& mesh, const Camera& camera,
+        Array2DWriteView< float > depth,
+        Array2DWriteView< int > faceIndex,
+        Array2DWriteView< Vector3f > barycentrics =
+            Array2DWriteView< Vector3f >() );
+
+    // Same as above, for any set of triangles.
+    bool render( Array1DReadView< Vector3f > positions,
+        Array1DReadView< Vector3i > faces, const Camera& camera,
+        Array2DWriteView< float > depth,
+        Array2DWriteView< int > faceIndex,
+        Array2DWriteView< Vector3f > barycentrics =
+            Array2DWriteView< Vector3f >() );
+
+private:
+
+    // A vertex of a face being clipped, with its barycentrics with respect
+    // to the face.
+    struct ClipVertex
+    {
+        Vector4f clip;
+        float eyeDepth;
+        Vector3f barycentrics;
+    };
+
+    // An attribute f interpolated linearly in screen space:
+    // f( x, y ) = value + ( x - origin.x ) * dx + ( y - origin.y ) * dy.
+    struct Plane
+    {
+        float value;
+        float dx;
+        float dy;
+    };
+
+    // A triangle ready for rasterization. Its attributes are divided by
+    // clip w, which makes them linear in screen space.
+    struct TriangleSetup
+    {
+        int face;
+        Vector2f origin;
+        Plane invW;
+        Plane eyeDepthOverW;
+        Plane barycentric0OverW;
+        Plane barycentric1OverW;
+    };
+
+    // Transforms the vertices to clip space and screen space, and computes
+    // their codes.
+    void transformVertices( Array1DReadView< Vector3f > positions,
+        const Camera& camera );
+
+    // Clips, culls and sets up all faces, in order, into m_triangles,
+    // m_setups and the tail of m_screenPositions.
+    void setupFaces( Array1DReadView< Vector3i > faces );
+
+    // Clips, culls and sets up face f.
+    // Returns the number of triangles it makes and sets nNewVertices to the
+    // number of screen vertices made by clipping.
+    // If triangles is not null, also writes the triangles, their setups, and
+    // the new vertices to screenPositions[ firstNewVertex, ... ).
+    int setupFace( int f, const Vector3i& face, int& nNewVertices,
+        Vector3i* triangles, TriangleSetup* setups,
+        Vector2f* screenPositions, int firstNewVertex ) const;
+
+    // Clips the face against the clipping volume planes set in clipCodes.
+    // Writes a convex polygon and returns its number of vertices. Returns 0
+    // (dropping the face) only if rounding makes it so nonconvex that it
+    // would have more than MAX_CLIPPED_VERTICES.
+    int clipFace( const Vector3i& face, uint8_t clipCodes,
+        ClipVertex polygon[] ) const;
+
+    // Whether a triangle (or polygon) with twice signed area "area" on screen
+    // is culled.
+    bool isCulled( float area ) const;
+
+    Vector2f screenFromClip( const Vector4f& clip ) const;
+
+    TriangleSetup triangleSetup( int f,
+        const ClipVertex& v0, const ClipVertex& v1, const ClipVertex& v2,
+        const Vector2f& s0, const Vector2f& s1, const Vector2f& s2 ) const;
+
+    // A triangle clipped by 6 planes has at most 9 vertices while it stays
+    // convex. Rounding can add a few more, so leave a comfortable margin.
+    static const int MAX_CLIPPED_VERTICES = 16;
+
+    Vector2i m_viewportSize;
+    CullMode m_cullMode;
+    bool m_directX = false;
+    // The clipping volume is |x| <= m_guardBand.x * w and
+    // |y| <= m_guardBand.y * w, between the near and far planes.
+    Vector2f m_guardBand;
+
+    TiledRasterizer m_rasterizer;
+
+    // Per vertex.
+    std::vector< Vector4f > m_clipPositions;
+    std::vector< float > m_eyeDepths;
+    // Bit i is set if the vertex is outside plane i of the view frustum.
+    std::vector< uint8_t > m_outCodes;
+    // Bit i is set if the vertex is outside plane i of the clipping volume.
+    std::vector< uint8_t > m_clipCodes;
+
+    // The screen positions of the vertices, followed by the vertices made
+    // by clipping.
+    std::vector< Vector2f > m_screenPositions;
+
+    // Per triangle sent to the rasterizer.
+    std::vector< Vector3i > m_triangles;
+    std::vector< TriangleSetup > m_setups;
+
+    // Per-chunk triangle and clipped vertex counts, for setting up in
+    // parallel.
+    std::vector< int > m_chunkTriangleCounts;
+    std::vector< int > m_chunkVertexCounts;
+
+    // Used when no depth output is given.
+    Array2D< float > m_depth;
+};
+
+} } } // geometry, core, libcgt
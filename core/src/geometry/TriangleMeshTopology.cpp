@@ -0,0 +1,531 @@
+#include "geometry/TriangleMeshTopology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <numeric>
+#include <utility>
+
+#include "common/ArrayUtils.h"
+#include "concurrency/ThreadPool.h"
+#include "geometry/TriangleMesh.h"
+
+using libcgt::core::arrayutils::copy;
+using libcgt::core::arrayutils::readViewOf;
+using libcgt::core::arrayutils::writeViewOf;
+using libcgt::core::concurrency::ThreadPool;
+
+namespace
+{
+
+// Turns counts[ i + 1 ] into the exclusive prefix sum:
+// counts[ i ] is the start of bucket i, counts.back() is the total.
+void countsToOffsets( std::vector< int >& counts )
+{
+    std::partial_sum( counts.begin(), counts.end(), counts.begin() );
+}
+
+// Returns the root of x, halving the path to it along the way.
+int findRoot( std::vector< std::atomic< int > >& parents, int x )
+{
+    while( true )
+    {
+        int parent = parents[ x ].load( std::memory_order_relaxed );
+        if( parent == x )
+        {
+            return x;
+        }
+
+        // Another thread may have moved x already: that's fine, since any
+        // ancestor is as good as its parent.
+        int grandparent = parents[ parent ].load( std::memory_order_relaxed );
+        if( grandparent != parent )
+        {
+            parents[ x ].compare_exchange_weak( parent, grandparent,
+                std::memory_order_relaxed );
+        }
+        x = grandparent;
+    }
+}
+
+// Links the larger of the roots of x and y under the smaller one, retrying
+// if another thread links either of them first.
+void unite( std::vector< std::atomic< int > >& parents, int x, int y )
+{
+    while( true )
+    {
+        x = findRoot( parents, x );
+        y = findRoot( parents, y );
+        if( x == y )
+        {
+            return;
+        }
+        if( x < y )
+        {
+            std::swap( x, y );
+        }
+
+        int expected = x;
+        if( parents[ x ].compare_exchange_strong( expected, y,
+            std::memory_order_relaxed ) )
+        {
+            return;
+        }
+    }
+}
+
+}
+
+TriangleMeshTopology::TriangleMeshTopology( Array1DReadView< Vector3i > faces,
+    int nVertices ) :
+    m_nVertices( nVertices ),
+    m_faces( faces.size() )
+{
+    copy( faces, writeViewOf( m_faces ) );
+
+    int nHalfEdges = numHalfEdges();
+    ThreadPool& pool = ThreadPool::global();
+
+    // Bucket every half edge by its smaller vertex, so that both halves of an
+    // edge land in the same bucket.
+    std::vector< int > edgeOffsets( nVertices + 1, 0 );
+    for( int h = 0; h < nHalfEdges; ++h )
+    {
+        assert( tail( h ) >= 0 && tail( h ) < nVertices );
+        ++edgeOffsets[ std::min( tail( h ), head( h ) ) + 1 ];
+    }
+    countsToOffsets( edgeOffsets );
+
+    // Each entry packs the larger vertex above the half edge index, so that
+    // sorting a bucket groups the halves of each edge, in face order.
+    std::vector< uint64_t > edgeBuckets( nHalfEdges );
+    {
+        std::vector< int > cursors( edgeOffsets.begin(), edgeOffsets.end() - 1 );
+        for( int h = 0; h < nHalfEdges; ++h )
+        {
+            int i = tail( h );
+            int j = head( h );
+            edgeBuckets[ cursors[ std::min( i, j ) ]++ ] =
+                ( static_cast< uint64_t >( std::max( i, j ) ) << 32 ) |
+                static_cast< uint32_t >( h );
+        }
+    }
+
+    // Within each bucket, each run of equal larger vertices is one edge.
+    m_twins.assign( nHalfEdges, -1 );
+    std::atomic< int > nNonManifoldEdges( 0 );
+    pool.parallelFor( 0, nVertices, 0,
+        [&]( int begin, int end )
+        {
+            int nNonManifold = 0;
+            for( int v = begin; v < end; ++v )
+            {
+                uint64_t* first = edgeBuckets.data() + edgeOffsets[ v ];
+                uint64_t* last = edgeBuckets.data() + edgeOffsets[ v + 1 ];
+                std::sort( first, last );
+
+                while( first != last )
+                {
+                    uint64_t* runEnd = first + 1;
+                    while( runEnd != last &&
+                        ( *runEnd >> 32 ) == ( *first >> 32 ) )
+                    {
+                        ++runEnd;
+                    }
+
+                    int h0 = static_cast< int >( first[ 0 ] & 0xffffffff );
+                    bool degenerate = ( tail( h0 ) == head( h0 ) );
+                    if( runEnd - first == 2 && !degenerate )
+                    {
+                        int h1 = static_cast< int >( first[ 1 ] & 0xffffffff );
+                        if( tail( h0 ) == head( h1 ) )
+                        {
+                            m_twins[ h0 ] = h1;
+                            m_twins[ h1 ] = h0;
+                        }
+                        else
+                        {
+                            // Two faces with opposite orientations.
+                            ++nNonManifold;
+                        }
+                    }
+                    else if( runEnd - first > 1 || degenerate )
+                    {
+                        ++nNonManifold;
+                    }
+
+                    first = runEnd;
+                }
+            }
+            nNonManifoldEdges += nNonManifold;
+        }
+    );
+    m_nNonManifoldEdges = nNonManifoldEdges;
+
+    // Bucket half edges by their tail. A vertex has one outgoing half edge
+    // per incident face. It has one more one-ring vertex than faces for each
+    // fan that starts on a boundary.
+    m_vertexFaceOffsets.assign( nVertices + 1, 0 );
+    m_vertexVertexOffsets.assign( nVertices + 1, 0 );
+    for( int h = 0; h < nHalfEdges; ++h )
+    {
+        int v = tail( h );
+        ++m_vertexFaceOffsets[ v + 1 ];
+        ++m_vertexVertexOffsets[ v + 1 ];
+        if( m_twins[ h ] == -1 )
+        {
+            ++m_vertexVertexOffsets[ v + 1 ];
+        }
+    }
+    countsToOffsets( m_vertexFaceOffsets );
+    countsToOffsets( m_vertexVertexOffsets );
+
+    std::vector< int > unorderedOutgoing( nHalfEdges );
+    {
+        std::vector< int > cursors( m_vertexFaceOffsets.begin(),
+            m_vertexFaceOffsets.end() - 1 );
+        for( int h = 0; h < nHalfEdges; ++h )
+        {
+            unorderedOutgoing[ cursors[ tail( h ) ]++ ] = h;
+        }
+    }
+
+    // Order each one-ring counterclockwise: first the fans that start on a
+    // boundary, then any closed fans. Each walk only visits half edges
+    // leaving its own vertex, so vertices can be processed in parallel.
+    m_vertexToOutgoingHalfEdges.resize( nHalfEdges );
+    m_vertexToFace.resize( nHalfEdges );
+    m_vertexToVertex.resize( m_vertexVertexOffsets.back() );
+    m_oneRingIsClosed.assign( nVertices, 0 );
+    std::vector< uint8_t > visited( nHalfEdges, 0 );
+    pool.parallelFor( 0, nVertices, 0,
+        [&]( int begin, int end )
+        {
+            for( int v = begin; v < end; ++v )
+            {
+                const int* outgoingBegin =
+                    unorderedOutgoing.data() + m_vertexFaceOffsets[ v ];
+                const int* outgoingEnd =
+                    unorderedOutgoing.data() + m_vertexFaceOffsets[ v + 1 ];
+
+                int* halfEdges = m_vertexToOutgoingHalfEdges.data() +
+                    m_vertexFaceOffsets[ v ];
+                int* vertices = m_vertexToVertex.data() +
+                    m_vertexVertexOffsets[ v ];
+
+                bool open = false;
+                for( const int* h = outgoingBegin; h != outgoingEnd; ++h )
+                {
+                    if( m_twins[ *h ] == -1 )
+                    {
+                        walkFan( *h, visited, halfEdges, vertices );
+                        open = true;
+                    }
+                }
+
+                int nClosedFans = 0;
+                for( const int* h = outgoingBegin; h != outgoingEnd; ++h )
+                {
+                    if( !visited[ *h ] )
+                    {
+                        walkFan( *h, visited, halfEdges, vertices );
+                        ++nClosedFans;
+                    }
+                }
+
+                m_oneRingIsClosed[ v ] = ( !open && nClosedFans == 1 );
+
+                for( int i = m_vertexFaceOffsets[ v ];
+                    i < m_vertexFaceOffsets[ v + 1 ]; ++i )
+                {
+                    m_vertexToFace[ i ] = face( m_vertexToOutgoingHalfEdges[ i ] );
+                }
+            }
+        }
+    );
+}
+
+TriangleMeshTopology::TriangleMeshTopology( const TriangleMesh& mesh ) :
+    TriangleMeshTopology( readViewOf( mesh.faces() ), mesh.numVertices() )
+{
+
+}
+
+int TriangleMeshTopology::numVertices() const
+{
+    return m_nVertices;
+}
+
+int TriangleMeshTopology::numFaces() const
+{
+    return static_cast< int >( m_faces.size() );
+}
+
+int TriangleMeshTopology::numHalfEdges() const
+{
+    return 3 * numFaces();
+}
+
+int TriangleMeshTopology::numNonManifoldEdges() const
+{
+    return m_nNonManifoldEdges;
+}
+
+// static
+int TriangleMeshTopology::face( int halfEdge )
+{
+    return halfEdge / 3;
+}
+
+// static
+int TriangleMeshTopology::next( int halfEdge )
+{
+    return ( halfEdge % 3 == 2 ) ? halfEdge - 2 : halfEdge + 1;
+}
+
+// static
+int TriangleMeshTopology::prev( int halfEdge )
+{
+    return ( halfEdge % 3 == 0 ) ? halfEdge + 2 : halfEdge - 1;
+}
+
+int TriangleMeshTopology::twin( int halfEdge ) const
+{
+    return m_twins[ halfEdge ];
+}
+
+int TriangleMeshTopology::tail( int halfEdge ) const
+{
+    return m_faces[ halfEdge / 3 ][ halfEdge % 3 ];
+}
+
+int TriangleMeshTopology::head( int halfEdge ) const
+{
+    return tail( next( halfEdge ) );
+}
+
+int TriangleMeshTopology::opposite( int halfEdge ) const
+{
+    return tail( prev( halfEdge ) );
+}
+
+bool TriangleMeshTopology::isBoundary( int halfEdge ) const
+{
+    return m_twins[ halfEdge ] == -1;
+}
+
+int TriangleMeshTopology::findHalfEdge( int i, int j ) const
+{
+    for( int k = m_vertexFaceOffsets[ i ]; k < m_vertexFaceOffsets[ i + 1 ];
+        ++k )
+    {
+        int h = m_vertexToOutgoingHalfEdges[ k ];
+        if( head( h ) == j )
+        {
+            return h;
+        }
+    }
+    return -1;
+}
+
+int TriangleMeshTopology::vertexOppositeEdge( int i, int j ) const
+{
+    int h = findHalfEdge( i, j );
+    if( h == -1 )
+    {
+        return -1;
+    }
+    return opposite( h );
+}
+
+bool TriangleMeshTopology::isBoundaryEdge( int i, int j ) const
+{
+    int h = findHalfEdge( i, j );
+    return h == -1 || isBoundary( h );
+}
+
+int TriangleMeshTopology::adjacentFace( int f, int k ) const
+{
+    int t = m_twins[ 3 * f + k ];
+    if( t == -1 )
+    {
+        return -1;
+    }
+    return face( t );
+}
+
+bool TriangleMeshTopology::isOneRingClosed( int v ) const
+{
+    return m_oneRingIsClosed[ v ] != 0;
+}
+
+int TriangleMeshTopology::valence( int v ) const
+{
+    return m_vertexFaceOffsets[ v + 1 ] - m_vertexFaceOffsets[ v ];
+}
+
+Array1DReadView< int > TriangleMeshTopology::outgoingHalfEdges( int v ) const
+{
+    return Array1DReadView< int >(
+        m_vertexToOutgoingHalfEdges.data() + m_vertexFaceOffsets[ v ],
+        valence( v ) );
+}
+
+Array1DReadView< int > TriangleMeshTopology::oneRingVertices( int v ) const
+{
+    return Array1DReadView< int >(
+        m_vertexToVertex.data() + m_vertexVertexOffsets[ v ],
+        m_vertexVertexOffsets[ v + 1 ] - m_vertexVertexOffsets[ v ] );
+}
+
+Array1DReadView< int > TriangleMeshTopology::oneRingFaces( int v ) const
+{
+    return Array1DReadView< int >(
+        m_vertexToFace.data() + m_vertexFaceOffsets[ v ],
+        valence( v ) );
+}
+
+int TriangleMeshTopology::connectedComponents(
+    std::vector< int >& faceComponents ) const
+{
+    int nFaces = numFaces();
+    ThreadPool& pool = ThreadPool::global();
+
+    // Lock-free union-find. Every face points to a face with a smaller or
+    // equal index, so the root of each tree is its smallest face.
+    std::vector< std::atomic< int > > parents( nFaces );
+    pool.parallelFor( 0, nFaces, 0,
+        [&]( int begin, int end )
+        {
+            for( int f = begin; f < end; ++f )
+            {
+                parents[ f ].store( f, std::memory_order_relaxed );
+            }
+        }
+    );
+
+    pool.parallelFor( 0, nFaces, 0,
+        [&]( int begin, int end )
+        {
+            for( int h = 3 * begin; h < 3 * end; ++h )
+            {
+                int t = m_twins[ h ];
+                if( t > h )
+                {
+                    unite( parents, face( h ), face( t ) );
+                }
+            }
+        }
+    );
+
+    // Twinless edges: boundary, non-manifold and inconsistently oriented.
+    // Faces still share them, so unite every face on each undirected edge
+    // { v, u }, found at v < u among the twinless half edges into and out of
+    // v, sorted by u.
+    pool.parallelFor( 0, m_nVertices, 0,
+        [&]( int begin, int end )
+        {
+            // ( u, face ) pairs.
+            std::vector< std::pair< int, int > > edgeFaces;
+            for( int v = begin; v < end; ++v )
+            {
+                edgeFaces.clear();
+                for( int i = m_vertexFaceOffsets[ v ];
+                    i < m_vertexFaceOffsets[ v + 1 ]; ++i )
+                {
+                    int h = m_vertexToOutgoingHalfEdges[ i ];
+                    int p = prev( h );
+                    if( m_twins[ h ] == -1 && head( h ) > v )
+                    {
+                        edgeFaces.emplace_back( head( h ), face( h ) );
+                    }
+                    if( m_twins[ p ] == -1 && tail( p ) > v )
+                    {
+                        edgeFaces.emplace_back( tail( p ), face( p ) );
+                    }
+                }
+
+                std::sort( edgeFaces.begin(), edgeFaces.end() );
+                for( size_t i = 1; i < edgeFaces.size(); ++i )
+                {
+                    if( edgeFaces[ i ].first == edgeFaces[ i - 1 ].first )
+                    {
+                        unite( parents, edgeFaces[ i - 1 ].second,
+                            edgeFaces[ i ].second );
+                    }
+                }
+            }
+        }
+    );
+
+    // Roots come before the rest of their component, so one pass in order
+    // numbers the components by their smallest face.
+    faceComponents.resize( nFaces );
+    pool.parallelFor( 0, nFaces, 0,
+        [&]( int begin, int end )
+        {
+            for( int f = begin; f < end; ++f )
+            {
+                faceComponents[ f ] = findRoot( parents, f );
+            }
+        }
+    );
+
+    int nComponents = 0;
+    for( int f = 0; f < nFaces; ++f )
+    {
+        int root = faceComponents[ f ];
+        faceComponents[ f ] = ( root == f ) ?
+            nComponents++ : faceComponents[ root ];
+    }
+
+    return nComponents;
+}
+
+std::vector< std::vector< int > > TriangleMeshTopology::connectedComponents() const
+{
+    std::vector< int > faceComponents;
+    int nComponents = connectedComponents( faceComponents );
+
+    std::vector< int > sizes( nComponents, 0 );
+    for( int c : faceComponents )
+    {
+        ++sizes[ c ];
+    }
+
+    std::vector< std::vector< int > > components( nComponents );
+    for( int c = 0; c < nComponents; ++c )
+    {
+        components[ c ].reserve( sizes[ c ] );
+    }
+    for( int f = 0; f < numFaces(); ++f )
+    {
+        components[ faceComponents[ f ] ].push_back( f );
+    }
+
+    return components;
+}
+
+void TriangleMeshTopology::walkFan( int start, std::vector< uint8_t >& visited,
+    int*& halfEdges, int*& vertices ) const
+{
+    // Rotate counterclockwise: the previous half edge on this face points
+    // into the vertex, and its twin leaves it on the next face.
+    int h = start;
+    do
+    {
+        visited[ h ] = 1;
+        *halfEdges++ = h;
+        *vertices++ = head( h );
+
+        int p = prev( h );
+        int t = m_twins[ p ];
+        if( t == -1 )
+        {
+            // Don't forget the last vertex, which has no face.
+            *vertices++ = tail( p );
+            return;
+        }
+        h = t;
+    } while( !visited[ h ] );
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "common/ArrayView.h"
+#include "vecmath/Vector3i.h"
+
+class TriangleMesh;
+
+// Compact, flat adjacency for a triangle mesh: an alternative to
+// TriangleMesh::buildAdjacency() that uses no maps or lists.
+//
+// Half edge h = 3f + k of face f goes from vertex faces[ f ][ k ] to vertex
+// faces[ f ][ ( k + 1 ) % 3 ]. Its face, next and previous half edges are
+// implicit. Only its twin (the opposite half edge on the adjacent face, or -1)
+// is stored.
+//
+// One-rings are stored in compressed sparse row (CSR) format: the one-ring of
+// vertex v is the range [ offsets[ v ], offsets[ v + 1 ] ) of a single flat
+// array, in counterclockwise order, following TriangleMesh::m_vertexToVertex
+// and m_vertexToFace.
+//
+// Construction sorts half edges into per-vertex buckets with a counting sort,
+// then matches twins within each bucket, so it takes time linear in the
+// number of faces (times the log of the maximum valence). The per-vertex
+// passes run in parallel on ThreadPool::global().
+//
+// An edge is manifold if it is used by exactly two faces, once in each
+// direction, or by exactly one face (a boundary edge). Half edges of
+// non-manifold and degenerate edges get no twin, so they act as boundaries.
+//
+// The topology is a copy: it does not refer to the mesh after construction.
+// If the mesh's faces change, rebuild it.
+class TriangleMeshTopology
+{
+public:
+
+    // The empty topology.
+    TriangleMeshTopology() = default;
+
+    // Build the topology of "faces", each of which indexes vertices in
+    // [ 0, nVertices ).
+    TriangleMeshTopology( Array1DReadView< Vector3i > faces, int nVertices );
+
+    // Build the topology of mesh.faces().
+    TriangleMeshTopology( const TriangleMesh& mesh );
+
+    int numVertices() const;
+    int numFaces() const;
+    int numHalfEdges() const;
+
+    // The number of (undirected) edges that are neither on a boundary nor
+    // shared by two consistently oriented faces, including degenerate edges
+    // from a vertex to itself.
+    int numNonManifoldEdges() const;
+
+    // ----- Half edges -----
+
+    static int face( int halfEdge );
+    static int next( int halfEdge );
+    static int prev( int halfEdge );
+
+    // Returns -1 if halfEdge is on a boundary.
+    int twin( int halfEdge ) const;
+
+    // The vertex halfEdge starts from.
+    int tail( int halfEdge ) const;
+
+    // The vertex halfEdge points to.
+    int head( int halfEdge ) const;
+
+    // The vertex opposite halfEdge on its face.
+    int opposite( int halfEdge ) const;
+
+    bool isBoundary( int halfEdge ) const;
+
+    // Returns the half edge i --> j, or -1 if it is not on a face.
+    // Takes time linear in the valence of i.
+    int findHalfEdge( int i, int j ) const;
+
+    // ----- Edge queries, same as TriangleMesh -----
+
+    // Returns -1 if edge i --> j is not on a face.
+    int vertexOppositeEdge( int i, int j ) const;
+
+    // The edge i --> j is a boundary edge if there is no twin edge j --> i.
+    // Also true if i --> j is not on a face.
+    bool isBoundaryEdge( int i, int j ) const;
+
+    // Returns the face sharing edge k of face f (the half edge 3f + k), or -1
+    // if there is none.
+    int adjacentFace( int f, int k ) const;
+
+    // ----- Vertex queries -----
+
+    // Whether the one-ring of v loops around. False for boundary, isolated
+    // and non-manifold vertices.
+    bool isOneRingClosed( int v ) const;
+
+    // The number of faces incident on v.
+    int valence( int v ) const;
+
+    // The half edges starting from v, in counterclockwise order.
+    // outgoingHalfEdges( v )[ i ] is on the face oneRingFaces( v )[ i ].
+    Array1DReadView< int > outgoingHalfEdges( int v ) const;
+
+    // The vertices around v, in counterclockwise order.
+    // If the one-ring is open, it starts and ends on the boundary, and has
+    // one more vertex than faces.
+    // If v is non-manifold, each fan of faces around it is listed in turn.
+    Array1DReadView< int > oneRingVertices( int v ) const;
+
+    // The faces around v, in counterclockwise order.
+    Array1DReadView< int > oneRingFaces( int v ) const;
+
+    // ----- Connected components -----
+
+    // Labels each face with the index of its connected component, where
+    // faces are connected if they share an edge: manifold, non-manifold or
+    // inconsistently oriented. Components are numbered in the order of their
+    // smallest face index.
+    // Uses a lock-free union-find over the twins, then over the faces around
+    // each twinless edge, in parallel.
+    //
+    // faceComponents is resized to numFaces().
+    // Returns the number of components.
+    int connectedComponents( std::vector< int >& faceComponents ) const;
+
+    // Same as above, but returns, for each component, the indices of its
+    // faces in increasing order (the format of
+    // TriangleMesh::m_connectedComponents).
+    std::vector< std::vector< int > > connectedComponents() const;
+
+private:
+
+    // Walks the fan of faces around v counterclockwise from outgoing half
+    // edge "start", until it hits a boundary or a half edge already visited.
+    // Appends to halfEdges and vertices.
+    void walkFan( int start, std::vector< uint8_t >& visited,
+        int*& halfEdges, int*& vertices ) const;
+
+    int m_nVertices = 0;
+    int m_nNonManifoldEdges = 0;
+
+    // m_faces[ f ][ k ] is the tail of half edge 3f + k.
+    std::vector< Vector3i > m_faces;
+
+    // Twin of each half edge, or -1.
+    std::vector< int > m_twins;
+
+    // Outgoing half edges and one-ring faces, both indexed by
+    // m_vertexFaceOffsets.
+    std::vector< int > m_vertexFaceOffsets;
+    std::vector< int > m_vertexToOutgoingHalfEdges;
+    std::vector< int > m_vertexToFace;
+
+    // One-ring vertices.
+    std::vector< int > m_vertexVertexOffsets;
+    std::vector< int > m_vertexToVertex;
+
+    std::vector< uint8_t > m_oneRingIsClosed;
+};
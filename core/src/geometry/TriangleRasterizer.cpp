@@ -0,0 +1,525 @@
+#include "geometry/TriangleRasterizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define LIBCGT_RASTERIZER_SSE2
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#include <arm_neon.h>
+#define LIBCGT_RASTERIZER_NEON
+#endif
+
+using libcgt::core::concurrency::ThreadPool;
+
+namespace
+{
+
+const int T = libcgt::core::geometry::RASTER_TILE_SIZE;
+const int64_t SUBPIXELS = 1 << libcgt::core::geometry::RASTER_SUBPIXEL_BITS;
+const int64_t HALF_PIXEL = SUBPIXELS / 2;
+
+// Rounds toward negative infinity.
+int64_t floorDivide( int64_t a, int64_t b )
+{
+    int64_t q = a / b;
+    if( ( a % b != 0 ) && ( ( a < 0 ) != ( b < 0 ) ) )
+    {
+        --q;
+    }
+    return q;
+}
+
+// Rounds v * SUBPIXELS to the nearest integer, halfway cases up.
+// Faster than std::llround, and exact since |v| <= MAX_RASTER_COORDINATE.
+int64_t snap( float v )
+{
+    double scaled = static_cast< double >( v ) * SUBPIXELS + 0.5;
+    int64_t truncated = static_cast< int64_t >( scaled );
+    return truncated > scaled ? truncated - 1 : truncated;
+}
+
+// A triangle snapped to the sub-pixel grid, counterclockwise with respect to
+// the edge functions below, with its pixel bounds.
+struct SnappedTriangle
+{
+    int64_t x[ 3 ];
+    int64_t y[ 3 ];
+
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Snaps the triangle and computes its bounds within clipRect.
+// Returns false if it can't cover any pixel.
+bool snapTriangle( const Vector2f& v0, const Vector2f& v1, const Vector2f& v2,
+    const Rect2i& clipRect, libcgt::core::geometry::RasterMode mode,
+    SnappedTriangle& snapped )
+{
+    const Vector2f* v[ 3 ] = { &v0, &v1, &v2 };
+    for( int i = 0; i < 3; ++i )
+    {
+        // Written so that NaNs fail too.
+        if( !( std::abs( v[ i ]->x ) <=
+                libcgt::core::geometry::MAX_RASTER_COORDINATE &&
+            std::abs( v[ i ]->y ) <=
+                libcgt::core::geometry::MAX_RASTER_COORDINATE ) )
+        {
+            return false;
+        }
+        snapped.x[ i ] = snap( v[ i ]->x );
+        snapped.y[ i ] = snap( v[ i ]->y );
+    }
+
+    // Twice the signed area. Vertex 2 is on the inside of edge 0 --> 1 if it
+    // is positive.
+    int64_t area =
+        ( snapped.x[ 1 ] - snapped.x[ 0 ] ) * ( snapped.y[ 2 ] - snapped.y[ 0 ] ) -
+        ( snapped.y[ 1 ] - snapped.y[ 0 ] ) * ( snapped.x[ 2 ] - snapped.x[ 0 ] );
+    if( area == 0 )
+    {
+        return false;
+    }
+    if( area < 0 )
+    {
+        std::swap( snapped.x[ 1 ], snapped.x[ 2 ] );
+        std::swap( snapped.y[ 1 ], snapped.y[ 2 ] );
+    }
+
+    int64_t minX = std::min( { snapped.x[ 0 ], snapped.x[ 1 ], snapped.x[ 2 ] } );
+    int64_t maxX = std::max( { snapped.x[ 0 ], snapped.x[ 1 ], snapped.x[ 2 ] } );
+    int64_t minY = std::min( { snapped.y[ 0 ], snapped.y[ 1 ], snapped.y[ 2 ] } );
+    int64_t maxY = std::max( { snapped.y[ 0 ], snapped.y[ 1 ], snapped.y[ 2 ] } );
+    if( mode == libcgt::core::geometry::RasterMode::CONSERVATIVE )
+    {
+        minX -= HALF_PIXEL;
+        maxX += HALF_PIXEL;
+        minY -= HALF_PIXEL;
+        maxY += HALF_PIXEL;
+    }
+
+    // Pixel x is centered at x * SUBPIXELS + HALF_PIXEL.
+    int64_t x0 = -floorDivide( HALF_PIXEL - minX, SUBPIXELS );
+    int64_t x1 = floorDivide( maxX - HALF_PIXEL, SUBPIXELS ) + 1;
+    int64_t y0 = -floorDivide( HALF_PIXEL - minY, SUBPIXELS );
+    int64_t y1 = floorDivide( maxY - HALF_PIXEL, SUBPIXELS ) + 1;
+
+    snapped.x0 = static_cast< int >(
+        std::max( x0, static_cast< int64_t >( clipRect.left() ) ) );
+    snapped.x1 = static_cast< int >(
+        std::min( x1, static_cast< int64_t >( clipRect.right() ) ) );
+    snapped.y0 = static_cast< int >(
+        std::max( y0, static_cast< int64_t >( clipRect.bottom() ) ) );
+    snapped.y1 = static_cast< int >(
+        std::min( y1, static_cast< int64_t >( clipRect.top() ) ) );
+
+    return snapped.x0 < snapped.x1 && snapped.y0 < snapped.y1;
+}
+
+}
+
+namespace libcgt { namespace core { namespace geometry {
+
+bool setupTriangle( const Vector2f& v0, const Vector2f& v1,
+    const Vector2f& v2, const Rect2i& clipRect, RasterTriangle& triangle,
+    RasterMode mode )
+{
+    SnappedTriangle snapped;
+    if( !snapTriangle( v0, v1, v2, clipRect, mode, snapped ) )
+    {
+        return false;
+    }
+
+    for( int i = 0; i < 3; ++i )
+    {
+        int j = ( i + 1 ) % 3;
+
+        // E( p ) = a * ( p.x - x_i ) + b * ( p.y - y_i ), where ( a, b ) is
+        // the inward normal of edge i --> j.
+        int64_t a = snapped.y[ i ] - snapped.y[ j ];
+        int64_t b = snapped.x[ j ] - snapped.x[ i ];
+
+        int64_t bias;
+        if( mode == RasterMode::CONSERVATIVE )
+        {
+            // Move the edge out by half a pixel in x and y: the pixel square
+            // touches the triangle if its nearest corner is inside.
+            bias = ( std::abs( a ) + std::abs( b ) ) * HALF_PIXEL;
+        }
+        else
+        {
+            // Top-left rule: centers exactly on an edge belong to the
+            // triangle on its right (in x), or below it (in y) if it's
+            // horizontal.
+            bool topLeft = ( a > 0 ) || ( a == 0 && b > 0 );
+            bias = topLeft ? 0 : -1;
+        }
+
+        triangle.e0[ i ] = a * ( HALF_PIXEL - snapped.x[ i ] ) +
+            b * ( HALF_PIXEL - snapped.y[ i ] ) + bias;
+        triangle.dx[ i ] = a * SUBPIXELS;
+        triangle.dy[ i ] = b * SUBPIXELS;
+    }
+
+    triangle.x0 = snapped.x0;
+    triangle.y0 = snapped.y0;
+    triangle.x1 = snapped.x1;
+    triangle.y1 = snapped.y1;
+
+    return true;
+}
+
+bool tileCoverage( const RasterTriangle& triangle, int x, int y,
+    uint8_t rowMasks[ RASTER_TILE_SIZE ] )
+{
+    // Pixels within the bounds.
+    int i0 = std::max( triangle.x0 - x, 0 );
+    int i1 = std::min( triangle.x1 - x, T );
+    int j0 = std::max( triangle.y0 - y, 0 );
+    int j1 = std::min( triangle.y1 - y, T );
+    if( i0 >= i1 || j0 >= j1 )
+    {
+        return false;
+    }
+    unsigned int columnMask = ( ( 1u << i1 ) - 1 ) & ~( ( 1u << i0 ) - 1 );
+
+    // Each edge function is linear, so its extremes over the tile's pixel
+    // centers are at the corners.
+    int64_t e[ 3 ];
+    bool full = true;
+    for( int k = 0; k < 3; ++k )
+    {
+        e[ k ] = triangle.e0[ k ] + x * triangle.dx[ k ] +
+            y * triangle.dy[ k ];
+
+        int64_t spanX = ( T - 1 ) * triangle.dx[ k ];
+        int64_t spanY = ( T - 1 ) * triangle.dy[ k ];
+        int64_t eMax = e[ k ] + std::max( spanX, int64_t( 0 ) ) +
+            std::max( spanY, int64_t( 0 ) );
+        int64_t eMin = e[ k ] + std::min( spanX, int64_t( 0 ) ) +
+            std::min( spanY, int64_t( 0 ) );
+        if( eMax < 0 )
+        {
+            return false;
+        }
+        if( eMin < 0 )
+        {
+            full = false;
+        }
+    }
+
+    if( full )
+    {
+        for( int j = 0; j < T; ++j )
+        {
+            rowMasks[ j ] = ( j >= j0 && j < j1 ) ?
+                static_cast< uint8_t >( columnMask ) : 0;
+        }
+        return true;
+    }
+
+    // A pixel is outside if any edge function is negative: OR them together
+    // and test the sign bit.
+    unsigned int anyCovered = 0;
+
+#if defined( LIBCGT_RASTERIZER_SSE2 )
+
+    __m128i offsets[ 3 ][ T / 2 ];
+    __m128i rowE[ 3 ];
+    __m128i rowStep[ 3 ];
+    for( int k = 0; k < 3; ++k )
+    {
+        for( int i = 0; i < T / 2; ++i )
+        {
+            offsets[ k ][ i ] = _mm_set_epi64x(
+                ( 2 * i + 1 ) * triangle.dx[ k ], 2 * i * triangle.dx[ k ] );
+        }
+        rowE[ k ] = _mm_set1_epi64x( e[ k ] + j0 * triangle.dy[ k ] );
+        rowStep[ k ] = _mm_set1_epi64x( triangle.dy[ k ] );
+    }
+
+    std::fill( rowMasks, rowMasks + T, uint8_t( 0 ) );
+    for( int j = j0; j < j1; ++j )
+    {
+        unsigned int outside = 0;
+        for( int i = 0; i < T / 2; ++i )
+        {
+            __m128i eAll = _mm_or_si128(
+                _mm_or_si128(
+                    _mm_add_epi64( rowE[ 0 ], offsets[ 0 ][ i ] ),
+                    _mm_add_epi64( rowE[ 1 ], offsets[ 1 ][ i ] ) ),
+                _mm_add_epi64( rowE[ 2 ], offsets[ 2 ][ i ] ) );
+            outside |= static_cast< unsigned int >(
+                _mm_movemask_pd( _mm_castsi128_pd( eAll ) ) ) << ( 2 * i );
+        }
+
+        unsigned int mask = ~outside & columnMask;
+        rowMasks[ j ] = static_cast< uint8_t >( mask );
+        anyCovered |= mask;
+
+        for( int k = 0; k < 3; ++k )
+        {
+            rowE[ k ] = _mm_add_epi64( rowE[ k ], rowStep[ k ] );
+        }
+    }
+
+#elif defined( LIBCGT_RASTERIZER_NEON )
+
+    int64x2_t offsets[ 3 ][ T / 2 ];
+    int64x2_t rowE[ 3 ];
+    int64x2_t rowStep[ 3 ];
+    for( int k = 0; k < 3; ++k )
+    {
+        for( int i = 0; i < T / 2; ++i )
+        {
+            int64_t pair[ 2 ] =
+            {
+                2 * i * triangle.dx[ k ],
+                ( 2 * i + 1 ) * triangle.dx[ k ]
+            };
+            offsets[ k ][ i ] = vld1q_s64( pair );
+        }
+        rowE[ k ] = vdupq_n_s64( e[ k ] + j0 * triangle.dy[ k ] );
+        rowStep[ k ] = vdupq_n_s64( triangle.dy[ k ] );
+    }
+
+    std::fill( rowMasks, rowMasks + T, uint8_t( 0 ) );
+    for( int j = j0; j < j1; ++j )
+    {
+        unsigned int outside = 0;
+        for( int i = 0; i < T / 2; ++i )
+        {
+            int64x2_t eAll = vorrq_s64(
+                vorrq_s64(
+                    vaddq_s64( rowE[ 0 ], offsets[ 0 ][ i ] ),
+                    vaddq_s64( rowE[ 1 ], offsets[ 1 ][ i ] ) ),
+                vaddq_s64( rowE[ 2 ], offsets[ 2 ][ i ] ) );
+            uint64x2_t sign = vshrq_n_u64( vreinterpretq_u64_s64( eAll ), 63 );
+            outside |= static_cast< unsigned int >(
+                ( vgetq_lane_u64( sign, 0 ) |
+                ( vgetq_lane_u64( sign, 1 ) << 1 ) ) << ( 2 * i ) );
+        }
+
+        unsigned int mask = ~outside & columnMask;
+        rowMasks[ j ] = static_cast< uint8_t >( mask );
+        anyCovered |= mask;
+
+        for( int k = 0; k < 3; ++k )
+        {
+            rowE[ k ] = vaddq_s64( rowE[ k ], rowStep[ k ] );
+        }
+    }
+
+#else
+
+    std::fill( rowMasks, rowMasks + T, uint8_t( 0 ) );
+    for( int j = j0; j < j1; ++j )
+    {
+        unsigned int mask = 0;
+        for( int i = i0; i < i1; ++i )
+        {
+            int64_t eAll = 0;
+            for( int k = 0; k < 3; ++k )
+            {
+                eAll |= e[ k ] + i * triangle.dx[ k ] + j * triangle.dy[ k ];
+            }
+            if( eAll >= 0 )
+            {
+                mask |= 1u << i;
+            }
+        }
+
+        rowMasks[ j ] = static_cast< uint8_t >( mask );
+        anyCovered |= mask;
+    }
+
+#endif
+
+    return anyCovered != 0;
+}
+
+TiledRasterizer::TiledRasterizer( const Vector2i& viewportSize, int binSize,
+    RasterMode mode ) :
+    m_binSize( std::max( T, ( ( binSize + T - 1 ) / T ) * T ) ),
+    m_mode( mode )
+{
+    setViewportSize( viewportSize );
+}
+
+Vector2i TiledRasterizer::viewportSize() const
+{
+    return m_viewportSize;
+}
+
+void TiledRasterizer::setViewportSize( const Vector2i& viewportSize )
+{
+    m_viewportSize = viewportSize;
+    m_numBins =
+    {
+        ( std::max( viewportSize.x, 0 ) + m_binSize - 1 ) / m_binSize,
+        ( std::max( viewportSize.y, 0 ) + m_binSize - 1 ) / m_binSize
+    };
+}
+
+int TiledRasterizer::binSize() const
+{
+    return m_binSize;
+}
+
+Vector2i TiledRasterizer::numBins() const
+{
+    return m_numBins;
+}
+
+RasterMode TiledRasterizer::mode() const
+{
+    return m_mode;
+}
+
+void TiledRasterizer::setMode( RasterMode mode )
+{
+    m_mode = mode;
+}
+
+void TiledRasterizer::binTriangles( Array1DReadView< Vector2f > positions,
+    Array1DReadView< Vector3i > triangles )
+{
+    int nTriangles = static_cast< int >( triangles.size() );
+    int nBins = m_numBins.x * m_numBins.y;
+
+    // Each chunk of consecutive triangles counts, then writes, its own
+    // references: concatenating the chunks bin by bin keeps triangles in
+    // order.
+    ThreadPool& pool = ThreadPool::global();
+    int nChunks = std::min( nTriangles, 8 * pool.numThreads() );
+    auto chunkBegin = [&]( int c )
+    {
+        return static_cast< int >(
+            static_cast< int64_t >( nTriangles ) * c / nChunks );
+    };
+
+    // The range of bins [ bx0, bx1 ] x [ by0, by1 ] that triangle t
+    // overlaps, or false if none. Uses float bounds padded by a pixel to
+    // cover snapping, rather than snapTriangle(): a triangle may land in a
+    // bin it does not cover, but setupTriangle() then rejects it.
+    float pad = ( m_mode == RasterMode::CONSERVATIVE ) ? 1.5f : 1.0f;
+    auto binRange = [&]( int t, Vector2i& binMin, Vector2i& binMax )
+    {
+        const Vector3i& vertexIndices = triangles[ t ];
+        const Vector2f& v0 = positions[ vertexIndices[ 0 ] ];
+        const Vector2f& v1 = positions[ vertexIndices[ 1 ] ];
+        const Vector2f& v2 = positions[ vertexIndices[ 2 ] ];
+        float minX = std::min( { v0.x, v1.x, v2.x } ) - pad;
+        float maxX = std::max( { v0.x, v1.x, v2.x } ) + pad;
+        float minY = std::min( { v0.y, v1.y, v2.y } ) - pad;
+        float maxY = std::max( { v0.y, v1.y, v2.y } ) + pad;
+
+        // Written so that NaNs fail too.
+        if( !( minX < m_viewportSize.x && maxX > 0 &&
+            minY < m_viewportSize.y && maxY > 0 ) )
+        {
+            return false;
+        }
+
+        int x0 = static_cast< int >( std::floor( std::max( minX, 0.0f ) ) );
+        int x1 = static_cast< int >( std::ceil(
+            std::min( maxX, static_cast< float >( m_viewportSize.x ) ) ) );
+        int y0 = static_cast< int >( std::floor( std::max( minY, 0.0f ) ) );
+        int y1 = static_cast< int >( std::ceil(
+            std::min( maxY, static_cast< float >( m_viewportSize.y ) ) ) );
+        binMin = { x0 / m_binSize, y0 / m_binSize };
+        binMax = { ( x1 - 1 ) / m_binSize, ( y1 - 1 ) / m_binSize };
+        return true;
+    };
+
+    m_chunkBinCounts.assign( static_cast< size_t >( nChunks ) * nBins, 0 );
+    pool.parallelFor( 0, nChunks, 1,
+        [&]( int begin, int end )
+        {
+            for( int c = begin; c < end; ++c )
+            {
+                int* counts = m_chunkBinCounts.data() +
+                    static_cast< size_t >( c ) * nBins;
+                for( int t = chunkBegin( c ); t < chunkBegin( c + 1 ); ++t )
+                {
+                    Vector2i binMin;
+                    Vector2i binMax;
+                    if( binRange( t, binMin, binMax ) )
+                    {
+                        for( int by = binMin.y; by <= binMax.y; ++by )
+                        {
+                            for( int bx = binMin.x; bx <= binMax.x; ++bx )
+                            {
+                                ++counts[ by * m_numBins.x + bx ];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    );
+
+    // Turn the counts into each chunk's write cursor in each bin.
+    m_binOffsets.resize( nBins + 1 );
+    int nReferences = 0;
+    for( int b = 0; b < nBins; ++b )
+    {
+        m_binOffsets[ b ] = nReferences;
+        for( int c = 0; c < nChunks; ++c )
+        {
+            int& count = m_chunkBinCounts[ static_cast< size_t >( c ) * nBins + b ];
+            int n = count;
+            count = nReferences;
+            nReferences += n;
+        }
+    }
+    m_binOffsets[ nBins ] = nReferences;
+
+    m_binTriangles.resize( nReferences );
+    pool.parallelFor( 0, nChunks, 1,
+        [&]( int begin, int end )
+        {
+            for( int c = begin; c < end; ++c )
+            {
+                int* cursors = m_chunkBinCounts.data() +
+                    static_cast< size_t >( c ) * nBins;
+                for( int t = chunkBegin( c ); t < chunkBegin( c + 1 ); ++t )
+                {
+                    Vector2i binMin;
+                    Vector2i binMax;
+                    if( binRange( t, binMin, binMax ) )
+                    {
+                        for( int by = binMin.y; by <= binMax.y; ++by )
+                        {
+                            for( int bx = binMin.x; bx <= binMax.x; ++bx )
+                            {
+                                m_binTriangles[
+                                    cursors[ by * m_numBins.x + bx ]++ ] = t;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    );
+}
+
+Rect2i TiledRasterizer::binRect( int binIndex ) const
+{
+    Vector2i origin
+    {
+        ( binIndex % m_numBins.x ) * m_binSize,
+        ( binIndex / m_numBins.x ) * m_binSize
+    };
+    Vector2i size
+    {
+        std::min( m_binSize, m_viewportSize.x - origin.x ),
+        std::min( m_binSize, m_viewportSize.y - origin.y )
+    };
+    return Rect2i( origin, size );
+}
+
+} } } // geometry, core, libcgt
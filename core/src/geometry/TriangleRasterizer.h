@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <common/ArrayView.h>
+#include <vecmath/Rect2i.h>
+#include <vecmath/Vector2f.h>
+#include <vecmath/Vector2i.h>
+#include <vecmath/Vector3i.h>
+
+namespace libcgt { namespace core { namespace geometry {
+
+// A half-space triangle rasterizer.
+//
+// Pixel (x, y) is centered at ( x + 0.5, y + 0.5 ). Vertices are snapped to
+// 1 / 2^RASTER_SUBPIXEL_BITS of a pixel, and the edge functions are evaluated
+// exactly in 64-bit integers, so triangles sharing an edge never both cover,
+// nor both miss, a pixel on it (the top-left fill rule). Both windings are
+// rasterized: cull before rasterizing if needed.
+//
+// The bounding box is walked in aligned 8x8 tiles. Tiles entirely outside an
+// edge are skipped and tiles entirely inside all three are filled without
+// per-pixel tests. Pixels in the remaining tiles are tested several at a time
+// (SSE2 or NEON when available).
+//
+// Coverage is delivered as spans: func( y, xBegin, xEnd ) is called for each
+// run of covered pixels [ xBegin, xEnd ) on row y. Each row gets at most one
+// call per triangle.
+
+// Vertices are snapped to 1 / 256 of a pixel.
+const int RASTER_SUBPIXEL_BITS = 8;
+
+// Vertices must be within this many pixels of the origin. Triangles with any
+// vertex farther away, or that is not finite, are not rasterized (clip them
+// first).
+const float MAX_RASTER_COORDINATE = static_cast< float >( 1 << 21 );
+
+// The size of the tiles used for rejection and trivial acceptance.
+const int RASTER_TILE_SIZE = 8;
+
+enum class RasterMode
+{
+    // Pixels whose centers are inside the triangle, with the top-left fill
+    // rule.
+    CENTER,
+
+    // Pixels whose square touches the triangle. Neighboring triangles
+    // overlap.
+    CONSERVATIVE
+};
+
+// A triangle set up for rasterization: three edge functions in fixed point
+// and its pixel bounds.
+struct RasterTriangle
+{
+    // Edge function i at the center of pixel (x, y) is:
+    //   e0[ i ] + x * dx[ i ] + y * dy[ i ]
+    // and the pixel is covered if it is >= 0 for all three edges.
+    int64_t e0[ 3 ];
+    int64_t dx[ 3 ];
+    int64_t dy[ 3 ];
+
+    // Pixels that can be covered: [ x0, x1 ) x [ y0, y1 ).
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+// Sets up the triangle ( v0, v1, v2 ), in pixel coordinates, to cover only
+// pixels inside clipRect.
+// Returns false if it has no area, cannot cover any pixel in clipRect, or
+// has a vertex that is not finite or beyond MAX_RASTER_COORDINATE.
+bool setupTriangle( const Vector2f& v0, const Vector2f& v1,
+    const Vector2f& v2, const Rect2i& clipRect, RasterTriangle& triangle,
+    RasterMode mode = RasterMode::CENTER );
+
+// Coverage of the 8x8 tile with top left pixel (x, y), which must be a
+// multiple of RASTER_TILE_SIZE: bit i of rowMasks[ j ] is set if pixel
+// ( x + i, y + j ) is covered. Pixels outside the triangle's bounds are not
+// covered.
+// Returns false if the tile is empty.
+bool tileCoverage( const RasterTriangle& triangle, int x, int y,
+    uint8_t rowMasks[ RASTER_TILE_SIZE ] );
+
+// Calls func( y, xBegin, xEnd ) for each span of pixels covered by triangle.
+template< typename SpanFunc >
+void rasterizeTriangle( const RasterTriangle& triangle, SpanFunc func );
+
+// Calls func( y, xBegin, xEnd ) for each span of pixels in clipRect covered
+// by the triangle ( v0, v1, v2 ).
+template< typename SpanFunc >
+void rasterizeTriangle( const Vector2f& v0, const Vector2f& v1,
+    const Vector2f& v2, const Rect2i& clipRect, SpanFunc func,
+    RasterMode mode = RasterMode::CENTER );
+
+// Rasterizes batches of triangles in parallel on ThreadPool::global().
+//
+// The viewport is divided into square bins. Triangles are sorted into the
+// bins they overlap, preserving their order, then bins are rasterized in
+// parallel. As a result, a pixel is only ever touched by one thread at a
+// time, and always sees triangles in submission order: a depth or index
+// buffer can be written from the span function without locks, and the result
+// is deterministic.
+//
+// The bin lists are kept between calls to avoid reallocating them.
+class TiledRasterizer
+{
+public:
+
+    // binSize is rounded up to a multiple of RASTER_TILE_SIZE.
+    TiledRasterizer( const Vector2i& viewportSize, int binSize = 64,
+        RasterMode mode = RasterMode::CENTER );
+
+    Vector2i viewportSize() const;
+    void setViewportSize( const Vector2i& viewportSize );
+
+    int binSize() const;
+    Vector2i numBins() const;
+
+    RasterMode mode() const;
+    void setMode( RasterMode mode );
+
+    // Rasterizes every triangle: triangle t has vertices
+    // positions[ triangles[ t ][ 0 ] ], positions[ triangles[ t ][ 1 ] ],
+    // and positions[ triangles[ t ][ 2 ] ], in pixel coordinates.
+    //
+    // Calls func( t, y, xBegin, xEnd ) for each span covered by triangle t.
+    // func is called concurrently, but never for overlapping pixels.
+    template< typename TriangleSpanFunc >
+    void rasterize( Array1DReadView< Vector2f > positions,
+        Array1DReadView< Vector3i > triangles, TriangleSpanFunc func );
+
+private:
+
+    // Sorts triangles into m_binOffsets and m_binTriangles.
+    void binTriangles( Array1DReadView< Vector2f > positions,
+        Array1DReadView< Vector3i > triangles );
+
+    Rect2i binRect( int binIndex ) const;
+
+    Vector2i m_viewportSize;
+    int m_binSize;
+    Vector2i m_numBins;
+    RasterMode m_mode;
+
+    // Triangles overlapping bin b, in order:
+    // m_binTriangles[ m_binOffsets[ b ], m_binOffsets[ b + 1 ] ).
+    std::vector< int > m_binOffsets;
+    std::vector< int > m_binTriangles;
+
+    // Per-chunk bin counts, for binning in parallel.
+    std::vector< int > m_chunkBinCounts;
+};
+
+} } } // geometry, core, libcgt
+
+#include "TriangleRasterizer.inl"
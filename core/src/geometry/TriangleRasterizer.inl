@@ -0,0 +1,131 @@
+#include <algorithm>
+
+#include "concurrency/ThreadPool.h"
+
+namespace libcgt { namespace core { namespace geometry {
+
+template< typename SpanFunc >
+void rasterizeTriangle( const RasterTriangle& triangle, SpanFunc func )
+{
+    const int T = RASTER_TILE_SIZE;
+
+    // Align the tile grid to absolute coordinates (rounding down negatives).
+    int tileX0 = triangle.x0 - ( ( triangle.x0 % T ) + T ) % T;
+    int tileY0 = triangle.y0 - ( ( triangle.y0 % T ) + T ) % T;
+
+    uint8_t rowMasks[ RASTER_TILE_SIZE ];
+    for( int ty = tileY0; ty < triangle.y1; ty += T )
+    {
+        // The left end of the span open on each row of this row of tiles, or
+        // -1. A span is closed at the first uncovered pixel after it.
+        int spanBegin[ RASTER_TILE_SIZE ];
+        std::fill( spanBegin, spanBegin + T, -1 );
+
+        for( int tx = tileX0; tx < triangle.x1; tx += T )
+        {
+            if( !tileCoverage( triangle, tx, ty, rowMasks ) )
+            {
+                std::fill( rowMasks, rowMasks + T, uint8_t( 0 ) );
+            }
+
+            // The triangle is convex, so each row mask is a single run of
+            // bits [ first, last ), and a span continues into the next tile
+            // only if it reaches the right end of this one.
+            for( int j = 0; j < T; ++j )
+            {
+                unsigned int mask = rowMasks[ j ];
+                if( mask == 0 )
+                {
+                    if( spanBegin[ j ] != -1 )
+                    {
+                        func( ty + j, spanBegin[ j ], tx );
+                        spanBegin[ j ] = -1;
+                    }
+                    continue;
+                }
+
+                int first = 0;
+                while( ( ( mask >> first ) & 1 ) == 0 )
+                {
+                    ++first;
+                }
+                int last = first + 1;
+                while( last < T && ( ( mask >> last ) & 1 ) != 0 )
+                {
+                    ++last;
+                }
+
+                if( spanBegin[ j ] == -1 )
+                {
+                    spanBegin[ j ] = tx + first;
+                }
+                if( last < T )
+                {
+                    func( ty + j, spanBegin[ j ], tx + last );
+                    spanBegin[ j ] = -1;
+                }
+            }
+        }
+
+        // Close the spans that reach the right edge of the bounds.
+        for( int j = 0; j < T; ++j )
+        {
+            if( spanBegin[ j ] != -1 )
+            {
+                func( ty + j, spanBegin[ j ], triangle.x1 );
+            }
+        }
+    }
+}
+
+template< typename SpanFunc >
+void rasterizeTriangle( const Vector2f& v0, const Vector2f& v1,
+    const Vector2f& v2, const Rect2i& clipRect, SpanFunc func,
+    RasterMode mode )
+{
+    RasterTriangle triangle;
+    if( setupTriangle( v0, v1, v2, clipRect, triangle, mode ) )
+    {
+        rasterizeTriangle( triangle, func );
+    }
+}
+
+template< typename TriangleSpanFunc >
+void TiledRasterizer::rasterize( Array1DReadView< Vector2f > positions,
+    Array1DReadView< Vector3i > triangles, TriangleSpanFunc func )
+{
+    binTriangles( positions, triangles );
+
+    int nBins = m_numBins.x * m_numBins.y;
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, nBins, 1,
+        [&]( int begin, int end )
+        {
+            for( int b = begin; b < end; ++b )
+            {
+                Rect2i clipRect = binRect( b );
+                for( int k = m_binOffsets[ b ]; k < m_binOffsets[ b + 1 ];
+                    ++k )
+                {
+                    int t = m_binTriangles[ k ];
+                    const Vector3i& vertexIndices = triangles[ t ];
+
+                    RasterTriangle triangle;
+                    if( setupTriangle( positions[ vertexIndices[ 0 ] ],
+                        positions[ vertexIndices[ 1 ] ],
+                        positions[ vertexIndices[ 2 ] ],
+                        clipRect, triangle, m_mode ) )
+                    {
+                        rasterizeTriangle( triangle,
+                            [&]( int y, int xBegin, int xEnd )
+                            {
+                                func( t, y, xBegin, xEnd );
+                            }
+                        );
+                    }
+                }
+            }
+        }
+    );
+}
+
+} } } // geometry, core, libcgt
@@ -1,70 +1,391 @@
 #include <imageproc/ColorMap.h>
 
+#include <cstring>
+
 #include <common/ArrayUtils.h>
+#include <concurrency/ThreadPool.h>
 #include <geometry/RangeUtils.h>
 #include <imageproc/ColorUtils.h>
 #include <math/MathUtils.h>
 
+#if defined( __SSE2__ ) || defined( _M_X64 )
+#include <emmintrin.h>
+#define LIBCGT_COLORMAP_SSE2
+#elif defined( __ARM_NEON ) && defined( __aarch64__ )
+#include <arm_neon.h>
+#define LIBCGT_COLORMAP_NEON
+#endif
+
+#if defined( LIBCGT_COLORMAP_SSE2 ) || defined( LIBCGT_COLORMAP_NEON )
+#define LIBCGT_COLORMAP_SIMD
+#endif
+
 using libcgt::core::arrayutils::map;
+using libcgt::core::arrayutils::readViewOf;
+using libcgt::core::concurrency::ThreadPool;
 using libcgt::core::math::clamp;
 using libcgt::core::math::fraction;
 using libcgt::core::geometry::rescale;
 
-namespace libcgt { namespace core { namespace imageproc {
+namespace execution = libcgt::core::arrayutils::execution;
+
+namespace
+{
+
+// If the elements of src and dst are packed, calls
+// rowFunc( srcRow, dstRow, width ) on each row in parallel. Otherwise, maps
+// pixelFunc over each pixel in parallel.
+template< typename TSrc, typename TDst, typename RowFunc, typename PixelFunc >
+void mapRows( Array2DReadView< TSrc > src, Array2DWriteView< TDst > dst,
+    const RowFunc& rowFunc, const PixelFunc& pixelFunc )
+{
+    if( src.size() != dst.size() )
+    {
+        return;
+    }
+
+    if( !src.elementsArePacked() || !dst.elementsArePacked() )
+    {
+        map( execution::par, src, dst, pixelFunc );
+        return;
+    }
+
+    ThreadPool::global().parallelFor( 0, src.height(), 0,
+        [&]( int begin, int end )
+        {
+            for( int y = begin; y < end; ++y )
+            {
+                rowFunc( src.rowPointer( y ), dst.rowPointer( y ),
+                    src.width() );
+            }
+        }
+    );
+}
+
+uint8_t remapToLuminance( uint16_t z, const Range1i& srcRange,
+    const Range1i& dstRange )
+{
+    return static_cast< uint8_t >(
+        clamp( rescale( z, srcRange, dstRange ), Range1i( 256 ) ) );
+}
+
+#if defined( LIBCGT_COLORMAP_SIMD )
+
+// Four floats, and the operations the kernels below need. Each matches the
+// scalar code in ColorUtils, lane by lane.
+
+#if defined( LIBCGT_COLORMAP_SSE2 )
+
+typedef __m128 Float4;
+
+inline Float4 set4( float x ) { return _mm_set1_ps( x ); }
+inline Float4 load4( const float* p ) { return _mm_loadu_ps( p ); }
+inline void store4( Float4 v, float* p ) { _mm_storeu_ps( p, v ); }
+inline Float4 add4( Float4 a, Float4 b ) { return _mm_add_ps( a, b ); }
+inline Float4 sub4( Float4 a, Float4 b ) { return _mm_sub_ps( a, b ); }
+inline Float4 mul4( Float4 a, Float4 b ) { return _mm_mul_ps( a, b ); }
+inline Float4 div4( Float4 a, Float4 b ) { return _mm_div_ps( a, b ); }
+inline Float4 min4( Float4 a, Float4 b ) { return _mm_min_ps( a, b ); }
+inline Float4 max4( Float4 a, Float4 b ) { return _mm_max_ps( a, b ); }
+
+// toUInt8() of each lane, as 32-bit integers.
+inline __m128i toUInt8Lanes( Float4 x )
+{
+    return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( x, set4( 255.0f ) ),
+        set4( 0.5f ) ) );
+}
+
+// Writes toUInt8() of the four lanes to dst[ 0, 4 ).
+inline void storeUInt8( Float4 x, uint8_t* dst )
+{
+    __m128i i16 = _mm_packs_epi32( toUInt8Lanes( x ), _mm_setzero_si128() );
+    int bytes = _mm_cvtsi128_si32( _mm_packus_epi16( i16, i16 ) );
+    std::memcpy( dst, &bytes, sizeof( bytes ) );
+}
+
+// Writes four pixels: dst[ i ] = toUInt8( ( r[ i ], g[ i ], b[ i ], a[ i ] ) ).
+inline void storeUInt8x4( Float4 r, Float4 g, Float4 b, Float4 a,
+    uint8x4* dst )
+{
+    __m128i rgba = _mm_or_si128(
+        _mm_or_si128( toUInt8Lanes( r ),
+            _mm_slli_epi32( toUInt8Lanes( g ), 8 ) ),
+        _mm_or_si128( _mm_slli_epi32( toUInt8Lanes( b ), 16 ),
+            _mm_slli_epi32( toUInt8Lanes( a ), 24 ) ) );
+    _mm_storeu_si128( reinterpret_cast< __m128i* >( dst ), rgba );
+}
+
+// Writes four pixels: dst[ i ] = ( r[ i ], g[ i ], b[ i ], a[ i ] ).
+inline void storeVector4f( Float4 r, Float4 g, Float4 b, Float4 a,
+    Vector4f* dst )
+{
+    _MM_TRANSPOSE4_PS( r, g, b, a );
+    float* p = reinterpret_cast< float* >( dst );
+    _mm_storeu_ps( p, r );
+    _mm_storeu_ps( p + 4, g );
+    _mm_storeu_ps( p + 8, b );
+    _mm_storeu_ps( p + 12, a );
+}
+
+// The body of normalsToRGBA() on one pixel.
+inline Float4 normalToRGBA4( Float4 normal )
+{
+    const Float4 xyzMask = _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) );
+    Float4 rgb = _mm_add_ps( _mm_mul_ps( set4( 0.5f ), normal ),
+        set4( 0.5f ) );
+    Float4 rgba = _mm_or_ps( _mm_and_ps( xyzMask, rgb ),
+        _mm_andnot_ps( xyzMask, set4( 1.0f ) ) );
+    Float4 valid = _mm_cmpgt_ps( normal, _mm_setzero_ps() );
+    valid = _mm_shuffle_ps( valid, valid, _MM_SHUFFLE( 3, 3, 3, 3 ) );
+    return _mm_and_ps( valid, rgba );
+}
+
+#elif defined( LIBCGT_COLORMAP_NEON )
 
-// TODO: u8_sat()
+typedef float32x4_t Float4;
+
+inline Float4 set4( float x ) { return vdupq_n_f32( x ); }
+inline Float4 load4( const float* p ) { return vld1q_f32( p ); }
+inline void store4( Float4 v, float* p ) { vst1q_f32( p, v ); }
+inline Float4 add4( Float4 a, Float4 b ) { return vaddq_f32( a, b ); }
+inline Float4 sub4( Float4 a, Float4 b ) { return vsubq_f32( a, b ); }
+inline Float4 mul4( Float4 a, Float4 b ) { return vmulq_f32( a, b ); }
+inline Float4 div4( Float4 a, Float4 b ) { return vdivq_f32( a, b ); }
+inline Float4 min4( Float4 a, Float4 b ) { return vminq_f32( a, b ); }
+inline Float4 max4( Float4 a, Float4 b ) { return vmaxq_f32( a, b ); }
+
+// toUInt8() of each lane, as 32-bit integers.
+inline uint32x4_t toUInt8Lanes( Float4 x )
+{
+    return vcvtq_u32_f32( vaddq_f32( vmulq_f32( x, set4( 255.0f ) ),
+        set4( 0.5f ) ) );
+}
+
+// Writes toUInt8() of the four lanes to dst[ 0, 4 ).
+inline void storeUInt8( Float4 x, uint8_t* dst )
+{
+    uint16x4_t i16 = vqmovn_u32( toUInt8Lanes( x ) );
+    uint8x8_t i8 = vqmovn_u16( vcombine_u16( i16, i16 ) );
+    uint32_t bytes = vget_lane_u32( vreinterpret_u32_u8( i8 ), 0 );
+    std::memcpy( dst, &bytes, sizeof( bytes ) );
+}
+
+// Writes four pixels: dst[ i ] = toUInt8( ( r[ i ], g[ i ], b[ i ], a[ i ] ) ).
+inline void storeUInt8x4( Float4 r, Float4 g, Float4 b, Float4 a,
+    uint8x4* dst )
+{
+    uint32x4_t rgba = vorrq_u32(
+        vorrq_u32( toUInt8Lanes( r ), vshlq_n_u32( toUInt8Lanes( g ), 8 ) ),
+        vorrq_u32( vshlq_n_u32( toUInt8Lanes( b ), 16 ),
+            vshlq_n_u32( toUInt8Lanes( a ), 24 ) ) );
+    vst1q_u32( reinterpret_cast< uint32_t* >( dst ), rgba );
+}
+
+// Writes four pixels: dst[ i ] = ( r[ i ], g[ i ], b[ i ], a[ i ] ).
+inline void storeVector4f( Float4 r, Float4 g, Float4 b, Float4 a,
+    Vector4f* dst )
+{
+    float32x4x4_t rgba = { { r, g, b, a } };
+    vst4q_f32( reinterpret_cast< float* >( dst ), rgba );
+}
+
+// The body of normalsToRGBA() on one pixel.
+inline Float4 normalToRGBA4( Float4 normal )
+{
+    const uint32_t xyzMaskBits[ 4 ] = { ~0u, ~0u, ~0u, 0u };
+    Float4 rgb = vaddq_f32( vmulq_f32( set4( 0.5f ), normal ), set4( 0.5f ) );
+    Float4 rgba = vbslq_f32( vld1q_u32( xyzMaskBits ), rgb, set4( 1.0f ) );
+    uint32x4_t valid = vcgtq_f32( vdupq_laneq_f32( normal, 3 ), set4( 0 ) );
+    return vreinterpretq_f32_u32(
+        vandq_u32( valid, vreinterpretq_u32_f32( rgba ) ) );
+}
+
+#endif
+
+// saturate() of each lane. NaNs become 0 on SSE2.
+inline Float4 saturate4( Float4 x )
+{
+    return min4( max4( x, set4( 0.0f ) ), set4( 1.0f ) );
+}
+
+// fraction( x, range ) of each lane.
+inline Float4 fraction4( Float4 x, const Range1f& range )
+{
+    return div4( sub4( x, set4( range.origin ) ), set4( range.size ) );
+}
+
+// rescale( x, src, dst ) of each lane.
+inline Float4 rescale4( Float4 x, const Range1f& src, const Range1f& dst )
+{
+    return add4( set4( dst.origin ), mul4( fraction4( x, src ),
+        set4( dst.size ) ) );
+}
+
+// jet( x ) of each lane, for x in [0, 1]. Alpha is 1.
+inline void jet4( Float4 x, Float4& r, Float4& g, Float4& b )
+{
+    Float4 fourX = mul4( set4( 4.0f ), x );
+    r = saturate4( min4( sub4( fourX, set4( 1.5f ) ),
+        sub4( set4( 4.5f ), fourX ) ) );
+    g = saturate4( min4( sub4( fourX, set4( 0.5f ) ),
+        sub4( set4( 3.5f ), fourX ) ) );
+    b = saturate4( min4( add4( fourX, set4( 0.5f ) ),
+        sub4( set4( 2.5f ), fourX ) ) );
+}
+
+#endif
+
+}
+
+namespace libcgt { namespace core { namespace imageproc {
 
 void jet( Array2DReadView< float > src, const Range1f& srcRange,
     Array2DWriteView< uint8x4 > dst )
 {
-    map( src, dst,
-        [&] ( float z )
+    auto f = [&] ( float z )
+    {
+        z = saturate( fraction( z, srcRange ) );
+        return toUInt8( jet( z ) );
+    };
+    mapRows( src, dst,
+        [&]( const float* srcRow, uint8x4* dstRow, int width )
         {
-            z = saturate( fraction( z, srcRange ) );
-            return toUInt8( jet( z ) );
-        }
+            int x = 0;
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( ; x + 4 <= width; x += 4 )
+            {
+                Float4 r;
+                Float4 g;
+                Float4 b;
+                jet4( saturate4( fraction4( load4( srcRow + x ), srcRange ) ),
+                    r, g, b );
+                storeUInt8x4( r, g, b, set4( 1.0f ), dstRow + x );
+            }
+#endif
+            for( ; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+        },
+        f
     );
 }
 
 void jet( Array2DReadView< float > src, const Range1f& srcRange,
     Array2DWriteView< Vector4f > dst )
 {
-    map( src, dst,
-        [&] ( float z ) { return jet( saturate( fraction( z, srcRange ) ) ); }
+    auto f = [&] ( float z )
+    {
+        return jet( saturate( fraction( z, srcRange ) ) );
+    };
+    mapRows( src, dst,
+        [&]( const float* srcRow, Vector4f* dstRow, int width )
+        {
+            int x = 0;
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( ; x + 4 <= width; x += 4 )
+            {
+                Float4 r;
+                Float4 g;
+                Float4 b;
+                jet4( saturate4( fraction4( load4( srcRow + x ), srcRange ) ),
+                    r, g, b );
+                storeVector4f( r, g, b, set4( 1.0f ), dstRow + x );
+            }
+#endif
+            for( ; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+        },
+        f
     );
 }
 
+void jet( Array2DReadView< uint16_t > src, const Range1i& srcRange,
+    Array2DWriteView< uint8x4 > dst )
+{
+    if( src.numElements() > LUT16_SIZE )
+    {
+        std::vector< uint8x4 > lut = jetLUT( srcRange );
+        applyLUT( src, readViewOf( lut ), dst );
+    }
+    else
+    {
+        map( execution::par, src, dst,
+            [&] ( uint16_t z )
+            {
+                return toUInt8( jet( saturate( fraction( z, srcRange ) ) ) );
+            }
+        );
+    }
+}
+
 void normalsToRGBA( Array2DReadView< Vector4f > src,
     Array2DWriteView< uint8x4 > dst )
 {
-    map( src, dst,
-        [&] ( const Vector4f& normal )
+    auto f = [&] ( const Vector4f& normal )
+    {
+        Vector4f rgba;
+        if( normal.w > 0 )
+        {
+            rgba.xyz = 0.5f * ( normal.xyz + Vector3f{ 1, 1, 1 } );
+            rgba.w = 1;
+        }
+        return toUInt8( rgba );
+    };
+    mapRows( src, dst,
+        [&]( const Vector4f* srcRow, uint8x4* dstRow, int width )
         {
-            Vector4f rgba;
-            if( normal.w > 0 )
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( int x = 0; x < width; ++x )
             {
-                rgba.xyz = 0.5f * ( normal.xyz + Vector3f{ 1, 1, 1 } );
-                rgba.w = 1;
+                storeUInt8( normalToRGBA4( load4(
+                    reinterpret_cast< const float* >( srcRow + x ) ) ),
+                    reinterpret_cast< uint8_t* >( dstRow + x ) );
             }
-            return toUInt8( rgba );
-        }
+#else
+            for( int x = 0; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+#endif
+        },
+        f
     );
 }
 
 void normalsToRGBA( Array2DReadView< Vector4f > src,
     Array2DWriteView< Vector4f > dst )
 {
-    map( src, dst,
-        [&] ( const Vector4f& normal )
+    auto f = [&] ( const Vector4f& normal )
+    {
+        Vector4f rgba;
+        if( normal.w > 0 )
+        {
+            rgba.xyz = 0.5f * ( normal.xyz + Vector3f{ 1, 1, 1 } );
+            rgba.w = 1;
+        }
+        return rgba;
+    };
+    mapRows( src, dst,
+        [&]( const Vector4f* srcRow, Vector4f* dstRow, int width )
         {
-            Vector4f rgba;
-            if( normal.w > 0 )
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( int x = 0; x < width; ++x )
             {
-                rgba.xyz = 0.5f * ( normal.xyz + Vector3f{ 1, 1, 1 } );
-                rgba.w = 1;
+                store4( normalToRGBA4( load4(
+                    reinterpret_cast< const float* >( srcRow + x ) ) ),
+                    reinterpret_cast< float* >( dstRow + x ) );
             }
-            return rgba;
-        }
+#else
+            for( int x = 0; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+#endif
+        },
+        f
     );
 }
 
@@ -72,46 +393,85 @@ void rgbToLuminance( Array2DReadView< uint8x3 > src,
     Array2DWriteView< uint8_t > dst )
 {
     uint8_t ( *f )( uint8x3 ) = &rgbToLuminance;
-    map( src, dst, f );
+    map( execution::par, src, dst, f );
 }
 
 void linearRemapToLuminance( Array2DReadView< uint16_t > src,
     const Range1i& srcRange, const Range1i& dstRange,
     Array2DWriteView< uint8_t > dst )
 {
-    map( src, dst,
-        [&] ( uint16_t z )
-        {
-            return static_cast< uint8_t >(
-                clamp( rescale( z, srcRange, dstRange ), Range1i( 256 ) ) );
-        }
-    );
+    if( src.numElements() > LUT16_SIZE )
+    {
+        std::vector< uint8_t > lut =
+            linearRemapToLuminanceLUT( srcRange, dstRange );
+        applyLUT( src, readViewOf( lut ), dst );
+    }
+    else
+    {
+        map( execution::par, src, dst,
+            [&] ( uint16_t z )
+            {
+                return remapToLuminance( z, srcRange, dstRange );
+            }
+        );
+    }
 }
 
 void linearRemapToLuminance( Array2DReadView< uint16_t > src,
     const Range1i& srcRange, const Range1i& dstRange,
     Array2DWriteView< uint8x3 > dst )
 {
-    map( src, dst,
-        [&] ( uint16_t z )
-        {
-            uint8_t luma = static_cast< uint8_t >(
-                clamp( rescale( z, srcRange, dstRange ), Range1i( 256 ) ) );
-            return uint8x3{ luma, luma, luma };
-        }
-    );
+    if( src.numElements() > LUT16_SIZE )
+    {
+        std::vector< uint8_t > lut =
+            linearRemapToLuminanceLUT( srcRange, dstRange );
+        map( execution::par, src, dst,
+            [&] ( uint16_t z )
+            {
+                uint8_t luma = lut[ z ];
+                return uint8x3{ luma, luma, luma };
+            }
+        );
+    }
+    else
+    {
+        map( execution::par, src, dst,
+            [&] ( uint16_t z )
+            {
+                uint8_t luma = remapToLuminance( z, srcRange, dstRange );
+                return uint8x3{ luma, luma, luma };
+            }
+        );
+    }
 }
 
 void linearRemapToLuminance( Array2DReadView< float > src,
     const Range1f& srcRange, const Range1f& dstRange,
     Array2DWriteView< uint8_t > dst )
 {
-    map( src, dst,
-        [&] ( float z )
+    auto f = [&] ( float z )
+    {
+        float luma = saturate( rescale( z, srcRange, dstRange ) );
+        return toUInt8( luma );
+    };
+    mapRows( src, dst,
+        [&]( const float* srcRow, uint8_t* dstRow, int width )
         {
-            float luma = saturate( rescale( z, srcRange, dstRange ) );
-            return toUInt8( luma );
-        }
+            int x = 0;
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( ; x + 4 <= width; x += 4 )
+            {
+                Float4 luma = saturate4( rescale4( load4( srcRow + x ),
+                    srcRange, dstRange ) );
+                storeUInt8( luma, dstRow + x );
+            }
+#endif
+            for( ; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+        },
+        f
     );
 }
 
@@ -119,27 +479,58 @@ void linearRemapToLuminance( Array2DReadView< uint16_t > src,
     const Range1i& srcRange, const Range1i& dstRange,
     uint8_t dstAlpha, Array2DWriteView< uint8x4 > dst )
 {
-    map( src, dst,
-        [&] ( uint16_t z )
-        {
-            uint8_t luma = static_cast< uint8_t >(
-                clamp( rescale( z, srcRange, dstRange ), Range1i( 256 ) ) );
-            return uint8x4{ luma, luma, luma, dstAlpha };
-        }
-    );
+    if( src.numElements() > LUT16_SIZE )
+    {
+        std::vector< uint8_t > lut =
+            linearRemapToLuminanceLUT( srcRange, dstRange );
+        map( execution::par, src, dst,
+            [&] ( uint16_t z )
+            {
+                uint8_t luma = lut[ z ];
+                return uint8x4{ luma, luma, luma, dstAlpha };
+            }
+        );
+    }
+    else
+    {
+        map( execution::par, src, dst,
+            [&] ( uint16_t z )
+            {
+                uint8_t luma = remapToLuminance( z, srcRange, dstRange );
+                return uint8x4{ luma, luma, luma, dstAlpha };
+            }
+        );
+    }
 }
 
 void linearRemapToLuminance( Array2DReadView< float > src,
     const Range1f& srcRange, const Range1f& dstRange,
     Array2DWriteView< uint8x4 > dst )
 {
-    map( src, dst,
-        [&] ( float z )
+    auto f = [&] ( float z )
+    {
+        float luma = saturate( rescale( z, srcRange, dstRange ) );
+        Vector4f rgba( luma, luma, luma, 1.0f );
+        return toUInt8( rgba );
+    };
+    mapRows( src, dst,
+        [&]( const float* srcRow, uint8x4* dstRow, int width )
         {
-            float luma = saturate( rescale( z, srcRange, dstRange ) );
-            Vector4f rgba( luma, luma, luma, 1.0f );
-            return toUInt8( rgba );
-        }
+            int x = 0;
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( ; x + 4 <= width; x += 4 )
+            {
+                Float4 luma = saturate4( rescale4( load4( srcRow + x ),
+                    srcRange, dstRange ) );
+                storeUInt8x4( luma, luma, luma, set4( 1.0f ), dstRow + x );
+            }
+#endif
+            for( ; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+        },
+        f
     );
 }
 
@@ -147,12 +538,28 @@ void linearRemapToLuminance( Array2DReadView< float > src,
     const Range1f& srcRange, const Range1f& dstRange,
     Array2DWriteView< float > dst )
 {
-    map( src, dst,
-        [&] ( float z )
+    auto f = [&] ( float z )
+    {
+        float luma = saturate( rescale( z, srcRange, dstRange ) );
+        return luma;
+    };
+    mapRows( src, dst,
+        [&]( const float* srcRow, float* dstRow, int width )
         {
-            float luma = saturate( rescale( z, srcRange, dstRange ) );
-            return luma;
-        }
+            int x = 0;
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( ; x + 4 <= width; x += 4 )
+            {
+                store4( saturate4( rescale4( load4( srcRow + x ),
+                    srcRange, dstRange ) ), dstRow + x );
+            }
+#endif
+            for( ; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+        },
+        f
     );
 }
 
@@ -160,14 +567,91 @@ void linearRemapToLuminance( Array2DReadView< float > src,
     const Range1f& srcRange, const Range1f& dstRange,
     Array2DWriteView< Vector4f > dst )
 {
-    map( src, dst,
-        [&] ( float z )
+    auto f = [&] ( float z )
+    {
+        float luma = saturate( rescale( z, srcRange, dstRange ) );
+        Vector4f rgba( luma, luma, luma, 1.0f );
+        return rgba;
+    };
+    mapRows( src, dst,
+        [&]( const float* srcRow, Vector4f* dstRow, int width )
         {
-            float luma = saturate( rescale( z, srcRange, dstRange ) );
-            Vector4f rgba( luma, luma, luma, 1.0f );
-            return rgba;
+            int x = 0;
+#if defined( LIBCGT_COLORMAP_SIMD )
+            for( ; x + 4 <= width; x += 4 )
+            {
+                Float4 luma = saturate4( rescale4( load4( srcRow + x ),
+                    srcRange, dstRange ) );
+                storeVector4f( luma, luma, luma, set4( 1.0f ), dstRow + x );
+            }
+#endif
+            for( ; x < width; ++x )
+            {
+                dstRow[ x ] = f( srcRow[ x ] );
+            }
+        },
+        f
+    );
+}
+
+std::vector< uint8x4 > jetLUT( const Range1i& srcRange )
+{
+    std::vector< uint8x4 > lut( LUT16_SIZE );
+    ThreadPool::global().parallelFor( 0, LUT16_SIZE, 0,
+        [&]( int begin, int end )
+        {
+            for( int z = begin; z < end; ++z )
+            {
+                lut[ z ] = toUInt8( jet( saturate( fraction( z, srcRange ) ) ) );
+            }
         }
     );
+    return lut;
+}
+
+std::vector< uint8_t > linearRemapToLuminanceLUT( const Range1i& srcRange,
+    const Range1i& dstRange )
+{
+    std::vector< uint8_t > lut( LUT16_SIZE );
+    for( int z = 0; z < LUT16_SIZE; ++z )
+    {
+        lut[ z ] = remapToLuminance( static_cast< uint16_t >( z ), srcRange,
+            dstRange );
+    }
+    return lut;
+}
+
+bool applyLUT( Array2DReadView< uint16_t > src,
+    Array1DReadView< uint8_t > lut, Array2DWriteView< uint8_t > dst )
+{
+    if( lut.size() != LUT16_SIZE )
+    {
+        return false;
+    }
+    return map( execution::par, src, dst,
+        [&] ( uint16_t z ) { return lut[ z ]; } );
+}
+
+bool applyLUT( Array2DReadView< uint16_t > src,
+    Array1DReadView< uint8x3 > lut, Array2DWriteView< uint8x3 > dst )
+{
+    if( lut.size() != LUT16_SIZE )
+    {
+        return false;
+    }
+    return map( execution::par, src, dst,
+        [&] ( uint16_t z ) { return lut[ z ]; } );
+}
+
+bool applyLUT( Array2DReadView< uint16_t > src,
+    Array1DReadView< uint8x4 > lut, Array2DWriteView< uint8x4 > dst )
+{
+    if( lut.size() != LUT16_SIZE )
+    {
+        return false;
+    }
+    return map( execution::par, src, dst,
+        [&] ( uint16_t z ) { return lut[ z ]; } );
 }
 
 } } } // imageproc, core, libcgt
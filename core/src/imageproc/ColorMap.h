@@ -1,12 +1,23 @@
 #pragma once
 
+#include <vector>
+
 #include <common/BasicTypes.h>
 #include <common/ArrayView.h>
 #include <vecmath/Range1f.h>
+#include <vecmath/Range1i.h>
 #include <vecmath/Vector4f.h>
 
 namespace libcgt { namespace core { namespace imageproc {
 
+// The functions below run in parallel on ThreadPool::global(). When the
+// elements of src and dst are packed, rows are processed four pixels at a
+// time with SSE2 or NEON, and give the same results as the per-pixel
+// functions in ColorUtils.
+//
+// Functions on uint16_t images with more pixels than there are uint16_t
+// values use a lookup table (see below).
+
 // Given an input array "src", clamp each pixel to "srcRange", then maps it to
 // and maps it to the MATLAB "jet" pattern.
 void jet( Array2DReadView< float > src, const Range1f& srcRange,
@@ -17,6 +28,11 @@ void jet( Array2DReadView< float > src, const Range1f& srcRange,
 void jet( Array2DReadView< float > src, const Range1f& srcRange,
     Array2DWriteView< Vector4f > dst );
 
+// Given an input array "src", clamp each pixel to "srcRange", then map it to
+// the MATLAB "jet" pattern.
+void jet( Array2DReadView< uint16_t > src, const Range1i& srcRange,
+    Array2DWriteView< uint8x4 > dst );
+
 // Given an input array "src" of unit normals (where w = 0 means invalid), maps
 // it to RGB = 0.5 * (normal + (1, 1, 1)). dst.alpha = src.w.
 void normalsToRGBA( Array2DReadView< Vector4f > src,
@@ -72,4 +88,30 @@ void linearRemapToLuminance( Array2DReadView< float > src,
     const Range1f& srcRange, const Range1f& dstRange,
     Array2DWriteView< Vector4f > dst );
 
+// ----- Lookup tables for uint16_t images -----
+// A table has one entry for every uint16_t value: dst = lut[ src ] is one
+// load per pixel. For a 16-bit depth stream, build the table once per range
+// and apply it to every frame.
+
+const int LUT16_SIZE = 65536;
+
+// lut[ z ] is the "jet" color of z, clamped to srcRange.
+std::vector< uint8x4 > jetLUT( const Range1i& srcRange );
+
+// lut[ z ] is z remapped from srcRange to dstRange, clamped to [0, 255].
+std::vector< uint8_t > linearRemapToLuminanceLUT( const Range1i& srcRange,
+    const Range1i& dstRange );
+
+// dst[ xy ] = lut[ src[ xy ] ].
+// Returns false if src and dst have different sizes or lut does not have
+// LUT16_SIZE entries.
+bool applyLUT( Array2DReadView< uint16_t > src,
+    Array1DReadView< uint8_t > lut, Array2DWriteView< uint8_t > dst );
+
+bool applyLUT( Array2DReadView< uint16_t > src,
+    Array1DReadView< uint8x3 > lut, Array2DWriteView< uint8x3 > dst );
+
+bool applyLUT( Array2DReadView< uint16_t > src,
+    Array1DReadView< uint8x4 > lut, Array2DWriteView< uint8x4 > dst );
+
 } } } // imageproc, core, libcgt
@@ -27,3 +27,47 @@ bool BinaryFileInputStream::close()
     }
     return false;
 }
+
+int64_t BinaryFileInputStream::tell() const
+{
+    if( m_fp == nullptr )
+    {
+        return -1;
+    }
+#ifdef _WIN32
+    return _ftelli64( m_fp );
+#else
+    return static_cast< int64_t >( ftello( m_fp ) );
+#endif
+}
+
+bool BinaryFileInputStream::seek( int64_t offset )
+{
+    if( m_fp == nullptr || offset < 0 )
+    {
+        return false;
+    }
+#ifdef _WIN32
+    return( _fseeki64( m_fp, offset, SEEK_SET ) == 0 );
+#else
+    return( fseeko( m_fp, static_cast< off_t >( offset ), SEEK_SET ) == 0 );
+#endif
+}
+
+int64_t BinaryFileInputStream::seekToEnd()
+{
+    if( m_fp == nullptr )
+    {
+        return -1;
+    }
+#ifdef _WIN32
+    int status = _fseeki64( m_fp, 0, SEEK_END );
+#else
+    int status = fseeko( m_fp, 0, SEEK_END );
+#endif
+    if( status != 0 )
+    {
+        return -1;
+    }
+    return tell();
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdio>
 
 #include <common/ArrayView.h>
@@ -20,6 +21,18 @@ public:
 
     bool close();
 
+    // Returns the current position in the file, in bytes from the start of
+    // the file, or -1 on error.
+    int64_t tell() const;
+
+    // Seek to "offset" bytes from the start of the file.
+    // Returns true on success.
+    bool seek( int64_t offset );
+
+    // Seek to the end of the file, returning the file's size in bytes,
+    // or -1 on error.
+    int64_t seekToEnd();
+
     // T must be a primitive type or a struct without pointer members.
     // Returns false on error or once end of file is reached.
     template< typename T >
@@ -54,3 +54,16 @@ bool BinaryFileOutputStream::close()
     }
     return false;
 }
+
+int64_t BinaryFileOutputStream::tell() const
+{
+    if( m_fp == nullptr )
+    {
+        return -1;
+    }
+#ifdef _WIN32
+    return _ftelli64( m_fp );
+#else
+    return static_cast< int64_t >( ftello( m_fp ) );
+#endif
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <cstdio>
 
 #include <common/ArrayView.h>
@@ -27,6 +28,10 @@ public:
     // Flush the last write operation.
     bool flush() const;
 
+    // Returns the current position in the file, in bytes from the start of
+    // the file, or -1 on error.
+    int64_t tell() const;
+
     template< typename T >
     bool write( const T& x ) const;
 
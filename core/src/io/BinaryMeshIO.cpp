@@ -0,0 +1,707 @@
+#include "io/BinaryMeshIO.h"
+
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "geometry/TriangleMesh.h"
+#include "io/MemoryMappedFile.h"
+#include "io/OBJData.h"
+
+namespace
+{
+
+const char MAGIC[ 8 ] = { 'L', 'C', 'G', 'T', 'M', 'E', 'S', 'H' };
+
+// Sections start at multiples of this many bytes.
+const uint64_t SECTION_ALIGNMENT = 16;
+
+enum SectionId : uint32_t
+{
+    SOURCE_PATH = 1,
+    STRINGS = 2,
+
+    POSITIONS = 16,
+    TEXTURE_COORDINATES = 17,
+    NORMALS = 18,
+
+    // OBJData: the vertices of face f are
+    // [ FACE_VERTEX_OFFSETS[ f ], FACE_VERTEX_OFFSETS[ f + 1 ] ), in the
+    // faces of every group, in order.
+    FACE_VERTEX_OFFSETS = 32,
+    FACE_POSITION_INDICES = 33,
+    FACE_TEXTURE_COORDINATE_INDICES = 34,
+    FACE_NORMAL_INDICES = 35,
+    FACE_FLAGS = 36,
+    GROUPS = 37,
+    GROUP_MATERIAL_RUNS = 38,
+    MATERIALS = 39,
+
+    // TriangleMesh.
+    TRIANGLES = 48
+};
+
+enum Flags : uint32_t
+{
+    HAS_TEXTURE_COORDINATES = 1,
+    HAS_NORMALS = 2
+};
+
+struct Header
+{
+    char magic[ 8 ];
+    uint32_t version;
+    uint32_t nSections;
+    uint64_t sourceSize;
+    int64_t sourceModificationTime;
+};
+
+struct SectionEntry
+{
+    uint32_t id;
+    uint32_t elementSize;
+    uint64_t offset;
+    uint64_t count;
+};
+
+// A string in the STRINGS section.
+struct StringRef
+{
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct GroupRecord
+{
+    StringRef name;
+    uint32_t flags;
+    uint32_t firstFace;
+    uint32_t nFaces;
+    uint32_t firstRun;
+    uint32_t nRuns;
+    uint32_t padding;
+};
+
+// "nFaces" consecutive faces of a group that use the same material.
+// There is one run per entry in OBJGroup::materialNames(), including ones
+// with no faces.
+struct MaterialRunRecord
+{
+    StringRef materialName;
+    uint32_t nFaces;
+    uint32_t padding;
+};
+
+struct MaterialRecord
+{
+    StringRef name;
+    StringRef ambientTexture;
+    StringRef diffuseTexture;
+    float ambientColor[ 3 ];
+    float diffuseColor[ 3 ];
+    float specularColor[ 3 ];
+    float alpha;
+    float shininess;
+    uint32_t illuminationModel;
+};
+
+static_assert( sizeof( Header ) == 32, "Header must be 32 bytes." );
+static_assert( sizeof( SectionEntry ) == 24,
+    "SectionEntry must be 24 bytes." );
+
+class Writer
+{
+public:
+
+    template< typename T >
+    void addSection( uint32_t id, const std::vector< T >& elements )
+    {
+        addSection( id, sizeof( T ), elements.size(), elements.data() );
+    }
+
+    void addSection( uint32_t id, uint32_t elementSize, uint64_t count,
+        const void* data )
+    {
+        m_sections.push_back( { id, elementSize, 0, count } );
+        m_data.push_back( data );
+    }
+
+    StringRef addString( const std::string& s )
+    {
+        StringRef ref;
+        ref.offset = static_cast< uint32_t >( m_strings.size() );
+        ref.length = static_cast< uint32_t >( s.size() );
+        m_strings.insert( m_strings.end(), s.begin(), s.end() );
+        return ref;
+    }
+
+    bool write( const std::string& filename,
+        const BinaryMeshIO::SourceInfo& source )
+    {
+        addSection( SOURCE_PATH, 1, source.path.size(), source.path.data() );
+        addSection( STRINGS, m_strings );
+
+        Header header;
+        memcpy( header.magic, MAGIC, sizeof( MAGIC ) );
+        header.version = BinaryMeshIO::VERSION;
+        header.nSections = static_cast< uint32_t >( m_sections.size() );
+        header.sourceSize = source.size;
+        header.sourceModificationTime = source.modificationTime;
+
+        uint64_t offset = sizeof( Header ) +
+            m_sections.size() * sizeof( SectionEntry );
+        for( SectionEntry& section : m_sections )
+        {
+            offset = align( offset );
+            section.offset = offset;
+            offset += section.count * section.elementSize;
+        }
+
+        FILE* fp = fopen( filename.c_str(), "wb" );
+        if( fp == nullptr )
+        {
+            return false;
+        }
+
+        bool succeeded =
+            fwrite( &header, sizeof( header ), 1, fp ) == 1 &&
+            fwrite( m_sections.data(), sizeof( SectionEntry ),
+                m_sections.size(), fp ) == m_sections.size();
+
+        const uint8_t zeros[ SECTION_ALIGNMENT ] = {};
+        offset = sizeof( Header ) +
+            m_sections.size() * sizeof( SectionEntry );
+        for( size_t i = 0; succeeded && i < m_sections.size(); ++i )
+        {
+            const SectionEntry& section = m_sections[ i ];
+            size_t nPaddingBytes =
+                static_cast< size_t >( section.offset - offset );
+            size_t nBytes =
+                static_cast< size_t >( section.count * section.elementSize );
+            succeeded =
+                fwrite( zeros, 1, nPaddingBytes, fp ) == nPaddingBytes &&
+                fwrite( m_data[ i ], 1, nBytes, fp ) == nBytes;
+            offset = section.offset + nBytes;
+        }
+
+        succeeded = ( fclose( fp ) == 0 ) && succeeded;
+        if( !succeeded )
+        {
+            remove( filename.c_str() );
+        }
+        return succeeded;
+    }
+
+private:
+
+    static uint64_t align( uint64_t offset )
+    {
+        return ( offset + SECTION_ALIGNMENT - 1 ) / SECTION_ALIGNMENT *
+            SECTION_ALIGNMENT;
+    }
+
+    std::vector< SectionEntry > m_sections;
+    std::vector< const void* > m_data;
+    std::vector< char > m_strings;
+};
+
+class Reader
+{
+public:
+
+    // Maps "filename" and validates its header and section table.
+    Reader( const std::string& filename ) :
+        m_file( filename.c_str() )
+    {
+        if( !m_file.isValid() || m_file.size() < sizeof( Header ) )
+        {
+            return;
+        }
+
+        memcpy( &m_header, m_file.data(), sizeof( Header ) );
+        if( memcmp( m_header.magic, MAGIC, sizeof( MAGIC ) ) != 0 ||
+            m_header.version != BinaryMeshIO::VERSION )
+        {
+            return;
+        }
+
+        size_t tableSize = m_header.nSections * sizeof( SectionEntry );
+        if( m_file.view( sizeof( Header ), tableSize ).isNull() )
+        {
+            return;
+        }
+        m_sections.resize( m_header.nSections );
+        memcpy( m_sections.data(), m_file.data() + sizeof( Header ),
+            tableSize );
+
+        for( const SectionEntry& section : m_sections )
+        {
+            if( section.elementSize == 0 ||
+                section.count > std::numeric_limits< uint64_t >::max() /
+                    section.elementSize ||
+                section.offset > m_file.size() ||
+                section.count * section.elementSize >
+                    m_file.size() - section.offset )
+            {
+                return;
+            }
+        }
+
+        m_isValid = true;
+    }
+
+    bool isValid() const
+    {
+        return m_isValid;
+    }
+
+    const Header& header() const
+    {
+        return m_header;
+    }
+
+    const SectionEntry* find( uint32_t id ) const
+    {
+        for( const SectionEntry& section : m_sections )
+        {
+            if( section.id == id )
+            {
+                return &section;
+            }
+        }
+        return nullptr;
+    }
+
+    bool contains( uint32_t id ) const
+    {
+        return find( id ) != nullptr;
+    }
+
+    // A view of section "id", directly into the mapped file. If the section
+    // does not exist or its elements are not of type T, sets "ok" to false
+    // and returns a null view.
+    template< typename T >
+    Array1DReadView< T > view( uint32_t id, bool& ok ) const
+    {
+        const SectionEntry* section = find( id );
+        if( section == nullptr || section->elementSize != sizeof( T ) )
+        {
+            ok = false;
+            return Array1DReadView< T >();
+        }
+        return Array1DReadView< T >( m_file.data() + section->offset,
+            static_cast< size_t >( section->count ) );
+    }
+
+    // Copies section "id" into "output" with a single memcpy.
+    // Missing sections are read as empty.
+    template< typename T >
+    bool read( uint32_t id, std::vector< T >& output ) const
+    {
+        const SectionEntry* section = find( id );
+        if( section == nullptr )
+        {
+            output.clear();
+            return true;
+        }
+        if( section->elementSize != sizeof( T ) )
+        {
+            return false;
+        }
+        output.resize( static_cast< size_t >( section->count ) );
+        if( !output.empty() )
+        {
+            memcpy( output.data(), m_file.data() + section->offset,
+                output.size() * sizeof( T ) );
+        }
+        return true;
+    }
+
+private:
+
+    MemoryMappedFile m_file;
+    Header m_header = {};
+    std::vector< SectionEntry > m_sections;
+    bool m_isValid = false;
+};
+
+bool readString( const std::vector< char >& strings, StringRef ref,
+    std::string& output )
+{
+    if( ref.offset > strings.size() ||
+        ref.length > strings.size() - ref.offset )
+    {
+        return false;
+    }
+    output.assign( strings.data() + ref.offset, ref.length );
+    return true;
+}
+
+}
+
+// static
+bool BinaryMeshIO::getSourceInfo( const std::string& filename,
+    SourceInfo& info )
+{
+#ifdef _WIN32
+    struct _stat64 s;
+    if( _stat64( filename.c_str(), &s ) != 0 )
+#else
+    struct stat s;
+    if( stat( filename.c_str(), &s ) != 0 )
+#endif
+    {
+        return false;
+    }
+
+    info.path = filename;
+    info.size = static_cast< uint64_t >( s.st_size );
+    info.modificationTime = static_cast< int64_t >( s.st_mtime );
+    return true;
+}
+
+// static
+bool BinaryMeshIO::write( const std::string& filename, const OBJData& data,
+    const SourceInfo& source )
+{
+    Writer writer;
+
+    std::vector< uint32_t > faceVertexOffsets( 1, 0 );
+    std::vector< int32_t > positionIndices;
+    std::vector< int32_t > textureCoordinateIndices;
+    std::vector< int32_t > normalIndices;
+    std::vector< uint8_t > faceFlags;
+    std::vector< GroupRecord > groups;
+    std::vector< MaterialRunRecord > runs;
+    std::vector< MaterialRecord > materials;
+
+    for( const OBJGroup& group : data.groups() )
+    {
+        GroupRecord record = {};
+        record.name = writer.addString( group.name() );
+        record.flags =
+            ( group.hasTextureCoordinates() ? HAS_TEXTURE_COORDINATES : 0 ) |
+            ( group.hasNormals() ? HAS_NORMALS : 0 );
+        record.firstFace = static_cast< uint32_t >( faceFlags.size() );
+        record.nFaces = static_cast< uint32_t >( group.numFaces() );
+        record.firstRun = static_cast< uint32_t >( runs.size() );
+        record.nRuns = static_cast< uint32_t >( group.numMaterials() );
+
+        for( const OBJFace& face : group.faces() )
+        {
+            int n = face.numVertices();
+            bool hasTextureCoordinates = face.hasTextureCoordinates() &&
+                face.textureCoordinateIndices().size() ==
+                    static_cast< size_t >( n );
+            bool hasNormals = face.hasNormals() &&
+                face.normalIndices().size() == static_cast< size_t >( n );
+
+            for( int i = 0; i < n; ++i )
+            {
+                positionIndices.push_back( face.positionIndices()[ i ] );
+                textureCoordinateIndices.push_back( hasTextureCoordinates ?
+                    face.textureCoordinateIndices()[ i ] : -1 );
+                normalIndices.push_back( hasNormals ?
+                    face.normalIndices()[ i ] : -1 );
+            }
+            faceVertexOffsets.push_back(
+                static_cast< uint32_t >( positionIndices.size() ) );
+            faceFlags.push_back( static_cast< uint8_t >(
+                ( hasTextureCoordinates ? HAS_TEXTURE_COORDINATES : 0 ) |
+                ( hasNormals ? HAS_NORMALS : 0 ) ) );
+        }
+
+        // OBJGroup only stores the set of faces for each material name.
+        // Recover the runs in file order: each face belongs to the earliest
+        // run with its material that has not ended, and the last run takes
+        // whatever is left.
+        std::vector< std::string > faceMaterials( group.numFaces() );
+        const auto& materialNames = group.materialNames();
+        for( const std::string& name : materialNames )
+        {
+            for( int f : group.facesForMaterial( name ) )
+            {
+                faceMaterials[ f ] = name;
+            }
+        }
+
+        int f = 0;
+        for( size_t m = 0; m < materialNames.size(); ++m )
+        {
+            int first = f;
+            if( m + 1 == materialNames.size() )
+            {
+                f = group.numFaces();
+            }
+            else
+            {
+                while( f < group.numFaces() &&
+                    faceMaterials[ f ] == materialNames[ m ] )
+                {
+                    ++f;
+                }
+            }
+
+            MaterialRunRecord run = {};
+            run.materialName = writer.addString( materialNames[ m ] );
+            run.nFaces = static_cast< uint32_t >( f - first );
+            runs.push_back( run );
+        }
+
+        groups.push_back( record );
+    }
+
+    for( const OBJMaterial& material : data.materials() )
+    {
+        MaterialRecord record = {};
+        record.name = writer.addString( material.name() );
+        record.ambientTexture = writer.addString( material.ambientTexture() );
+        record.diffuseTexture = writer.addString( material.diffuseTexture() );
+        for( int i = 0; i < 3; ++i )
+        {
+            record.ambientColor[ i ] = material.ambientColor()[ i ];
+            record.diffuseColor[ i ] = material.diffuseColor()[ i ];
+            record.specularColor[ i ] = material.specularColor()[ i ];
+        }
+        record.alpha = material.alpha();
+        record.shininess = material.shininess();
+        record.illuminationModel =
+            static_cast< uint32_t >( material.illuminationModel() );
+        materials.push_back( record );
+    }
+
+    writer.addSection( POSITIONS, data.positions() );
+    writer.addSection( TEXTURE_COORDINATES, data.textureCoordinates() );
+    writer.addSection( NORMALS, data.normals() );
+    writer.addSection( FACE_VERTEX_OFFSETS, faceVertexOffsets );
+    writer.addSection( FACE_POSITION_INDICES, positionIndices );
+    writer.addSection( FACE_TEXTURE_COORDINATE_INDICES,
+        textureCoordinateIndices );
+    writer.addSection( FACE_NORMAL_INDICES, normalIndices );
+    writer.addSection( FACE_FLAGS, faceFlags );
+    writer.addSection( GROUPS, groups );
+    writer.addSection( GROUP_MATERIAL_RUNS, runs );
+    writer.addSection( MATERIALS, materials );
+
+    return writer.write( filename, source );
+}
+
+// static
+bool BinaryMeshIO::write( const std::string& filename,
+    const TriangleMesh& mesh, const SourceInfo& source )
+{
+    Writer writer;
+    writer.addSection( POSITIONS, mesh.positions() );
+    writer.addSection( NORMALS, mesh.normals() );
+    writer.addSection( TRIANGLES, mesh.faces() );
+    return writer.write( filename, source );
+}
+
+// static
+std::unique_ptr< OBJData > BinaryMeshIO::readOBJData(
+    const std::string& filename, const SourceInfo* source )
+{
+    Reader reader( filename );
+    if( !reader.isValid() || !reader.contains( GROUPS ) )
+    {
+        return nullptr;
+    }
+
+    std::vector< char > strings;
+    std::vector< char > sourcePath;
+    if( !reader.read( STRINGS, strings ) ||
+        !reader.read( SOURCE_PATH, sourcePath ) )
+    {
+        return nullptr;
+    }
+
+    if( source != nullptr &&
+        ( reader.header().sourceSize != source->size ||
+          reader.header().sourceModificationTime !=
+            source->modificationTime ||
+          std::string( sourcePath.begin(), sourcePath.end() ) !=
+            source->path ) )
+    {
+        return nullptr;
+    }
+
+    std::unique_ptr< OBJData > pOBJData( new OBJData );
+    std::vector< uint32_t > faceVertexOffsets;
+    std::vector< int32_t > positionIndices;
+    std::vector< int32_t > textureCoordinateIndices;
+    std::vector< int32_t > normalIndices;
+    std::vector< uint8_t > faceFlags;
+    std::vector< GroupRecord > groups;
+    std::vector< MaterialRunRecord > runs;
+    std::vector< MaterialRecord > materials;
+
+    if( !reader.read( POSITIONS, pOBJData->positions() ) ||
+        !reader.read( TEXTURE_COORDINATES,
+            pOBJData->textureCoordinates() ) ||
+        !reader.read( NORMALS, pOBJData->normals() ) ||
+        !reader.read( FACE_VERTEX_OFFSETS, faceVertexOffsets ) ||
+        !reader.read( FACE_POSITION_INDICES, positionIndices ) ||
+        !reader.read( FACE_TEXTURE_COORDINATE_INDICES,
+            textureCoordinateIndices ) ||
+        !reader.read( FACE_NORMAL_INDICES, normalIndices ) ||
+        !reader.read( FACE_FLAGS, faceFlags ) ||
+        !reader.read( GROUPS, groups ) ||
+        !reader.read( GROUP_MATERIAL_RUNS, runs ) ||
+        !reader.read( MATERIALS, materials ) )
+    {
+        return nullptr;
+    }
+
+    size_t nVertices = positionIndices.size();
+    if( faceVertexOffsets.size() != faceFlags.size() + 1 ||
+        faceVertexOffsets.back() != nVertices ||
+        textureCoordinateIndices.size() != nVertices ||
+        normalIndices.size() != nVertices )
+    {
+        return nullptr;
+    }
+
+    std::string name;
+    for( const MaterialRecord& record : materials )
+    {
+        std::string ambientTexture;
+        std::string diffuseTexture;
+        if( !readString( strings, record.name, name ) ||
+            !readString( strings, record.ambientTexture, ambientTexture ) ||
+            !readString( strings, record.diffuseTexture, diffuseTexture ) )
+        {
+            return nullptr;
+        }
+
+        OBJMaterial& material = pOBJData->addMaterial( name );
+        material.setAmbientTexture( ambientTexture );
+        material.setDiffuseTexture( diffuseTexture );
+        material.setAmbientColor( Vector3f{ record.ambientColor[ 0 ],
+            record.ambientColor[ 1 ], record.ambientColor[ 2 ] } );
+        material.setDiffuseColor( Vector3f{ record.diffuseColor[ 0 ],
+            record.diffuseColor[ 1 ], record.diffuseColor[ 2 ] } );
+        material.setSpecularColor( Vector3f{ record.specularColor[ 0 ],
+            record.specularColor[ 1 ], record.specularColor[ 2 ] } );
+        material.setAlpha( record.alpha );
+        material.setShininess( record.shininess );
+        material.setIlluminationModel(
+            static_cast< OBJMaterial::IlluminationModel >(
+                record.illuminationModel ) );
+    }
+
+    for( const GroupRecord& record : groups )
+    {
+        if( !readString( strings, record.name, name ) ||
+            record.firstFace > faceFlags.size() ||
+            record.nFaces > faceFlags.size() - record.firstFace ||
+            record.nRuns == 0 ||
+            record.firstRun > runs.size() ||
+            record.nRuns > runs.size() - record.firstRun )
+        {
+            return nullptr;
+        }
+
+        OBJGroup& group = pOBJData->addGroup( name );
+        group.setHasTextureCoordinates(
+            ( record.flags & HAS_TEXTURE_COORDINATES ) != 0 );
+        group.setHasNormals( ( record.flags & HAS_NORMALS ) != 0 );
+
+        uint32_t f = record.firstFace;
+        uint32_t groupEnd = record.firstFace + record.nFaces;
+        for( uint32_t r = 0; r < record.nRuns; ++r )
+        {
+            const MaterialRunRecord& run = runs[ record.firstRun + r ];
+            if( !readString( strings, run.materialName, name ) ||
+                run.nFaces > groupEnd - f )
+            {
+                return nullptr;
+            }
+
+            // Every group starts with the default material "".
+            if( r > 0 )
+            {
+                group.addMaterial( name );
+            }
+
+            for( uint32_t i = 0; i < run.nFaces; ++i, ++f )
+            {
+                uint32_t vBegin = faceVertexOffsets[ f ];
+                uint32_t vEnd = faceVertexOffsets[ f + 1 ];
+                if( vBegin > vEnd || vEnd > nVertices )
+                {
+                    return nullptr;
+                }
+
+                OBJFace face(
+                    ( faceFlags[ f ] & HAS_TEXTURE_COORDINATES ) != 0,
+                    ( faceFlags[ f ] & HAS_NORMALS ) != 0 );
+                face.positionIndices().assign(
+                    positionIndices.begin() + vBegin,
+                    positionIndices.begin() + vEnd );
+                if( face.hasTextureCoordinates() )
+                {
+                    face.textureCoordinateIndices().assign(
+                        textureCoordinateIndices.begin() + vBegin,
+                        textureCoordinateIndices.begin() + vEnd );
+                }
+                if( face.hasNormals() )
+                {
+                    face.normalIndices().assign(
+                        normalIndices.begin() + vBegin,
+                        normalIndices.begin() + vEnd );
+                }
+                group.addFace( std::move( face ) );
+            }
+        }
+
+        if( f != groupEnd )
+        {
+            return nullptr;
+        }
+    }
+
+    return pOBJData;
+}
+
+// static
+bool BinaryMeshIO::read( const std::string& filename, TriangleMesh& mesh )
+{
+    Reader reader( filename );
+    if( !reader.isValid() || !reader.contains( TRIANGLES ) )
+    {
+        return false;
+    }
+
+    bool ok = true;
+    Array1DReadView< Vector3f > positions =
+        reader.view< Vector3f >( POSITIONS, ok );
+    Array1DReadView< Vector3i > faces =
+        reader.view< Vector3i >( TRIANGLES, ok );
+    Array1DReadView< Vector3f > normals;
+    if( reader.contains( NORMALS ) )
+    {
+        normals = reader.view< Vector3f >( NORMALS, ok );
+    }
+    if( !ok )
+    {
+        return false;
+    }
+
+    if( normals.size() > 0 )
+    {
+        if( normals.size() != positions.size() )
+        {
+            return false;
+        }
+        mesh = TriangleMesh( positions, normals, faces );
+    }
+    else
+    {
+        mesh = TriangleMesh( positions, faces );
+    }
+    return true;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+class OBJData;
+class TriangleMesh;
+
+// A versioned binary format for meshes that loads without any parsing.
+//
+// A file is a 32-byte header, a table of sections, and the sections
+// themselves, each 16-byte aligned. Every section is a flat array: vertex
+// attributes, face indices, and fixed-size records for groups and materials
+// that refer to a shared string table. Reading maps the file and copies each
+// array into place with a single memcpy.
+//
+// Data is stored in the byte order of the machine that wrote it.
+//
+// The header also records the path, size and modification time of the file
+// the mesh was converted from, so that the file can serve as a cache (see
+// OBJLoader::setCacheDirectory()).
+class BinaryMeshIO
+{
+public:
+
+    // Identifies the file a binary mesh was converted from.
+    struct SourceInfo
+    {
+        std::string path;
+        uint64_t size;
+        int64_t modificationTime;
+    };
+
+    static const uint32_t VERSION = 1;
+
+    // Get the path, size and modification time of "filename".
+    // Returns false if it does not exist.
+    static bool getSourceInfo( const std::string& filename,
+        SourceInfo& info );
+
+    static bool write( const std::string& filename, const OBJData& data,
+        const SourceInfo& source = SourceInfo{} );
+
+    static bool write( const std::string& filename, const TriangleMesh& mesh,
+        const SourceInfo& source = SourceInfo{} );
+
+    // Returns null if the file cannot be read, has a different version, or
+    // does not contain OBJData. If "source" is not null, also returns null
+    // unless the file was written with the same SourceInfo.
+    static std::unique_ptr< OBJData > readOBJData( const std::string& filename,
+        const SourceInfo* source = nullptr );
+
+    // Returns false if the file cannot be read, has a different version, or
+    // does not contain a TriangleMesh.
+    static bool read( const std::string& filename, TriangleMesh& mesh );
+};
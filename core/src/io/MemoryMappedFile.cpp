@@ -0,0 +1,179 @@
+#include "io/MemoryMappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MemoryMappedFile::MemoryMappedFile( const char* filename )
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if( file == INVALID_HANDLE_VALUE )
+    {
+        return;
+    }
+    m_fileHandle = file;
+
+    LARGE_INTEGER fileSize;
+    if( !GetFileSizeEx( file, &fileSize ) || fileSize.QuadPart == 0 )
+    {
+        close();
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY,
+        0, 0, nullptr );
+    if( mapping == nullptr )
+    {
+        close();
+        return;
+    }
+    m_mappingHandle = mapping;
+
+    void* data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    if( data == nullptr )
+    {
+        close();
+        return;
+    }
+
+    m_data = reinterpret_cast< const uint8_t* >( data );
+    m_size = static_cast< size_t >( fileSize.QuadPart );
+#else
+    m_fd = open( filename, O_RDONLY );
+    if( m_fd == -1 )
+    {
+        return;
+    }
+
+    struct stat sb;
+    if( fstat( m_fd, &sb ) != 0 || sb.st_size == 0 )
+    {
+        close();
+        return;
+    }
+
+    size_t size = static_cast< size_t >( sb.st_size );
+    void* data = mmap( nullptr, size, PROT_READ, MAP_SHARED, m_fd, 0 );
+    if( data == MAP_FAILED )
+    {
+        close();
+        return;
+    }
+
+    m_data = reinterpret_cast< const uint8_t* >( data );
+    m_size = size;
+#endif
+}
+
+// virtual
+MemoryMappedFile::~MemoryMappedFile()
+{
+    close();
+}
+
+MemoryMappedFile::MemoryMappedFile( MemoryMappedFile&& move )
+{
+    moveFrom( move );
+}
+
+MemoryMappedFile& MemoryMappedFile::operator = ( MemoryMappedFile&& move )
+{
+    if( this != &move )
+    {
+        close();
+        moveFrom( move );
+    }
+    return *this;
+}
+
+bool MemoryMappedFile::isValid() const
+{
+    return( m_data != nullptr );
+}
+
+bool MemoryMappedFile::close()
+{
+    bool wasValid = isValid();
+    bool ok = true;
+
+#ifdef _WIN32
+    if( m_data != nullptr )
+    {
+        ok = ( UnmapViewOfFile( m_data ) != 0 ) && ok;
+    }
+    if( m_mappingHandle != nullptr )
+    {
+        ok = ( CloseHandle( m_mappingHandle ) != 0 ) && ok;
+        m_mappingHandle = nullptr;
+    }
+    if( m_fileHandle != nullptr )
+    {
+        ok = ( CloseHandle( m_fileHandle ) != 0 ) && ok;
+        m_fileHandle = nullptr;
+    }
+#else
+    if( m_data != nullptr )
+    {
+        ok = ( munmap( const_cast< uint8_t* >( m_data ), m_size ) == 0 ) &&
+            ok;
+    }
+    if( m_fd != -1 )
+    {
+        ok = ( ::close( m_fd ) == 0 ) && ok;
+        m_fd = -1;
+    }
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+    return wasValid && ok;
+}
+
+size_t MemoryMappedFile::size() const
+{
+    return m_size;
+}
+
+const uint8_t* MemoryMappedFile::data() const
+{
+    return m_data;
+}
+
+Array1DReadView< uint8_t > MemoryMappedFile::view() const
+{
+    return Array1DReadView< uint8_t >( m_data, m_size );
+}
+
+Array1DReadView< uint8_t > MemoryMappedFile::view( size_t offset,
+    size_t size ) const
+{
+    if( offset > m_size || size > m_size - offset )
+    {
+        return Array1DReadView< uint8_t >();
+    }
+    return Array1DReadView< uint8_t >( m_data + offset, size );
+}
+
+void MemoryMappedFile::moveFrom( MemoryMappedFile& move )
+{
+#ifdef _WIN32
+    m_fileHandle = move.m_fileHandle;
+    m_mappingHandle = move.m_mappingHandle;
+    move.m_fileHandle = nullptr;
+    move.m_mappingHandle = nullptr;
+#else
+    m_fd = move.m_fd;
+    move.m_fd = -1;
+#endif
+    m_data = move.m_data;
+    m_size = move.m_size;
+    move.m_data = nullptr;
+    move.m_size = 0;
+}
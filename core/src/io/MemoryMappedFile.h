@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <common/ArrayView.h>
+
+// A read-only view of an entire file, mapped into the address space of the
+// process. Pages are brought in from the operating system's page cache on
+// demand: no copies are made.
+class MemoryMappedFile
+{
+public:
+
+    // The null MemoryMappedFile.
+    MemoryMappedFile() = default;
+
+    // Map the file "filename" for reading. On failure (or if the file is
+    // empty), isValid() returns false.
+    MemoryMappedFile( const char* filename );
+    virtual ~MemoryMappedFile();
+
+    MemoryMappedFile( const MemoryMappedFile& copy ) = delete;
+    MemoryMappedFile& operator = ( const MemoryMappedFile& copy ) = delete;
+    MemoryMappedFile( MemoryMappedFile&& move );
+    MemoryMappedFile& operator = ( MemoryMappedFile&& move );
+
+    // Returns true if the file was properly mapped.
+    bool isValid() const;
+
+    // Unmaps the file. Any views into it become invalid.
+    // Returns true if the file was properly unmapped.
+    bool close();
+
+    // The size of the file in bytes.
+    size_t size() const;
+
+    // A pointer to the first byte of the file.
+    const uint8_t* data() const;
+
+    // The entire file as a view.
+    Array1DReadView< uint8_t > view() const;
+
+    // A view of "size" bytes starting at "offset".
+    // Returns a null view if it would extend past the end of the file.
+    Array1DReadView< uint8_t > view( size_t offset, size_t size ) const;
+
+private:
+
+    void moveFrom( MemoryMappedFile& move );
+
+#ifdef _WIN32
+    void* m_fileHandle = nullptr;
+    void* m_mappingHandle = nullptr;
+#else
+    int m_fd = -1;
+#endif
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+};
@@ -84,6 +84,11 @@ int OBJData::numMaterials() const
     return static_cast< int >( m_materials.size() );
 }
 
+const std::vector< OBJMaterial >& OBJData::materials() const
+{
+    return m_materials;
+}
+
 std::vector< OBJMaterial >& OBJData::materials()
 {
     return m_materials;
@@ -49,6 +49,7 @@ public:
     int numMaterials() const;
 
     // returns all the materials from OBJData (in file order)
+    const std::vector< OBJMaterial >& materials() const;
     std::vector< OBJMaterial >& materials();
 
     // Adds a new material by name and returns a reference to it.
@@ -67,6 +67,14 @@ void OBJGroup::addFace( const OBJFace& face )
     m_facesByMaterial[ lastMaterial ].push_back( numFaces() - 1 );
 }
 
+void OBJGroup::addFace( OBJFace&& face )
+{
+    m_faces.push_back( std::move( face ) );
+
+    const std::string& lastMaterial = m_materialNames.back();
+    m_facesByMaterial[ lastMaterial ].push_back( numFaces() - 1 );
+}
+
 int OBJGroup::numMaterials() const
 {
     return static_cast< int >( m_materialNames.size() );
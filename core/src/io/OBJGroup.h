@@ -27,6 +27,7 @@ public:
 
     // adds a new face to the current material
     void addFace( const OBJFace& face );
+    void addFace( OBJFace&& face );
 
     int numMaterials() const;
     const std::vector< std::string >& materialNames() const;
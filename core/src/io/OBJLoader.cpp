@@ -1,132 +1,438 @@
 #include "io/OBJLoader.h"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
 
 #include <third_party/pystring/pystring.h>
 
+#include "concurrency/ThreadPool.h"
+#include "io/BinaryMeshIO.h"
+#include "io/File.h"
+#include "io/MemoryMappedFile.h"
 #include "io/OBJData.h"
 #include "io/OBJGroup.h"
 
-// static
-std::unique_ptr< OBJData > OBJLoader::loadFile( const std::string& objFilename,
-                                               bool removeEmptyGroups )
+namespace
+{
+
+// Chunks are at least this big, so that small files are parsed serially.
+const size_t MIN_CHUNK_BYTES = 1 << 20;
+
+const double POWERS_OF_TEN[] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+bool isSpace( char c )
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+bool isDigit( char c )
+{
+    return c >= '0' && c <= '9';
+}
+
+void skipSpaces( const char*& p, const char* end )
 {
-    std::unique_ptr< OBJData > pOBJData( new OBJData );
-    bool succeeded = parseOBJ( objFilename, pOBJData.get() );
-    if( !succeeded )
+    while( p < end && isSpace( *p ) )
     {
-        // Return null.
-        pOBJData.reset();
+        ++p;
     }
+}
 
-    if( removeEmptyGroups )
+// The end of the token starting at p.
+const char* tokenEnd( const char* p, const char* end )
+{
+    while( p < end && !isSpace( *p ) )
     {
-        pOBJData->removeEmptyGroups();
+        ++p;
     }
+    return p;
+}
 
-    return pOBJData;
+bool tokenEquals( const char* begin, const char* end, const char* s )
+{
+    size_t n = strlen( s );
+    return static_cast< size_t >( end - begin ) == n &&
+        memcmp( begin, s, n ) == 0;
 }
 
-// static
-bool OBJLoader::parseOBJ( const std::string& objFilename, OBJData* pOBJData )
+// Parses a decimal integer at p and advances p past it.
+bool parseInt( const char*& p, const char* end, int& value )
 {
-    // Attempt to read the file.
-    std::ifstream inputFile( objFilename );
-    if (inputFile.fail())
+    bool negative = false;
+    if( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        negative = ( *p == '-' );
+        ++p;
+    }
+    if( p == end || !isDigit( *p ) )
     {
         return false;
     }
 
-    int lineNumber = 0;
-    std::string line = "";
-    // Default group name is the empty string.
-    OBJGroup& currentGroup = pOBJData->addGroup( "" );
-    // Default material name is the empty string.
-    pOBJData->addMaterial( "" );
-
-    const std::string& delim( " " );
-    while( std::getline( inputFile, line ) )
+    int x = 0;
+    while( p < end && isDigit( *p ) )
     {
-        if( line == "" ||
-           pystring::startswith( line, "#" ) ||
-           pystring::startswith( line, "//" ) )
-        {
-            ++lineNumber;
-            continue;
-        }
+        x = 10 * x + ( *p - '0' );
+        ++p;
+    }
+    value = negative ? -x : x;
+    return true;
+}
 
-        std::vector< std::string > tokens;
-        pystring::split( line, tokens, delim );
+// Parses a floating point number at p and advances p past it.
+//
+// Numbers with up to 19 significant digits and a decimal exponent of at
+// most 22 (after moving the decimal point) are exact in a double and are
+// converted with a single multiplication or division. Anything else, such as
+// "nan", is handed to strtod().
+bool parseFloat( const char*& p, const char* end, float& value )
+{
+    const char* start = p;
 
-        if( tokens.size() == 0 )
+    bool negative = false;
+    if( p < end && ( *p == '-' || *p == '+' ) )
+    {
+        negative = ( *p == '-' );
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int nDigits = 0;
+    int exponent = 0;
+    bool hasDigits = false;
+    while( p < end && isDigit( *p ) )
+    {
+        if( nDigits < 19 )
         {
-            ++lineNumber;
-            continue;
+            mantissa = 10 * mantissa + ( *p - '0' );
+            if( mantissa > 0 )
+            {
+                ++nDigits;
+            }
         }
-
-        const std::string& commandToken = tokens[ 0 ];
-        if( commandToken == "mtllib" )
+        else
         {
-            const std::string& mtlRelativeFilename = tokens[ 1 ];
-            std::string dirname = pystring::os::path::dirname( objFilename );
-            std::string mtlFilename =
-            pystring::os::path::join( dirname, mtlRelativeFilename );
-            parseMTL( mtlFilename, pOBJData );
+            ++exponent;
         }
-        else if( commandToken == "g" )
+        hasDigits = true;
+        ++p;
+    }
+    if( p < end && *p == '.' )
+    {
+        ++p;
+        while( p < end && isDigit( *p ) )
         {
-            std::string newGroupName;
-            if( tokens.size() < 2 )
-            {
-                fprintf( stderr,
-                        "Warning: group has no name, defaulting to ""\n"
-                        "line %d: %s",
-                        lineNumber, line.c_str() );
-
-                newGroupName = "";
-            }
-            else
-            {
-                newGroupName = line.substr( 2 );
-            }
-
-            if( newGroupName != currentGroup.name() )
+            if( nDigits < 19 )
             {
-                if( pOBJData->containsGroup( newGroupName ) )
-                {
-                    currentGroup = pOBJData->getGroupByName( newGroupName );
-                }
-                else
+                mantissa = 10 * mantissa + ( *p - '0' );
+                if( mantissa > 0 )
                 {
-                    currentGroup = pOBJData->addGroup( newGroupName );
+                    ++nDigits;
                 }
+                --exponent;
             }
+            hasDigits = true;
+            ++p;
         }
-        else if( commandToken == "v" )
+    }
+    if( hasDigits && p < end && ( *p == 'e' || *p == 'E' ) )
+    {
+        const char* q = p + 1;
+        int e;
+        if( parseInt( q, end, e ) )
         {
-            // TODO: error checking on all of these.
-            OBJLoader::parsePosition( lineNumber, line, tokens, pOBJData );
+            exponent += e;
+            p = q;
         }
-        else if( commandToken == "vt" )
+    }
+
+    if( hasDigits && ( p == end || isSpace( *p ) ) &&
+        exponent >= -22 && exponent <= 22 &&
+        mantissa < ( uint64_t( 1 ) << 53 ) )
+    {
+        double x = static_cast< double >( mantissa );
+        x = exponent < 0 ? x / POWERS_OF_TEN[ -exponent ] :
+            x * POWERS_OF_TEN[ exponent ];
+        value = static_cast< float >( negative ? -x : x );
+        return true;
+    }
+
+    // Slow path: the mapped file is not null terminated, so copy the token.
+    char buffer[ 64 ];
+    const char* q = tokenEnd( start, end );
+    size_t n = static_cast< size_t >( q - start );
+    if( n == 0 || n >= sizeof( buffer ) )
+    {
+        return false;
+    }
+    memcpy( buffer, start, n );
+    buffer[ n ] = '\0';
+
+    char* parsedEnd;
+    double x = strtod( buffer, &parsedEnd );
+    if( parsedEnd != buffer + n )
+    {
+        return false;
+    }
+    value = static_cast< float >( x );
+    p = q;
+    return true;
+}
+
+// Parses "n" whitespace separated floats from p.
+bool parseFloats( const char*& p, const char* end, int n, float* values )
+{
+    for( int i = 0; i < n; ++i )
+    {
+        skipSpaces( p, end );
+        if( !parseFloat( p, end, values[ i ] ) )
         {
-            OBJLoader::parseTextureCoordinate( lineNumber, line, tokens,
-                                              pOBJData );
+            return false;
         }
-        else if( commandToken == "vn" )
+    }
+    return true;
+}
+
+std::mutex s_cacheMutex;
+std::string s_cacheDirectory;
+
+// The cache file for "objFilename" in "cacheDirectory".
+std::string cacheFilename( const std::string& cacheDirectory,
+    const std::string& objFilename )
+{
+    char name[ 32 ];
+    snprintf( name, sizeof( name ), "%016llx.lcgtmesh",
+        static_cast< unsigned long long >(
+            std::hash< std::string >()( objFilename ) ) );
+    return cacheDirectory + "/" + name;
+}
+
+// Writes "data" to a temporary file next to "filename", then renames it, so
+// that other processes never see a partially written cache file. The
+// temporary name includes the process and thread ids and a random number, so
+// that concurrent writers of the same cache file never share one.
+void writeCacheFile( const std::string& filename, const OBJData& data,
+    const BinaryMeshIO::SourceInfo& source )
+{
+#ifdef _WIN32
+    int pid = _getpid();
+#else
+    int pid = static_cast< int >( getpid() );
+#endif
+    char suffix[ 64 ];
+    snprintf( suffix, sizeof( suffix ), ".%d.%zx.%08x.tmp", pid,
+        std::hash< std::thread::id >()( std::this_thread::get_id() ),
+        static_cast< unsigned int >( std::random_device()() ) );
+    std::string tmpFilename = filename + suffix;
+    if( BinaryMeshIO::write( tmpFilename, data, source ) )
+    {
+#ifdef _WIN32
+        // rename() does not replace existing files on Windows.
+        remove( filename.c_str() );
+#endif
+        if( rename( tmpFilename.c_str(), filename.c_str() ) != 0 )
         {
-            OBJLoader::parseNormal( lineNumber, line, tokens, pOBJData );
+            remove( tmpFilename.c_str() );
         }
-        else if( commandToken == "usemtl" )
+    }
+}
+
+}
+
+// The result of parsing part of a file, before it is appended to OBJData.
+struct OBJLoader::Chunk
+{
+    // Something that changes how later faces are interpreted.
+    struct Command
+    {
+        enum class Type
+        {
+            GROUP,
+            USE_MATERIAL,
+            MATERIAL_LIBRARY
+        };
+
+        Type type;
+        std::string name;
+
+        // The command comes before faces[ faceIndex ].
+        int faceIndex;
+    };
+
+    // A negative index, which is relative to the number of vertex attributes
+    // before it in the file. It has been resolved relative to the start of
+    // the chunk, and needs the number of attributes in earlier chunks added.
+    struct RelativeIndex
+    {
+        int faceIndex;
+        int vertex;
+        int attribute; // 0: position, 1: texture coordinate, 2: normal.
+    };
+
+    std::vector< Vector3f > positions;
+    std::vector< Vector2f > textureCoordinates;
+    std::vector< Vector3f > normals;
+
+    std::vector< OBJFace > faces;
+    std::vector< int > faceLineNumbers;
+    std::vector< Command > commands;
+    std::vector< RelativeIndex > relativeIndices;
+
+    // Line number within the chunk, message.
+    std::vector< std::pair< int, std::string > > warnings;
+    int nLines = 0;
+
+    // Filled in by parseOBJ() before merging.
+    int firstLineNumber = 0;
+    int positionOffset = 0;
+    int textureCoordinateOffset = 0;
+    int normalOffset = 0;
+
+    // Scratch space for parseFace().
+    int lineNumber = 0;
+    std::vector< int > vertexIndices;
+};
+
+// static
+std::unique_ptr< OBJData > OBJLoader::loadFile( const std::string& objFilename,
+                                               bool removeEmptyGroups )
+{
+    std::unique_ptr< OBJData > pOBJData;
+
+    // The cache stores the file as parsed, before removing empty groups.
+    std::string directory = cacheDirectory();
+    std::string cacheFile;
+    BinaryMeshIO::SourceInfo source;
+    if( !directory.empty() &&
+        BinaryMeshIO::getSourceInfo( objFilename, source ) )
+    {
+        cacheFile = cacheFilename( directory, objFilename );
+        pOBJData = BinaryMeshIO::readOBJData( cacheFile, &source );
+    }
+
+    if( pOBJData == nullptr )
+    {
+        pOBJData.reset( new OBJData );
+        bool succeeded = parseOBJ( objFilename, pOBJData.get() );
+        if( !succeeded )
         {
-            currentGroup.addMaterial( tokens[ 1 ] );
+            // Return null.
+            pOBJData.reset();
+            return pOBJData;
         }
-        else if( commandToken == "f" || commandToken == "fo" )
+
+        if( !cacheFile.empty() )
         {
-            OBJLoader::parseFace( lineNumber, line,
-                tokens, currentGroup );
+            writeCacheFile( cacheFile, *pOBJData, source );
         }
+    }
 
-        ++lineNumber;
+    if( removeEmptyGroups )
+    {
+        pOBJData->removeEmptyGroups();
+    }
+
+    return pOBJData;
+}
+
+// static
+void OBJLoader::setCacheDirectory( const std::string& directory )
+{
+    std::lock_guard< std::mutex > lock( s_cacheMutex );
+    s_cacheDirectory = directory;
+}
+
+// static
+std::string OBJLoader::cacheDirectory()
+{
+    std::lock_guard< std::mutex > lock( s_cacheMutex );
+    return s_cacheDirectory;
+}
+
+// static
+bool OBJLoader::parseOBJ( const std::string& objFilename, OBJData* pOBJData )
+{
+    // Attempt to map the file. Empty files cannot be mapped, but are valid.
+    MemoryMappedFile file( objFilename.c_str() );
+    if( !file.isValid() && !File::exists( objFilename.c_str() ) )
+    {
+        return false;
+    }
+
+    const char* data = reinterpret_cast< const char* >( file.data() );
+    size_t size = file.size();
+
+    // Split the file at line boundaries.
+    auto& pool = libcgt::core::concurrency::ThreadPool::global();
+    size_t nTargetChunks = std::max< size_t >( 1, std::min< size_t >(
+        size / MIN_CHUNK_BYTES, 4 * pool.numThreads() ) );
+    std::vector< const char* > boundaries;
+    boundaries.push_back( data );
+    for( size_t i = 1; i < nTargetChunks; ++i )
+    {
+        const char* p = std::max( data + i * size / nTargetChunks,
+            boundaries.back() );
+        const char* newline = reinterpret_cast< const char* >(
+            memchr( p, '\n', ( data + size ) - p ) );
+        if( newline == nullptr )
+        {
+            break;
+        }
+        boundaries.push_back( newline + 1 );
+    }
+    boundaries.push_back( data + size );
+
+    int nChunks = static_cast< int >( boundaries.size() ) - 1;
+    std::vector< Chunk > chunks( nChunks );
+    pool.parallelFor( 0, nChunks, 1,
+        [&]( int begin, int end )
+        {
+            for( int i = begin; i < end; ++i )
+            {
+                parseChunk( boundaries[ i ], boundaries[ i + 1 ],
+                    chunks[ i ] );
+            }
+        }
+    );
+
+    // Default group name is the empty string.
+    OBJGroup* pCurrentGroup = &( pOBJData->addGroup( "" ) );
+    // Default material name is the empty string.
+    pOBJData->addMaterial( "" );
+
+    int lineNumber = 0;
+    for( int i = 0; i < nChunks; ++i )
+    {
+        chunks[ i ].firstLineNumber = lineNumber;
+        lineNumber += chunks[ i ].nLines;
+        chunks[ i ].positionOffset =
+            static_cast< int >( pOBJData->positions().size() );
+        chunks[ i ].textureCoordinateOffset =
+            static_cast< int >( pOBJData->textureCoordinates().size() );
+        chunks[ i ].normalOffset =
+            static_cast< int >( pOBJData->normals().size() );
+
+        mergeChunk( objFilename, chunks[ i ], pOBJData, pCurrentGroup );
+
+        // Free each chunk as soon as it is merged.
+        chunks[ i ] = Chunk();
     }
 
     return true;
@@ -260,363 +566,337 @@ bool OBJLoader::parseMTL( const std::string& mtlFilename, OBJData* pOBJData )
 }
 
 // static
-bool OBJLoader::parsePosition( int lineNumber, const std::string& line,
-                              const std::vector< std::string >& tokens,
-                              OBJData* pOBJData )
+void OBJLoader::parseChunk( const char* begin, const char* end, Chunk& chunk )
 {
-    if( tokens.size() < 4 )
-    {
-        fprintf( stderr,
-            "Incorrect number of tokens at line number: %d\n, %s\n",
-            lineNumber, line.c_str() );
-        return false;
-    }
-    else
+    const char* p = begin;
+    for( ; p < end; ++chunk.lineNumber )
     {
-        // TODO: consider using std::stringstream
-#if 0
-        bool succeeded = true;
-
-        float x = tokens[ 1 ].toFloat( &succeeded );
-        if( !succeeded )
+        const char* lineEnd = reinterpret_cast< const char* >(
+            memchr( p, '\n', end - p ) );
+        if( lineEnd == nullptr )
         {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
-            return false;
+            lineEnd = end;
         }
 
-        float y = tokens[ 2 ].toFloat( &succeeded );
-        if( !succeeded )
-        {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
-            return false;
-        }
+        const char* lineBegin = p;
+        const char* next = lineEnd + ( lineEnd < end ? 1 : 0 );
 
-        float z = tokens[ 3 ].toFloat( &succeeded );
-        if( !succeeded )
+        skipSpaces( p, lineEnd );
+        if( p == lineEnd || *p == '#' ||
+            ( lineEnd - p >= 2 && p[ 0 ] == '/' && p[ 1 ] == '/' ) )
         {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
-            return false;
+            p = next;
+            continue;
         }
-#endif
-
-        float x = std::stof( tokens[ 1 ] );
-        float y = std::stof( tokens[ 2 ] );
-        float z = std::stof( tokens[ 3 ] );
 
-        pOBJData->positions().push_back( { x, y, z } );
+        const char* commandEnd = tokenEnd( p, lineEnd );
+        const char* command = p;
+        p = commandEnd;
 
-        return true;
-    }
-}
+        bool succeeded = true;
+        if( tokenEquals( command, commandEnd, "v" ) )
+        {
+            Vector3f v;
+            succeeded = parseFloats( p, lineEnd, 3, &( v[ 0 ] ) );
+            if( succeeded )
+            {
+                chunk.positions.push_back( v );
+            }
+        }
+        else if( tokenEquals( command, commandEnd, "vt" ) )
+        {
+            Vector2f vt;
+            succeeded = parseFloats( p, lineEnd, 2, &( vt[ 0 ] ) );
+            if( succeeded )
+            {
+                chunk.textureCoordinates.push_back( vt );
+            }
+        }
+        else if( tokenEquals( command, commandEnd, "vn" ) )
+        {
+            Vector3f n;
+            succeeded = parseFloats( p, lineEnd, 3, &( n[ 0 ] ) );
+            if( succeeded )
+            {
+                chunk.normals.push_back( n );
+            }
+        }
+        else if( tokenEquals( command, commandEnd, "f" ) ||
+            tokenEquals( command, commandEnd, "fo" ) )
+        {
+            parseFace( p, lineEnd, chunk );
+        }
+        else if( tokenEquals( command, commandEnd, "g" ) ||
+            tokenEquals( command, commandEnd, "usemtl" ) ||
+            tokenEquals( command, commandEnd, "mtllib" ) )
+        {
+            // Group names are the rest of the line, usemtl and mtllib take
+            // the first token.
+            skipSpaces( p, lineEnd );
+            const char* nameEnd = lineEnd;
+            while( nameEnd > p && isSpace( nameEnd[ -1 ] ) )
+            {
+                --nameEnd;
+            }
 
-// static
-bool OBJLoader::parseTextureCoordinate( int lineNumber, const std::string& line,
-                                       const std::vector< std::string >& tokens,
-                                       OBJData* pOBJData )
-{
-    if( tokens.size() < 3 )
-    {
-        fprintf( stderr,
-            "Incorrect number of tokens at line number: %d\n, %s\n",
-            lineNumber, line.c_str() );
-        return false;
-    }
-    else
-    {
-#if 0
-        bool succeeded;
+            Chunk::Command c;
+            c.faceIndex = static_cast< int >( chunk.faces.size() );
+            if( *command == 'g' )
+            {
+                c.type = Chunk::Command::Type::GROUP;
+                if( p == nameEnd )
+                {
+                    chunk.warnings.emplace_back( chunk.lineNumber,
+                        "Warning: group has no name, defaulting to \"\"" );
+                }
+            }
+            else
+            {
+                c.type = ( *command == 'u' ) ?
+                    Chunk::Command::Type::USE_MATERIAL :
+                    Chunk::Command::Type::MATERIAL_LIBRARY;
+                nameEnd = tokenEnd( p, nameEnd );
+                succeeded = ( p < nameEnd );
+            }
 
-        float s = tokens[ 1 ].toFloat( &succeeded );
-        if( !succeeded )
-        {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
-            return false;
+            if( succeeded )
+            {
+                c.name.assign( p, nameEnd );
+                chunk.commands.push_back( c );
+            }
         }
 
-        float t = tokens[ 2 ].toFloat( &succeeded );
         if( !succeeded )
         {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
-            return false;
+            chunk.warnings.emplace_back( chunk.lineNumber,
+                "Incorrect number of tokens: " +
+                std::string( lineBegin, lineEnd ) );
         }
-#endif
-
-        float s = std::stof( tokens[ 1 ] );
-        float t = std::stof( tokens[ 2 ] );
-
-        pOBJData->textureCoordinates().push_back( Vector2f{ s, t } );
 
-        return true;
+        p = next;
     }
+
+    chunk.nLines = chunk.lineNumber;
+    chunk.vertexIndices = std::vector< int >();
 }
 
 // static
-bool OBJLoader::parseNormal( int lineNumber, const std::string& line,
-                            const std::vector< std::string >& tokens,
-                            OBJData* pOBJData )
+bool OBJLoader::parseFace( const char* p, const char* lineEnd, Chunk& chunk )
 {
-    if( tokens.size() < 4 )
-    {
-        fprintf( stderr,
-            "Incorrect number of tokens at line number: %d\n, %s\n",
-            lineNumber, line.c_str() );
-        return false;
-    }
-    else
-    {
-#if 0
-        bool succeeded;
+    const char* lineBegin = p;
 
-        float nx = tokens[ 1 ].toFloat( &succeeded );
-        if( !succeeded )
-        {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
-            return false;
-        }
+    // Each vertex is "v", "v/vt", "v//vn", or "v/vt/vn". Parse them into
+    // triplets, with 0 for missing attributes.
+    std::vector< int >& indices = chunk.vertexIndices;
+    indices.clear();
 
-        float ny = tokens[ 2 ].toFloat( &succeeded );
-        if( !succeeded )
+    bool hasTextureCoordinates = false;
+    bool hasNormals = false;
+    bool consistent = true;
+    int nVertices = 0;
+
+    skipSpaces( p, lineEnd );
+    while( p < lineEnd )
+    {
+        int v = 0;
+        int vt = 0;
+        int vn = 0;
+        bool valid = parseInt( p, lineEnd, v );
+        if( valid && p < lineEnd && *p == '/' )
+        {
+            ++p;
+            if( p < lineEnd && *p != '/' )
+            {
+                valid = parseInt( p, lineEnd, vt );
+            }
+            if( valid && p < lineEnd && *p == '/' )
+            {
+                ++p;
+                valid = parseInt( p, lineEnd, vn );
+            }
+        }
+        if( !valid || ( p < lineEnd && !isSpace( *p ) ) || v == 0 )
         {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
+            chunk.warnings.emplace_back( chunk.lineNumber,
+                "Invalid face vertex: " + std::string( lineBegin, lineEnd ) );
             return false;
         }
 
-        float nz = tokens[ 3 ].toFloat( &succeeded );
-        if( !succeeded )
+        // Each vertex in the face should have the same attributes.
+        if( nVertices == 0 )
         {
-            fprintf( stderr, "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, qPrintable( line ) );
-            return false;
+            hasTextureCoordinates = ( vt != 0 );
+            hasNormals = ( vn != 0 );
         }
-#endif
-
-        float nx = std::stof( tokens[ 1 ] );
-        float ny = std::stof( tokens[ 2 ] );
-        float nz = std::stof( tokens[ 3 ] );
+        consistent &= ( ( vt != 0 ) == hasTextureCoordinates ) &&
+            ( ( vn != 0 ) == hasNormals );
 
-        pOBJData->normals().push_back( { nx, ny, nz } );
+        indices.push_back( v );
+        indices.push_back( vt );
+        indices.push_back( vn );
+        ++nVertices;
 
-        return true;
+        skipSpaces( p, lineEnd );
     }
-}
 
-// static
-bool OBJLoader::parseFace( int lineNumber, const std::string& line,
-                          const std::vector< std::string >& tokens,
-                          OBJGroup& currentGroup )
-{
-    // TODO: support negative indices.
-    if( tokens.size() < 4 )
+    if( nVertices < 3 )
     {
-        fprintf( stderr,
-                "Incorrect number of tokens at line number: %d\n, %s\n",
-                lineNumber, line.c_str() );
+        chunk.warnings.emplace_back( chunk.lineNumber,
+            "Incorrect number of tokens: " +
+            std::string( lineBegin, lineEnd ) );
         return false;
     }
-    // first check line consistency - each vertex in the face
-    // should have the same number of attributes
-    bool faceIsValid;
-    bool faceHasTextureCoordinates;
-    bool faceHasNormals;
-
-    faceIsValid = OBJLoader::faceHasConsistentAttributes( tokens,
-        &faceHasTextureCoordinates, &faceHasNormals );
-
-    if( !faceIsValid )
+    if( !consistent )
     {
-        fprintf( stderr, "Face attributes inconsistent at line number: %d\n%s\n",
-                lineNumber, line.c_str() );
+        chunk.warnings.emplace_back( chunk.lineNumber,
+            "Face attributes inconsistent: " +
+            std::string( lineBegin, lineEnd ) );
         return false;
     }
 
-    // ensure that all faces in a group are consistent:
-    // they either all have texture coordinates or they don't
-    // they either all have normals or they don't
-    //
-    // check how many faces the current group has
-    // if the group has no faces, then the first face sets the group attributes
-
-    if( currentGroup.numFaces() == 0 )
+    // OBJ indices are 1-based. Negative indices count back from the last
+    // attribute read: resolve them relative to the start of the chunk for
+    // now.
+    int faceIndex = static_cast< int >( chunk.faces.size() );
+    int counts[ 3 ] =
     {
-        currentGroup.setHasTextureCoordinates( faceHasTextureCoordinates );
-        currentGroup.setHasNormals( faceHasNormals );
-    }
-
-    bool faceIsConsistentWithGroup =
-        ( currentGroup.hasTextureCoordinates() == faceHasTextureCoordinates )
-        && ( currentGroup.hasNormals() == faceHasNormals );
-
-    if( !faceIsConsistentWithGroup )
+        static_cast< int >( chunk.positions.size() ),
+        static_cast< int >( chunk.textureCoordinates.size() ),
+        static_cast< int >( chunk.normals.size() )
+    };
+    OBJFace face( hasTextureCoordinates, hasNormals );
+    std::vector< int >* outputs[ 3 ] =
     {
-        // TODO: boolToString()
-        fprintf( stderr,
-                "Face attributes inconsistent with group: %s at line: %d\n%s\n",
-                currentGroup.name().c_str(), lineNumber, line.c_str() );
-        fprintf( stderr, "group.hasTextureCoordinates() = %d\n",
-                currentGroup.hasTextureCoordinates() );
-        fprintf( stderr, "face.hasTextureCoordinates() = %d\n",
-                faceHasTextureCoordinates );
-        fprintf( stderr, "group.hasNormals() = %d\n",
-                currentGroup.hasNormals() );
-        fprintf( stderr, "face.hasNormals() = %d\n", faceHasNormals );
+        &( face.positionIndices() ),
+        &( face.textureCoordinateIndices() ),
+        &( face.normalIndices() )
+    };
+    bool present[ 3 ] = { true, hasTextureCoordinates, hasNormals };
 
-        return false;
-    }
-
-    OBJFace face( faceHasTextureCoordinates, faceHasNormals );
-
-    // Process each vertex.
-    for( int i = 1; i < tokens.size(); ++i )
+    for( int a = 0; a < 3; ++a )
     {
-        int vertexPositionIndex;
-        int vertexTextureCoordinateIndex;
-        int vertexNormalIndex;
-
-        OBJLoader::getVertexAttributes( tokens[ i ],
-            &vertexPositionIndex, &vertexTextureCoordinateIndex,
-            &vertexNormalIndex );
-
-        face.positionIndices().push_back( vertexPositionIndex - 1 );
-
-        if( faceHasTextureCoordinates )
+        if( !present[ a ] )
         {
-            face.textureCoordinateIndices().push_back(
-                vertexTextureCoordinateIndex - 1 );
+            continue;
         }
-        if( faceHasNormals )
+
+        outputs[ a ]->reserve( nVertices );
+        for( int i = 0; i < nVertices; ++i )
         {
-            face.normalIndices().push_back( vertexNormalIndex - 1 );
+            int index = indices[ 3 * i + a ];
+            if( index > 0 )
+            {
+                outputs[ a ]->push_back( index - 1 );
+            }
+            else
+            {
+                outputs[ a ]->push_back( counts[ a ] + index );
+                chunk.relativeIndices.push_back( { faceIndex, i, a } );
+            }
         }
     }
 
-    currentGroup.addFace( face );
+    chunk.faces.push_back( std::move( face ) );
+    chunk.faceLineNumbers.push_back( chunk.lineNumber );
     return true;
 }
 
 // static
-bool OBJLoader::faceHasConsistentAttributes(
-    const std::vector< std::string >& tokens,
-    bool* pHasTextureCoordinates, bool* pHasNormals )
+void OBJLoader::mergeChunk( const std::string& objFilename, Chunk& chunk,
+    OBJData* pOBJData, OBJGroup*& pCurrentGroup )
 {
-    if( tokens.size() < 2 )
+    for( const auto& warning : chunk.warnings )
     {
-        *pHasTextureCoordinates = false;
-        *pHasNormals = false;
-        return true;
+        fprintf( stderr, "line %d: %s\n",
+            chunk.firstLineNumber + warning.first, warning.second.c_str() );
     }
 
-    int firstVertexPositionIndex;
-    int firstVertexTextureCoordinateIndex;
-    int firstVertexNormalIndex;
+    pOBJData->positions().insert( pOBJData->positions().end(),
+        chunk.positions.begin(), chunk.positions.end() );
+    pOBJData->textureCoordinates().insert(
+        pOBJData->textureCoordinates().end(),
+        chunk.textureCoordinates.begin(), chunk.textureCoordinates.end() );
+    pOBJData->normals().insert( pOBJData->normals().end(),
+        chunk.normals.begin(), chunk.normals.end() );
 
-    bool firstVertexIsValid;
-    bool firstVertexHasTextureCoordinates;
-    bool firstVertexHasNormals;
-
-    firstVertexIsValid = OBJLoader::getVertexAttributes( tokens[1],
-        &firstVertexPositionIndex, &firstVertexTextureCoordinateIndex,
-        &firstVertexNormalIndex );
-    firstVertexHasTextureCoordinates =
-        ( firstVertexTextureCoordinateIndex != -1 );
-    firstVertexHasNormals = ( firstVertexNormalIndex != -1 );
-
-    if( !firstVertexIsValid )
+    for( const Chunk::RelativeIndex& r : chunk.relativeIndices )
     {
-        *pHasTextureCoordinates = false;
-        *pHasNormals = false;
-        return false;
-    }
-
-    for( int i = 2; i < tokens.size(); ++i )
-    {
-        int vertexPositionIndex;
-        int vertexTextureCoordinateIndex;
-        int vertexNormalIndex;
-
-        bool vertexIsValid;
-        bool vertexHasTextureCoordinates;
-        bool vertexHasNormals;
-
-        vertexIsValid = OBJLoader::getVertexAttributes( tokens[i],
-            &vertexPositionIndex, &vertexTextureCoordinateIndex,
-            &vertexNormalIndex );
-        vertexHasTextureCoordinates = ( vertexTextureCoordinateIndex != -1 );
-        vertexHasNormals = ( vertexNormalIndex != -1 );
-
-        if( !vertexIsValid )
+        OBJFace& face = chunk.faces[ r.faceIndex ];
+        if( r.attribute == 0 )
         {
-            *pHasTextureCoordinates = false;
-            *pHasNormals = false;
-            return false;
+            face.positionIndices()[ r.vertex ] += chunk.positionOffset;
         }
-
-        if( firstVertexHasTextureCoordinates != vertexHasTextureCoordinates )
+        else if( r.attribute == 1 )
         {
-            *pHasTextureCoordinates = false;
-            *pHasNormals = false;
-            return false;
+            face.textureCoordinateIndices()[ r.vertex ] +=
+                chunk.textureCoordinateOffset;
         }
-
-        if( firstVertexHasNormals != vertexHasNormals )
+        else
         {
-            *pHasTextureCoordinates = false;
-            *pHasNormals = false;
-            return false;
+            face.normalIndices()[ r.vertex ] += chunk.normalOffset;
         }
     }
 
-    *pHasTextureCoordinates = firstVertexHasTextureCoordinates;
-    *pHasNormals = firstVertexHasNormals;
-    return true;
-}
-
-// static
-bool OBJLoader::getVertexAttributes( const std::string& objFaceVertexToken,
-                                    int* pPositionIndex,
-                                    int* pTextureCoordinateIndex,
-                                    int* pNormalIndex )
-{
-    *pPositionIndex = 0;
-    *pTextureCoordinateIndex = 0;
-    *pNormalIndex = 0;
-
-    std::vector< std::string > vertexAttributes;
-    pystring::split( objFaceVertexToken, vertexAttributes, "/" );
-    size_t numVertexAttributes = vertexAttributes.size();
-
-    // Check if it has position. It is required.
-    if( numVertexAttributes < 1 )
-    {
-        return false;
-    }
-
-    if( vertexAttributes[0] == "" )
+    size_t c = 0;
+    int nFaces = static_cast< int >( chunk.faces.size() );
+    for( int f = 0; f <= nFaces; ++f )
     {
-        return false;
-    }
+        // Apply the commands that come before this face.
+        for( ; c < chunk.commands.size() && chunk.commands[ c ].faceIndex == f;
+            ++c )
+        {
+            const Chunk::Command& command = chunk.commands[ c ];
+            if( command.type == Chunk::Command::Type::GROUP )
+            {
+                if( command.name != pCurrentGroup->name() )
+                {
+                    // addGroup() returns the existing group if there is one.
+                    // It may reallocate, so only hold on to the new pointer.
+                    pCurrentGroup = pOBJData->containsGroup( command.name ) ?
+                        &( pOBJData->getGroupByName( command.name ) ) :
+                        &( pOBJData->addGroup( command.name ) );
+                }
+            }
+            else if( command.type == Chunk::Command::Type::USE_MATERIAL )
+            {
+                pCurrentGroup->addMaterial( command.name );
+            }
+            else
+            {
+                std::string dirname =
+                    pystring::os::path::dirname( objFilename );
+                parseMTL( pystring::os::path::join( dirname, command.name ),
+                    pOBJData );
+            }
+        }
 
-    // TODO: error checking on parsing the ints.
-    *pPositionIndex = std::stoi( vertexAttributes[ 0 ] );
-    if( numVertexAttributes > 1 )
-    {
-        if( vertexAttributes[1] != "" )
+        if( f == nFaces )
         {
-            *pTextureCoordinateIndex =
-                std::stoi( vertexAttributes[ 1 ] );
+            break;
         }
 
-        if( numVertexAttributes > 2 && vertexAttributes[2] != "" )
+        // Ensure that all faces in a group are consistent: they either all
+        // have texture coordinates or they don't, and they either all have
+        // normals or they don't. The first face sets the group attributes.
+        OBJFace& face = chunk.faces[ f ];
+        if( pCurrentGroup->numFaces() == 0 )
         {
-            *pNormalIndex = std::stoi( vertexAttributes[ 2 ] );
+            pCurrentGroup->setHasTextureCoordinates(
+                face.hasTextureCoordinates() );
+            pCurrentGroup->setHasNormals( face.hasNormals() );
+        }
 
+        if( pCurrentGroup->hasTextureCoordinates() !=
+                face.hasTextureCoordinates() ||
+            pCurrentGroup->hasNormals() != face.hasNormals() )
+        {
+            fprintf( stderr,
+                "line %d: Face attributes inconsistent with group: %s\n",
+                chunk.firstLineNumber + chunk.faceLineNumbers[ f ],
+                pCurrentGroup->name().c_str() );
+            continue;
         }
+
+        pCurrentGroup->addFace( std::move( face ) );
     }
-    return true;
 }
@@ -7,6 +7,16 @@
 class OBJData;
 class OBJGroup;
 
+// Loads Wavefront OBJ files.
+//
+// The file is memory mapped and split into chunks at line boundaries, which
+// are parsed in parallel on ThreadPool::global() without allocating per line
+// or per number. The chunks are then merged in file order, so that groups,
+// materials, and relative (negative) vertex indices mean the same thing as if
+// the file were read line by line.
+//
+// Optionally, parsed files can be cached as binary meshes (see
+// BinaryMeshIO), which load with a few memcpys instead of parsing.
 class OBJLoader
 {
 public:
@@ -14,48 +24,31 @@ public:
     static std::unique_ptr< OBJData > loadFile( const std::string& objFilename,
                              bool removeEmptyGroups = true );
 
+    // Cache every file loaded by loadFile() in "directory", which must
+    // exist. A cache file is used only if the OBJ file has the same path,
+    // size and modification time as when it was written. Changes to .mtl
+    // files are not detected.
+    //
+    // Pass the empty string to disable caching (the default).
+    static void setCacheDirectory( const std::string& directory );
+    static std::string cacheDirectory();
+
 private:
 
+    struct Chunk;
+
     static bool parseOBJ( const std::string& objFilename, OBJData* pOBJData );
     static bool parseMTL( const std::string& mtlFilename, OBJData* pOBJData );
 
-    // parses a position line (starting with "v")
-    // returns false on an error
-    static bool parsePosition( int lineNumber, const std::string& line,
-        const std::vector< std::string >& tokens, OBJData* pOBJData );
-
-    // parses a texture coordinate line (starting with "vt")
-    // returns false on an error
-    static bool parseTextureCoordinate( int lineNumber, const std::string& line,
-        const std::vector< std::string >& tokens, OBJData* pOBJData );
-
-    // parses a normal line (starting with "vn")
-    // returns false on an error
-    static bool parseNormal( int lineNumber, const std::string& line,
-        const std::vector< std::string >& tokens, OBJData* pOBJData );
-
-    // parses a face line (starting with "f" or "fo")
-    // returns false on an error
-    static bool parseFace( int lineNumber, const std::string& line,
-                          const std::vector< std::string >& tokens,
-                          OBJGroup& currentGroup );
-
-    // given the tokens in a face line
-    // returns if the attached attributes are consistent
-    static bool faceHasConsistentAttributes(
-        const std::vector< std::string >& tokens,
-        bool* pHasTextureCoordinates, bool* pHasNormals );
-
-    // objFaceVertexToken is something of the form:
-    // "int"
-    // "int/int"
-    // "int/int/int",
-    // "int//int"
-    // i.e. one of the delimited int strings that specify a vertex and its
-    // attributes.
-    //
-    // Returns:
-    // Whether the vertex is valid and the indices in the out parameters
-    static bool getVertexAttributes( const std::string& objFaceVertexToken,
-        int* pPositionIndex, int* pTextureCoordinateIndex, int* pNormalIndex );
+    // Parses the lines in [ begin, end ) into "chunk".
+    static void parseChunk( const char* begin, const char* end,
+        Chunk& chunk );
+
+    // Parses a face line (starting with "f" or "fo"), after the command.
+    // Returns false on an error.
+    static bool parseFace( const char* p, const char* lineEnd, Chunk& chunk );
+
+    // Appends "chunk" to pOBJData, in file order.
+    static void mergeChunk( const std::string& objFilename, Chunk& chunk,
+        OBJData* pOBJData, OBJGroup*& pCurrentGroup );
 };
@@ -6,6 +6,9 @@
 #include <common/ArrayView.h>
 #include <common/Array2D.h>
 
+// Reads and writes entire PNG images with LodePNG, using its default
+// settings. To read or write an image a band of rows at a time, or to tune
+// compression, use PNGInputStream and PNGOutputStream.
 class PNGIO
 {
 public:
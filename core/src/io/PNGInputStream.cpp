@@ -0,0 +1,405 @@
+#include "io/PNGInputStream.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+using libcgt::core::io::ZlibDecompressor;
+using libcgt::core::io::crc32;
+
+namespace
+{
+
+const uint8_t PNG_SIGNATURE[ 8 ] =
+{
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+};
+
+uint32_t getBigEndian32( const uint8_t* input )
+{
+    return ( static_cast< uint32_t >( input[ 0 ] ) << 24 ) |
+        ( static_cast< uint32_t >( input[ 1 ] ) << 16 ) |
+        ( static_cast< uint32_t >( input[ 2 ] ) << 8 ) |
+        static_cast< uint32_t >( input[ 3 ] );
+}
+
+uint8_t paethPredictor( int a, int b, int c )
+{
+    int p = a + b - c;
+    int pa = std::abs( p - a );
+    int pb = std::abs( p - b );
+    int pc = std::abs( p - c );
+    if( pa <= pb && pa <= pc )
+    {
+        return static_cast< uint8_t >( a );
+    }
+    else if( pb <= pc )
+    {
+        return static_cast< uint8_t >( b );
+    }
+    return static_cast< uint8_t >( c );
+}
+
+// Reads the CRC at the end of a chunk and compares it to "crc".
+bool checkCRC( FILE* fp, uint32_t crc )
+{
+    uint8_t stored[ 4 ];
+    return fread( stored, 1, 4, fp ) == 4 && getBigEndian32( stored ) == crc;
+}
+
+}
+
+PNGInputStream::PNGInputStream( const std::string& filename )
+{
+    m_fp = fopen( filename.c_str(), "rb" );
+    if( m_fp == nullptr )
+    {
+        return;
+    }
+
+    uint8_t signature[ 8 ];
+    if( fread( signature, 1, 8, m_fp ) != 8 ||
+        memcmp( signature, PNG_SIGNATURE, 8 ) != 0 )
+    {
+        return;
+    }
+
+    uint32_t length;
+    char type[ 4 ];
+    uint8_t header[ 13 ];
+    if( !readChunkHeader( length, type ) || memcmp( type, "IHDR", 4 ) != 0 ||
+        length != sizeof( header ) ||
+        fread( header, 1, sizeof( header ), m_fp ) != sizeof( header ) ||
+        !checkCRC( m_fp, crc32( header, sizeof( header ),
+            crc32( reinterpret_cast< const uint8_t* >( type ), 4 ) ) ) )
+    {
+        return;
+    }
+
+    uint32_t width = getBigEndian32( header );
+    uint32_t height = getBigEndian32( header + 4 );
+    m_bitDepth = header[ 8 ];
+    switch( header[ 9 ] )
+    {
+    case 0:
+        m_nComponents = 1;
+        break;
+    case 2:
+        m_nComponents = 3;
+        break;
+    case 4:
+        m_nComponents = 2;
+        break;
+    case 6:
+        m_nComponents = 4;
+        break;
+    default:
+        // Palette.
+        return;
+    }
+
+    // Deflate, adaptive filtering, and no interlacing.
+    if( width == 0 || width > INT32_MAX || height == 0 ||
+        height > INT32_MAX || ( m_bitDepth != 8 && m_bitDepth != 16 ) ||
+        header[ 10 ] != 0 || header[ 11 ] != 0 || header[ 12 ] != 0 )
+    {
+        return;
+    }
+    m_size = { static_cast< int >( width ), static_cast< int >( height ) };
+
+    // Skip to the first IDAT chunk.
+    while( true )
+    {
+        if( !readChunkHeader( length, type ) ||
+            memcmp( type, "IEND", 4 ) == 0 )
+        {
+            return;
+        }
+        if( memcmp( type, "IDAT", 4 ) == 0 )
+        {
+            break;
+        }
+        if( fseek( m_fp, static_cast< long >( length ) + 4, SEEK_CUR ) != 0 )
+        {
+            return;
+        }
+    }
+    m_chunkRemaining = length;
+    m_chunkCRC = crc32( reinterpret_cast< const uint8_t* >( type ), 4 );
+
+    m_decompressor.reset( new ZlibDecompressor(
+        [this] ( uint8_t* buffer, size_t capacity )
+        {
+            return readCompressed( buffer, capacity );
+        }
+    ) );
+
+    m_bytesPerPixel = m_nComponents * m_bitDepth / 8;
+    m_rowBytes = static_cast< size_t >( m_size.x ) * m_bytesPerPixel;
+    m_filtered.resize( m_rowBytes + 1 );
+    m_row.resize( m_rowBytes );
+    m_previousRow.assign( m_rowBytes, 0 );
+    m_ok = true;
+}
+
+// virtual
+PNGInputStream::~PNGInputStream()
+{
+    if( m_fp != nullptr )
+    {
+        fclose( m_fp );
+    }
+}
+
+bool PNGInputStream::isOpen() const
+{
+    return m_fp != nullptr && m_ok;
+}
+
+Vector2i PNGInputStream::size() const
+{
+    return m_size;
+}
+
+int PNGInputStream::numComponents() const
+{
+    return m_nComponents;
+}
+
+int PNGInputStream::bitDepth() const
+{
+    return m_bitDepth;
+}
+
+int PNGInputStream::numRowsRead() const
+{
+    return m_nRowsRead;
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint8_t > output )
+{
+    return readRows( output, 1, 8 );
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint8x2 > output )
+{
+    return readRows( output, 2, 8 );
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint8x3 > output )
+{
+    return readRows( output, 3, 8 );
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint8x4 > output )
+{
+    return readRows( output, 4, 8 );
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint16_t > output )
+{
+    return readRows( output, 1, 16 );
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint16x2 > output )
+{
+    return readRows( output, 2, 16 );
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint16x3 > output )
+{
+    return readRows( output, 3, 16 );
+}
+
+bool PNGInputStream::read( Array2DWriteView< uint16x4 > output )
+{
+    return readRows( output, 4, 16 );
+}
+
+bool PNGInputStream::close()
+{
+    if( m_fp == nullptr )
+    {
+        return false;
+    }
+
+    bool succeeded = m_ok;
+    if( m_ok && m_nRowsRead == m_size.y )
+    {
+        succeeded = m_decompressor->finish() && m_ok;
+    }
+
+    succeeded = ( fclose( m_fp ) == 0 ) && succeeded;
+    m_fp = nullptr;
+    m_ok = false;
+    return succeeded;
+}
+
+template< typename T >
+bool PNGInputStream::readRows( Array2DWriteView< T > output,
+    int nComponents, int bitDepth )
+{
+    if( !isOpen() || output.isNull() || nComponents != m_nComponents ||
+        bitDepth != m_bitDepth || output.width() != m_size.x ||
+        output.height() > m_size.y - m_nRowsRead )
+    {
+        return false;
+    }
+
+    // PNG is big endian: swap bytes within 16-bit components.
+    const size_t swap = ( bitDepth == 16 ) ? 1 : 0;
+
+    for( int y = 0; y < output.height(); ++y )
+    {
+        // m_ok is cleared if a chunk fails its CRC.
+        if( !m_decompressor->read( m_filtered.data(), m_filtered.size() ) ||
+            !m_ok || !unfilterRow() )
+        {
+            m_ok = false;
+            return false;
+        }
+
+        if( output.elementsArePacked() && swap == 0 )
+        {
+            memcpy( output.rowPointer( y ), m_row.data(), m_rowBytes );
+        }
+        else if( output.elementsArePacked() )
+        {
+            uint8_t* dst = reinterpret_cast< uint8_t* >(
+                output.rowPointer( y ) );
+            for( size_t i = 0; i < m_rowBytes; ++i )
+            {
+                dst[ i ] = m_row[ i ^ swap ];
+            }
+        }
+        else
+        {
+            for( int x = 0; x < output.width(); ++x )
+            {
+                uint8_t* dst = reinterpret_cast< uint8_t* >(
+                    output.elementPointer( { x, y } ) );
+                const uint8_t* src = m_row.data() + x * sizeof( T );
+                for( size_t i = 0; i < sizeof( T ); ++i )
+                {
+                    dst[ i ] = src[ i ^ swap ];
+                }
+            }
+        }
+
+        std::swap( m_row, m_previousRow );
+        ++m_nRowsRead;
+    }
+
+    return true;
+}
+
+bool PNGInputStream::readChunkHeader( uint32_t& length, char type[ 4 ] )
+{
+    uint8_t header[ 8 ];
+    if( fread( header, 1, 8, m_fp ) != 8 )
+    {
+        return false;
+    }
+    length = getBigEndian32( header );
+    memcpy( type, header + 4, 4 );
+    return length <= INT32_MAX;
+}
+
+size_t PNGInputStream::readCompressed( uint8_t* buffer, size_t capacity )
+{
+    size_t n = 0;
+    while( n < capacity && !m_idatEnded )
+    {
+        if( m_chunkRemaining == 0 )
+        {
+            uint32_t length;
+            char type[ 4 ];
+            if( !checkCRC( m_fp, m_chunkCRC ) ||
+                !readChunkHeader( length, type ) )
+            {
+                m_ok = false;
+                m_idatEnded = true;
+            }
+            else if( memcmp( type, "IDAT", 4 ) != 0 )
+            {
+                m_idatEnded = true;
+            }
+            else
+            {
+                m_chunkRemaining = length;
+                m_chunkCRC =
+                    crc32( reinterpret_cast< const uint8_t* >( type ), 4 );
+            }
+            continue;
+        }
+
+        size_t k = fread( buffer + n, 1,
+            std::min< size_t >( capacity - n, m_chunkRemaining ), m_fp );
+        if( k == 0 )
+        {
+            m_ok = false;
+            m_idatEnded = true;
+            break;
+        }
+        m_chunkCRC = crc32( buffer + n, k, m_chunkCRC );
+        m_chunkRemaining -= static_cast< uint32_t >( k );
+        n += k;
+    }
+    return n;
+}
+
+bool PNGInputStream::unfilterRow()
+{
+    const uint8_t* in = m_filtered.data() + 1;
+    const uint8_t* previous = m_previousRow.data();
+    uint8_t* out = m_row.data();
+    const size_t bpp = m_bytesPerPixel;
+    const size_t n = m_rowBytes;
+
+    switch( m_filtered[ 0 ] )
+    {
+    case 0:
+        memcpy( out, in, n );
+        break;
+
+    case 1:
+        for( size_t i = 0; i < n; ++i )
+        {
+            uint8_t a = ( i >= bpp ) ? out[ i - bpp ] : 0;
+            out[ i ] = static_cast< uint8_t >( in[ i ] + a );
+        }
+        break;
+
+    case 2:
+        for( size_t i = 0; i < n; ++i )
+        {
+            out[ i ] = static_cast< uint8_t >( in[ i ] + previous[ i ] );
+        }
+        break;
+
+    case 3:
+        for( size_t i = 0; i < n; ++i )
+        {
+            int a = ( i >= bpp ) ? out[ i - bpp ] : 0;
+            out[ i ] = static_cast< uint8_t >(
+                in[ i ] + ( ( a + previous[ i ] ) >> 1 ) );
+        }
+        break;
+
+    case 4:
+        for( size_t i = 0; i < n; ++i )
+        {
+            bool hasLeft = ( i >= bpp );
+            int a = hasLeft ? out[ i - bpp ] : 0;
+            int c = hasLeft ? previous[ i - bpp ] : 0;
+            out[ i ] = static_cast< uint8_t >(
+                in[ i ] + paethPredictor( a, previous[ i ], c ) );
+        }
+        break;
+
+    default:
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <common/ArrayView.h>
+#include <common/BasicTypes.h>
+#include <vecmath/Vector2i.h>
+
+#include "io/ZlibStream.h"
+
+// Reads a PNG file a band of rows at a time, into caller-provided views, so
+// that the whole image never has to be in memory. IDAT chunks are read from
+// the file and decompressed only as rows are requested.
+//
+// Supports 8 and 16 bits per component, with 1 (gray), 2 (gray and alpha),
+// 3 (RGB), or 4 (RGBA) components, not interlaced. Use PNGIO::read() for
+// other formats.
+class PNGInputStream
+{
+public:
+
+    // Opens "filename" and reads its header. Check isOpen() for success.
+    PNGInputStream( const std::string& filename );
+    virtual ~PNGInputStream();
+
+    PNGInputStream( const PNGInputStream& copy ) = delete;
+    PNGInputStream& operator = ( const PNGInputStream& copy ) = delete;
+
+    // Returns true if the file was opened and is in a supported format.
+    bool isOpen() const;
+
+    Vector2i size() const;
+    int numComponents() const;
+    int bitDepth() const;
+
+    // The number of rows read so far.
+    int numRowsRead() const;
+
+    // Reads the next output.height() rows of the image, from top to bottom.
+    // Returns false if the element type does not match the image format,
+    // output.width() != size().x, there are fewer rows left than requested,
+    // or the file is corrupt.
+    bool read( Array2DWriteView< uint8_t > output );
+    bool read( Array2DWriteView< uint8x2 > output );
+    bool read( Array2DWriteView< uint8x3 > output );
+    bool read( Array2DWriteView< uint8x4 > output );
+    bool read( Array2DWriteView< uint16_t > output );
+    bool read( Array2DWriteView< uint16x2 > output );
+    bool read( Array2DWriteView< uint16x3 > output );
+    bool read( Array2DWriteView< uint16x4 > output );
+
+    // Closes the file. Returns false if any of it was found to be corrupt.
+    // If every row has been read, this includes the end of the compressed
+    // data.
+    bool close();
+
+private:
+
+    template< typename T >
+    bool readRows( Array2DWriteView< T > output, int nComponents,
+        int bitDepth );
+
+    // Reads the header of the next chunk.
+    bool readChunkHeader( uint32_t& length, char type[ 4 ] );
+
+    // The ZlibDecompressor::Source: the contents of consecutive IDAT chunks.
+    size_t readCompressed( uint8_t* buffer, size_t capacity );
+
+    // Reverses the filter on m_filtered into m_row.
+    bool unfilterRow();
+
+    FILE* m_fp = nullptr;
+
+    Vector2i m_size;
+    int m_nComponents = 0;
+    int m_bitDepth = 0;
+
+    int m_bytesPerPixel = 0;
+    size_t m_rowBytes = 0;
+    int m_nRowsRead = 0;
+
+    // The unread bytes of the current IDAT chunk, and its running CRC.
+    uint32_t m_chunkRemaining = 0;
+    uint32_t m_chunkCRC = 0;
+    bool m_idatEnded = false;
+
+    std::unique_ptr< libcgt::core::io::ZlibDecompressor > m_decompressor;
+
+    std::vector< uint8_t > m_filtered;
+    std::vector< uint8_t > m_row;
+    std::vector< uint8_t > m_previousRow;
+
+    bool m_ok = false;
+};
@@ -0,0 +1,371 @@
+#include "io/PNGOutputStream.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+using libcgt::core::io::crc32;
+
+namespace
+{
+
+const uint8_t PNG_SIGNATURE[ 8 ] =
+{
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+};
+
+// Compressed data is written out in IDAT chunks of about this size.
+const size_t IDAT_CHUNK_BYTES = 1 << 16;
+
+void putBigEndian32( uint32_t x, uint8_t* output )
+{
+    output[ 0 ] = static_cast< uint8_t >( x >> 24 );
+    output[ 1 ] = static_cast< uint8_t >( x >> 16 );
+    output[ 2 ] = static_cast< uint8_t >( x >> 8 );
+    output[ 3 ] = static_cast< uint8_t >( x );
+}
+
+uint8_t paethPredictor( int a, int b, int c )
+{
+    int p = a + b - c;
+    int pa = std::abs( p - a );
+    int pb = std::abs( p - b );
+    int pc = std::abs( p - c );
+    if( pa <= pb && pa <= pc )
+    {
+        return static_cast< uint8_t >( a );
+    }
+    else if( pb <= pc )
+    {
+        return static_cast< uint8_t >( b );
+    }
+    return static_cast< uint8_t >( c );
+}
+
+// Filters "row" with filter type "type", into output[ 1 .. n ], and writes
+// the type into output[ 0 ].
+void filter( int type, const uint8_t* row, const uint8_t* previous,
+    size_t n, int bpp, uint8_t* output )
+{
+    output[ 0 ] = static_cast< uint8_t >( type );
+    uint8_t* out = output + 1;
+
+    switch( type )
+    {
+    case 0:
+        memcpy( out, row, n );
+        break;
+
+    case 1:
+        for( size_t i = 0; i < n; ++i )
+        {
+            uint8_t a = ( i >= static_cast< size_t >( bpp ) ) ?
+                row[ i - bpp ] : 0;
+            out[ i ] = static_cast< uint8_t >( row[ i ] - a );
+        }
+        break;
+
+    case 2:
+        for( size_t i = 0; i < n; ++i )
+        {
+            out[ i ] = static_cast< uint8_t >( row[ i ] - previous[ i ] );
+        }
+        break;
+
+    case 3:
+        for( size_t i = 0; i < n; ++i )
+        {
+            int a = ( i >= static_cast< size_t >( bpp ) ) ?
+                row[ i - bpp ] : 0;
+            out[ i ] = static_cast< uint8_t >(
+                row[ i ] - ( ( a + previous[ i ] ) >> 1 ) );
+        }
+        break;
+
+    case 4:
+        for( size_t i = 0; i < n; ++i )
+        {
+            bool hasLeft = ( i >= static_cast< size_t >( bpp ) );
+            int a = hasLeft ? row[ i - bpp ] : 0;
+            int c = hasLeft ? previous[ i - bpp ] : 0;
+            out[ i ] = static_cast< uint8_t >(
+                row[ i ] - paethPredictor( a, previous[ i ], c ) );
+        }
+        break;
+    }
+}
+
+// The sum of the absolute values of "data" as signed bytes.
+uint64_t sumOfAbsoluteValues( const uint8_t* data, size_t n )
+{
+    uint64_t sum = 0;
+    for( size_t i = 0; i < n; ++i )
+    {
+        sum += std::abs( static_cast< int8_t >( data[ i ] ) );
+    }
+    return sum;
+}
+
+}
+
+// static
+PNGOutputStream::Settings PNGOutputStream::Settings::fast()
+{
+    Settings settings;
+    settings.compressionLevel = 1;
+    settings.filter = Filter::SUB;
+    settings.windowBits = 15;
+    return settings;
+}
+
+PNGOutputStream::PNGOutputStream( const std::string& filename,
+    const Vector2i& size, int nComponents, int bitDepth ) :
+    PNGOutputStream( filename, size, nComponents, bitDepth, Settings() )
+{
+
+}
+
+PNGOutputStream::PNGOutputStream( const std::string& filename,
+    const Vector2i& size, int nComponents, int bitDepth,
+    const Settings& settings ) :
+    m_size( size ),
+    m_nComponents( nComponents ),
+    m_bitDepth( bitDepth ),
+    m_settings( settings ),
+    m_compressor( settings.compressionLevel, settings.windowBits )
+{
+    const uint8_t COLOR_TYPES[ 4 ] = { 0, 4, 2, 6 };
+    if( size.x <= 0 || size.y <= 0 || nComponents < 1 || nComponents > 4 ||
+        ( bitDepth != 8 && bitDepth != 16 ) )
+    {
+        return;
+    }
+
+    m_fp = fopen( filename.c_str(), "wb" );
+    if( m_fp == nullptr )
+    {
+        return;
+    }
+
+    m_bytesPerPixel = nComponents * bitDepth / 8;
+    m_rowBytes = static_cast< size_t >( size.x ) * m_bytesPerPixel;
+    m_row.resize( m_rowBytes );
+    m_previousRow.assign( m_rowBytes, 0 );
+    int nFilterBuffers =
+        ( settings.filter == Filter::ADAPTIVE ) ? 5 : 1;
+    for( int i = 0; i < nFilterBuffers; ++i )
+    {
+        m_filtered[ i ].resize( m_rowBytes + 1 );
+    }
+
+    // Width, height, bit depth, color type, and the default compression,
+    // filter, and interlace methods.
+    uint8_t header[ 13 ];
+    putBigEndian32( size.x, header );
+    putBigEndian32( size.y, header + 4 );
+    header[ 8 ] = static_cast< uint8_t >( bitDepth );
+    header[ 9 ] = COLOR_TYPES[ nComponents - 1 ];
+    header[ 10 ] = 0;
+    header[ 11 ] = 0;
+    header[ 12 ] = 0;
+
+    m_ok = fwrite( PNG_SIGNATURE, 1, sizeof( PNG_SIGNATURE ), m_fp ) ==
+        sizeof( PNG_SIGNATURE ) &&
+        writeChunk( "IHDR", header, sizeof( header ) );
+}
+
+// virtual
+PNGOutputStream::~PNGOutputStream()
+{
+    close();
+}
+
+bool PNGOutputStream::isOpen() const
+{
+    return m_fp != nullptr && m_ok;
+}
+
+Vector2i PNGOutputStream::size() const
+{
+    return m_size;
+}
+
+int PNGOutputStream::numComponents() const
+{
+    return m_nComponents;
+}
+
+int PNGOutputStream::bitDepth() const
+{
+    return m_bitDepth;
+}
+
+int PNGOutputStream::numRowsWritten() const
+{
+    return m_nRowsWritten;
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint8_t > rows )
+{
+    return writeRows( rows, 1, 8 );
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint8x2 > rows )
+{
+    return writeRows( rows, 2, 8 );
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint8x3 > rows )
+{
+    return writeRows( rows, 3, 8 );
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint8x4 > rows )
+{
+    return writeRows( rows, 4, 8 );
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint16_t > rows )
+{
+    return writeRows( rows, 1, 16 );
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint16x2 > rows )
+{
+    return writeRows( rows, 2, 16 );
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint16x3 > rows )
+{
+    return writeRows( rows, 3, 16 );
+}
+
+bool PNGOutputStream::write( Array2DReadView< uint16x4 > rows )
+{
+    return writeRows( rows, 4, 16 );
+}
+
+bool PNGOutputStream::close()
+{
+    if( m_fp == nullptr )
+    {
+        return false;
+    }
+
+    bool succeeded = m_ok && m_nRowsWritten == m_size.y;
+    if( succeeded )
+    {
+        m_compressor.finish( m_compressed );
+        succeeded = flushCompressed() && writeChunk( "IEND", nullptr, 0 );
+    }
+
+    succeeded = ( fclose( m_fp ) == 0 ) && succeeded;
+    m_fp = nullptr;
+    m_ok = false;
+    return succeeded;
+}
+
+template< typename T >
+bool PNGOutputStream::writeRows( Array2DReadView< T > rows, int nComponents,
+    int bitDepth )
+{
+    if( !isOpen() || rows.isNull() || nComponents != m_nComponents ||
+        bitDepth != m_bitDepth || rows.width() != m_size.x ||
+        rows.height() > m_size.y - m_nRowsWritten )
+    {
+        return false;
+    }
+
+    for( int y = 0; y < rows.height(); ++y )
+    {
+        if( rows.elementsArePacked() )
+        {
+            memcpy( m_row.data(), rows.rowPointer( y ), m_rowBytes );
+        }
+        else
+        {
+            for( int x = 0; x < rows.width(); ++x )
+            {
+                memcpy( m_row.data() + x * sizeof( T ),
+                    rows.elementPointer( { x, y } ), sizeof( T ) );
+            }
+        }
+
+        // PNG is big endian.
+        if( bitDepth == 16 )
+        {
+            for( size_t i = 0; i < m_rowBytes; i += 2 )
+            {
+                std::swap( m_row[ i ], m_row[ i + 1 ] );
+            }
+        }
+
+        filterRow();
+        std::swap( m_row, m_previousRow );
+
+        if( m_compressed.size() >= IDAT_CHUNK_BYTES && !flushCompressed() )
+        {
+            m_ok = false;
+            return false;
+        }
+        ++m_nRowsWritten;
+    }
+
+    return true;
+}
+
+void PNGOutputStream::filterRow()
+{
+    const std::vector< uint8_t >* best = &( m_filtered[ 0 ] );
+
+    if( m_settings.filter == Filter::ADAPTIVE )
+    {
+        uint64_t bestSum = std::numeric_limits< uint64_t >::max();
+        for( int type = 0; type < 5; ++type )
+        {
+            filter( type, m_row.data(), m_previousRow.data(), m_rowBytes,
+                m_bytesPerPixel, m_filtered[ type ].data() );
+            uint64_t sum = sumOfAbsoluteValues(
+                m_filtered[ type ].data() + 1, m_rowBytes );
+            if( sum < bestSum )
+            {
+                bestSum = sum;
+                best = &( m_filtered[ type ] );
+            }
+        }
+    }
+    else
+    {
+        filter( static_cast< int >( m_settings.filter ), m_row.data(),
+            m_previousRow.data(), m_rowBytes, m_bytesPerPixel,
+            m_filtered[ 0 ].data() );
+    }
+
+    m_compressor.write( best->data(), best->size(), m_compressed );
+}
+
+bool PNGOutputStream::writeChunk( const char* type, const uint8_t* data,
+    size_t size )
+{
+    uint8_t header[ 8 ];
+    putBigEndian32( static_cast< uint32_t >( size ), header );
+    memcpy( header + 4, type, 4 );
+
+    uint32_t crc = crc32( header + 4, 4 );
+    crc = crc32( data, size, crc );
+    uint8_t footer[ 4 ];
+    putBigEndian32( crc, footer );
+
+    return fwrite( header, 1, 8, m_fp ) == 8 &&
+        ( size == 0 || fwrite( data, 1, size, m_fp ) == size ) &&
+        fwrite( footer, 1, 4, m_fp ) == 4;
+}
+
+bool PNGOutputStream::flushCompressed()
+{
+    bool succeeded = m_compressed.empty() ||
+        writeChunk( "IDAT", m_compressed.data(), m_compressed.size() );
+    m_compressed.clear();
+    return succeeded;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <common/ArrayView.h>
+#include <common/BasicTypes.h>
+#include <vecmath/Vector2i.h>
+
+#include "io/ZlibStream.h"
+
+// Writes a PNG file a band of rows at a time, so that the whole image never
+// has to be in memory: each band is filtered and compressed as it is
+// written, and the compressed data is flushed to the file in 64 KiB IDAT
+// chunks.
+//
+// Unlike PNGIO::write(), the compression level, filter, and zlib window size
+// can be set. Settings::fast() is several times faster to write than the
+// defaults, at the cost of somewhat larger files.
+//
+// Supports 8 and 16 bits per component, with 1 (gray), 2 (gray and alpha),
+// 3 (RGB), or 4 (RGBA) components, not interlaced.
+class PNGOutputStream
+{
+public:
+
+    // The PNG filter applied to each row before compression.
+    enum class Filter
+    {
+        NONE = 0,
+        SUB = 1,
+        UP = 2,
+        AVERAGE = 3,
+        PAETH = 4,
+
+        // For each row, the filter that minimizes the sum of the absolute
+        // values of the filtered bytes (as signed bytes).
+        ADAPTIVE = 5
+    };
+
+    struct Settings
+    {
+        // From 0 (no compression) to 9 (smallest files).
+        int compressionLevel = 6;
+
+        Filter filter = Filter::ADAPTIVE;
+
+        // log2 of the zlib window size, in [ 8, 15 ].
+        int windowBits = 15;
+
+        // Settings for dumping captured frames, where write speed matters
+        // more than file size.
+        static Settings fast();
+    };
+
+    // The null PNGOutputStream.
+    PNGOutputStream() = default;
+
+    // Creates "filename" and writes the PNG header for a "size" image with
+    // "nComponents" components of "bitDepth" bits each. Check isOpen() for
+    // success.
+    PNGOutputStream( const std::string& filename, const Vector2i& size,
+        int nComponents, int bitDepth );
+    PNGOutputStream( const std::string& filename, const Vector2i& size,
+        int nComponents, int bitDepth, const Settings& settings );
+
+    // Closes the file if it is open.
+    virtual ~PNGOutputStream();
+
+    PNGOutputStream( const PNGOutputStream& copy ) = delete;
+    PNGOutputStream& operator = ( const PNGOutputStream& copy ) = delete;
+
+    bool isOpen() const;
+
+    Vector2i size() const;
+    int numComponents() const;
+    int bitDepth() const;
+
+    // The number of rows written so far.
+    int numRowsWritten() const;
+
+    // Writes the next rows.height() rows of the image, from top to bottom.
+    // Returns false if the element type does not match the image format,
+    // rows.width() != size().x, there are more rows than remain, or on an
+    // I/O error.
+    bool write( Array2DReadView< uint8_t > rows );
+    bool write( Array2DReadView< uint8x2 > rows );
+    bool write( Array2DReadView< uint8x3 > rows );
+    bool write( Array2DReadView< uint8x4 > rows );
+    bool write( Array2DReadView< uint16_t > rows );
+    bool write( Array2DReadView< uint16x2 > rows );
+    bool write( Array2DReadView< uint16x3 > rows );
+    bool write( Array2DReadView< uint16x4 > rows );
+
+    // Finishes the file. Returns false if not every row has been written,
+    // on an I/O error, or if the stream is not open.
+    bool close();
+
+private:
+
+    template< typename T >
+    bool writeRows( Array2DReadView< T > rows, int nComponents,
+        int bitDepth );
+
+    // Filters m_row against m_previousRow into m_filtered.
+    void filterRow();
+
+    bool writeChunk( const char* type, const uint8_t* data, size_t size );
+
+    // Writes compressed data as IDAT chunks.
+    bool flushCompressed();
+
+    FILE* m_fp = nullptr;
+
+    Vector2i m_size;
+    int m_nComponents = 0;
+    int m_bitDepth = 0;
+    Settings m_settings;
+
+    int m_bytesPerPixel = 0;
+    size_t m_rowBytes = 0;
+    int m_nRowsWritten = 0;
+
+    std::vector< uint8_t > m_row;
+    std::vector< uint8_t > m_previousRow;
+
+    // The filter type byte followed by the filtered row. For
+    // Filter::ADAPTIVE, one per filter type.
+    std::vector< uint8_t > m_filtered[ 5 ];
+
+    libcgt::core::io::ZlibCompressor m_compressor;
+    std::vector< uint8_t > m_compressed;
+
+    bool m_ok = false;
+};
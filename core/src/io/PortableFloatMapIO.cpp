@@ -1,5 +1,87 @@
 #include "io/PortableFloatMapIO.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#include "common/NewDeleteAllocator.h"
+#include "concurrency/ThreadPool.h"
+#include "io/MemoryMappedFile.h"
+
+namespace
+{
+
+// Enough for the magic number, dimensions, scale, and a short comment.
+const size_t MAX_HEADER_BYTES = 256;
+
+// Reverses the bytes of each of "nFloats" floats.
+void swapBytes( void* data, size_t nFloats )
+{
+    uint8_t* bytes = reinterpret_cast< uint8_t* >( data );
+    for( size_t i = 0; i < nFloats; ++i, bytes += 4 )
+    {
+        std::swap( bytes[ 0 ], bytes[ 3 ] );
+        std::swap( bytes[ 1 ], bytes[ 2 ] );
+    }
+}
+
+// Skips whitespace and comment lines (which begin with '#').
+void skipWhitespace( const uint8_t* data, size_t size, size_t& i )
+{
+    while( i < size )
+    {
+        if( isspace( data[ i ] ) )
+        {
+            ++i;
+        }
+        else if( data[ i ] == '#' )
+        {
+            while( i < size && data[ i ] != '\n' )
+            {
+                ++i;
+            }
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+// Copies the next whitespace-delimited token into "token" and
+// null-terminates it. Returns false if there is none or it is too long.
+bool nextToken( const uint8_t* data, size_t size, size_t& i,
+    char token[ 32 ] )
+{
+    skipWhitespace( data, size, i );
+    int n = 0;
+    while( i < size && !isspace( data[ i ] ) )
+    {
+        if( n == 31 )
+        {
+            return false;
+        }
+        token[ n ] = static_cast< char >( data[ i ] );
+        ++n;
+        ++i;
+    }
+    token[ n ] = '\0';
+    return n > 0;
+}
+
+// Reads and parses the header at the start of "fp", leaving it positioned
+// at the start of the data.
+bool readHeader( FILE* fp, PortableFloatMapIO::PFMHeader& header )
+{
+    uint8_t buffer[ MAX_HEADER_BYTES ];
+    size_t n = fread( buffer, 1, sizeof( buffer ), fp );
+    return PortableFloatMapIO::parseHeader( buffer, n, header ) &&
+        fseek( fp, static_cast< long >( header.dataOffset ), SEEK_SET ) == 0;
+}
+
+}
+
 // static
 PortableFloatMapIO::PFMData PortableFloatMapIO::read( const std::string& filename )
 {
@@ -12,81 +94,238 @@ PortableFloatMapIO::PFMData PortableFloatMapIO::read( const std::string& filenam
         return output;
     }
 
-    char buffer[ 80 ];
+    PFMHeader header;
+    if( !::readHeader( fp, header ) )
+    {
+        fclose( fp );
+        return output;
+    }
+
+    // Allocate without initializing: every element is about to be read.
+    void* pointer = NewDeleteAllocator::instance()->allocate(
+        header.nComponents * sizeof( float ) *
+        header.size.x * header.size.y );
+
+    bool succeeded = false;
+    if( header.nComponents == 1 )
+    {
+        output.grayscale = Array2D< float >( pointer, header.size );
+        succeeded = readData( fp, header, output.grayscale.writeView(),
+            false );
+    }
+    else if( header.nComponents == 2 )
+    {
+        output.rg = Array2D< Vector2f >( pointer, header.size );
+        succeeded = readData( fp, header, output.rg.writeView(), false );
+    }
+    else if( header.nComponents == 3 )
+    {
+        output.rgb = Array2D< Vector3f >( pointer, header.size );
+        succeeded = readData( fp, header, output.rgb.writeView(), false );
+    }
+    else if( header.nComponents == 4 )
+    {
+        output.rgba = Array2D< Vector4f >( pointer, header.size );
+        succeeded = readData( fp, header, output.rgba.writeView(), false );
+    }
+    fclose( fp );
 
-    // Read the top level header
-    char* readStatus = fgets( buffer, 80, fp );
-    if( readStatus == nullptr )
+    if( !succeeded )
     {
+        output.grayscale.invalidate();
+        output.rg.invalidate();
+        output.rgb.invalidate();
+        output.rgba.invalidate();
         return output;
     }
 
-    int nComponents = 0;
-    if( strncmp( buffer, "Pf", 2 ) == 0 )
+    output.valid = true;
+    output.nComponents = header.nComponents;
+    output.scale = header.scale;
+    return output;
+}
+
+// static
+bool PortableFloatMapIO::parseHeader( const uint8_t* data, size_t size,
+    PFMHeader& header )
+{
+    if( size < 3 || data[ 0 ] != 'P' )
     {
-        nComponents = 1;
+        return false;
     }
-    else if( strncmp( buffer, "PF2", 3 ) == 0 )
+
+    size_t i;
+    if( data[ 1 ] == 'f' )
+    {
+        header.nComponents = 1;
+        i = 2;
+    }
+    else if( data[ 1 ] == 'F' && data[ 2 ] == '2' )
     {
-        nComponents = 2;
+        header.nComponents = 2;
+        i = 3;
     }
-    else if( strncmp( buffer, "PF4", 3 ) == 0 )
+    else if( data[ 1 ] == 'F' && data[ 2 ] == '4' )
     {
-        nComponents = 4;
+        header.nComponents = 4;
+        i = 3;
     }
-    else if( strncmp( buffer, "PF", 2 ) == 0 )
+    else if( data[ 1 ] == 'F' )
     {
-        nComponents = 3;
+        header.nComponents = 3;
+        i = 2;
     }
     else
     {
-        fclose( fp );
-        return output;
+        return false;
     }
 
-    // TODO: read comments: lines that begin with #
-    int width;
-    int height;
-    float scale;
-    int nMatches = fscanf( fp, "%d %d %f\n", &width, &height, &scale );
-    if( nMatches != 3 || width <= 0 || height <= 0 )
+    char width[ 32 ];
+    char height[ 32 ];
+    char scale[ 32 ];
+    if( i >= size || !isspace( data[ i ] ) ||
+        !nextToken( data, size, i, width ) ||
+        !nextToken( data, size, i, height ) ||
+        !nextToken( data, size, i, scale ) )
     {
-        fclose( fp );
-        return output;
+        return false;
     }
 
-    float* floatData = new float[ nComponents * width * height ];
-    size_t nElementsRead =
-        fread( floatData, nComponents * sizeof( float ), width * height, fp );
-    if( nElementsRead != width * height )
+    // Exactly one whitespace character separates the header from the data.
+    if( i >= size || !isspace( data[ i ] ) )
     {
-        delete[] floatData;
-        fclose( fp );
-        return output;
+        return false;
     }
+    header.dataOffset = i + 1;
 
-    if( nComponents == 1 )
+    char* end;
+    int64_t w = strtoll( width, &end, 10 );
+    if( *end != '\0' )
     {
-        output.grayscale = Array2D< float >( floatData, { width, height } );
+        return false;
     }
-    else if( nComponents == 2 )
+    int64_t h = strtoll( height, &end, 10 );
+    if( *end != '\0' )
     {
-        output.rg = Array2D< Vector2f >( floatData, { width, height } );
+        return false;
     }
-    else if( nComponents == 3 )
+    header.scale = strtof( scale, &end );
+    if( *end != '\0' || header.scale == 0 )
     {
-        output.rgb = Array2D< Vector3f >( floatData, { width, height } );
+        return false;
     }
-    else if( nComponents == 4 )
+
+    // Also rejects sizes whose number of bytes would overflow an int.
+    if( w <= 0 || h <= 0 ||
+        w * h > INT32_MAX / ( 4 * header.nComponents ) )
     {
-        output.rgba = Array2D< Vector4f >( floatData, { width, height } );
+        return false;
     }
+    header.size = { static_cast< int >( w ), static_cast< int >( h ) };
+    return true;
+}
 
-    output.valid = true;
-    output.nComponents = nComponents;
-    output.scale = scale;
+// static
+bool PortableFloatMapIO::readHeader( const std::string& filename,
+    PFMHeader& header )
+{
+    FILE* fp = fopen( filename.c_str(), "rb" );
+    if( fp == nullptr )
+    {
+        return false;
+    }
+    bool succeeded = ::readHeader( fp, header );
     fclose( fp );
-    return output;
+    return succeeded;
+}
+
+// static
+bool PortableFloatMapIO::read( const std::string& filename,
+    Array2DWriteView< float > output, bool flipY )
+{
+    return readFile( filename, output, flipY );
+}
+
+// static
+bool PortableFloatMapIO::read( const std::string& filename,
+    Array2DWriteView< Vector2f > output, bool flipY )
+{
+    return readFile( filename, output, flipY );
+}
+
+// static
+bool PortableFloatMapIO::read( const std::string& filename,
+    Array2DWriteView< Vector3f > output, bool flipY )
+{
+    return readFile( filename, output, flipY );
+}
+
+// static
+bool PortableFloatMapIO::read( const std::string& filename,
+    Array2DWriteView< Vector4f > output, bool flipY )
+{
+    return readFile( filename, output, flipY );
+}
+
+// static
+bool PortableFloatMapIO::read( const MemoryMappedFile& file,
+    Array2DWriteView< float > output, bool flipY )
+{
+    return readMapped( file, output, flipY );
+}
+
+// static
+bool PortableFloatMapIO::read( const MemoryMappedFile& file,
+    Array2DWriteView< Vector2f > output, bool flipY )
+{
+    return readMapped( file, output, flipY );
+}
+
+// static
+bool PortableFloatMapIO::read( const MemoryMappedFile& file,
+    Array2DWriteView< Vector3f > output, bool flipY )
+{
+    return readMapped( file, output, flipY );
+}
+
+// static
+bool PortableFloatMapIO::read( const MemoryMappedFile& file,
+    Array2DWriteView< Vector4f > output, bool flipY )
+{
+    return readMapped( file, output, flipY );
+}
+
+// static
+int PortableFloatMapIO::readSequence(
+    const std::vector< std::string >& filenames,
+    Array3DWriteView< float > output, bool flipY,
+    std::vector< bool >* succeeded )
+{
+    const int nFiles = static_cast< int >( filenames.size() );
+
+    // std::vector< bool > is not safe to write from several threads.
+    std::vector< uint8_t > fileSucceeded( nFiles, 0 );
+    if( output.notNull() && output.depth() == nFiles )
+    {
+        libcgt::core::concurrency::ThreadPool::global().parallelFor(
+            0, nFiles, 1,
+            [&] ( int begin, int end )
+            {
+                for( int z = begin; z < end; ++z )
+                {
+                    fileSucceeded[ z ] =
+                        read( filenames[ z ], output.zSlice( z ), flipY );
+                }
+            }
+        );
+    }
+
+    if( succeeded != nullptr )
+    {
+        succeeded->assign( fileSucceeded.begin(), fileSucceeded.end() );
+    }
+    return static_cast< int >(
+        std::count( fileSucceeded.begin(), fileSucceeded.end(), 1 ) );
 }
 
 // static
@@ -288,3 +527,151 @@ bool PortableFloatMapIO::write( const std::string& filename, Array2DReadView< Ve
     fclose( pFile );
     return true;
 }
+
+// static
+template< typename T >
+bool PortableFloatMapIO::readData( FILE* fp, const PFMHeader& header,
+    Array2DWriteView< T > output, bool flipY )
+{
+    const int nComponents = sizeof( T ) / sizeof( float );
+    if( output.isNull() || header.nComponents != nComponents ||
+        output.width() != header.size.x || output.height() != header.size.y )
+    {
+        return false;
+    }
+
+    // The data is big endian if the scale is positive.
+    const bool swap = ( header.scale > 0 );
+    const int w = output.width();
+    const int h = output.height();
+
+    // All at once.
+    if( output.packed() && !flipY )
+    {
+        size_t n = output.numElements();
+        if( fread( output.pointer(), sizeof( T ), n, fp ) != n )
+        {
+            return false;
+        }
+        if( swap )
+        {
+            swapBytes( output.pointer(), n * nComponents );
+        }
+    }
+    // Row by row.
+    else if( output.elementsArePacked() )
+    {
+        for( int y = 0; y < h; ++y )
+        {
+            T* row = output.rowPointer( flipY ? h - 1 - y : y );
+            if( fread( row, sizeof( T ), w, fp ) != static_cast< size_t >( w ) )
+            {
+                return false;
+            }
+            if( swap )
+            {
+                swapBytes( row, w * nComponents );
+            }
+        }
+    }
+    // Through a buffer on the stack, then element by element.
+    else
+    {
+        float buffer[ 1024 ];
+        const int elementsPerChunk = 1024 / nComponents;
+        for( int y = 0; y < h; ++y )
+        {
+            int outputY = flipY ? h - 1 - y : y;
+            for( int x0 = 0; x0 < w; x0 += elementsPerChunk )
+            {
+                int n = std::min( elementsPerChunk, w - x0 );
+                if( fread( buffer, sizeof( T ), n, fp ) !=
+                    static_cast< size_t >( n ) )
+                {
+                    return false;
+                }
+                if( swap )
+                {
+                    swapBytes( buffer, n * nComponents );
+                }
+                for( int x = 0; x < n; ++x )
+                {
+                    memcpy( output.elementPointer( { x0 + x, outputY } ),
+                        buffer + x * nComponents, sizeof( T ) );
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// static
+template< typename T >
+bool PortableFloatMapIO::readFile( const std::string& filename,
+    Array2DWriteView< T > output, bool flipY )
+{
+    FILE* fp = fopen( filename.c_str(), "rb" );
+    if( fp == nullptr )
+    {
+        return false;
+    }
+
+    PFMHeader header;
+    bool succeeded = ::readHeader( fp, header ) &&
+        readData( fp, header, output, flipY );
+    fclose( fp );
+    return succeeded;
+}
+
+// static
+template< typename T >
+bool PortableFloatMapIO::readMapped( const MemoryMappedFile& file,
+    Array2DWriteView< T > output, bool flipY )
+{
+    const int nComponents = sizeof( T ) / sizeof( float );
+    PFMHeader header;
+    if( !file.isValid() ||
+        !parseHeader( file.data(), file.size(), header ) ||
+        output.isNull() || header.nComponents != nComponents ||
+        output.width() != header.size.x || output.height() != header.size.y )
+    {
+        return false;
+    }
+
+    const int w = output.width();
+    const int h = output.height();
+    const size_t rowBytes = w * sizeof( T );
+    if( file.size() < header.dataOffset + h * rowBytes )
+    {
+        return false;
+    }
+
+    const bool swap = ( header.scale > 0 );
+    const uint8_t* src = file.data() + header.dataOffset;
+    for( int y = 0; y < h; ++y, src += rowBytes )
+    {
+        int outputY = flipY ? h - 1 - y : y;
+        if( output.elementsArePacked() )
+        {
+            T* row = output.rowPointer( outputY );
+            memcpy( row, src, rowBytes );
+            if( swap )
+            {
+                swapBytes( row, w * nComponents );
+            }
+        }
+        else
+        {
+            for( int x = 0; x < w; ++x )
+            {
+                T* dst = output.elementPointer( { x, outputY } );
+                memcpy( dst, src + x * sizeof( T ), sizeof( T ) );
+                if( swap )
+                {
+                    swapBytes( dst, nComponents );
+                }
+            }
+        }
+    }
+    return true;
+}
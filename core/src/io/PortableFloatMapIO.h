@@ -1,17 +1,42 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <string>
+#include <vector>
 
 #include <common/ArrayView.h>
 #include <common/Array2D.h>
 #include <vecmath/Vector2f.h>
+#include <vecmath/Vector2i.h>
 #include <vecmath/Vector3f.h>
 #include <vecmath/Vector4f.h>
 
+class MemoryMappedFile;
+
+// Reads and writes PFM files. Rows are stored in the file in the same order
+// as in memory: since PFM rows go from bottom to top, this matches images
+// whose y axis points up. Pass flipY = true to the read-into-view functions
+// for images whose y axis points down.
 class PortableFloatMapIO
 {
 public:
 
+    struct PFMHeader
+    {
+        // 1 ("Pf"), 2 ("PF2"), 3 ("PF"), or 4 ("PF4").
+        int nComponents;
+        Vector2i size;
+
+        // The absolute value is the scale. The data is little endian if
+        // negative and big endian if positive.
+        float scale;
+
+        // Offset of the pixel data from the start of the file, in bytes.
+        size_t dataOffset;
+    };
+
     struct PFMData
     {
         bool valid;
@@ -26,6 +51,53 @@ public:
 
     static PFMData read( const std::string& filename );
 
+    // Parses the header at the start of "data", which has "size" bytes.
+    // Returns false if it is malformed.
+    static bool parseHeader( const uint8_t* data, size_t size,
+        PFMHeader& header );
+
+    // Reads the header of "filename". Returns false on failure.
+    static bool readHeader( const std::string& filename, PFMHeader& header );
+
+    // Reads "filename" directly into "output", which must match the file's
+    // size and number of components. Nothing is allocated, so the same
+    // buffer can be reused for a sequence of files. If flipY is true, row y
+    // of the file is written to row height - 1 - y of output.
+    //
+    // Returns false on failure, in which case "output" may have been
+    // partially overwritten.
+    static bool read( const std::string& filename,
+        Array2DWriteView< float > output, bool flipY = false );
+    static bool read( const std::string& filename,
+        Array2DWriteView< Vector2f > output, bool flipY = false );
+    static bool read( const std::string& filename,
+        Array2DWriteView< Vector3f > output, bool flipY = false );
+    static bool read( const std::string& filename,
+        Array2DWriteView< Vector4f > output, bool flipY = false );
+
+    // Same as above, but from a memory mapped file. Each row is copied
+    // straight out of the mapping.
+    static bool read( const MemoryMappedFile& file,
+        Array2DWriteView< float > output, bool flipY = false );
+    static bool read( const MemoryMappedFile& file,
+        Array2DWriteView< Vector2f > output, bool flipY = false );
+    static bool read( const MemoryMappedFile& file,
+        Array2DWriteView< Vector3f > output, bool flipY = false );
+    static bool read( const MemoryMappedFile& file,
+        Array2DWriteView< Vector4f > output, bool flipY = false );
+
+    // Reads grayscale file filenames[ z ] into output.zSlice( z ), for each
+    // z in parallel on ThreadPool::global(). Every file must be
+    // output.width() x output.height(), and output.depth() must equal
+    // filenames.size().
+    //
+    // Returns the number of files that were read successfully. If
+    // "succeeded" is not null, it is resized and set to whether each file was
+    // read.
+    static int readSequence( const std::vector< std::string >& filenames,
+        Array3DWriteView< float > output, bool flipY = false,
+        std::vector< bool >* succeeded = nullptr );
+
     // Writes a standard "PFM" format.
     // Header is "Pf" - grayscale.
     static bool write( const std::string& filename,
@@ -45,4 +117,20 @@ public:
     // The header is "PF4", and includes an alpha channel.
     static bool write( const std::string& filename,
         Array2DReadView< Vector4f > image );
+
+private:
+
+    // Reads the pixel data following a header into "output", from "fp"
+    // positioned at header.dataOffset.
+    template< typename T >
+    static bool readData( FILE* fp, const PFMHeader& header,
+        Array2DWriteView< T > output, bool flipY );
+
+    template< typename T >
+    static bool readFile( const std::string& filename,
+        Array2DWriteView< T > output, bool flipY );
+
+    template< typename T >
+    static bool readMapped( const MemoryMappedFile& file,
+        Array2DWriteView< T > output, bool flipY );
 };
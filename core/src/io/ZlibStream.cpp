@@ -0,0 +1,1362 @@
+#include "io/ZlibStream.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+const int MIN_MATCH = 3;
+const int MAX_MATCH = 258;
+
+// Bytes held back from the end of the input until more arrives or the
+// stream is finished (like zlib's MIN_LOOKAHEAD), so that output does not
+// depend on how the input is split into write()s. Lazy matching may move
+// up to MAX_MATCH - MIN_MATCH bytes past the first position considered, and
+// a match starting there may be MAX_MATCH long and needs MIN_MATCH bytes
+// after it to be hashed.
+const int LOOKAHEAD = 2 * MAX_MATCH + MIN_MATCH;
+
+const int HASH_BITS = 15;
+
+// Blocks are ended after this many symbols or input bytes, so that their
+// Huffman codes adapt to the data and the stored fallback stays small.
+const size_t MAX_BLOCK_SYMBOLS = 16384;
+const int64_t MAX_BLOCK_BYTES = 1 << 17;
+
+const int MAX_STORED_BYTES = 65535;
+
+const int END_OF_BLOCK = 256;
+const int N_LITERAL_LENGTH_CODES = 286;
+const int N_DISTANCE_CODES = 30;
+const int N_CODE_LENGTH_CODES = 19;
+
+const uint16_t LENGTH_BASE[ 29 ] =
+{
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+const uint8_t LENGTH_EXTRA_BITS[ 29 ] =
+{
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+const uint16_t DISTANCE_BASE[ 30 ] =
+{
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+    16385, 24577
+};
+
+const uint8_t DISTANCE_EXTRA_BITS[ 30 ] =
+{
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+const uint8_t CODE_LENGTH_ORDER[ N_CODE_LENGTH_CODES ] =
+{
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Match finder parameters for each level, after zlib's.
+struct LevelParameters
+{
+    int maxChainLength;
+
+    // Stop searching once a match is at least this long.
+    int niceLength;
+
+    // Look for a longer match at the next byte if the current match is
+    // shorter than this. 0 disables lazy matching.
+    int lazyLength;
+};
+
+const LevelParameters LEVELS[ 10 ] =
+{
+    { 0, 0, 0 },
+    { 4, 8, 0 },
+    { 8, 16, 0 },
+    { 32, 32, 0 },
+    { 16, 16, 4 },
+    { 32, 32, 16 },
+    { 128, 128, 16 },
+    { 256, 128, 32 },
+    { 1024, 258, 128 },
+    { 4096, 258, 258 }
+};
+
+struct Tables
+{
+    uint32_t crc[ 256 ];
+
+    // Length 3 .. 258 --> code index 0 .. 28.
+    uint8_t lengthCode[ MAX_MATCH + 1 ];
+
+    Tables()
+    {
+        for( uint32_t i = 0; i < 256; ++i )
+        {
+            uint32_t c = i;
+            for( int k = 0; k < 8; ++k )
+            {
+                c = ( c & 1 ) ? ( 0xedb88320u ^ ( c >> 1 ) ) : ( c >> 1 );
+            }
+            crc[ i ] = c;
+        }
+
+        for( int code = 0; code < 29; ++code )
+        {
+            int end = ( code == 28 ) ? MAX_MATCH + 1 :
+                LENGTH_BASE[ code ] + ( 1 << LENGTH_EXTRA_BITS[ code ] );
+            for( int length = LENGTH_BASE[ code ]; length < end; ++length )
+            {
+                lengthCode[ length ] = static_cast< uint8_t >( code );
+            }
+        }
+        // 258 has its own code, not 227 + 31.
+        lengthCode[ MAX_MATCH ] = 28;
+    }
+};
+
+const Tables& tables()
+{
+    static Tables s_tables;
+    return s_tables;
+}
+
+int distanceCode( int distance )
+{
+    return static_cast< int >( std::upper_bound( DISTANCE_BASE,
+        DISTANCE_BASE + N_DISTANCE_CODES, distance ) - DISTANCE_BASE ) - 1;
+}
+
+uint32_t reverseBits( uint32_t code, int nBits )
+{
+    uint32_t reversed = 0;
+    for( int i = 0; i < nBits; ++i )
+    {
+        reversed = ( reversed << 1 ) | ( code & 1 );
+        code >>= 1;
+    }
+    return reversed;
+}
+
+// Computes the lengths of a Huffman code for "frequencies", limited to
+// "maxLength" bits. Unused symbols get length 0.
+void huffmanLengths( const uint32_t* frequencies, int n, int maxLength,
+    uint8_t* lengths )
+{
+    std::fill( lengths, lengths + n, 0 );
+
+    // ( frequency, symbol ), in increasing order of frequency.
+    std::vector< std::pair< uint32_t, int > > used;
+    for( int i = 0; i < n; ++i )
+    {
+        if( frequencies[ i ] > 0 )
+        {
+            used.emplace_back( frequencies[ i ], i );
+        }
+    }
+    std::sort( used.begin(), used.end() );
+
+    int nUsed = static_cast< int >( used.size() );
+    if( nUsed == 0 )
+    {
+        return;
+    }
+    if( nUsed == 1 )
+    {
+        lengths[ used[ 0 ].second ] = 1;
+        return;
+    }
+
+    // Moffat and Katajainen's in-place algorithm: turns the sorted
+    // frequencies into code lengths, in decreasing order.
+    std::vector< uint32_t > a( nUsed );
+    for( int i = 0; i < nUsed; ++i )
+    {
+        a[ i ] = used[ i ].first;
+    }
+
+    a[ 0 ] += a[ 1 ];
+    int root = 0;
+    int leaf = 2;
+    for( int next = 1; next < nUsed - 1; ++next )
+    {
+        if( leaf >= nUsed || a[ root ] < a[ leaf ] )
+        {
+            a[ next ] = a[ root ];
+            a[ root++ ] = next;
+        }
+        else
+        {
+            a[ next ] = a[ leaf++ ];
+        }
+
+        if( leaf >= nUsed || ( root < next && a[ root ] < a[ leaf ] ) )
+        {
+            a[ next ] += a[ root ];
+            a[ root++ ] = next;
+        }
+        else
+        {
+            a[ next ] += a[ leaf++ ];
+        }
+    }
+
+    a[ nUsed - 2 ] = 0;
+    for( int next = nUsed - 3; next >= 0; --next )
+    {
+        a[ next ] = a[ a[ next ] ] + 1;
+    }
+
+    int available = 1;
+    int nUsedAtDepth = 0;
+    uint32_t depth = 0;
+    root = nUsed - 2;
+    int next = nUsed - 1;
+    while( available > 0 )
+    {
+        while( root >= 0 && a[ root ] == depth )
+        {
+            ++nUsedAtDepth;
+            --root;
+        }
+        while( available > nUsedAtDepth )
+        {
+            a[ next-- ] = depth;
+            --available;
+        }
+        available = 2 * nUsedAtDepth;
+        ++depth;
+        nUsedAtDepth = 0;
+    }
+
+    // Count codes of each length, moving overly long ones to maxLength, then
+    // lengthen shorter codes until the code is complete again.
+    std::vector< int > counts( std::max< uint32_t >( depth, maxLength ) + 1 );
+    for( int i = 0; i < nUsed; ++i )
+    {
+        ++counts[ std::min< uint32_t >( a[ i ], maxLength ) ];
+    }
+
+    uint32_t total = 0;
+    for( int length = maxLength; length > 0; --length )
+    {
+        total += static_cast< uint32_t >( counts[ length ] ) <<
+            ( maxLength - length );
+    }
+    while( total > ( 1u << maxLength ) )
+    {
+        --counts[ maxLength ];
+        for( int length = maxLength - 1; length > 0; --length )
+        {
+            if( counts[ length ] > 0 )
+            {
+                --counts[ length ];
+                counts[ length + 1 ] += 2;
+                break;
+            }
+        }
+        --total;
+    }
+
+    // The most frequent symbols get the shortest codes.
+    int symbol = nUsed;
+    for( int length = 1; length <= maxLength; ++length )
+    {
+        for( int i = 0; i < counts[ length ]; ++i )
+        {
+            lengths[ used[ --symbol ].second ] =
+                static_cast< uint8_t >( length );
+        }
+    }
+}
+
+// Canonical codes for "lengths", bit reversed for output.
+void huffmanCodes( const uint8_t* lengths, int n, uint16_t* codes )
+{
+    int counts[ 16 ] = {};
+    for( int i = 0; i < n; ++i )
+    {
+        ++counts[ lengths[ i ] ];
+    }
+    counts[ 0 ] = 0;
+
+    uint32_t nextCode[ 16 ] = {};
+    uint32_t code = 0;
+    for( int length = 1; length < 16; ++length )
+    {
+        code = ( code + counts[ length - 1 ] ) << 1;
+        nextCode[ length ] = code;
+    }
+
+    for( int i = 0; i < n; ++i )
+    {
+        codes[ i ] = static_cast< uint16_t >( lengths[ i ] > 0 ?
+            reverseBits( nextCode[ lengths[ i ] ]++, lengths[ i ] ) : 0 );
+    }
+}
+
+void fixedLengths( uint8_t* literalLengthLengths, uint8_t* distanceLengths )
+{
+    for( int i = 0; i < 288; ++i )
+    {
+        literalLengthLengths[ i ] = static_cast< uint8_t >(
+            i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8 );
+    }
+    std::fill( distanceLengths, distanceLengths + 32, 5 );
+}
+
+// A run length encoded sequence of code lengths, for a dynamic block header.
+struct CodeLengthRun
+{
+    uint8_t symbol;
+    uint8_t extraBits;
+    uint8_t nExtraBits;
+};
+
+std::vector< CodeLengthRun > encodeCodeLengths( const uint8_t* lengths,
+    int n )
+{
+    std::vector< CodeLengthRun > runs;
+    int i = 0;
+    while( i < n )
+    {
+        uint8_t length = lengths[ i ];
+        int runLength = 1;
+        while( i + runLength < n && lengths[ i + runLength ] == length )
+        {
+            ++runLength;
+        }
+        i += runLength;
+
+        if( length == 0 )
+        {
+            while( runLength >= 11 )
+            {
+                int r = std::min( runLength, 138 );
+                runs.push_back( { 18, static_cast< uint8_t >( r - 11 ), 7 } );
+                runLength -= r;
+            }
+            if( runLength >= 3 )
+            {
+                runs.push_back(
+                    { 17, static_cast< uint8_t >( runLength - 3 ), 3 } );
+                runLength = 0;
+            }
+        }
+        else
+        {
+            runs.push_back( { length, 0, 0 } );
+            --runLength;
+            while( runLength >= 3 )
+            {
+                int r = std::min( runLength, 6 );
+                runs.push_back( { 16, static_cast< uint8_t >( r - 3 ), 2 } );
+                runLength -= r;
+            }
+        }
+
+        for( ; runLength > 0; --runLength )
+        {
+            runs.push_back( { length, 0, 0 } );
+        }
+    }
+    return runs;
+}
+
+}
+
+namespace libcgt { namespace core { namespace io {
+
+uint32_t crc32( const uint8_t* data, size_t size, uint32_t crc )
+{
+    const uint32_t* table = tables().crc;
+    crc = ~crc;
+    for( size_t i = 0; i < size; ++i )
+    {
+        crc = table[ ( crc ^ data[ i ] ) & 0xff ] ^ ( crc >> 8 );
+    }
+    return ~crc;
+}
+
+uint32_t adler32( const uint8_t* data, size_t size, uint32_t adler )
+{
+    const uint32_t MOD_ADLER = 65521;
+
+    // The largest n such that 255 n ( n + 1 ) / 2 + ( n + 1 ) ( 65520 )
+    // fits in 32 bits, so that the sums are only reduced once per block.
+    const size_t BLOCK_SIZE = 5552;
+
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+    while( size > 0 )
+    {
+        size_t n = std::min( size, BLOCK_SIZE );
+        for( size_t i = 0; i < n; ++i )
+        {
+            a += data[ i ];
+            b += a;
+        }
+        a %= MOD_ADLER;
+        b %= MOD_ADLER;
+        data += n;
+        size -= n;
+    }
+    return ( b << 16 ) | a;
+}
+
+ZlibCompressor::ZlibCompressor( int level, int windowBits ) :
+    m_level( std::min( std::max( level, 0 ), 9 ) ),
+    m_windowSize( 1 << std::min( std::max( windowBits, 8 ), 15 ) )
+{
+    m_maxChainLength = LEVELS[ m_level ].maxChainLength;
+    m_niceLength = LEVELS[ m_level ].niceLength;
+    m_lazyLength = LEVELS[ m_level ].lazyLength;
+
+    if( m_level > 0 )
+    {
+        m_head.assign( 1 << HASH_BITS, -1 );
+        m_previous.assign( m_windowSize, -1 );
+        m_symbols.reserve( MAX_BLOCK_SYMBOLS );
+    }
+}
+
+void ZlibCompressor::write( const uint8_t* input, size_t size,
+    std::vector< uint8_t >& output )
+{
+    m_output = &output;
+
+    if( !m_headerWritten )
+    {
+        // CINFO = log2( window size ) - 8, CM = 8 (deflate), and FLEVEL,
+        // with FCHECK making the header a multiple of 31.
+        int windowBits = 0;
+        while( ( 1 << windowBits ) < m_windowSize )
+        {
+            ++windowBits;
+        }
+        uint32_t cmf = ( ( windowBits - 8 ) << 4 ) | 8;
+        uint32_t flevel = m_level < 2 ? 0 : m_level < 6 ? 1 :
+            m_level == 6 ? 2 : 3;
+        uint32_t flg = flevel << 6;
+        flg += 31 - ( cmf * 256 + flg ) % 31;
+        output.push_back( static_cast< uint8_t >( cmf ) );
+        output.push_back( static_cast< uint8_t >( flg ) );
+        m_headerWritten = true;
+    }
+
+    m_adler = adler32( input, size, m_adler );
+    m_buffer.insert( m_buffer.end(), input, input + size );
+    compress( false );
+
+    // Keep the window for future matches, and the current block in case it
+    // is stored.
+    int64_t keepFrom = std::min( m_blockStart, m_position - m_windowSize );
+    if( keepFrom > m_bufferStart )
+    {
+        m_buffer.erase( m_buffer.begin(),
+            m_buffer.begin() + static_cast< size_t >( keepFrom -
+                m_bufferStart ) );
+        m_bufferStart = keepFrom;
+    }
+
+    m_output = nullptr;
+}
+
+void ZlibCompressor::finish( std::vector< uint8_t >& output )
+{
+    if( !m_headerWritten )
+    {
+        write( nullptr, 0, output );
+    }
+
+    m_output = &output;
+    compress( true );
+    emitBlock( true );
+    alignToByte();
+
+    for( int shift = 24; shift >= 0; shift -= 8 )
+    {
+        output.push_back( static_cast< uint8_t >( m_adler >> shift ) );
+    }
+
+    m_output = nullptr;
+}
+
+const uint8_t* ZlibCompressor::bufferPointer( int64_t position ) const
+{
+    return m_buffer.data() + ( position - m_bufferStart );
+}
+
+void ZlibCompressor::insert( int64_t position, int64_t end )
+{
+    if( end - position < MIN_MATCH )
+    {
+        return;
+    }
+
+    const uint8_t* p = bufferPointer( position );
+    uint32_t key = p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 );
+    uint32_t hash = ( key * 2654435761u ) >> ( 32 - HASH_BITS );
+    m_previous[ position & ( m_windowSize - 1 ) ] = m_head[ hash ];
+    m_head[ hash ] = position;
+}
+
+ZlibCompressor::Match ZlibCompressor::findAndInsert( int64_t position,
+    int64_t end )
+{
+    Match best = { 0, 0 };
+    if( end - position < MIN_MATCH )
+    {
+        return best;
+    }
+
+    const uint8_t* p = bufferPointer( position );
+    uint32_t key = p[ 0 ] | ( p[ 1 ] << 8 ) | ( p[ 2 ] << 16 );
+    uint32_t hash = ( key * 2654435761u ) >> ( 32 - HASH_BITS );
+
+    int maxLength = static_cast< int >(
+        std::min< int64_t >( MAX_MATCH, end - position ) );
+    int64_t minPosition = std::max( m_bufferStart,
+        position - m_windowSize );
+
+    int64_t candidate = m_head[ hash ];
+    for( int chain = m_maxChainLength;
+        chain > 0 && candidate >= minPosition; --chain )
+    {
+        const uint8_t* q = bufferPointer( candidate );
+        if( q[ best.length ] == p[ best.length ] && q[ 0 ] == p[ 0 ] )
+        {
+            int length = 0;
+            while( length < maxLength && q[ length ] == p[ length ] )
+            {
+                ++length;
+            }
+            if( length > best.length )
+            {
+                best.length = length;
+                best.distance = static_cast< int >( position - candidate );
+                if( length >= m_niceLength || length == maxLength )
+                {
+                    break;
+                }
+            }
+        }
+
+        int64_t next = m_previous[ candidate & ( m_windowSize - 1 ) ];
+        if( next >= candidate )
+        {
+            // The slot was reused by a newer position.
+            break;
+        }
+        candidate = next;
+    }
+
+    m_previous[ position & ( m_windowSize - 1 ) ] = m_head[ hash ];
+    m_head[ hash ] = position;
+
+    if( best.length < MIN_MATCH )
+    {
+        best.length = 0;
+    }
+    return best;
+}
+
+void ZlibCompressor::compress( bool flush )
+{
+    int64_t end = m_bufferStart + static_cast< int64_t >( m_buffer.size() );
+
+    if( m_level == 0 )
+    {
+        while( m_position < end )
+        {
+            m_position = std::min( end, m_blockStart + MAX_STORED_BYTES );
+            if( m_position - m_blockStart == MAX_STORED_BYTES )
+            {
+                emitBlock( false );
+            }
+        }
+        return;
+    }
+
+    // Positions before "limit" have enough lookahead. See LOOKAHEAD.
+    int64_t limit = flush ? end : end - LOOKAHEAD;
+    while( m_position < limit )
+    {
+        Match match = findAndInsert( m_position, end );
+
+        // Lazy matching: if the next byte starts a longer match, emit this
+        // byte as a literal instead.
+        while( match.length > 0 && match.length < m_lazyLength &&
+            m_position + 1 < end )
+        {
+            Match next = findAndInsert( m_position + 1, end );
+            if( next.length <= match.length )
+            {
+                // m_position + 1 was already inserted.
+                addMatch( match );
+                for( int i = 2; i < match.length; ++i )
+                {
+                    insert( m_position + i, end );
+                }
+                m_position += match.length;
+                match.length = -1;
+                break;
+            }
+
+            addLiteral( m_position );
+            ++m_position;
+            match = next;
+        }
+
+        if( match.length > 0 )
+        {
+            addMatch( match );
+
+            // Fast levels skip indexing the inside of long matches.
+            if( m_lazyLength > 0 || match.length <= m_niceLength )
+            {
+                for( int i = 1; i < match.length; ++i )
+                {
+                    insert( m_position + i, end );
+                }
+            }
+            m_position += match.length;
+        }
+        else if( match.length == 0 )
+        {
+            addLiteral( m_position );
+            ++m_position;
+        }
+
+        if( m_symbols.size() >= MAX_BLOCK_SYMBOLS ||
+            m_position - m_blockStart >= MAX_BLOCK_BYTES )
+        {
+            emitBlock( false );
+        }
+    }
+}
+
+void ZlibCompressor::addLiteral( int64_t position )
+{
+    m_symbols.push_back( { *bufferPointer( position ), 0 } );
+}
+
+void ZlibCompressor::addMatch( const Match& match )
+{
+    m_symbols.push_back( { static_cast< uint16_t >( match.length ),
+        static_cast< uint16_t >( match.distance ) } );
+}
+
+void ZlibCompressor::emitBlock( bool final )
+{
+    if( m_level == 0 )
+    {
+        emitStored( final );
+        m_blockStart = m_position;
+        return;
+    }
+
+    const Tables& t = tables();
+
+    uint32_t literalLengthFrequencies[ 288 ] = {};
+    uint32_t distanceFrequencies[ 32 ] = {};
+    uint64_t nExtraBits = 0;
+    for( const Symbol& s : m_symbols )
+    {
+        if( s.distance == 0 )
+        {
+            ++literalLengthFrequencies[ s.literalOrLength ];
+        }
+        else
+        {
+            int lengthCode = t.lengthCode[ s.literalOrLength ];
+            int distCode = distanceCode( s.distance );
+            ++literalLengthFrequencies[ 257 + lengthCode ];
+            ++distanceFrequencies[ distCode ];
+            nExtraBits += LENGTH_EXTRA_BITS[ lengthCode ] +
+                DISTANCE_EXTRA_BITS[ distCode ];
+        }
+    }
+    ++literalLengthFrequencies[ END_OF_BLOCK ];
+
+    // Dynamic code.
+    uint8_t literalLengthLengths[ 288 ] = {};
+    uint8_t distanceLengths[ 32 ] = {};
+    huffmanLengths( literalLengthFrequencies, N_LITERAL_LENGTH_CODES, 15,
+        literalLengthLengths );
+    huffmanLengths( distanceFrequencies, N_DISTANCE_CODES, 15,
+        distanceLengths );
+
+    // Keep the distance code complete, which some decoders require.
+    int nDistanceUsed = static_cast< int >( std::count_if( distanceLengths,
+        distanceLengths + N_DISTANCE_CODES,
+        [] ( uint8_t l ) { return l > 0; } ) );
+    if( nDistanceUsed == 0 )
+    {
+        distanceLengths[ 0 ] = 1;
+        distanceLengths[ 1 ] = 1;
+    }
+    else if( nDistanceUsed == 1 )
+    {
+        distanceLengths[ distanceLengths[ 0 ] > 0 ? 1 : 0 ] = 1;
+    }
+
+    int nLiteralLengthCodes = N_LITERAL_LENGTH_CODES;
+    while( nLiteralLengthCodes > 257 &&
+        literalLengthLengths[ nLiteralLengthCodes - 1 ] == 0 )
+    {
+        --nLiteralLengthCodes;
+    }
+    int nDistanceCodes = N_DISTANCE_CODES;
+    while( nDistanceCodes > 1 && distanceLengths[ nDistanceCodes - 1 ] == 0 )
+    {
+        --nDistanceCodes;
+    }
+
+    uint8_t allLengths[ 288 + 32 ];
+    std::copy( literalLengthLengths,
+        literalLengthLengths + nLiteralLengthCodes, allLengths );
+    std::copy( distanceLengths, distanceLengths + nDistanceCodes,
+        allLengths + nLiteralLengthCodes );
+    std::vector< CodeLengthRun > runs = encodeCodeLengths( allLengths,
+        nLiteralLengthCodes + nDistanceCodes );
+
+    uint32_t codeLengthFrequencies[ N_CODE_LENGTH_CODES ] = {};
+    for( const CodeLengthRun& run : runs )
+    {
+        ++codeLengthFrequencies[ run.symbol ];
+    }
+    uint8_t codeLengthLengths[ N_CODE_LENGTH_CODES ];
+    huffmanLengths( codeLengthFrequencies, N_CODE_LENGTH_CODES, 7,
+        codeLengthLengths );
+    int nCodeLengthCodes = N_CODE_LENGTH_CODES;
+    while( nCodeLengthCodes > 4 &&
+        codeLengthLengths[ CODE_LENGTH_ORDER[ nCodeLengthCodes - 1 ] ] == 0 )
+    {
+        --nCodeLengthCodes;
+    }
+
+    uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * nCodeLengthCodes + nExtraBits;
+    for( const CodeLengthRun& run : runs )
+    {
+        dynamicBits += codeLengthLengths[ run.symbol ] + run.nExtraBits;
+    }
+
+    // Fixed code.
+    uint8_t fixedLiteralLengthLengths[ 288 ];
+    uint8_t fixedDistanceLengths[ 32 ];
+    fixedLengths( fixedLiteralLengthLengths, fixedDistanceLengths );
+    uint64_t fixedBits = 3 + nExtraBits;
+
+    for( int i = 0; i < 288; ++i )
+    {
+        dynamicBits += static_cast< uint64_t >( literalLengthFrequencies[ i ] ) *
+            literalLengthLengths[ i ];
+        fixedBits += static_cast< uint64_t >( literalLengthFrequencies[ i ] ) *
+            fixedLiteralLengthLengths[ i ];
+    }
+    for( int i = 0; i < 32; ++i )
+    {
+        dynamicBits += static_cast< uint64_t >( distanceFrequencies[ i ] ) *
+            distanceLengths[ i ];
+        fixedBits += static_cast< uint64_t >( distanceFrequencies[ i ] ) * 5;
+    }
+
+    int64_t nBlockBytes = m_position - m_blockStart;
+    uint64_t storedBits = 8 * static_cast< uint64_t >( nBlockBytes ) +
+        40 * ( nBlockBytes / MAX_STORED_BYTES + 1 ) + 7;
+
+    if( storedBits < std::min( dynamicBits, fixedBits ) )
+    {
+        emitStored( final );
+    }
+    else
+    {
+        bool dynamic = dynamicBits < fixedBits;
+        const uint8_t* lengths = literalLengthLengths;
+        const uint8_t* distLengths = distanceLengths;
+
+        putBits( final ? 1 : 0, 1 );
+        if( dynamic )
+        {
+            putBits( 2, 2 );
+            putBits( nLiteralLengthCodes - 257, 5 );
+            putBits( nDistanceCodes - 1, 5 );
+            putBits( nCodeLengthCodes - 4, 4 );
+            for( int i = 0; i < nCodeLengthCodes; ++i )
+            {
+                putBits( codeLengthLengths[ CODE_LENGTH_ORDER[ i ] ], 3 );
+            }
+
+            uint16_t codeLengthCodes[ N_CODE_LENGTH_CODES ];
+            huffmanCodes( codeLengthLengths, N_CODE_LENGTH_CODES,
+                codeLengthCodes );
+            for( const CodeLengthRun& run : runs )
+            {
+                putBits( codeLengthCodes[ run.symbol ],
+                    codeLengthLengths[ run.symbol ] );
+                putBits( run.extraBits, run.nExtraBits );
+            }
+        }
+        else
+        {
+            putBits( 1, 2 );
+            lengths = fixedLiteralLengthLengths;
+            distLengths = fixedDistanceLengths;
+        }
+
+        uint16_t literalLengthCodes[ 288 ];
+        uint16_t distanceCodes[ 32 ];
+        huffmanCodes( lengths, 288, literalLengthCodes );
+        huffmanCodes( distLengths, 32, distanceCodes );
+
+        for( const Symbol& s : m_symbols )
+        {
+            if( s.distance == 0 )
+            {
+                putBits( literalLengthCodes[ s.literalOrLength ],
+                    lengths[ s.literalOrLength ] );
+            }
+            else
+            {
+                int lengthCode = t.lengthCode[ s.literalOrLength ];
+                putBits( literalLengthCodes[ 257 + lengthCode ],
+                    lengths[ 257 + lengthCode ] );
+                putBits( s.literalOrLength - LENGTH_BASE[ lengthCode ],
+                    LENGTH_EXTRA_BITS[ lengthCode ] );
+
+                int distCode = distanceCode( s.distance );
+                putBits( distanceCodes[ distCode ], distLengths[ distCode ] );
+                putBits( s.distance - DISTANCE_BASE[ distCode ],
+                    DISTANCE_EXTRA_BITS[ distCode ] );
+            }
+        }
+        putBits( literalLengthCodes[ END_OF_BLOCK ], lengths[ END_OF_BLOCK ] );
+    }
+
+    m_symbols.clear();
+    m_blockStart = m_position;
+}
+
+void ZlibCompressor::emitStored( bool final )
+{
+    int64_t position = m_blockStart;
+    do
+    {
+        int n = static_cast< int >(
+            std::min< int64_t >( m_position - position, MAX_STORED_BYTES ) );
+        bool last = ( position + n == m_position );
+
+        putBits( ( final && last ) ? 1 : 0, 1 );
+        putBits( 0, 2 );
+        alignToByte();
+        putBits( n, 16 );
+        putBits( ~n & 0xffff, 16 );
+
+        const uint8_t* p = bufferPointer( position );
+        m_output->insert( m_output->end(), p, p + n );
+        position += n;
+    } while( position < m_position );
+}
+
+void ZlibCompressor::putBits( uint32_t bits, int nBits )
+{
+    m_bitBuffer |= static_cast< uint64_t >( bits ) << m_nBits;
+    m_nBits += nBits;
+    while( m_nBits >= 8 )
+    {
+        m_output->push_back( static_cast< uint8_t >( m_bitBuffer ) );
+        m_bitBuffer >>= 8;
+        m_nBits -= 8;
+    }
+}
+
+void ZlibCompressor::alignToByte()
+{
+    if( m_nBits > 0 )
+    {
+        putBits( 0, 8 - m_nBits );
+    }
+}
+
+ZlibDecompressor::ZlibDecompressor( Source source ) :
+    m_source( source ),
+    m_input( 1 << 16 ),
+    m_window( 1 << 15 )
+{
+
+}
+
+bool ZlibDecompressor::read( uint8_t* output, size_t size )
+{
+    const size_t windowMask = m_window.size() - 1;
+    size_t nRead = 0;
+
+    while( nRead < size )
+    {
+        switch( m_state )
+        {
+        case State::STREAM_HEADER:
+            if( !readStreamHeader() )
+            {
+                m_state = State::FAILED;
+            }
+            break;
+
+        case State::BLOCK_HEADER:
+            if( m_finalBlock )
+            {
+                m_state = readTrailer() ? State::FINISHED : State::FAILED;
+            }
+            else if( !readBlockHeader() )
+            {
+                m_state = State::FAILED;
+            }
+            break;
+
+        case State::STORED:
+        {
+            uint32_t byte;
+            while( m_storedRemaining > 0 && nRead < size )
+            {
+                if( !readBits( 8, byte ) )
+                {
+                    m_state = State::FAILED;
+                    break;
+                }
+                output[ nRead++ ] = static_cast< uint8_t >( byte );
+                m_window[ m_nBytesOut++ & windowMask ] =
+                    static_cast< uint8_t >( byte );
+                --m_storedRemaining;
+            }
+            if( m_state == State::STORED && m_storedRemaining == 0 )
+            {
+                m_state = State::BLOCK_HEADER;
+            }
+            break;
+        }
+
+        case State::HUFFMAN:
+        {
+            int symbol = decodeSymbol( m_literalLengthCode );
+            if( symbol < 0 )
+            {
+                m_state = State::FAILED;
+            }
+            else if( symbol < 256 )
+            {
+                output[ nRead++ ] = static_cast< uint8_t >( symbol );
+                m_window[ m_nBytesOut++ & windowMask ] =
+                    static_cast< uint8_t >( symbol );
+            }
+            else if( symbol == END_OF_BLOCK )
+            {
+                m_state = State::BLOCK_HEADER;
+            }
+            else
+            {
+                int lengthCode = symbol - 257;
+                uint32_t lengthExtra;
+                int distCode;
+                uint32_t distanceExtra;
+                if( lengthCode >= 29 ||
+                    !readBits( LENGTH_EXTRA_BITS[ lengthCode ],
+                        lengthExtra ) ||
+                    ( distCode = decodeSymbol( m_distanceCode ) ) < 0 ||
+                    distCode >= N_DISTANCE_CODES ||
+                    !readBits( DISTANCE_EXTRA_BITS[ distCode ],
+                        distanceExtra ) )
+                {
+                    m_state = State::FAILED;
+                    break;
+                }
+
+                m_copyLength = LENGTH_BASE[ lengthCode ] + lengthExtra;
+                m_copyDistance = DISTANCE_BASE[ distCode ] + distanceExtra;
+                if( m_copyDistance > m_nBytesOut ||
+                    m_copyDistance > m_window.size() )
+                {
+                    m_state = State::FAILED;
+                    break;
+                }
+                m_state = State::COPY;
+            }
+            break;
+        }
+
+        case State::COPY:
+            while( m_copyLength > 0 && nRead < size )
+            {
+                uint8_t byte =
+                    m_window[ ( m_nBytesOut - m_copyDistance ) & windowMask ];
+                output[ nRead++ ] = byte;
+                m_window[ m_nBytesOut++ & windowMask ] = byte;
+                --m_copyLength;
+            }
+            if( m_copyLength == 0 )
+            {
+                m_state = State::HUFFMAN;
+            }
+            break;
+
+        case State::FINISHED:
+        case State::FAILED:
+            m_adler = adler32( output, nRead, m_adler );
+            return false;
+        }
+    }
+
+    m_adler = adler32( output, nRead, m_adler );
+    return true;
+}
+
+bool ZlibDecompressor::finish()
+{
+    uint8_t extra;
+    return !read( &extra, 1 ) && m_state == State::FINISHED;
+}
+
+void ZlibDecompressor::refill()
+{
+    while( m_nBits <= 56 )
+    {
+        if( m_inputPosition == m_inputSize )
+        {
+            if( m_inputEnded )
+            {
+                return;
+            }
+            m_inputSize = m_source( m_input.data(), m_input.size() );
+            m_inputPosition = 0;
+            if( m_inputSize == 0 )
+            {
+                m_inputEnded = true;
+                return;
+            }
+        }
+        m_bitBuffer |= static_cast< uint64_t >(
+            m_input[ m_inputPosition++ ] ) << m_nBits;
+        m_nBits += 8;
+    }
+}
+
+bool ZlibDecompressor::readBits( int nBits, uint32_t& bits )
+{
+    if( m_nBits < nBits )
+    {
+        refill();
+        if( m_nBits < nBits )
+        {
+            return false;
+        }
+    }
+    bits = static_cast< uint32_t >( m_bitBuffer & ( ( 1ull << nBits ) - 1 ) );
+    m_bitBuffer >>= nBits;
+    m_nBits -= nBits;
+    return true;
+}
+
+// static
+bool ZlibDecompressor::build( const uint8_t* lengths, int n,
+    Huffman& huffman )
+{
+    std::fill( huffman.counts, huffman.counts + 16, 0 );
+    std::fill( huffman.fast, huffman.fast + ( 1 << FAST_BITS ), 0 );
+    for( int i = 0; i < n; ++i )
+    {
+        ++huffman.counts[ lengths[ i ] ];
+    }
+    huffman.counts[ 0 ] = 0;
+
+    // Reject over-subscribed codes. Incomplete ones are fine: their unused
+    // codes fail to decode.
+    int left = 1;
+    for( int length = 1; length < 16; ++length )
+    {
+        left = 2 * left - huffman.counts[ length ];
+        if( left < 0 )
+        {
+            return false;
+        }
+    }
+
+    uint16_t offsets[ 16 ];
+    offsets[ 1 ] = 0;
+    for( int length = 1; length < 15; ++length )
+    {
+        offsets[ length + 1 ] = offsets[ length ] + huffman.counts[ length ];
+    }
+
+    uint32_t nextCode[ 16 ] = {};
+    uint32_t code = 0;
+    for( int length = 1; length < 16; ++length )
+    {
+        code = ( code + huffman.counts[ length - 1 ] ) << 1;
+        nextCode[ length ] = code;
+    }
+
+    for( int i = 0; i < n; ++i )
+    {
+        int length = lengths[ i ];
+        if( length == 0 )
+        {
+            continue;
+        }
+
+        huffman.symbols[ offsets[ length ]++ ] = static_cast< uint16_t >( i );
+
+        uint32_t reversed = reverseBits( nextCode[ length ]++, length );
+        if( length <= FAST_BITS )
+        {
+            for( uint32_t j = reversed; j < ( 1u << FAST_BITS );
+                j += ( 1u << length ) )
+            {
+                huffman.fast[ j ] = static_cast< uint16_t >(
+                    ( i << 4 ) | length );
+            }
+        }
+    }
+    return true;
+}
+
+int ZlibDecompressor::decodeSymbol( const Huffman& huffman )
+{
+    if( m_nBits < 15 )
+    {
+        refill();
+    }
+
+    uint16_t entry =
+        huffman.fast[ m_bitBuffer & ( ( 1u << FAST_BITS ) - 1 ) ];
+    int length = entry & 15;
+    if( length > 0 )
+    {
+        if( length > m_nBits )
+        {
+            return -1;
+        }
+        m_bitBuffer >>= length;
+        m_nBits -= length;
+        return entry >> 4;
+    }
+
+    // Longer codes: walk the canonical code one bit at a time.
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for( length = 1; length < 16; ++length )
+    {
+        if( m_nBits == 0 )
+        {
+            return -1;
+        }
+        code |= static_cast< int >( m_bitBuffer & 1 );
+        m_bitBuffer >>= 1;
+        --m_nBits;
+
+        int count = huffman.counts[ length ];
+        if( code - first < count )
+        {
+            return huffman.symbols[ index + code - first ];
+        }
+        index += count;
+        first = ( first + count ) << 1;
+        code <<= 1;
+    }
+    return -1;
+}
+
+bool ZlibDecompressor::readStreamHeader()
+{
+    uint32_t cmf;
+    uint32_t flg;
+    if( !readBits( 8, cmf ) || !readBits( 8, flg ) )
+    {
+        return false;
+    }
+
+    // Deflate, a window of at most 32 KiB, valid check bits, and no preset
+    // dictionary.
+    bool valid = ( cmf & 15 ) == 8 && ( cmf >> 4 ) <= 7 &&
+        ( cmf * 256 + flg ) % 31 == 0 && ( flg & 0x20 ) == 0;
+    if( valid )
+    {
+        m_state = State::BLOCK_HEADER;
+    }
+    return valid;
+}
+
+bool ZlibDecompressor::readBlockHeader()
+{
+    uint32_t final;
+    uint32_t type;
+    if( !readBits( 1, final ) || !readBits( 2, type ) )
+    {
+        return false;
+    }
+    m_finalBlock = ( final != 0 );
+
+    if( type == 0 )
+    {
+        uint32_t length;
+        uint32_t complement;
+        m_bitBuffer >>= ( m_nBits & 7 );
+        m_nBits -= ( m_nBits & 7 );
+        if( !readBits( 16, length ) || !readBits( 16, complement ) ||
+            length != ( ~complement & 0xffff ) )
+        {
+            return false;
+        }
+        m_storedRemaining = length;
+        m_state = ( length > 0 ) ? State::STORED : State::BLOCK_HEADER;
+        return true;
+    }
+    else if( type == 1 )
+    {
+        uint8_t literalLengthLengths[ 288 ];
+        uint8_t distanceLengths[ 32 ];
+        fixedLengths( literalLengthLengths, distanceLengths );
+        build( literalLengthLengths, 288, m_literalLengthCode );
+        build( distanceLengths, 32, m_distanceCode );
+        m_state = State::HUFFMAN;
+        return true;
+    }
+    else if( type == 2 )
+    {
+        if( !readDynamicCodes() )
+        {
+            return false;
+        }
+        m_state = State::HUFFMAN;
+        return true;
+    }
+    return false;
+}
+
+bool ZlibDecompressor::readDynamicCodes()
+{
+    uint32_t hlit;
+    uint32_t hdist;
+    uint32_t hclen;
+    if( !readBits( 5, hlit ) || !readBits( 5, hdist ) ||
+        !readBits( 4, hclen ) )
+    {
+        return false;
+    }
+    int nLiteralLengthCodes = hlit + 257;
+    int nDistanceCodes = hdist + 1;
+    int nCodeLengthCodes = hclen + 4;
+    if( nLiteralLengthCodes > N_LITERAL_LENGTH_CODES ||
+        nDistanceCodes > N_DISTANCE_CODES )
+    {
+        return false;
+    }
+
+    uint8_t codeLengthLengths[ N_CODE_LENGTH_CODES ] = {};
+    for( int i = 0; i < nCodeLengthCodes; ++i )
+    {
+        uint32_t length;
+        if( !readBits( 3, length ) )
+        {
+            return false;
+        }
+        codeLengthLengths[ CODE_LENGTH_ORDER[ i ] ] =
+            static_cast< uint8_t >( length );
+    }
+
+    Huffman codeLengthCode;
+    if( !build( codeLengthLengths, N_CODE_LENGTH_CODES, codeLengthCode ) )
+    {
+        return false;
+    }
+
+    uint8_t lengths[ N_LITERAL_LENGTH_CODES + N_DISTANCE_CODES ];
+    int n = nLiteralLengthCodes + nDistanceCodes;
+    int i = 0;
+    while( i < n )
+    {
+        int symbol = decodeSymbol( codeLengthCode );
+        if( symbol < 0 )
+        {
+            return false;
+        }
+
+        if( symbol < 16 )
+        {
+            lengths[ i++ ] = static_cast< uint8_t >( symbol );
+            continue;
+        }
+
+        uint32_t extra;
+        uint8_t value = 0;
+        int repeat;
+        if( symbol == 16 )
+        {
+            if( i == 0 || !readBits( 2, extra ) )
+            {
+                return false;
+            }
+            value = lengths[ i - 1 ];
+            repeat = 3 + extra;
+        }
+        else if( symbol == 17 )
+        {
+            if( !readBits( 3, extra ) )
+            {
+                return false;
+            }
+            repeat = 3 + extra;
+        }
+        else
+        {
+            if( !readBits( 7, extra ) )
+            {
+                return false;
+            }
+            repeat = 11 + extra;
+        }
+
+        if( i + repeat > n )
+        {
+            return false;
+        }
+        std::fill( lengths + i, lengths + i + repeat, value );
+        i += repeat;
+    }
+
+    // The end of block code is required.
+    if( lengths[ END_OF_BLOCK ] == 0 )
+    {
+        return false;
+    }
+
+    return build( lengths, nLiteralLengthCodes, m_literalLengthCode ) &&
+        build( lengths + nLiteralLengthCodes, nDistanceCodes,
+            m_distanceCode );
+}
+
+bool ZlibDecompressor::readTrailer()
+{
+    m_bitBuffer >>= ( m_nBits & 7 );
+    m_nBits -= ( m_nBits & 7 );
+
+    uint32_t adler = 0;
+    for( int i = 0; i < 4; ++i )
+    {
+        uint32_t byte;
+        if( !readBits( 8, byte ) )
+        {
+            return false;
+        }
+        adler = ( adler << 8 ) | byte;
+    }
+    return adler == m_adler;
+}
+
+} } } // io, core, libcgt
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace libcgt { namespace core { namespace io {
+
+// CRC-32, as used by PNG chunks. To checksum data in pieces, pass the
+// previous return value as "crc".
+uint32_t crc32( const uint8_t* data, size_t size, uint32_t crc = 0 );
+
+// Adler-32, as used by zlib streams. To checksum data in pieces, pass the
+// previous return value as "adler".
+uint32_t adler32( const uint8_t* data, size_t size, uint32_t adler = 1 );
+
+// Incrementally compresses data into a zlib (RFC 1950) stream of deflate
+// (RFC 1951) blocks, so that a stream can be produced piece by piece without
+// holding all of its input or output in memory.
+//
+// Matches are found with hash chains over a sliding window of the last
+// 2^windowBits bytes. Each block is emitted with whichever of dynamic
+// Huffman, fixed Huffman, or stored coding is smallest.
+class ZlibCompressor
+{
+public:
+
+    // "level" trades speed for size, from 0 (no compression) to 9 (smallest
+    // output), as in zlib. "windowBits" is in [ 8, 15 ]: smaller windows use
+    // less memory but find fewer matches. Out of range values are clamped.
+    ZlibCompressor( int level = 6, int windowBits = 15 );
+
+    // Compresses "size" bytes of "input", appending to "output" any
+    // compressed bytes that are ready.
+    void write( const uint8_t* input, size_t size,
+        std::vector< uint8_t >& output );
+
+    // Ends the stream, appending the rest of the compressed bytes to
+    // "output". The compressor can not be written to afterwards.
+    void finish( std::vector< uint8_t >& output );
+
+private:
+
+    struct Symbol
+    {
+        // A literal byte if distance == 0, otherwise a match length.
+        uint16_t literalOrLength;
+        uint16_t distance;
+    };
+
+    struct Match
+    {
+        int length;
+        int distance;
+    };
+
+    // Finds the longest match for the bytes at absolute position "position",
+    // then adds it to the hash chains.
+    Match findAndInsert( int64_t position, int64_t end );
+    void insert( int64_t position, int64_t end );
+
+    // Find matches for everything written so far, except for the last
+    // LOOKAHEAD bytes unless "flush" is true: those wait for the next
+    // write(), so that matches are not cut at write() boundaries and the
+    // output is the same however the input is split.
+    void compress( bool flush );
+
+    void addLiteral( int64_t position );
+    void addMatch( const Match& match );
+
+    // Writes the pending symbols (or for level 0, bytes) as a block.
+    void emitBlock( bool final );
+    void emitStored( bool final );
+
+    void putBits( uint32_t bits, int nBits );
+    void alignToByte();
+
+    const uint8_t* bufferPointer( int64_t position ) const;
+
+    int m_level;
+    int m_maxChainLength;
+    int m_niceLength;
+    int m_lazyLength;
+    int m_windowSize;
+
+    // Input bytes from absolute position m_bufferStart on: at least the
+    // window and the current block.
+    std::vector< uint8_t > m_buffer;
+    int64_t m_bufferStart = 0;
+    int64_t m_position = 0;
+    int64_t m_blockStart = 0;
+
+    // Hash chains of absolute positions, -1 terminated.
+    std::vector< int64_t > m_head;
+    std::vector< int64_t > m_previous;
+
+    std::vector< Symbol > m_symbols;
+
+    std::vector< uint8_t >* m_output = nullptr;
+    uint64_t m_bitBuffer = 0;
+    int m_nBits = 0;
+
+    uint32_t m_adler = 1;
+    bool m_headerWritten = false;
+};
+
+// Incrementally decompresses a zlib (RFC 1950) stream. Input is pulled from
+// a Source as needed and output is produced in whatever amounts the caller
+// asks for, so that neither has to fit in memory at once.
+class ZlibDecompressor
+{
+public:
+
+    // Copies up to "capacity" bytes of input into "buffer", returning how
+    // many were copied. Returns 0 once the input is exhausted.
+    using Source = std::function< size_t( uint8_t* buffer, size_t capacity ) >;
+
+    ZlibDecompressor( Source source );
+
+    // Decompresses exactly "size" bytes into "output".
+    // Returns false if the stream is corrupt or ends first.
+    bool read( uint8_t* output, size_t size );
+
+    // Reads the end of the stream and verifies its checksum. Returns false
+    // if there is more data, or if the stream is corrupt.
+    bool finish();
+
+private:
+
+    enum class State
+    {
+        STREAM_HEADER,
+        BLOCK_HEADER,
+        STORED,
+        HUFFMAN,
+        COPY,
+        FINISHED,
+        FAILED
+    };
+
+    static const int FAST_BITS = 10;
+
+    // A canonical Huffman code. Codes of up to FAST_BITS bits are decoded
+    // with a single table lookup.
+    struct Huffman
+    {
+        // ( symbol << 4 ) | length, or 0 if the code is longer.
+        uint16_t fast[ 1 << FAST_BITS ];
+        uint16_t counts[ 16 ];
+        uint16_t symbols[ 288 ];
+    };
+
+    static bool build( const uint8_t* lengths, int n, Huffman& huffman );
+
+    // Returns -1 on error.
+    int decodeSymbol( const Huffman& huffman );
+
+    // Returns false if the input ended first.
+    bool readBits( int nBits, uint32_t& bits );
+
+    void refill();
+
+    bool readStreamHeader();
+    bool readBlockHeader();
+    bool readDynamicCodes();
+    bool readTrailer();
+
+    Source m_source;
+    std::vector< uint8_t > m_input;
+    size_t m_inputPosition = 0;
+    size_t m_inputSize = 0;
+    bool m_inputEnded = false;
+
+    uint64_t m_bitBuffer = 0;
+    int m_nBits = 0;
+
+    State m_state = State::STREAM_HEADER;
+    bool m_finalBlock = false;
+    uint32_t m_storedRemaining = 0;
+    int m_copyLength = 0;
+    uint32_t m_copyDistance = 0;
+
+    Huffman m_literalLengthCode;
+    Huffman m_distanceCode;
+
+    // The last 32 KiB of output, for matches.
+    std::vector< uint8_t > m_window;
+    uint64_t m_nBytesOut = 0;
+
+    uint32_t m_adler = 1;
+};
+
+} } } // io, core, libcgt
@@ -1,44 +1,583 @@
 #include "time/PerformanceCollector.h"
 
-void PerformanceCollector::registerEvent( const std::string& name )
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+namespace
+{
+
+// Durations below SUB_BUCKETS ns get a bucket each. Above that, each power
+// of two is split into SUB_BUCKETS buckets.
+const int SUB_BUCKET_BITS = 4;
+const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+const int NUM_BUCKETS = ( 64 - SUB_BUCKET_BITS + 1 ) * SUB_BUCKETS;
+
+int floorLog2( uint64_t x )
+{
+    int output = 0;
+    while( x > 1 )
+    {
+        ++output;
+        x >>= 1;
+    }
+    return output;
+}
+
+int bucketIndex( int64_t ns )
+{
+    uint64_t x = static_cast< uint64_t >( std::max< int64_t >( ns, 0 ) );
+    if( x < SUB_BUCKETS )
+    {
+        return static_cast< int >( x );
+    }
+    int e = floorLog2( x );
+    int shift = e - SUB_BUCKET_BITS;
+    int sub = static_cast< int >( ( x >> shift ) & ( SUB_BUCKETS - 1 ) );
+    return ( shift + 1 ) * SUB_BUCKETS + sub;
+}
+
+// The largest duration that falls in bucket i.
+int64_t bucketUpperBound( int i )
+{
+    if( i < SUB_BUCKETS )
+    {
+        return i;
+    }
+    int shift = i / SUB_BUCKETS - 1;
+    int sub = i % SUB_BUCKETS;
+    uint64_t lower = static_cast< uint64_t >( SUB_BUCKETS + sub ) << shift;
+    return static_cast< int64_t >( lower + ( uint64_t( 1 ) << shift ) - 1 );
+}
+
+float nsToMS( int64_t ns )
+{
+    return static_cast< float >( ns * 1e-6 );
+}
+
+std::string jsonEscape( const std::string& s )
+{
+    std::string output;
+    for( char c : s )
+    {
+        if( c == '"' || c == '\\' )
+        {
+            output += '\\';
+            output += c;
+        }
+        else if( static_cast< unsigned char >( c ) < 0x20 )
+        {
+            char buffer[ 8 ];
+            snprintf( buffer, sizeof( buffer ), "\\u%04x", c );
+            output += buffer;
+        }
+        else
+        {
+            output += c;
+        }
+    }
+    return output;
+}
+
+std::atomic< uint64_t > s_nextCollectorId( 0 );
+
+}
+
+// Written only by the thread that owns it, read by any thread.
+//
+// Other threads reset a histogram by calling requestReset(), and the owner
+// applies the reset on its next add(), so that a reset is never lost or
+// interleaved with an add(). Until then, readers see it as empty.
+struct PerformanceCollector::Histogram
 {
-    m_eventStartTime[ name ] = Clock::now();
-    m_eventTotalElapsedTime[ name ] = Clock::duration::zero();
-    m_eventCounts[ name ] = 0;
+    std::atomic< int64_t > count;
+    std::atomic< int64_t > totalNS;
+    std::atomic< int64_t > maxNS;
+    std::atomic< int64_t > buckets[ NUM_BUCKETS ];
+
+    // The number of resets requested.
+    std::atomic< uint64_t > resetsRequested;
+
+    // Twice the number of resets applied, plus 1 while one is being
+    // applied.
+    std::atomic< uint64_t > version;
+
+    Histogram()
+    {
+        resetsRequested.store( 0, std::memory_order_relaxed );
+        version.store( 0, std::memory_order_relaxed );
+        clear();
+    }
+
+    // Any thread.
+    void requestReset()
+    {
+        resetsRequested.fetch_add( 1, std::memory_order_release );
+    }
+
+    // Single writer: no need for read-modify-write instructions.
+    void add( int64_t ns )
+    {
+        uint64_t v = version.load( std::memory_order_relaxed );
+        if( resetsRequested.load( std::memory_order_acquire ) != v / 2 )
+        {
+            applyReset( v );
+        }
+
+        increment( count, 1 );
+        increment( totalNS, ns );
+        if( ns > maxNS.load( std::memory_order_relaxed ) )
+        {
+            maxNS.store( ns, std::memory_order_relaxed );
+        }
+        increment( buckets[ bucketIndex( ns ) ], 1 );
+    }
+
+    // Any thread: adds the contents to the outputs, unless a reset is
+    // pending or was applied while reading, in which case it is empty.
+    void mergeInto( std::vector< int64_t >& mergedBuckets,
+        int64_t& mergedCount, int64_t& mergedTotalNS,
+        int64_t& mergedMaxNS ) const
+    {
+        uint64_t v = version.load( std::memory_order_acquire );
+        if( v % 2 != 0 ||
+            resetsRequested.load( std::memory_order_acquire ) != v / 2 )
+        {
+            return;
+        }
+
+        int64_t c = count.load( std::memory_order_relaxed );
+        int64_t t = totalNS.load( std::memory_order_relaxed );
+        int64_t m = maxNS.load( std::memory_order_relaxed );
+        int64_t b[ NUM_BUCKETS ];
+        for( int i = 0; i < NUM_BUCKETS; ++i )
+        {
+            b[ i ] = buckets[ i ].load( std::memory_order_relaxed );
+        }
+
+        std::atomic_thread_fence( std::memory_order_acquire );
+        if( version.load( std::memory_order_relaxed ) != v )
+        {
+            return;
+        }
+
+        mergedCount += c;
+        mergedTotalNS += t;
+        mergedMaxNS = std::max( mergedMaxNS, m );
+        for( int i = 0; i < NUM_BUCKETS; ++i )
+        {
+            mergedBuckets[ i ] += b[ i ];
+        }
+    }
+
+private:
+
+    // Owner only. Applies all resets requested so far.
+    void applyReset( uint64_t v )
+    {
+        uint64_t requested = resetsRequested.load( std::memory_order_acquire );
+
+        version.store( v + 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+        clear();
+        version.store( 2 * requested, std::memory_order_release );
+    }
+
+    void clear()
+    {
+        count.store( 0, std::memory_order_relaxed );
+        totalNS.store( 0, std::memory_order_relaxed );
+        maxNS.store( 0, std::memory_order_relaxed );
+        for( int i = 0; i < NUM_BUCKETS; ++i )
+        {
+            buckets[ i ].store( 0, std::memory_order_relaxed );
+        }
+    }
+
+    static void increment( std::atomic< int64_t >& x, int64_t delta )
+    {
+        x.store( x.load( std::memory_order_relaxed ) + delta,
+            std::memory_order_relaxed );
+    }
+};
+
+struct PerformanceCollector::TraceRecord
+{
+    EventHandle handle;
+    int64_t startNS; // Since m_epoch.
+    int64_t durationNS;
+};
+
+struct PerformanceCollector::ThreadState
+{
+    struct OpenEvent
+    {
+        EventHandle handle;
+        Clock::time_point start;
+    };
+
+    ThreadState( int index, int traceCapacity ) :
+        threadIndex( index ),
+        trace( new TraceRecord[ traceCapacity ] ),
+        traceSize( 0 )
+    {
+        for( int i = 0; i < MAX_EVENTS; ++i )
+        {
+            histograms[ i ].store( nullptr, std::memory_order_relaxed );
+        }
+    }
+
+    ~ThreadState()
+    {
+        for( int i = 0; i < MAX_EVENTS; ++i )
+        {
+            delete histograms[ i ].load( std::memory_order_relaxed );
+        }
+    }
+
+    const int threadIndex;
+
+    // Only touched by the owning thread.
+    std::vector< OpenEvent > openEvents;
+
+    // Allocated on first use by the owning thread.
+    std::atomic< Histogram* > histograms[ MAX_EVENTS ];
+
+    // Records [ 0, traceSize ) are complete.
+    std::unique_ptr< TraceRecord[] > trace;
+    std::atomic< int > traceSize;
+};
+
+PerformanceCollector::ScopedTimer::ScopedTimer(
+    PerformanceCollector& collector, EventHandle handle ) :
+    m_collector( collector ),
+    m_handle( handle )
+{
+    m_collector.beginEvent( m_handle );
+}
+
+PerformanceCollector::ScopedTimer::~ScopedTimer()
+{
+    m_collector.endEvent( m_handle );
+}
+
+PerformanceCollector::PerformanceCollector( int traceCapacity ) :
+    m_id( s_nextCollectorId++ ),
+    m_traceCapacity( std::max( traceCapacity, 0 ) ),
+    m_epoch( Clock::now() )
+{
+
+}
+
+PerformanceCollector::~PerformanceCollector() = default;
+
+PerformanceCollector::EventHandle PerformanceCollector::registerEvent(
+    const std::string& name )
+{
+    if( name.empty() )
+    {
+        return INVALID_HANDLE;
+    }
+
+    std::lock_guard< std::mutex > lock( m_mutex );
+
+    auto itr = std::find( m_eventNames.begin(), m_eventNames.end(), name );
+    if( itr != m_eventNames.end() )
+    {
+        return static_cast< EventHandle >( itr - m_eventNames.begin() );
+    }
+
+    EventHandle handle = INVALID_HANDLE;
+    itr = std::find( m_eventNames.begin(), m_eventNames.end(),
+        std::string() );
+    if( itr != m_eventNames.end() )
+    {
+        handle = static_cast< EventHandle >( itr - m_eventNames.begin() );
+        *itr = name;
+    }
+    else if( m_eventNames.size() < MAX_EVENTS )
+    {
+        handle = static_cast< EventHandle >( m_eventNames.size() );
+        m_eventNames.push_back( name );
+    }
+    else
+    {
+        return INVALID_HANDLE;
+    }
+
+    // Clear what a previous event with this handle left behind.
+    for( const auto& ts : m_threadStates )
+    {
+        Histogram* h = ts->histograms[ handle ].load(
+            std::memory_order_acquire );
+        if( h != nullptr )
+        {
+            h->requestReset();
+        }
+    }
+    return handle;
 }
 
 void PerformanceCollector::unregisterEvent( const std::string& name )
 {
-    m_eventStartTime.erase( name );
-    m_eventTotalElapsedTime.erase( name );
-    m_eventCounts.erase( name );
+    std::lock_guard< std::mutex > lock( m_mutex );
+
+    auto itr = std::find( m_eventNames.begin(), m_eventNames.end(), name );
+    if( itr != m_eventNames.end() )
+    {
+        itr->clear();
+    }
+}
+
+PerformanceCollector::EventHandle PerformanceCollector::eventHandle(
+    const std::string& name ) const
+{
+    std::lock_guard< std::mutex > lock( m_mutex );
+
+    auto itr = std::find( m_eventNames.begin(), m_eventNames.end(), name );
+    if( name.empty() || itr == m_eventNames.end() )
+    {
+        return INVALID_HANDLE;
+    }
+    return static_cast< EventHandle >( itr - m_eventNames.begin() );
+}
+
+void PerformanceCollector::resetEvent( EventHandle handle )
+{
+    if( handle < 0 || handle >= MAX_EVENTS )
+    {
+        return;
+    }
+
+    std::lock_guard< std::mutex > lock( m_mutex );
+    for( const auto& ts : m_threadStates )
+    {
+        Histogram* h = ts->histograms[ handle ].load(
+            std::memory_order_acquire );
+        if( h != nullptr )
+        {
+            h->requestReset();
+        }
+    }
+}
+
+void PerformanceCollector::resetEvent( const std::string& name )
+{
+    resetEvent( eventHandle( name ) );
+}
+
+void PerformanceCollector::beginEvent( EventHandle handle )
+{
+    ThreadState* ts = threadState();
+    ts->openEvents.push_back( { handle, Clock::now() } );
 }
 
 void PerformanceCollector::beginEvent( const std::string& name )
 {
-    m_eventStartTime[ name ] = PerformanceCollector::Clock::now();
+    beginEvent( registerEvent( name ) );
+}
+
+void PerformanceCollector::endEvent( EventHandle handle )
+{
+    auto now = Clock::now();
+
+    ThreadState* ts = threadState();
+    if( ts->openEvents.empty() || ts->openEvents.back().handle != handle )
+    {
+        return;
+    }
+    Clock::time_point start = ts->openEvents.back().start;
+    ts->openEvents.pop_back();
+
+    if( handle < 0 || handle >= MAX_EVENTS )
+    {
+        return;
+    }
+
+    int64_t dtNS = std::chrono::duration_cast< std::chrono::nanoseconds >(
+        now - start ).count();
+
+    Histogram* h = ts->histograms[ handle ].load( std::memory_order_relaxed );
+    if( h == nullptr )
+    {
+        h = new Histogram;
+        ts->histograms[ handle ].store( h, std::memory_order_release );
+    }
+    h->add( dtNS );
+
+    int n = ts->traceSize.load( std::memory_order_relaxed );
+    if( n < m_traceCapacity )
+    {
+        TraceRecord& record = ts->trace[ n ];
+        record.handle = handle;
+        record.startNS = std::chrono::duration_cast<
+            std::chrono::nanoseconds >( start - m_epoch ).count();
+        record.durationNS = dtNS;
+        ts->traceSize.store( n + 1, std::memory_order_release );
+    }
 }
 
 void PerformanceCollector::endEvent( const std::string& name )
 {
-    auto now = PerformanceCollector::Clock::now();
-    auto last = m_eventStartTime[ name ];
-    auto dt = now - last;
+    endEvent( eventHandle( name ) );
+}
 
-    m_eventTotalElapsedTime[ name ] += dt;
-    ++m_eventCounts[ name ];
+PerformanceCollector::Statistics PerformanceCollector::statistics(
+    EventHandle handle ) const
+{
+    Statistics stats;
+    if( handle < 0 || handle >= MAX_EVENTS )
+    {
+        return stats;
+    }
+
+    std::vector< int64_t > buckets;
+    int64_t count;
+    int64_t totalNS;
+    int64_t maxNS;
+    mergeHistograms( handle, buckets, count, totalNS, maxNS );
+
+    int64_t bucketTotal = 0;
+    for( int64_t b : buckets )
+    {
+        bucketTotal += b;
+    }
+    if( count == 0 || bucketTotal == 0 )
+    {
+        return stats;
+    }
+
+    stats.count = count;
+    stats.meanMilliseconds = nsToMS( totalNS ) / count;
+    stats.maxMilliseconds = nsToMS( maxNS );
+
+    const float fractions[] = { 0.5f, 0.95f, 0.99f };
+    float* outputs[] = { &stats.p50Milliseconds, &stats.p95Milliseconds,
+        &stats.p99Milliseconds };
+    for( int k = 0; k < 3; ++k )
+    {
+        // The smallest bucket at which the cumulative count reaches the rank.
+        int64_t rank = std::max< int64_t >( 1,
+            static_cast< int64_t >( fractions[ k ] * bucketTotal + 0.5f ) );
+        int64_t cumulative = 0;
+        for( int i = 0; i < NUM_BUCKETS; ++i )
+        {
+            cumulative += buckets[ i ];
+            if( cumulative >= rank )
+            {
+                *( outputs[ k ] ) =
+                    nsToMS( std::min( bucketUpperBound( i ), maxNS ) );
+                break;
+            }
+        }
+    }
+
+    return stats;
+}
+
+PerformanceCollector::Statistics PerformanceCollector::statistics(
+    const std::string& name ) const
+{
+    return statistics( eventHandle( name ) );
+}
+
+float PerformanceCollector::averageTimeMilliseconds( EventHandle handle ) const
+{
+    return statistics( handle ).meanMilliseconds;
+}
+
+float PerformanceCollector::averageTimeMilliseconds(
+    const std::string& name ) const
+{
+    return averageTimeMilliseconds( eventHandle( name ) );
 }
 
-float PerformanceCollector::averageTimeMilliseconds( const std::string& name )
+bool PerformanceCollector::saveChromeTrace( const std::string& filename ) const
 {
-    if( m_eventCounts.find( name ) == m_eventCounts.end() ||
-       m_eventCounts[ name ] == 0 )
+    FILE* fp = fopen( filename.c_str(), "w" );
+    if( fp == nullptr )
+    {
+        return false;
+    }
+
+    std::lock_guard< std::mutex > lock( m_mutex );
+
+    std::vector< std::string > escapedNames;
+    for( const std::string& name : m_eventNames )
+    {
+        escapedNames.push_back( jsonEscape( name ) );
+    }
+
+    fprintf( fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" );
+    bool first = true;
+    for( const auto& ts : m_threadStates )
+    {
+        int n = ts->traceSize.load( std::memory_order_acquire );
+        for( int i = 0; i < n; ++i )
+        {
+            const TraceRecord& record = ts->trace[ i ];
+            if( record.handle >= static_cast< int >( escapedNames.size() ) ||
+                escapedNames[ record.handle ].empty() )
+            {
+                continue;
+            }
+
+            fprintf( fp, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,"
+                "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                first ? "" : ",",
+                escapedNames[ record.handle ].c_str(), ts->threadIndex,
+                record.startNS * 1e-3, record.durationNS * 1e-3 );
+            first = false;
+        }
+    }
+    fprintf( fp, "\n]}\n" );
+
+    bool succeeded = ( ferror( fp ) == 0 );
+    succeeded &= ( fclose( fp ) == 0 );
+    return succeeded;
+}
+
+PerformanceCollector::ThreadState* PerformanceCollector::threadState()
+{
+    // Collector id --> this thread's state in that collector.
+    thread_local std::vector< std::pair< uint64_t, ThreadState* > > t_states;
+
+    for( const auto& kvp : t_states )
+    {
+        if( kvp.first == m_id )
+        {
+            return kvp.second;
+        }
+    }
+
+    ThreadState* ts;
+    {
+        std::lock_guard< std::mutex > lock( m_mutex );
+        m_threadStates.emplace_back( new ThreadState(
+            static_cast< int >( m_threadStates.size() ), m_traceCapacity ) );
+        ts = m_threadStates.back().get();
+    }
+    t_states.push_back( std::make_pair( m_id, ts ) );
+    return ts;
+}
+
+void PerformanceCollector::mergeHistograms( EventHandle handle,
+    std::vector< int64_t >& buckets, int64_t& count, int64_t& totalNS,
+    int64_t& maxNS ) const
+{
+    buckets.assign( NUM_BUCKETS, 0 );
+    count = 0;
+    totalNS = 0;
+    maxNS = 0;
+
+    std::lock_guard< std::mutex > lock( m_mutex );
+    for( const auto& ts : m_threadStates )
     {
-        return 0.0f;
+        const Histogram* h = ts->histograms[ handle ].load(
+            std::memory_order_acquire );
+        if( h != nullptr )
+        {
+            h->mergeInto( buckets, count, totalNS, maxNS );
+        }
     }
-    auto dt = m_eventTotalElapsedTime[ name ];
-    int count = m_eventCounts[ name ];
-    float dtMillis = std::chrono::duration_cast<
-        PerformanceCollector::FloatDurationMS >( dt ).count();
-    return dtMillis / count;
 }
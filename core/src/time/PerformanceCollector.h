@@ -1,43 +1,144 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
-#include <unordered_map>
+#include <vector>
 
+// Collects timing statistics for named events.
+//
+// Register each event once with registerEvent(), which returns a handle, and
+// bracket each occurrence with beginEvent() / endEvent(), or with a
+// ScopedTimer. Events may be nested, and may be timed concurrently from any
+// number of threads: begin and end just push and pop a per-thread stack, and
+// each completed event is recorded in a per-thread histogram (and optionally a
+// per-thread trace buffer) without taking any locks.
+//
+// statistics() merges the histograms of all threads and reports the mean,
+// median, 95th and 99th percentiles and the maximum. Percentiles are
+// resolved to within about 6%.
+//
+// If traceCapacity > 0, each thread also keeps its first traceCapacity
+// completed events, which saveChromeTrace() writes out in the Chrome
+// trace-event format (load it in chrome://tracing or Perfetto).
+//
+// The std::string overloads look the event up by name first: prefer handles
+// in inner loops.
 class PerformanceCollector
 {
 public:
 
-    PerformanceCollector() = default;
+    using EventHandle = int;
 
-    // Register an event for performance collection.
-    void registerEvent( const std::string& name );
+    static const EventHandle INVALID_HANDLE = -1;
 
-    // Unregister an event from performance collection.
+    // The maximum number of events registered at once.
+    static const int MAX_EVENTS = 256;
+
+    struct Statistics
+    {
+        int64_t count = 0;
+        float meanMilliseconds = 0;
+        float p50Milliseconds = 0;
+        float p95Milliseconds = 0;
+        float p99Milliseconds = 0;
+        float maxMilliseconds = 0;
+    };
+
+    // Times the enclosing scope as one occurrence of an event.
+    class ScopedTimer
+    {
+    public:
+
+        ScopedTimer( PerformanceCollector& collector, EventHandle handle );
+        ~ScopedTimer();
+
+        ScopedTimer( const ScopedTimer& copy ) = delete;
+        ScopedTimer& operator = ( const ScopedTimer& copy ) = delete;
+
+    private:
+
+        PerformanceCollector& m_collector;
+        EventHandle m_handle;
+    };
+
+    // traceCapacity: the number of completed events kept per thread for
+    // saveChromeTrace(). 0 disables tracing.
+    PerformanceCollector( int traceCapacity = 0 );
+    ~PerformanceCollector();
+
+    PerformanceCollector( const PerformanceCollector& copy ) = delete;
+    PerformanceCollector& operator = ( const PerformanceCollector& copy ) =
+        delete;
+
+    // Register an event for performance collection, and return its handle.
+    // If the event is already registered, returns its existing handle.
+    // Returns INVALID_HANDLE if MAX_EVENTS events are already registered.
+    EventHandle registerEvent( const std::string& name );
+
+    // Unregister an event from performance collection. Its handle may be
+    // reused by a later registerEvent().
     void unregisterEvent( const std::string& name );
 
+    // The handle of a registered event, or INVALID_HANDLE.
+    EventHandle eventHandle( const std::string& name ) const;
+
     // Resets the statistics for an event.
+    void resetEvent( EventHandle handle );
     void resetEvent( const std::string& name );
 
-    // Call each time an event starts.
+    // Call each time an event starts, on the thread that will end it.
+    void beginEvent( EventHandle handle );
     void beginEvent( const std::string& name );
 
-    // Call each time an event ends.
+    // Call each time an event ends. It must be the innermost event begun on
+    // this thread that has not yet ended.
+    void endEvent( EventHandle handle );
     void endEvent( const std::string& name );
 
+    // Statistics over all beginEvent()/endEvent() pairs since the event
+    // was registered or reset, on all threads.
+    Statistics statistics( EventHandle handle ) const;
+    Statistics statistics( const std::string& name ) const;
+
     // Returns the average time spent on an event over all
     // beginEvent()/endEvent pairs.
-    float averageTimeMilliseconds( const std::string& name );
+    float averageTimeMilliseconds( EventHandle handle ) const;
+    float averageTimeMilliseconds( const std::string& name ) const;
+
+    // Write the trace buffers of all threads as Chrome trace-event JSON.
+    // Events still being recorded are skipped.
+    // Returns false if the file could not be written.
+    bool saveChromeTrace( const std::string& filename ) const;
 
 private:
 
     using Clock = std::chrono::high_resolution_clock;
-    using FloatDurationMS = std::chrono::duration< float, std::milli >;
 
-    // In nanoseconds.
-    std::unordered_map< std::string, Clock::time_point > m_eventStartTime;
-    std::unordered_map< std::string, Clock::duration > m_eventTotalElapsedTime;
-    std::unordered_map< std::string, int > m_eventCounts;
+    struct Histogram;
+    struct TraceRecord;
+    struct ThreadState;
+
+    // The state of the calling thread, created on first use.
+    ThreadState* threadState();
+
+    // Merge the histograms of all threads for "handle".
+    void mergeHistograms( EventHandle handle, std::vector< int64_t >& buckets,
+        int64_t& count, int64_t& totalNS, int64_t& maxNS ) const;
+
+    // Identifies this collector in thread-local caches, which outlive it.
+    const uint64_t m_id;
+    const int m_traceCapacity;
+    const Clock::time_point m_epoch;
+
+    mutable std::mutex m_mutex;
+
+    // Event name by handle. Empty if the handle is free.
+    std::vector< std::string > m_eventNames;
 
+    // One per thread that has used this collector.
+    std::vector< std::unique_ptr< ThreadState > > m_threadStates;
 };
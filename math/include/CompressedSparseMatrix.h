@@ -26,10 +26,36 @@ public:
     uint32_t numCols() const;
 
     // only valid where the structure is already defined
-    // get and put takes O( log( nnz ) ) since it requires a binary search tree lookup
+    // get and put take O( log( nnz in column j ) ): they call slot()
+    // get returns 0 if (i,j) is not in the structure, put ignores it
     T get( uint32_t i, uint32_t j ) const;
     void put( uint32_t i, uint32_t j, const T& value );
 
+    // returns the index of (i,j) in values() and innerIndices(),
+    // or -1 if (i,j) is not in the structure
+    // binary searches the row indices of column j, which must be sorted
+    // (as produced by CoordinateSparseMatrix::compress(), transposed(),
+    // and multiply())
+    int slot( uint32_t i, uint32_t j ) const;
+
+    // slots[ k ] <-- slot( rows[ k ], cols[ k ] )
+    // for assembling the same sparsity pattern repeatedly:
+    // look up the slots once, then scatter() values each time
+    void findSlots( const std::vector< uint32_t >& rows, const std::vector< uint32_t >& cols,
+        std::vector< int >& slots ) const;
+
+    // values()[ slots[ k ] ] <-- values[ k ]
+    // slots < 0 are skipped
+    void scatter( const std::vector< int >& slots, const std::vector< T >& values );
+
+    // values()[ slots[ k ] ] += values[ k ]
+    // for assembly where several terms contribute to the same entry
+    // slots < 0 are skipped
+    void scatterAdd( const std::vector< int >& slots, const std::vector< T >& values );
+
+    // values() <-- 0, keeping the structure
+    void clearValues();
+
     MatrixType matrixType() const;
 
     // the non-zero values of this matrix
@@ -51,10 +77,6 @@ public:
     std::vector< uint32_t >& outerIndexPointers();
     const std::vector< uint32_t >& outerIndexPointers() const;
 
-    // returns a data structure mapping indices (i,j)
-    // to indices in values() and innerIndices()
-    SparseMatrixStructureTreeMap& structureMap();
-
     void transposed( CompressedSparseMatrix< T >& f ) const;
 
     // sparse-dense vector product
@@ -67,6 +89,47 @@ public:
     // x should be m x 1, y should be n x 1
     void multiplyTransposeVector( FloatMatrix& x, FloatMatrix& y );
 
+    // Builds a compressed sparse row copy of this matrix (the "row mirror"),
+    // so that each row of A x can be computed independently, without
+    // scattering into y. Call this after changing the structure.
+    void buildRowMirror();
+
+    // Copies values() into the row mirror. Call this after changing values
+    // but not the structure (e.g., once per Gauss-Newton iteration).
+    void updateRowMirrorValues();
+
+    // Returns true if the row mirror has been built for the current
+    // dimensions and number of non-zeros.
+    bool hasRowMirror() const;
+
+    // Multi-threaded sparse-dense products on the global ThreadPool, for
+    // GENERAL matrices.
+    //
+    // y <-- Ax
+    // Requires the row mirror. Each thread computes a contiguous range of
+    // rows.
+    // Also accepts SYMMETRIC matrices with one triangle stored (e.g., the
+    // output of multiplyTranspose()): y[ i ] gathers row i from the mirror
+    // and the off-diagonal entries of column i, so nothing is scattered.
+    void parallelMultiplyVector( const FloatMatrix& x, FloatMatrix& y ) const;
+
+    // y <-- A' x
+    // Each y[ j ] is a dot product with column j, so no mirror is needed.
+    void parallelMultiplyTransposeVector( const FloatMatrix& x,
+        FloatMatrix& y ) const;
+
+    // Sparse-dense matrix products, for several right hand sides at once.
+    // Each row or column of A is loaded once for all columns of x.
+    //
+    // y <-- Ax
+    // x should be n x k, y will be m x k. Requires the row mirror.
+    void parallelMultiplyMatrix( const FloatMatrix& x, FloatMatrix& y ) const;
+
+    // y <-- A' x
+    // x should be m x k, y will be n x k.
+    void parallelMultiplyTransposeMatrix( const FloatMatrix& x,
+        FloatMatrix& y ) const;
+
     // sparse-sparse product
     // computes A^T A
     // Since the product is always symmetric,
@@ -89,6 +152,19 @@ public:
     // TODO: if output format is full, do the copy
     void multiplyTranspose( CompressedSparseMatrix< T >& product ) const;
 
+    // A'A in two phases, for when the structure of A is fixed but its values
+    // change (e.g., the Jacobian in Gauss-Newton). Both require the row
+    // mirror, and product must be SYMMETRIC: only the lower triangle is
+    // stored, with sorted row indices.
+    //
+    // multiplyTransposeStructure() resets product to the structure of A'A,
+    // with zero values.
+    // parallelMultiplyTranspose() computes the values, assuming product has
+    // that structure. Each column of the product is accumulated
+    // independently, one range of columns per thread.
+    void multiplyTransposeStructure( CompressedSparseMatrix< T >& product ) const;
+    void parallelMultiplyTranspose( CompressedSparseMatrix< T >& product ) const;
+
     // copy data from the same matrix in coordinate format given index map
     void gather( const CoordinateSparseMatrix< T >& coord, const std::vector< int >& indexMap );
 
@@ -113,8 +189,10 @@ private:
     std::vector< uint32_t > m_innerIndices;
     std::vector< uint32_t > m_outerIndexPointers;
 
-    // structure dictionary
-    // mapping matrix coordinates (i,j) --> index k
-    // in m_values and m_innerIndices
-    SparseMatrixStructureTreeMap m_structureMap;
+    // Row mirror: compressed sparse row storage of the same matrix.
+    // m_rowValues[ k ] is a copy of m_values[ m_rowSourceIndices[ k ] ].
+    std::vector< T > m_rowValues;
+    std::vector< uint32_t > m_rowInnerIndices;
+    std::vector< uint32_t > m_rowOuterIndexPointers;
+    std::vector< uint32_t > m_rowSourceIndices;
 };
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+
+#include <common/BasicTypes.h>
+
+#include "SparseLinearSolver.h"
+
+// Iterative solver for sparse symmetric systems A x = b that needs no
+// external libraries. Memory is bounded: a few vectors of length n, plus the
+// incomplete Cholesky factor, which has the same structure as A's lower
+// triangle.
+//
+// A is a square CompressedSparseMatrix< float > that is either SYMMETRIC with
+// one triangle stored (e.g., J'J from multiplyTranspose()), or GENERAL with
+// both triangles stored. Products with A are multi-threaded on the global
+// ThreadPool (see CompressedSparseMatrix::parallelMultiplyVector()).
+//
+// Usage mirrors PARDISOSolver (see SparseLinearSolver):
+//   analyzePattern( A ) once per sparsity structure,
+//   factorize( A ) whenever the values change,
+//   then solve() for any number of right hand sides.
+// A must stay alive and unchanged between factorize() and solve().
+class ConjugateGradientSolver : public SparseLinearSolver
+{
+public:
+
+    enum Method
+    {
+        // preconditioned conjugate gradients:
+        // A must be symmetric positive definite
+        CONJUGATE_GRADIENT,
+
+        // preconditioned MINRES:
+        // A may be symmetric indefinite (e.g., a saddle point system)
+        // but the preconditioner must be positive definite
+        MINRES
+    };
+
+    enum Preconditioner
+    {
+        NO_PRECONDITIONER,
+
+        // M = diag( A ), or diag( |A| ) for MINRES
+        JACOBI,
+
+        // M = L L', where L has the sparsity of A's lower triangle
+        // if the factorization breaks down, the diagonal is shifted until it
+        // succeeds
+        INCOMPLETE_CHOLESKY
+    };
+
+    ConjugateGradientSolver( Method method = CONJUGATE_GRADIENT,
+        Preconditioner preconditioner = JACOBI );
+
+    Method method() const;
+    void setMethod( Method method );
+
+    // call analyzePattern() again after changing the preconditioner
+    Preconditioner preconditioner() const;
+    void setPreconditioner( Preconditioner preconditioner );
+
+    // iteration stops when || b - Ax || <= tolerance * || b ||
+    // (for MINRES, the residual is measured in the preconditioner's norm)
+    // or after maxIterations
+    float tolerance() const;
+    void setTolerance( float tolerance );
+
+    int maxIterations() const;
+    void setMaxIterations( int maxIterations );
+
+    // builds A's row mirror and the preconditioner's structure
+    // returns false if A is not square
+    virtual bool analyzePattern( CompressedSparseMatrix< float >& A ) override;
+
+    // copies A's values into its row mirror and computes the preconditioner
+    // A must have the structure given to analyzePattern()
+    // returns false if the preconditioner could not be computed
+    virtual bool factorize( CompressedSparseMatrix< float >& A ) override;
+
+    // solve A x = b, with A from the last factorize(), starting from 0
+    // solution is automatically resized to n x 1
+    // returns true if the tolerance was reached
+    virtual bool solve( const FloatMatrix& rhs, FloatMatrix& solution ) override;
+
+    // same as above, but if warmStart is true and solution is already n x 1,
+    // it is used as the initial guess
+    bool solve( const FloatMatrix& rhs, FloatMatrix& solution,
+        bool warmStart );
+
+    // statistics from the last solve()
+    int numIterations() const;
+    float relativeResidual() const;
+
+private:
+
+    void applyPreconditioner( const FloatMatrix& r, FloatMatrix& z ) const;
+
+    // attempts IC(0) of A + shift * diag( A ) in m_icValues
+    bool incompleteCholesky( const std::vector< float >& aValues,
+        float shift );
+
+    // iterate from the current solution, counting on from m_nIterations
+    bool solveConjugateGradient( const FloatMatrix& rhs,
+        FloatMatrix& solution );
+    bool solveMINRES( const FloatMatrix& rhs, FloatMatrix& solution );
+
+    Method m_method;
+    Preconditioner m_preconditioner;
+    float m_tolerance;
+    int m_maxIterations;
+
+    const CompressedSparseMatrix< float >* m_pA;
+    int m_n;
+
+    // for JACOBI: the index of each diagonal entry in A.values() (or -1)
+    // and the inverse of the diagonal
+    std::vector< int > m_diagonalSlots;
+    std::vector< float > m_inverseDiagonal;
+
+    // for INCOMPLETE_CHOLESKY: the factor L, in compressed sparse column
+    // format with sorted row indices, so the diagonal comes first in each
+    // column
+    // m_icValues[ k ] is computed from A.values()[ m_icSourceIndices[ k ] ]
+    std::vector< float > m_icValues;
+    std::vector< uint32_t > m_icInnerIndices;
+    std::vector< uint32_t > m_icOuterIndexPointers;
+    std::vector< uint32_t > m_icSourceIndices;
+
+    int m_nIterations;
+    float m_relativeResidual;
+};
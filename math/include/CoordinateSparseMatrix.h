@@ -1,6 +1,6 @@
 #pragma once
 
-#include <QString>
+#include <string>
 
 #include "SparseMatrixCommon.h"
 #include "CompressedSparseMatrix.h"
@@ -63,15 +63,15 @@ public:
 
     // TODO: multiplyMatrix with mkl_?coomm
 
-    bool loadTXT( QString filename );
-    bool saveTXT( QString filename );
+    bool loadTXT( const std::string& filename );
+    bool saveTXT( const std::string& filename );
 
 private:
 
     // TODO: use the three array variation
     // SparseMatrixTriplet< T >s are used only for sorting during compression anyway
 
-    void compressCore( std::vector< SparseMatrixTriplet< T > > ijvSorted, CompressedSparseMatrix< T >& output ) const;
+    void compressCore( const std::vector< SparseMatrixTriplet< T > >& ijvSorted, CompressedSparseMatrix< T >& output ) const;
 
     // compare i first, then j
     static bool rowMajorLess( SparseMatrixTriplet< T >& a, SparseMatrixTriplet< T >& b );
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <map>
-#include <QString>
+#include <string>
 
 #include "SparseMatrixCommon.h"
 
@@ -22,10 +22,13 @@ public:
 
     // one-based: useful for FORTRAN-style numerical libraries
     // upperTriangleOnly: if the input is already symmetric and positive definite
+    // the output is compressed by rows (the outer index is i), for PARDISO:
+    // CompressedSparseMatrix::get(), put(), and slot() see it transposed,
+    // and do not work if oneBased is true
     void compress( CompressedSparseMatrix< T >& output,
         bool oneBased = false, bool upperTriangleOnly = false ) const;
 
-    QString toString() const;
+    std::string toString() const;
 
 private:
 
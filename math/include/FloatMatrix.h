@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include <vecmath/Vector2i.h>
@@ -7,8 +8,6 @@
 
 #include "MatrixCommon.h"
 
-class QString;
-
 class FloatMatrix
 {
 public:
@@ -178,18 +177,19 @@ public:
     float minimum() const;
     float maximum() const;
 
-    bool loadTXT( QString filename );
-    bool saveTXT( QString filename );
+    bool loadTXT( const std::string& filename );
+    bool saveTXT( const std::string& filename );
 
     void print( const char* prefix = nullptr, const char* suffix = nullptr ) const;
-    QString toString();
+    std::string toString();
 
 private:
 
-    // calls MKL's ?lange to compute a norm
+    // computes a norm (with MKL's ?lange if available)
     // whichNorm can be:
     // 'm' for maximum absolute value
-    // 'o' for the 1-norm (maximum column sum), or
+    // 'o' for the 1-norm (maximum column sum),
+    // 'i' for the infinity norm (maximum row sum), or
     // 'f' for the Frobenius norm (sqrt of sum of squares)
     float norm( char whichNorm ) const;
 
@@ -1,9 +1,6 @@
-// TODO: use Eigen instead of CHOLMOD directly
-#if 0
 #pragma once
 
-#include <cholmod.h>
-#include <SparseMatrix.h>
+#include "CoordinateSparseMatrix.h"
 
 class FloatMatrix;
 
@@ -27,15 +24,11 @@ public:
     //   residual is a numFunctions x 1 vector
     //   J is a numFunctions x numVariables sparse matrix
     //     J(i,j) = \frac{ \partial r_i }{ \partial \Beta_j } | \Beta
-
-    // and return it in r (a numFunctions x 1 vector)
-    virtual void evaluateResidualAndJacobian( const FloatMatrix& beta,
-        FloatMatrix& residual, cholmod_triplet* J ) = 0;
-
+    //
+    // J is empty on input: append its non-zero entries.
+    // SparseGaussNewton analyzes the structure of J only once, so every call
+    // must append the same (i,j) in the same order, even entries that happen
+    // to be zero at this beta.
     virtual void evaluateResidualAndJacobian( const FloatMatrix& beta,
         FloatMatrix& residual, CoordinateSparseMatrix< float >& J ) = 0;
-
-    virtual void evaluateResidualAndJacobian( const FloatMatrix& beta,
-        FloatMatrix& residual, CompressedSparseMatrix< float >& J ) = 0;
 };
-#endif
\ No newline at end of file
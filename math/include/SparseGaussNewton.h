@@ -1,90 +1,110 @@
-// TODO: use Eigen instead of CHOLMOD directly
-#if 0
 #pragma once
 
 #include <memory>
-#include <common/BasicTypes.h>
+#include <vector>
 
-#include "SparseEnergy.h"
+#include "CompressedSparseMatrix.h"
+#include "CoordinateSparseMatrix.h"
 #include "FloatMatrix.h"
-
-#include <cholmod.h>
-#include <SuiteSparseQR.hpp>
-
-#include "SparseMatrix.h"
-#include "PARDISOSolver.h"
-
+#include "SparseEnergy.h"
+#include "SparseLinearSolver.h"
+
+// Minimizes E( beta ) = || r( beta ) ||^2 for a SparseEnergy.
+//
+// Each iteration solves the normal equations
+//   ( J'J + lambda * diag( J'J ) ) delta = J'r
+// and steps to beta - delta.
+//
+// With damping lambda = 0 (the default), this is Gauss-Newton and every step
+// is taken. With lambda > 0, it is Levenberg-Marquardt: a step that does not
+// decrease the energy is rejected and lambda grows, and a step that does is
+// taken and lambda shrinks.
+//
+// The structure of J and J'J, and the linear solver's analysis of it, are
+// computed on the first iteration and reused until the energy or the solver
+// is replaced, or the number of non-zeroes in J changes. J'J and J'r are
+// computed in parallel on the global ThreadPool.
 class SparseGaussNewton
 {
 public:
 
     // Initialize Sparse Gauss-Newton solver
-    // pEnergy->numFunctions() >= pEnergy->numParameters()
+    // pEnergy->numFunctions() >= pEnergy->numVariables()
     //
     // Parameters:
-    //   epsilon: minimize() will run until the residual has squared norm < epsilon
-    //   or...
-    //
     //   maxNumIterations n: minimize() will run for at most n iterations.
-    //   Set to a negative number to ignore
     //
-    SparseGaussNewton( std::shared_ptr< SparseEnergy > pEnergy, cholmod_common* pcc,
+    //   epsilon: minimize() will run until the energy changes by less than
+    //   epsilon * ( 1 + energy ) in one iteration
+    //
+    //   pLinearSolver: solves the normal equations.
+    //   If null, uses a ConjugateGradientSolver with an incomplete Cholesky
+    //   preconditioner and a relative tolerance of 1e-4, which needs no
+    //   external libraries.
+    //   (PARDISO, CHOLMOD, etc. can be used by implementing SparseLinearSolver.)
+    //
+    SparseGaussNewton( std::shared_ptr< SparseEnergy > pEnergy,
         int maxNumIterations = 100,
-        float epsilon = 1e-6 );
-    virtual ~SparseGaussNewton();
+        float epsilon = 1e-6f,
+        std::shared_ptr< SparseLinearSolver > pLinearSolver = nullptr );
 
     void setEnergy( std::shared_ptr< SparseEnergy > pEnergy );
 
-    uint32_t maxNumIterations() const;
-    void setMaxNumIterations( uint32_t maxNumIterations );
+    std::shared_ptr< SparseLinearSolver > linearSolver() const;
+    void setLinearSolver( std::shared_ptr< SparseLinearSolver > pLinearSolver );
+
+    int maxNumIterations() const;
+    void setMaxNumIterations( int maxNumIterations );
 
     float epsilon() const;
     void setEpsilon( float epsilon );
 
-    // use SPQR
+    // the initial Levenberg-Marquardt damping lambda
+    // 0 for Gauss-Newton
+    float damping() const;
+    void setDamping( float damping );
+
+    // returns the minimizing beta
+    // pNumIterations counts rejected steps too
+    // stops early if the linear solver fails
     const FloatMatrix& minimize( float* pEnergyFound = nullptr, int* pNumIterations = nullptr );
 
-    // use CHOLMOD
-    const FloatMatrix& minimize2( float* pEnergyFound = nullptr, int* pNumIterations = nullptr );
+private:
 
-    // use PARDISO
-    const FloatMatrix& minimize3( float* pEnergyFound = nullptr, int* pNumIterations = nullptr );
+    // evaluates the residual and Jacobian at beta into m_r and m_coordJ
+    // returns the energy || r ||^2
+    float evaluate( const FloatMatrix& beta );
 
-private:
+    // updates m_cscJ from m_coordJ, then computes m_cscJtJ and m_jtr
+    // so that they describe the last beta evaluated
+    // analyzes the structure first if needed
+    bool updateNormalEquations();
 
     std::shared_ptr< SparseEnergy > m_pEnergy;
+    std::shared_ptr< SparseLinearSolver > m_pLinearSolver;
     int m_maxNumIterations;
     float m_epsilon;
-    float m_sqrtEpsilon;
+    float m_damping;
 
-    cholmod_common* m_pcc;
-    cholmod_triplet* m_J;
-    SuiteSparseQR_factorization< double >* m_pFactorization;
-
-    FloatMatrix m_prevBeta;
+    // the current and candidate solutions
     FloatMatrix m_currBeta;
+    FloatMatrix m_nextBeta;
     FloatMatrix m_delta;
-    FloatMatrix m_r;
-    cholmod_dense* m_r2;
 
-    // for Cholesky:
-    // solve J'J \Beta = J'r
-    cholmod_factor* m_L;
-    cholmod_dense* m_jtr2;
-
-    // for PARDISO + Eigen
+    // the residual and Jacobian at the last beta evaluated
+    FloatMatrix m_r;
     CoordinateSparseMatrix< float > m_coordJ;
+
+    // m_cscJ.values()[ k ] comes from m_coordJ.get( m_jIndexMap[ k ] )
     CompressedSparseMatrix< float > m_cscJ;
-    CompressedSparseMatrix< float > m_cscJt;
     std::vector< int > m_jIndexMap;
-    std::vector< int > m_jtIndexMap;
 
+    // J'J (lower triangle) and J'r
+    // and the index and undamped value of each diagonal entry of J'J
     CompressedSparseMatrix< float > m_cscJtJ;
     FloatMatrix m_jtr;
-
-    // Eigen::VectorXf m_eJtR;
+    std::vector< int > m_jtjDiagonalSlots;
+    std::vector< float > m_jtjDiagonal;
 
     bool m_alreadySetup;
-    PARDISOSolver< float, true > m_pardiso;
 };
-#endif
\ No newline at end of file
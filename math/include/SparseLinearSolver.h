@@ -0,0 +1,27 @@
+#pragma once
+
+template< typename valueType >
+class CompressedSparseMatrix;
+
+class FloatMatrix;
+
+// interface
+// A solver for sparse symmetric systems A x = b, where A is square
+// and either SYMMETRIC (one triangle stored) or GENERAL.
+//
+// Callers analyze the pattern once per sparsity structure,
+// factorize whenever the values change, then solve any number of times.
+// Solvers may keep a reference to A between factorize() and solve().
+class SparseLinearSolver
+{
+public:
+
+    virtual ~SparseLinearSolver() = default;
+
+    virtual bool analyzePattern( CompressedSparseMatrix< float >& A ) = 0;
+
+    virtual bool factorize( CompressedSparseMatrix< float >& A ) = 0;
+
+    // solution is automatically resized to A.numRows() x 1
+    virtual bool solve( const FloatMatrix& rhs, FloatMatrix& solution ) = 0;
+};
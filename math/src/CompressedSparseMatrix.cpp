@@ -3,14 +3,33 @@
 #include <cassert>
 #include <algorithm>
 
+#ifdef LIBCGT_USE_MKL
 #include <mkl_spblas.h>
+#endif
 
 #include <common/Comparators.h>
-#include <time/StopWatch.h>
+#include <concurrency/ThreadPool.h>
 
 #include "CoordinateSparseMatrix.h"
 #include "FloatMatrix.h"
 
+namespace
+{
+
+// a zero-filled array of at least n elements, one per thread
+// callers must leave it zero-filled when they are done
+template< typename U >
+std::vector< U >& threadWorkspace( int n )
+{
+    static thread_local std::vector< U > workspace;
+    if( workspace.size() < static_cast< size_t >( n ) )
+    {
+        workspace.resize( n, U( 0 ) );
+    }
+    return workspace;
+}
+
+}
 
 template< typename T >
 CompressedSparseMatrix< T >::CompressedSparseMatrix( MatrixType matrixType,
@@ -31,7 +50,11 @@ void CompressedSparseMatrix< T >::reset( uint32_t nRows, uint32_t nCols, uint32_
     m_values.resize( nnz );
     m_innerIndices.resize( nnz );
     m_outerIndexPointers.resize( nCols + 1 );
-    m_structureMap.clear();
+
+    m_rowValues.clear();
+    m_rowInnerIndices.clear();
+    m_rowOuterIndexPointers.clear();
+    m_rowSourceIndices.clear();
 }
 
 template< typename T >
@@ -57,10 +80,9 @@ T CompressedSparseMatrix< T >::get( uint32_t i, uint32_t j ) const
 {
     T output( 0 );
 
-    auto itr = m_structureMap.find( std::make_pair( i, j ) );
-    if( itr != m_structureMap.end() )
+    int k = slot( i, j );
+    if( k >= 0 )
     {
-        uint32_t k = itr->second;
         output = m_values[ k ];
     }
 
@@ -70,8 +92,79 @@ T CompressedSparseMatrix< T >::get( uint32_t i, uint32_t j ) const
 template< typename T >
 void CompressedSparseMatrix< T >::put( uint32_t i, uint32_t j, const T& value )
 {
-    uint32_t k = m_structureMap[ std::make_pair( i, j ) ];
-    m_values[ k ] = value;
+    int k = slot( i, j );
+    assert( k >= 0 );
+    if( k >= 0 )
+    {
+        m_values[ k ] = value;
+    }
+}
+
+template< typename T >
+int CompressedSparseMatrix< T >::slot( uint32_t i, uint32_t j ) const
+{
+    if( j >= m_nCols )
+    {
+        return -1;
+    }
+
+    auto begin = m_innerIndices.begin() + m_outerIndexPointers[ j ];
+    auto end = m_innerIndices.begin() + m_outerIndexPointers[ j + 1 ];
+    auto itr = std::lower_bound( begin, end, i );
+    if( itr != end && *itr == i )
+    {
+        return static_cast< int >( itr - m_innerIndices.begin() );
+    }
+    return -1;
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::findSlots( const std::vector< uint32_t >& rows,
+    const std::vector< uint32_t >& cols, std::vector< int >& slots ) const
+{
+    assert( rows.size() == cols.size() );
+
+    slots.resize( rows.size() );
+    for( size_t k = 0; k < rows.size(); ++k )
+    {
+        slots[ k ] = slot( rows[ k ], cols[ k ] );
+    }
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::scatter( const std::vector< int >& slots, const std::vector< T >& values )
+{
+    assert( slots.size() == values.size() );
+
+    for( size_t k = 0; k < slots.size(); ++k )
+    {
+        int l = slots[ k ];
+        if( l >= 0 )
+        {
+            m_values[ l ] = values[ k ];
+        }
+    }
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::scatterAdd( const std::vector< int >& slots, const std::vector< T >& values )
+{
+    assert( slots.size() == values.size() );
+
+    for( size_t k = 0; k < slots.size(); ++k )
+    {
+        int l = slots[ k ];
+        if( l >= 0 )
+        {
+            m_values[ l ] += values[ k ];
+        }
+    }
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::clearValues()
+{
+    std::fill( m_values.begin(), m_values.end(), T( 0 ) );
 }
 
 template< typename T >
@@ -116,12 +209,6 @@ const std::vector< uint32_t >& CompressedSparseMatrix< T >::outerIndexPointers()
     return m_outerIndexPointers;
 }
 
-template< typename T >
-std::map< SparseMatrixKey, uint32_t >& CompressedSparseMatrix< T >::structureMap()
-{
-    return m_structureMap;
-}
-
 template< typename T >
 void CompressedSparseMatrix< T >::transposed( CompressedSparseMatrix< T >& f ) const
 {
@@ -193,14 +280,6 @@ void CompressedSparseMatrix< T >::transposed( CompressedSparseMatrix< T >& f ) c
         }
     }
 
-    // setup output structure map
-    for( auto itr = m_structureMap.begin(); itr != m_structureMap.end(); ++itr )
-    {
-        auto ij = itr->first;
-        auto k = itr->second;
-        auto ji = std::make_pair( ij.second, ij.first );
-        f.m_structureMap[ ji ] = k;
-    }
 }
 
 template< typename T >
@@ -218,6 +297,7 @@ void CompressedSparseMatrix< T >::multiplyVector( FloatMatrix& x, FloatMatrix& y
 
     if( matrixType() == GENERAL )
     {
+#ifdef LIBCGT_USE_MKL
 #if 0
         // mkl_cspblas_scsrgemv assumes CSR storage
         // since we use CSC, call it transposed (set transa to 't')
@@ -263,7 +343,17 @@ void CompressedSparseMatrix< T >::multiplyVector( FloatMatrix& x, FloatMatrix& y
             &beta,
             y.data()
         );
-
+#else
+        // scatter column j, scaled by x[j], into y
+        for( int j = 0; j < n; ++j )
+        {
+            float xj = x[ j ];
+            for( uint32_t k = m_outerIndexPointers[ j ]; k < m_outerIndexPointers[ j + 1 ]; ++k )
+            {
+                y[ m_innerIndices[ k ] ] += static_cast< float >( m_values[ k ] ) * xj;
+            }
+        }
+#endif
     }
     else if( matrixType() == SYMMETRIC )
     {
@@ -288,6 +378,7 @@ void CompressedSparseMatrix< T >::multiplyTransposeVector( FloatMatrix& x, Float
 
     if( matrixType() == GENERAL )
     {
+#ifdef LIBCGT_USE_MKL
 #if 0
         // mkl_cspblas_scsrgemv assumes CSR storage
         // since this is the transposed version, don't transpose
@@ -333,6 +424,18 @@ void CompressedSparseMatrix< T >::multiplyTransposeVector( FloatMatrix& x, Float
             &beta,
             y.data()
         );
+#else
+        // y[j] is the dot product of column j with x
+        for( int j = 0; j < n; ++j )
+        {
+            float sum = 0;
+            for( uint32_t k = m_outerIndexPointers[ j ]; k < m_outerIndexPointers[ j + 1 ]; ++k )
+            {
+                sum += static_cast< float >( m_values[ k ] ) * x[ m_innerIndices[ k ] ];
+            }
+            y[ j ] = sum;
+        }
+#endif
     }
     else if( matrixType() == SYMMETRIC )
     {
@@ -343,6 +446,234 @@ void CompressedSparseMatrix< T >::multiplyTransposeVector( FloatMatrix& x, Float
     }
 }
 
+template< typename T >
+void CompressedSparseMatrix< T >::buildRowMirror()
+{
+    uint32_t m = numRows();
+    uint32_t n = numCols();
+    uint32_t nnz = numNonZeros();
+
+    m_rowValues.resize( nnz );
+    m_rowInnerIndices.resize( nnz );
+    m_rowSourceIndices.resize( nnz );
+    m_rowOuterIndexPointers.assign( m + 1, 0 );
+
+    // count the number of entries in each row, then scan to get row pointers
+    for( uint32_t k = 0; k < nnz; ++k )
+    {
+        ++( m_rowOuterIndexPointers[ m_innerIndices[ k ] + 1 ] );
+    }
+    for( uint32_t i = 0; i < m; ++i )
+    {
+        m_rowOuterIndexPointers[ i + 1 ] += m_rowOuterIndexPointers[ i ];
+    }
+
+    // sweep through the columns in order, so that the column indices within
+    // each row come out sorted
+    std::vector< uint32_t > next( m_rowOuterIndexPointers.begin(),
+        m_rowOuterIndexPointers.end() - 1 );
+    for( uint32_t j = 0; j < n; ++j )
+    {
+        for( uint32_t k = m_outerIndexPointers[ j ]; k < m_outerIndexPointers[ j + 1 ]; ++k )
+        {
+            uint32_t q = next[ m_innerIndices[ k ] ]++;
+            m_rowInnerIndices[ q ] = j;
+            m_rowSourceIndices[ q ] = k;
+        }
+    }
+
+    updateRowMirrorValues();
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::updateRowMirrorValues()
+{
+    assert( hasRowMirror() );
+
+    int nnz = static_cast< int >( m_rowValues.size() );
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, nnz, 0,
+        [&] ( int begin, int end )
+        {
+            for( int k = begin; k < end; ++k )
+            {
+                m_rowValues[ k ] = m_values[ m_rowSourceIndices[ k ] ];
+            }
+        }
+    );
+}
+
+template< typename T >
+bool CompressedSparseMatrix< T >::hasRowMirror() const
+{
+    return m_rowOuterIndexPointers.size() == m_nRows + 1 &&
+        m_rowValues.size() == m_values.size();
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::parallelMultiplyVector( const FloatMatrix& x, FloatMatrix& y ) const
+{
+    assert( hasRowMirror() );
+
+    int m = numRows();
+    int n = numCols();
+
+    assert( x.numRows() == n );
+    assert( x.numCols() == 1 );
+
+    if( y.numRows() != m || y.numCols() != 1 )
+    {
+        y.resize( m, 1 );
+    }
+
+    bool symmetric = ( matrixType() == SYMMETRIC );
+    assert( !symmetric || m == n );
+
+    const float* px = x.data();
+    float* py = y.data();
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, m, 0,
+        [&] ( int begin, int end )
+        {
+            for( int i = begin; i < end; ++i )
+            {
+                T sum( 0 );
+                for( uint32_t k = m_rowOuterIndexPointers[ i ]; k < m_rowOuterIndexPointers[ i + 1 ]; ++k )
+                {
+                    sum += m_rowValues[ k ] * px[ m_rowInnerIndices[ k ] ];
+                }
+                if( symmetric )
+                {
+                    // the mirrored half: column i, minus the diagonal
+                    for( uint32_t k = m_outerIndexPointers[ i ]; k < m_outerIndexPointers[ i + 1 ]; ++k )
+                    {
+                        uint32_t r = m_innerIndices[ k ];
+                        if( r != static_cast< uint32_t >( i ) )
+                        {
+                            sum += m_values[ k ] * px[ r ];
+                        }
+                    }
+                }
+                py[ i ] = sum;
+            }
+        }
+    );
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::parallelMultiplyTransposeVector( const FloatMatrix& x, FloatMatrix& y ) const
+{
+    assert( matrixType() == GENERAL );
+
+    int m = numRows();
+    int n = numCols();
+
+    assert( x.numRows() == m );
+    assert( x.numCols() == 1 );
+
+    if( y.numRows() != n || y.numCols() != 1 )
+    {
+        y.resize( n, 1 );
+    }
+
+    const float* px = x.data();
+    float* py = y.data();
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, n, 0,
+        [&] ( int begin, int end )
+        {
+            for( int j = begin; j < end; ++j )
+            {
+                T sum( 0 );
+                for( uint32_t k = m_outerIndexPointers[ j ]; k < m_outerIndexPointers[ j + 1 ]; ++k )
+                {
+                    sum += m_values[ k ] * px[ m_innerIndices[ k ] ];
+                }
+                py[ j ] = sum;
+            }
+        }
+    );
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::parallelMultiplyMatrix( const FloatMatrix& x, FloatMatrix& y ) const
+{
+    assert( matrixType() == GENERAL );
+    assert( hasRowMirror() );
+
+    int m = numRows();
+    int n = numCols();
+    int nRHS = x.numCols();
+
+    assert( x.numRows() == n );
+
+    if( y.numRows() != m || y.numCols() != nRHS )
+    {
+        y.resize( m, nRHS );
+    }
+
+    // FloatMatrix is column major: column c of x starts at px + c * n
+    const float* px = x.data();
+    float* py = y.data();
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, m, 0,
+        [&] ( int begin, int end )
+        {
+            for( int i = begin; i < end; ++i )
+            {
+                uint32_t kStart = m_rowOuterIndexPointers[ i ];
+                uint32_t kEnd = m_rowOuterIndexPointers[ i + 1 ];
+                for( int c = 0; c < nRHS; ++c )
+                {
+                    const float* xc = px + static_cast< size_t >( c ) * n;
+                    T sum( 0 );
+                    for( uint32_t k = kStart; k < kEnd; ++k )
+                    {
+                        sum += m_rowValues[ k ] * xc[ m_rowInnerIndices[ k ] ];
+                    }
+                    py[ i + static_cast< size_t >( c ) * m ] = sum;
+                }
+            }
+        }
+    );
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::parallelMultiplyTransposeMatrix( const FloatMatrix& x, FloatMatrix& y ) const
+{
+    assert( matrixType() == GENERAL );
+
+    int m = numRows();
+    int n = numCols();
+    int nRHS = x.numCols();
+
+    assert( x.numRows() == m );
+
+    if( y.numRows() != n || y.numCols() != nRHS )
+    {
+        y.resize( n, nRHS );
+    }
+
+    const float* px = x.data();
+    float* py = y.data();
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, n, 0,
+        [&] ( int begin, int end )
+        {
+            for( int j = begin; j < end; ++j )
+            {
+                uint32_t kStart = m_outerIndexPointers[ j ];
+                uint32_t kEnd = m_outerIndexPointers[ j + 1 ];
+                for( int c = 0; c < nRHS; ++c )
+                {
+                    const float* xc = px + static_cast< size_t >( c ) * m;
+                    T sum( 0 );
+                    for( uint32_t k = kStart; k < kEnd; ++k )
+                    {
+                        sum += m_values[ k ] * xc[ m_innerIndices[ k ] ];
+                    }
+                    py[ j + static_cast< size_t >( c ) * n ] = sum;
+                }
+            }
+        }
+    );
+}
+
 template< typename T >
 void CompressedSparseMatrix< T >::multiplyTranspose( CoordinateSparseMatrix< T >& product ) const
 {
@@ -403,13 +734,18 @@ void CompressedSparseMatrix< T >::multiplyTranspose( CoordinateSparseMatrix< T >
 template< typename T >
 void CompressedSparseMatrix< T >::gather( const CoordinateSparseMatrix< T >& coord, const std::vector< int >& indexMap )
 {
-    uint32_t nnz = numNonZeros();
-    for( uint32_t k = 0; k < nnz; ++k )
-    {
-        int l = indexMap[ k ];
-        auto ijk = coord.get( l );
-        m_values[ k ] = ijk.value;
-    }
+    int nnz = static_cast< int >( numNonZeros() );
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, nnz, 0,
+        [&] ( int begin, int end )
+        {
+            for( int k = begin; k < end; ++k )
+            {
+                int l = indexMap[ k ];
+                auto ijk = coord.get( l );
+                m_values[ k ] = ijk.value;
+            }
+        }
+    );
 }
 
 template< typename T >
@@ -472,6 +808,135 @@ void CompressedSparseMatrix< T >::multiplyTranspose( CompressedSparseMatrix< T >
     }
 }
 
+template< typename T >
+void CompressedSparseMatrix< T >::multiplyTransposeStructure( CompressedSparseMatrix< T >& product ) const
+{
+    assert( hasRowMirror() );
+    assert( product.matrixType() == SYMMETRIC );
+
+    int n = numCols();
+
+    // column j of A'A has a non-zero in row i >= j
+    // if some row r of A has non-zeros in both columns i and j
+    // collects the rows of column j into "rows", which is left unsorted
+    auto findRows = [&] ( int j, std::vector< uint8_t >& flags, std::vector< uint32_t >& rows )
+    {
+        rows.clear();
+        for( uint32_t k = m_outerIndexPointers[ j ]; k < m_outerIndexPointers[ j + 1 ]; ++k )
+        {
+            uint32_t r = m_innerIndices[ k ];
+
+            // the row mirror has sorted column indices: walk back to j
+            for( uint32_t kk = m_rowOuterIndexPointers[ r + 1 ];
+                kk > m_rowOuterIndexPointers[ r ] && m_rowInnerIndices[ kk - 1 ] >= static_cast< uint32_t >( j );
+                --kk )
+            {
+                uint32_t i = m_rowInnerIndices[ kk - 1 ];
+                if( !flags[ i ] )
+                {
+                    flags[ i ] = 1;
+                    rows.push_back( i );
+                }
+            }
+        }
+        for( uint32_t i : rows )
+        {
+            flags[ i ] = 0;
+        }
+    };
+
+    auto& pool = libcgt::core::concurrency::ThreadPool::global();
+
+    // count, then fill
+    std::vector< uint32_t > counts( n );
+    pool.parallelFor( 0, n, 0,
+        [&] ( int begin, int end )
+        {
+            std::vector< uint8_t >& flags = threadWorkspace< uint8_t >( n );
+            std::vector< uint32_t > rows;
+            for( int j = begin; j < end; ++j )
+            {
+                findRows( j, flags, rows );
+                counts[ j ] = static_cast< uint32_t >( rows.size() );
+            }
+        }
+    );
+
+    uint32_t nnz = 0;
+    for( int j = 0; j < n; ++j )
+    {
+        nnz += counts[ j ];
+    }
+    product.reset( n, n, nnz );
+    auto& pOIP = product.outerIndexPointers();
+    auto& pII = product.innerIndices();
+    pOIP[ 0 ] = 0;
+    for( int j = 0; j < n; ++j )
+    {
+        pOIP[ j + 1 ] = pOIP[ j ] + counts[ j ];
+    }
+
+    pool.parallelFor( 0, n, 0,
+        [&] ( int begin, int end )
+        {
+            std::vector< uint8_t >& flags = threadWorkspace< uint8_t >( n );
+            std::vector< uint32_t > rows;
+            for( int j = begin; j < end; ++j )
+            {
+                findRows( j, flags, rows );
+                std::sort( rows.begin(), rows.end() );
+                std::copy( rows.begin(), rows.end(), pII.begin() + pOIP[ j ] );
+            }
+        }
+    );
+
+    product.clearValues();
+}
+
+template< typename T >
+void CompressedSparseMatrix< T >::parallelMultiplyTranspose( CompressedSparseMatrix< T >& product ) const
+{
+    assert( hasRowMirror() );
+    assert( product.matrixType() == SYMMETRIC );
+    assert( product.numRows() == numCols() );
+    assert( product.numCols() == numCols() );
+
+    int n = numCols();
+    auto& pV = product.values();
+    const auto& pII = product.innerIndices();
+    const auto& pOIP = product.outerIndexPointers();
+
+    libcgt::core::concurrency::ThreadPool::global().parallelFor( 0, n, 0,
+        [&] ( int begin, int end )
+        {
+            // scatter column j of A'A = A' A[ :, j ] into work,
+            // then gather it into the structure, clearing work as we go
+            std::vector< T >& work = threadWorkspace< T >( n );
+            for( int j = begin; j < end; ++j )
+            {
+                for( uint32_t k = m_outerIndexPointers[ j ]; k < m_outerIndexPointers[ j + 1 ]; ++k )
+                {
+                    uint32_t r = m_innerIndices[ k ];
+                    T a = m_values[ k ];
+                    for( uint32_t kk = m_rowOuterIndexPointers[ r + 1 ];
+                        kk > m_rowOuterIndexPointers[ r ] && m_rowInnerIndices[ kk - 1 ] >= static_cast< uint32_t >( j );
+                        --kk )
+                    {
+                        work[ m_rowInnerIndices[ kk - 1 ] ] += a * m_rowValues[ kk - 1 ];
+                    }
+                }
+
+                for( uint32_t q = pOIP[ j ]; q < pOIP[ j + 1 ]; ++q )
+                {
+                    uint32_t i = pII[ q ];
+                    pV[ q ] = work[ i ];
+                    work[ i ] = 0;
+                }
+            }
+        }
+    );
+}
+
 // static
 template< typename T >
 void CompressedSparseMatrix< T >::multiply( const CompressedSparseMatrix< T >& a, const CompressedSparseMatrix< T >& b,
@@ -643,7 +1108,7 @@ void CompressedSparseMatrix< T >::multiply( const CompressedSparseMatrix< T >& a
         {
             work2[ kk ] = std::make_pair( cII[ k + kk ], cV[ k + kk ] );
         }
-        std::sort( work2.begin(), work2.end(), Comparators::pairFirstElementLess< int, T > );
+        std::sort( work2.begin(), work2.end(), libcgt::core::pairFirstElementLess< int, T > );
 
         for( int kk = 0; kk < n; ++kk )
         {
@@ -660,7 +1125,7 @@ void CompressedSparseMatrix< T >::multiply( const CompressedSparseMatrix< T >& a
 //////////////////////////////////////////////////////////////////////////
 
 template
-CompressedSparseMatrix< float >;
+class CompressedSparseMatrix< float >;
 
 //template
-//CompressedSparseMatrix< double >;
\ No newline at end of file
+//class CompressedSparseMatrix< double >;
\ No newline at end of file
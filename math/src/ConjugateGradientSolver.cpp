@@ -0,0 +1,655 @@
+#include "ConjugateGradientSolver.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include <concurrency/ThreadPool.h>
+
+#include "CompressedSparseMatrix.h"
+#include "FloatMatrix.h"
+
+using libcgt::core::concurrency::ThreadPool;
+
+namespace
+{
+
+// vector operations are split into blocks of this many elements
+const int BLOCK_SIZE = 4096;
+
+// marks an entry of the incomplete Cholesky factor that is not in A
+const uint32_t NOT_IN_A = std::numeric_limits< uint32_t >::max();
+
+// calls f( i ) for i in [0, n) on the global ThreadPool
+template< typename F >
+void forEach( int n, F f )
+{
+    ThreadPool::global().parallelFor( 0, n, BLOCK_SIZE,
+        [&] ( int begin, int end )
+        {
+            for( int i = begin; i < end; ++i )
+            {
+                f( i );
+            }
+        }
+    );
+}
+
+// x . y, accumulated in double per block, then summed in block order,
+// so that the result does not depend on the number of threads
+double dot( const FloatMatrix& x, const FloatMatrix& y )
+{
+    int n = x.numElements();
+    const float* px = x.data();
+    const float* py = y.data();
+
+    int nBlocks = ( n + BLOCK_SIZE - 1 ) / BLOCK_SIZE;
+    std::vector< double > partialSums( nBlocks );
+    ThreadPool::global().parallelFor( 0, nBlocks, 1,
+        [&] ( int begin, int end )
+        {
+            for( int b = begin; b < end; ++b )
+            {
+                int i1 = std::min( n, ( b + 1 ) * BLOCK_SIZE );
+                double sum = 0;
+                for( int i = b * BLOCK_SIZE; i < i1; ++i )
+                {
+                    sum += static_cast< double >( px[ i ] ) * py[ i ];
+                }
+                partialSums[ b ] = sum;
+            }
+        }
+    );
+    return std::accumulate( partialSums.begin(), partialSums.end(), 0.0 );
+}
+
+}
+
+ConjugateGradientSolver::ConjugateGradientSolver( Method method,
+    Preconditioner preconditioner ) :
+
+    m_method( method ),
+    m_preconditioner( preconditioner ),
+    m_tolerance( 1e-6f ),
+    m_maxIterations( 1000 ),
+
+    m_pA( nullptr ),
+    m_n( 0 ),
+
+    m_nIterations( 0 ),
+    m_relativeResidual( 0 )
+
+{
+
+}
+
+ConjugateGradientSolver::Method ConjugateGradientSolver::method() const
+{
+    return m_method;
+}
+
+void ConjugateGradientSolver::setMethod( Method method )
+{
+    m_method = method;
+}
+
+ConjugateGradientSolver::Preconditioner ConjugateGradientSolver::preconditioner() const
+{
+    return m_preconditioner;
+}
+
+void ConjugateGradientSolver::setPreconditioner( Preconditioner preconditioner )
+{
+    m_preconditioner = preconditioner;
+}
+
+float ConjugateGradientSolver::tolerance() const
+{
+    return m_tolerance;
+}
+
+void ConjugateGradientSolver::setTolerance( float tolerance )
+{
+    m_tolerance = tolerance;
+}
+
+int ConjugateGradientSolver::maxIterations() const
+{
+    return m_maxIterations;
+}
+
+void ConjugateGradientSolver::setMaxIterations( int maxIterations )
+{
+    m_maxIterations = maxIterations;
+}
+
+// virtual
+bool ConjugateGradientSolver::analyzePattern( CompressedSparseMatrix< float >& A )
+{
+    m_pA = nullptr;
+    if( A.numRows() != A.numCols() )
+    {
+        return false;
+    }
+
+    m_n = A.numRows();
+    A.buildRowMirror();
+
+    m_diagonalSlots.clear();
+    m_inverseDiagonal.clear();
+    m_icValues.clear();
+    m_icInnerIndices.clear();
+    m_icOuterIndexPointers.clear();
+    m_icSourceIndices.clear();
+
+    if( m_preconditioner == JACOBI )
+    {
+        m_diagonalSlots.resize( m_n );
+        m_inverseDiagonal.resize( m_n );
+        for( int i = 0; i < m_n; ++i )
+        {
+            m_diagonalSlots[ i ] = A.slot( i, i );
+        }
+    }
+    else if( m_preconditioner == INCOMPLETE_CHOLESKY )
+    {
+        // gather the lower triangle of A as ( column, row, index in A )
+        // for SYMMETRIC matrices that store the upper triangle, flip it
+        // for GENERAL matrices, the upper triangle is redundant
+        struct Entry
+        {
+            uint32_t col;
+            uint32_t row;
+            uint32_t source;
+        };
+        std::vector< Entry > entries;
+
+        const std::vector< uint32_t >& innerIndices = A.innerIndices();
+        const std::vector< uint32_t >& outerIndexPointers = A.outerIndexPointers();
+        bool symmetric = ( A.matrixType() == SYMMETRIC );
+        for( uint32_t j = 0; j < static_cast< uint32_t >( m_n ); ++j )
+        {
+            bool hasDiagonal = false;
+            for( uint32_t k = outerIndexPointers[ j ]; k < outerIndexPointers[ j + 1 ]; ++k )
+            {
+                uint32_t i = innerIndices[ k ];
+                if( i >= j )
+                {
+                    entries.push_back( { j, i, k } );
+                }
+                else if( symmetric )
+                {
+                    entries.push_back( { i, j, k } );
+                }
+                hasDiagonal = hasDiagonal || ( i == j );
+            }
+
+            // the factor always has a diagonal
+            if( !hasDiagonal )
+            {
+                entries.push_back( { j, j, NOT_IN_A } );
+            }
+        }
+
+        std::sort( entries.begin(), entries.end(),
+            [] ( const Entry& a, const Entry& b )
+            {
+                return a.col < b.col || ( a.col == b.col && a.row < b.row );
+            }
+        );
+
+        size_t nnz = entries.size();
+        m_icValues.resize( nnz );
+        m_icInnerIndices.resize( nnz );
+        m_icSourceIndices.resize( nnz );
+        m_icOuterIndexPointers.assign( m_n + 1, 0 );
+        for( size_t k = 0; k < nnz; ++k )
+        {
+            m_icInnerIndices[ k ] = entries[ k ].row;
+            m_icSourceIndices[ k ] = entries[ k ].source;
+            ++m_icOuterIndexPointers[ entries[ k ].col + 1 ];
+        }
+        std::partial_sum( m_icOuterIndexPointers.begin(), m_icOuterIndexPointers.end(),
+            m_icOuterIndexPointers.begin() );
+    }
+
+    return true;
+}
+
+// virtual
+bool ConjugateGradientSolver::factorize( CompressedSparseMatrix< float >& A )
+{
+    m_pA = nullptr;
+    if( static_cast< int >( A.numRows() ) != m_n || !A.hasRowMirror() )
+    {
+        return false;
+    }
+    A.updateRowMirrorValues();
+
+    const std::vector< float >& values = A.values();
+    if( m_preconditioner == JACOBI )
+    {
+        // CG needs a positive diagonal
+        // MINRES needs a positive definite preconditioner,
+        // so it uses the magnitude, and 1 for zeroes
+        for( int i = 0; i < m_n; ++i )
+        {
+            int k = m_diagonalSlots[ i ];
+            float d = ( k >= 0 ) ? values[ k ] : 0;
+            if( m_method == MINRES )
+            {
+                m_inverseDiagonal[ i ] = ( d != 0 ) ? 1.0f / std::abs( d ) : 1.0f;
+            }
+            else if( d > 0 )
+            {
+                m_inverseDiagonal[ i ] = 1.0f / d;
+            }
+            else
+            {
+                return false;
+            }
+        }
+    }
+    else if( m_preconditioner == INCOMPLETE_CHOLESKY )
+    {
+        // shift the diagonal by increasing multiples of its largest magnitude
+        // until the factorization succeeds
+        float scale = 0;
+        for( int j = 0; j < m_n; ++j )
+        {
+            uint32_t source = m_icSourceIndices[ m_icOuterIndexPointers[ j ] ];
+            if( source != NOT_IN_A )
+            {
+                scale = std::max( scale, std::abs( values[ source ] ) );
+            }
+        }
+        if( scale == 0 )
+        {
+            scale = 1;
+        }
+
+        const int MAX_ATTEMPTS = 24;
+        bool succeeded = false;
+        float shift = 0;
+        for( int attempt = 0; attempt < MAX_ATTEMPTS && !succeeded; ++attempt )
+        {
+            succeeded = incompleteCholesky( values, shift * scale );
+            shift = ( shift == 0 ) ? 1e-3f : 2 * shift;
+        }
+        if( !succeeded )
+        {
+            return false;
+        }
+    }
+
+    m_pA = &A;
+    return true;
+}
+
+// virtual
+bool ConjugateGradientSolver::solve( const FloatMatrix& rhs, FloatMatrix& solution )
+{
+    return solve( rhs, solution, false );
+}
+
+bool ConjugateGradientSolver::solve( const FloatMatrix& rhs, FloatMatrix& solution,
+    bool warmStart )
+{
+    m_nIterations = 0;
+    m_relativeResidual = 0;
+
+    assert( m_pA != nullptr );
+    if( m_pA == nullptr || rhs.numRows() != m_n || rhs.numCols() != 1 )
+    {
+        return false;
+    }
+
+    if( !warmStart || solution.numRows() != m_n || solution.numCols() != 1 )
+    {
+        solution.resize( m_n, 1 );
+    }
+
+    // In single precision, the residual estimated by the recurrences can
+    // drift away from the true residual. Each pass starts from the true
+    // residual of the current solution, so only a pass that converges
+    // without iterating has confirmed convergence. Otherwise, restart.
+    while( true )
+    {
+        int nIterations = m_nIterations;
+        bool converged = ( m_method == MINRES ) ?
+            solveMINRES( rhs, solution ) :
+            solveConjugateGradient( rhs, solution );
+        if( !converged || m_nIterations == nIterations )
+        {
+            return converged;
+        }
+    }
+}
+
+int ConjugateGradientSolver::numIterations() const
+{
+    return m_nIterations;
+}
+
+float ConjugateGradientSolver::relativeResidual() const
+{
+    return m_relativeResidual;
+}
+
+void ConjugateGradientSolver::applyPreconditioner( const FloatMatrix& r, FloatMatrix& z ) const
+{
+    const float* pr = r.data();
+    float* pz = z.data();
+
+    if( m_preconditioner == JACOBI )
+    {
+        const float* pd = m_inverseDiagonal.data();
+        forEach( m_n, [&] ( int i ) { pz[ i ] = pd[ i ] * pr[ i ]; } );
+    }
+    else if( m_preconditioner == INCOMPLETE_CHOLESKY )
+    {
+        // the triangular solves are sequential
+        std::copy( pr, pr + m_n, pz );
+
+        // L y = r, by columns
+        for( int j = 0; j < m_n; ++j )
+        {
+            uint32_t k0 = m_icOuterIndexPointers[ j ];
+            uint32_t k1 = m_icOuterIndexPointers[ j + 1 ];
+            float yj = pz[ j ] / m_icValues[ k0 ];
+            pz[ j ] = yj;
+            for( uint32_t k = k0 + 1; k < k1; ++k )
+            {
+                pz[ m_icInnerIndices[ k ] ] -= m_icValues[ k ] * yj;
+            }
+        }
+
+        // L' z = y: column j of L is row j of L'
+        for( int j = m_n - 1; j >= 0; --j )
+        {
+            uint32_t k0 = m_icOuterIndexPointers[ j ];
+            uint32_t k1 = m_icOuterIndexPointers[ j + 1 ];
+            float sum = pz[ j ];
+            for( uint32_t k = k0 + 1; k < k1; ++k )
+            {
+                sum -= m_icValues[ k ] * pz[ m_icInnerIndices[ k ] ];
+            }
+            pz[ j ] = sum / m_icValues[ k0 ];
+        }
+    }
+    else
+    {
+        forEach( m_n, [&] ( int i ) { pz[ i ] = pr[ i ]; } );
+    }
+}
+
+bool ConjugateGradientSolver::incompleteCholesky( const std::vector< float >& aValues,
+    float shift )
+{
+    size_t nnz = m_icValues.size();
+    for( size_t k = 0; k < nnz; ++k )
+    {
+        uint32_t source = m_icSourceIndices[ k ];
+        m_icValues[ k ] = ( source != NOT_IN_A ) ? aValues[ source ] : 0;
+    }
+
+    // right-looking IC(0): once column j is final, subtract its outer product
+    // from the later columns, keeping only entries already in the structure
+    for( int j = 0; j < m_n; ++j )
+    {
+        uint32_t k0 = m_icOuterIndexPointers[ j ];
+        uint32_t k1 = m_icOuterIndexPointers[ j + 1 ];
+
+        float d = m_icValues[ k0 ] + shift;
+        if( !( d > 0 ) )
+        {
+            return false;
+        }
+        d = sqrt( d );
+        m_icValues[ k0 ] = d;
+        for( uint32_t k = k0 + 1; k < k1; ++k )
+        {
+            m_icValues[ k ] /= d;
+        }
+
+        for( uint32_t k = k0 + 1; k < k1; ++k )
+        {
+            // L( i, c ) -= L( i, j ) * L( c, j ) for rows i >= c in both columns
+            uint32_t c = m_icInnerIndices[ k ];
+            float lcj = m_icValues[ k ];
+
+            uint32_t kj = k;
+            for( uint32_t kc = m_icOuterIndexPointers[ c ]; kc < m_icOuterIndexPointers[ c + 1 ] && kj < k1; ++kc )
+            {
+                uint32_t i = m_icInnerIndices[ kc ];
+                while( kj < k1 && m_icInnerIndices[ kj ] < i )
+                {
+                    ++kj;
+                }
+                if( kj < k1 && m_icInnerIndices[ kj ] == i )
+                {
+                    m_icValues[ kc ] -= m_icValues[ kj ] * lcj;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool ConjugateGradientSolver::solveConjugateGradient( const FloatMatrix& rhs,
+    FloatMatrix& solution )
+{
+    const CompressedSparseMatrix< float >& A = *m_pA;
+    int n = m_n;
+
+    double bNorm = sqrt( dot( rhs, rhs ) );
+    if( bNorm == 0 )
+    {
+        solution.fill( 0 );
+        return true;
+    }
+
+    FloatMatrix r( n, 1 );
+    FloatMatrix z( n, 1 );
+    FloatMatrix p( n, 1 );
+    FloatMatrix ap( n, 1 );
+
+    const float* pb = rhs.data();
+    float* px = solution.data();
+    float* pr = r.data();
+    float* pz = z.data();
+    float* pp = p.data();
+    float* pap = ap.data();
+
+    // r <-- b - A x
+    A.parallelMultiplyVector( solution, ap );
+    forEach( n, [&] ( int i ) { pr[ i ] = pb[ i ] - pap[ i ]; } );
+
+    applyPreconditioner( r, z );
+    forEach( n, [&] ( int i ) { pp[ i ] = pz[ i ]; } );
+    double rz = dot( r, z );
+    double rr = dot( r, r );
+
+    while( true )
+    {
+        m_relativeResidual = static_cast< float >( sqrt( rr ) / bNorm );
+        if( m_relativeResidual <= m_tolerance )
+        {
+            return true;
+        }
+        if( m_nIterations >= m_maxIterations )
+        {
+            return false;
+        }
+
+        A.parallelMultiplyVector( p, ap );
+        double pAp = dot( p, ap );
+        if( !( pAp > 0 ) )
+        {
+            // A is not positive definite
+            return false;
+        }
+
+        float alpha = static_cast< float >( rz / pAp );
+        forEach( n,
+            [&] ( int i )
+            {
+                px[ i ] += alpha * pp[ i ];
+                pr[ i ] -= alpha * pap[ i ];
+            }
+        );
+
+        applyPreconditioner( r, z );
+        double rzNext = dot( r, z );
+        float beta = static_cast< float >( rzNext / rz );
+        rz = rzNext;
+        forEach( n, [&] ( int i ) { pp[ i ] = pz[ i ] + beta * pp[ i ]; } );
+
+        rr = dot( r, r );
+        ++m_nIterations;
+    }
+}
+
+bool ConjugateGradientSolver::solveMINRES( const FloatMatrix& rhs,
+    FloatMatrix& solution )
+{
+    // Paige and Saunders, "Solution of Sparse Indefinite Systems of Linear
+    // Equations", 1975, with a positive definite preconditioner M.
+    // The Lanczos vectors are v = M^-1 r / beta, where r1, r2 are the last
+    // two unscaled residual-like vectors.
+    const CompressedSparseMatrix< float >& A = *m_pA;
+    int n = m_n;
+
+    FloatMatrix r1( n, 1 );
+    FloatMatrix r2( n, 1 );
+    FloatMatrix y( n, 1 );
+    FloatMatrix v( n, 1 );
+    FloatMatrix w( n, 1 );
+    FloatMatrix w1( n, 1 );
+    FloatMatrix w2( n, 1 );
+
+    // the residual is measured in the M^-1 norm, relative to b's
+    applyPreconditioner( rhs, y );
+    double bNorm = dot( rhs, y );
+    if( !( bNorm >= 0 ) )
+    {
+        return false;
+    }
+    bNorm = sqrt( bNorm );
+    if( bNorm == 0 )
+    {
+        solution.fill( 0 );
+        return true;
+    }
+
+    const float* pb = rhs.data();
+    float* px = solution.data();
+
+    // r1 <-- b - A x
+    A.parallelMultiplyVector( solution, y );
+    {
+        float* pr1 = r1.data();
+        const float* py = y.data();
+        forEach( n, [&] ( int i ) { pr1[ i ] = pb[ i ] - py[ i ]; } );
+    }
+    applyPreconditioner( r1, y );
+    double beta1 = dot( r1, y );
+    if( !( beta1 >= 0 ) )
+    {
+        return false;
+    }
+    beta1 = sqrt( beta1 );
+    r2.copy( r1 );
+
+    double oldb = 0;
+    double beta = beta1;
+    double dbar = 0;
+    double epsln = 0;
+    double phibar = beta1;
+    double cs = -1;
+    double sn = 0;
+
+    while( true )
+    {
+        m_relativeResidual = static_cast< float >( phibar / bNorm );
+        if( m_relativeResidual <= m_tolerance || beta == 0 )
+        {
+            return m_relativeResidual <= m_tolerance;
+        }
+        if( m_nIterations >= m_maxIterations )
+        {
+            return false;
+        }
+
+        float* pr1 = r1.data();
+        float* pr2 = r2.data();
+        float* py = y.data();
+        float* pv = v.data();
+
+        // Lanczos step
+        float s = static_cast< float >( 1.0 / beta );
+        forEach( n, [&] ( int i ) { pv[ i ] = s * py[ i ]; } );
+        A.parallelMultiplyVector( v, y );
+        if( oldb != 0 )
+        {
+            float c = static_cast< float >( beta / oldb );
+            forEach( n, [&] ( int i ) { py[ i ] -= c * pr1[ i ]; } );
+        }
+        double alfa = dot( v, y );
+        {
+            float c = static_cast< float >( alfa / beta );
+            forEach( n, [&] ( int i ) { py[ i ] -= c * pr2[ i ]; } );
+        }
+        std::swap( r1, r2 );
+        std::swap( r2, y );
+        applyPreconditioner( r2, y );
+        oldb = beta;
+        beta = dot( r2, y );
+        if( !( beta >= 0 ) )
+        {
+            // M is not positive definite
+            return false;
+        }
+        beta = sqrt( beta );
+
+        // apply the previous rotation, then compute and apply the next one
+        double oldeps = epsln;
+        double delta = cs * dbar + sn * alfa;
+        double gbar = sn * dbar - cs * alfa;
+        epsln = sn * beta;
+        dbar = -cs * beta;
+
+        double gamma = std::max( sqrt( gbar * gbar + beta * beta ),
+            static_cast< double >( std::numeric_limits< float >::epsilon() ) );
+        cs = gbar / gamma;
+        sn = beta / gamma;
+        double phi = cs * phibar;
+        phibar = sn * phibar;
+
+        // w <-- ( v - oldeps * w1 - delta * w2 ) / gamma, x += phi * w
+        std::swap( w1, w2 );
+        std::swap( w2, w );
+        {
+            float* pw = w.data();
+            const float* pw1 = w1.data();
+            const float* pw2 = w2.data();
+            const float* pv2 = v.data();
+            float a = static_cast< float >( oldeps );
+            float d = static_cast< float >( delta );
+            float g = static_cast< float >( 1.0 / gamma );
+            float f = static_cast< float >( phi );
+            forEach( n,
+                [&] ( int i )
+                {
+                    pw[ i ] = ( pv2[ i ] - a * pw1[ i ] - d * pw2[ i ] ) * g;
+                    px[ i ] += f * pw[ i ];
+                }
+            );
+        }
+
+        ++m_nIterations;
+    }
+}
@@ -3,7 +3,9 @@
 #include <cassert>
 #include <algorithm>
 
+#ifdef LIBCGT_USE_MKL
 #include <mkl_spblas.h>
+#endif
 
 #include "FloatMatrix.h"
 
@@ -151,101 +153,87 @@ void CoordinateSparseMatrix< T >::transposed( CoordinateSparseMatrix< T >& f ) c
 
 template< typename T >
 void CoordinateSparseMatrix< T >::compress( CompressedSparseMatrix< T >& output ) const
+{
+    std::vector< int > indexMap;
+    compress( output, indexMap );
+}
+
+template< typename T >
+void CoordinateSparseMatrix< T >::compress( CompressedSparseMatrix< T >& output, std::vector< int >& indexMap ) const
 {
     int m = numRows();
     int n = numCols();
     int nnz = numNonZeroes();
     output.reset( m, n, nnz );
 
-    // copy the SparseMatrixTriplet< T > vector
-    std::vector< SparseMatrixTriplet< T > > ijv( nnz );
-
+    // sort the indices of the entries (rather than the entries themselves)
+    // into column major order: the sorted indices are the index map
+    indexMap.resize( nnz );
     for( int k = 0; k < nnz; ++k )
     {
-        SparseMatrixTriplet< T >& t = ijv[ k ];
+        indexMap[ k ] = k;
+    }
+    std::sort( indexMap.begin(), indexMap.end(),
+        [&] ( int a, int b )
+        {
+            return ( m_colIndices[ a ] < m_colIndices[ b ] ) ||
+                ( m_colIndices[ a ] == m_colIndices[ b ] && m_rowIndices[ a ] < m_rowIndices[ b ] );
+        }
+    );
+
+    std::vector< SparseMatrixTriplet< T > > ijv( nnz );
+    for( int l = 0; l < nnz; ++l )
+    {
+        int k = indexMap[ l ];
+        SparseMatrixTriplet< T >& t = ijv[ l ];
         t.i = m_rowIndices[ k ];
         t.j = m_colIndices[ k ];
         t.value = m_values[ k ];
     }
 
-    std::sort( ijv.begin(), ijv.end(), colMajorLess );
-
     compressCore( ijv, output );
-
-    // populate structure map
-    auto& structureMap = output.structureMap();
-    for( int k = 0; k < nnz; ++k )
-    {
-        const SparseMatrixTriplet< T >& t = ijv[k];
-        structureMap[ std::make_pair( t.i, t.j ) ] = k;
-    }
 }
 
 template< typename T >
-void CoordinateSparseMatrix< T >::compress( CompressedSparseMatrix< T >& output, std::vector< int >& indexMap ) const
+void CoordinateSparseMatrix< T >::compressTranspose( CompressedSparseMatrix< T >& outputAt ) const
 {
-    compress( output );
-
-    const auto& structureMap = output.structureMap();
-
-    int nnz = numNonZeroes();
-    indexMap.resize( nnz );
-    for( int k = 0; k < nnz; ++k )
-    {
-        auto ij = std::make_pair( m_rowIndices[k], m_colIndices[k] );
-        int l = structureMap.find( ij )->second;
-        indexMap[ l ] = k;
-    }
+    std::vector< int > indexMap;
+    compressTranspose( outputAt, indexMap );
 }
 
 template< typename T >
-void CoordinateSparseMatrix< T >::compressTranspose( CompressedSparseMatrix< T >& outputAt ) const
+void CoordinateSparseMatrix< T >::compressTranspose( CompressedSparseMatrix< T >& outputAt, std::vector< int >& indexMap ) const
 {
     int m = numRows();
     int n = numCols();
     int nnz = numNonZeroes();
     outputAt.reset( n, m, nnz );
 
-    // copy the SparseMatrixTriplet< T > vector
-    std::vector< SparseMatrixTriplet< T > > ijv( nnz );
-
-    // flip i and j
+    // same as compress(), with i and j flipped: sort into row major order
+    indexMap.resize( nnz );
     for( int k = 0; k < nnz; ++k )
     {
-        SparseMatrixTriplet< T >& t = ijv[ k ];
+        indexMap[ k ] = k;
+    }
+    std::sort( indexMap.begin(), indexMap.end(),
+        [&] ( int a, int b )
+        {
+            return ( m_rowIndices[ a ] < m_rowIndices[ b ] ) ||
+                ( m_rowIndices[ a ] == m_rowIndices[ b ] && m_colIndices[ a ] < m_colIndices[ b ] );
+        }
+    );
+
+    std::vector< SparseMatrixTriplet< T > > ijv( nnz );
+    for( int l = 0; l < nnz; ++l )
+    {
+        int k = indexMap[ l ];
+        SparseMatrixTriplet< T >& t = ijv[ l ];
         t.i = m_colIndices[ k ];
         t.j = m_rowIndices[ k ];
         t.value = m_values[ k ];
     }
 
-    std::sort( ijv.begin(), ijv.end(), colMajorLess );
-
     compressCore( ijv, outputAt );
-
-    // populate structure map
-    auto& structureMap = outputAt.structureMap();
-    for( int k = 0; k < nnz; ++k )
-    {
-        const SparseMatrixTriplet< T >& t = ijv[k];
-        structureMap[ std::make_pair( t.i, t.j ) ] = k;
-    }
-}
-
-template< typename T >
-void CoordinateSparseMatrix< T >::compressTranspose( CompressedSparseMatrix< T >& outputAt, std::vector< int >& indexMap ) const
-{
-    compressTranspose( outputAt );
-
-    const auto& structureMap = outputAt.structureMap();
-
-    int nnz = numNonZeroes();
-    indexMap.resize( nnz );
-    for( int k = 0; k < nnz; ++k )
-    {
-        auto ji = std::make_pair( m_colIndices[k], m_rowIndices[k] );
-        int l = structureMap.find( ji )->second;
-        indexMap[ l ] = k;
-    }
 }
 
 template<>
@@ -260,9 +248,11 @@ void CoordinateSparseMatrix< float >::multiplyVector( FloatMatrix& x, FloatMatri
     y.resize( m, 1 );
 
     // TODO: implement doubles version
-    char transa = 'n';
     int nnz = numNonZeroes();
 
+#ifdef LIBCGT_USE_MKL
+    char transa = 'n';
+
     mkl_cspblas_scoogemv
     (
         &transa,
@@ -274,6 +264,12 @@ void CoordinateSparseMatrix< float >::multiplyVector( FloatMatrix& x, FloatMatri
         x.data(),
         y.data()
     );
+#else
+    for( int k = 0; k < nnz; ++k )
+    {
+        y[ m_rowIndices[ k ] ] += m_values[ k ] * x[ m_colIndices[ k ] ];
+    }
+#endif
 }
 
 template<>
@@ -288,9 +284,11 @@ void CoordinateSparseMatrix< float >::multiplyTransposeVector( FloatMatrix& x, F
     y.resize( n, 1 );
 
     // TODO: implement doubles version
-    char transa = 't';
     int nnz = numNonZeroes();
 
+#ifdef LIBCGT_USE_MKL
+    char transa = 't';
+
     mkl_cspblas_scoogemv
     (
         &transa,
@@ -302,6 +300,12 @@ void CoordinateSparseMatrix< float >::multiplyTransposeVector( FloatMatrix& x, F
         x.data(),
         y.data()
     );
+#else
+    for( int k = 0; k < nnz; ++k )
+    {
+        y[ m_colIndices[ k ] ] += m_values[ k ] * x[ m_rowIndices[ k ] ];
+    }
+#endif
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -309,7 +313,7 @@ void CoordinateSparseMatrix< float >::multiplyTransposeVector( FloatMatrix& x, F
 //////////////////////////////////////////////////////////////////////////
 
 template< typename T >
-void CoordinateSparseMatrix< T >::compressCore( std::vector< SparseMatrixTriplet< T > > ijvSorted, CompressedSparseMatrix< T >& output ) const
+void CoordinateSparseMatrix< T >::compressCore( const std::vector< SparseMatrixTriplet< T > >& ijvSorted, CompressedSparseMatrix< T >& output ) const
 {
     // TODO: if we want the output to be only symmetric or triangular
     //if( ( !upperTriangleOnly ) ||
@@ -333,15 +337,21 @@ void CoordinateSparseMatrix< T >::compressCore( std::vector< SparseMatrixTriplet
         values[ innerIndex ] = value;
         innerIndices[ innerIndex ] = i;
 
-        if( j == outerIndexPointerIndex )
+        // start column j, and any empty columns before it
+        while( outerIndexPointerIndex <= j )
         {
             outerIndexPointers[ outerIndexPointerIndex ] = innerIndex;
             ++outerIndexPointerIndex;
         }
         ++innerIndex;
     }
-    outerIndexPointers[ outerIndexPointerIndex ] = innerIndex;
-    ++outerIndexPointerIndex;
+
+    // close the last column, and any empty columns after it
+    while( outerIndexPointerIndex < static_cast< int >( outerIndexPointers.size() ) )
+    {
+        outerIndexPointers[ outerIndexPointerIndex ] = innerIndex;
+        ++outerIndexPointerIndex;
+    }
 }
 
 // static
@@ -381,9 +391,9 @@ bool CoordinateSparseMatrix< T >::colMajorLess( SparseMatrixTriplet< T >& a, Spa
 }
 
 template<>
-bool CoordinateSparseMatrix< float >::loadTXT( QString filename )
+bool CoordinateSparseMatrix< float >::loadTXT( const std::string& filename )
 {
-    FILE* fp = fopen( qPrintable( filename ), "r" );
+    FILE* fp = fopen( filename.c_str(), "r" );
     bool succeeded = ( fp != NULL );
 
     if( succeeded )
@@ -428,9 +438,9 @@ bool CoordinateSparseMatrix< float >::loadTXT( QString filename )
 }
 
 template<>
-bool CoordinateSparseMatrix< double >::loadTXT( QString filename )
+bool CoordinateSparseMatrix< double >::loadTXT( const std::string& filename )
 {
-    FILE* fp = fopen( qPrintable( filename ), "r" );
+    FILE* fp = fopen( filename.c_str(), "r" );
     bool succeeded = ( fp != NULL );
 
     if( succeeded )
@@ -475,9 +485,9 @@ bool CoordinateSparseMatrix< double >::loadTXT( QString filename )
 }
 
 template<>
-bool CoordinateSparseMatrix< float >::saveTXT( QString filename )
+bool CoordinateSparseMatrix< float >::saveTXT( const std::string& filename )
 {
-    FILE* fp = fopen( qPrintable( filename ), "w" );
+    FILE* fp = fopen( filename.c_str(), "w" );
     bool succeeded = ( fp != NULL );
 
     if( succeeded )
@@ -496,9 +506,9 @@ bool CoordinateSparseMatrix< float >::saveTXT( QString filename )
 }
 
 template<>
-bool CoordinateSparseMatrix< double >::saveTXT( QString filename )
+bool CoordinateSparseMatrix< double >::saveTXT( const std::string& filename )
 {
-    FILE* fp = fopen( qPrintable( filename ), "w" );
+    FILE* fp = fopen( filename.c_str(), "w" );
     bool succeeded = ( fp != NULL );
 
     if( succeeded )
@@ -521,7 +531,7 @@ bool CoordinateSparseMatrix< double >::saveTXT( QString filename )
 //////////////////////////////////////////////////////////////////////////
 
 template
-CoordinateSparseMatrix< float >;
+class CoordinateSparseMatrix< float >;
 
 //template
-//CoordinateSparseMatrix< double >;
+//class CoordinateSparseMatrix< double >;
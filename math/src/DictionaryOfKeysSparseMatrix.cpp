@@ -77,7 +77,6 @@ void DictionaryOfKeysSparseMatrix< T >::compress( CompressedSparseMatrix< T >& o
     auto& values = output.values();
     auto& innerIndices = output.innerIndices();
     auto& outerIndexPointers = output.outerIndexPointers();
-    auto& structureMap = output.structureMap();
 
     for( auto itr = m_values.begin(); itr != m_values.end(); ++itr )
     {
@@ -93,8 +92,6 @@ void DictionaryOfKeysSparseMatrix< T >::compress( CompressedSparseMatrix< T >& o
             values[ columnsIndex ] = value;
             innerIndices[ columnsIndex ] = j + offset;
 
-            structureMap[ ij ] = columnsIndex;
-
             if( i == rowIndexIndex )
             {
                 outerIndexPointers[ rowIndexIndex ] = columnsIndex;
@@ -109,7 +106,7 @@ void DictionaryOfKeysSparseMatrix< T >::compress( CompressedSparseMatrix< T >& o
 }
 
 template< typename T >
-QString DictionaryOfKeysSparseMatrix< T >::toString() const
+std::string DictionaryOfKeysSparseMatrix< T >::toString() const
 {
     // TODO: implement me
     return "";
@@ -120,7 +117,7 @@ QString DictionaryOfKeysSparseMatrix< T >::toString() const
 //////////////////////////////////////////////////////////////////////////
 
 template
-DictionaryOfKeysSparseMatrix< float >;
+class DictionaryOfKeysSparseMatrix< float >;
 
 //template
-//DictionaryOfKeysSparseMatrix< double >;
\ No newline at end of file
+//class DictionaryOfKeysSparseMatrix< double >;
\ No newline at end of file
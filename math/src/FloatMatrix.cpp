@@ -1,17 +1,259 @@
 #include "FloatMatrix.h"
 
 #include <cassert>
+#include <cmath>
 #include <cstdarg>
+#include <cstdio>
 #include <algorithm>
 
+#ifdef LIBCGT_USE_MKL
 #include <mkl.h>
 #include <mkl_blas.h>
-
-#include <QString>
+#endif
 
 #include <math/MathUtils.h>
 
+#ifdef LIBCGT_USE_MKL
 #include "LUFactorization.h"
+#endif
+
+using libcgt::core::math::clampToRangeExclusive;
+
+#ifndef LIBCGT_USE_MKL
+namespace
+{
+
+// portable replacements for the LAPACK routines used below
+// they return an info code like their LAPACK counterparts:
+// 0 on success, i + 1 if it failed at row / column i
+
+// gaussian elimination with partial pivoting (?gesv)
+// a (square) is overwritten with U, b with the solution
+int gaussianEliminationSolve( FloatMatrix& a, FloatMatrix& b )
+{
+    int n = a.numRows();
+    int nRHS = b.numCols();
+
+    for( int k = 0; k < n; ++k )
+    {
+        int pivot = k;
+        for( int i = k + 1; i < n; ++i )
+        {
+            if( std::abs( a( i, k ) ) > std::abs( a( pivot, k ) ) )
+            {
+                pivot = i;
+            }
+        }
+
+        if( a( pivot, k ) == 0 )
+        {
+            return k + 1;
+        }
+
+        if( pivot != k )
+        {
+            for( int j = k; j < n; ++j )
+            {
+                std::swap( a( k, j ), a( pivot, j ) );
+            }
+            for( int r = 0; r < nRHS; ++r )
+            {
+                std::swap( b( k, r ), b( pivot, r ) );
+            }
+        }
+
+        for( int i = k + 1; i < n; ++i )
+        {
+            float f = a( i, k ) / a( k, k );
+            for( int j = k + 1; j < n; ++j )
+            {
+                a( i, j ) -= f * a( k, j );
+            }
+            for( int r = 0; r < nRHS; ++r )
+            {
+                b( i, r ) -= f * b( k, r );
+            }
+        }
+    }
+
+    for( int r = 0; r < nRHS; ++r )
+    {
+        for( int i = n - 1; i >= 0; --i )
+        {
+            float sum = b( i, r );
+            for( int j = i + 1; j < n; ++j )
+            {
+                sum -= a( i, j ) * b( j, r );
+            }
+            b( i, r ) = sum / a( i, i );
+        }
+    }
+
+    return 0;
+}
+
+// cholesky factorization and solve (?posv)
+// only the stored triangle of a is read
+// b is overwritten with the solution
+int choleskySolve( const FloatMatrix& a, MatrixTriangle storedTriangle, FloatMatrix& b )
+{
+    int n = a.numRows();
+    int nRHS = b.numCols();
+
+    auto at = [&] ( int i, int j )
+    {
+        // i >= j
+        return ( storedTriangle == LOWER ) ? a( i, j ) : a( j, i );
+    };
+
+    // a = l l^T
+    FloatMatrix l( n, n );
+    for( int j = 0; j < n; ++j )
+    {
+        float d = at( j, j );
+        for( int k = 0; k < j; ++k )
+        {
+            d -= l( j, k ) * l( j, k );
+        }
+
+        if( !( d > 0 ) )
+        {
+            return j + 1;
+        }
+        l( j, j ) = std::sqrt( d );
+
+        for( int i = j + 1; i < n; ++i )
+        {
+            float sum = at( i, j );
+            for( int k = 0; k < j; ++k )
+            {
+                sum -= l( i, k ) * l( j, k );
+            }
+            l( i, j ) = sum / l( j, j );
+        }
+    }
+
+    for( int r = 0; r < nRHS; ++r )
+    {
+        // l y = b
+        for( int i = 0; i < n; ++i )
+        {
+            float sum = b( i, r );
+            for( int k = 0; k < i; ++k )
+            {
+                sum -= l( i, k ) * b( k, r );
+            }
+            b( i, r ) = sum / l( i, i );
+        }
+
+        // l^T x = y
+        for( int i = n - 1; i >= 0; --i )
+        {
+            float sum = b( i, r );
+            for( int k = i + 1; k < n; ++k )
+            {
+                sum -= l( k, i ) * b( k, r );
+            }
+            b( i, r ) = sum / l( i, i );
+        }
+    }
+
+    return 0;
+}
+
+// cyclic jacobi eigenvalue algorithm (?syev, eigenvalues only)
+// only the stored triangle of a is read
+// eigenvalues are returned in ascending order, like ?syev
+int jacobiEigenvaluesSymmetric( const FloatMatrix& a, MatrixTriangle storedTriangle, FloatMatrix& eigenvalues )
+{
+    const int MAX_SWEEPS = 50;
+
+    int n = a.numRows();
+
+    FloatMatrix s( n, n );
+    for( int j = 0; j < n; ++j )
+    {
+        for( int i = j; i < n; ++i )
+        {
+            float v = ( storedTriangle == LOWER ) ? a( i, j ) : a( j, i );
+            s( i, j ) = v;
+            s( j, i ) = v;
+        }
+    }
+
+    bool converged = false;
+    for( int sweep = 0; sweep < MAX_SWEEPS && !converged; ++sweep )
+    {
+        double off = 0;
+        double total = 0;
+        for( int j = 0; j < n; ++j )
+        {
+            for( int i = 0; i < n; ++i )
+            {
+                double v2 = static_cast< double >( s( i, j ) ) * s( i, j );
+                total += v2;
+                if( i != j )
+                {
+                    off += v2;
+                }
+            }
+        }
+
+        converged = ( off <= 1e-14 * total );
+        if( converged )
+        {
+            break;
+        }
+
+        for( int p = 0; p < n - 1; ++p )
+        {
+            for( int q = p + 1; q < n; ++q )
+            {
+                float apq = s( p, q );
+                if( apq == 0 )
+                {
+                    continue;
+                }
+
+                // rotate by the angle that zeroes s( p, q )
+                float theta = ( s( q, q ) - s( p, p ) ) / ( 2 * apq );
+                float t = 1.0f / ( std::abs( theta ) + std::sqrt( theta * theta + 1 ) );
+                if( theta < 0 )
+                {
+                    t = -t;
+                }
+                float c = 1.0f / std::sqrt( t * t + 1 );
+                float sn = t * c;
+
+                for( int k = 0; k < n; ++k )
+                {
+                    float skp = s( k, p );
+                    float skq = s( k, q );
+                    s( k, p ) = c * skp - sn * skq;
+                    s( k, q ) = sn * skp + c * skq;
+                }
+                for( int k = 0; k < n; ++k )
+                {
+                    float spk = s( p, k );
+                    float sqk = s( q, k );
+                    s( p, k ) = c * spk - sn * sqk;
+                    s( q, k ) = sn * spk + c * sqk;
+                }
+            }
+        }
+    }
+
+    for( int i = 0; i < n; ++i )
+    {
+        eigenvalues[ i ] = s( i, i );
+    }
+    std::sort( eigenvalues.data(), eigenvalues.data() + n );
+
+    return converged ? 0 : 1;
+}
+
+}
+#endif
 
 //////////////////////////////////////////////////////////////////////////
 // Public
@@ -149,7 +391,7 @@ void FloatMatrix::resize( int nRows, int nCols )
 
     m_nRows = nRows;
     m_nCols = nCols;
-    m_data.resize( nRows * nCols, 0 );
+    m_data.assign( nRows * nCols, 0 );
 }
 
 bool FloatMatrix::reshape( int nRows, int nCols )
@@ -211,7 +453,7 @@ FloatMatrix FloatMatrix::extractTriangle( MatrixTriangle triangle, int k ) const
     {
         for( int i = 0; i < numRows(); ++i )
         {
-            int j1 = MathUtils::clampToRangeInclusive( i + k + 1, 0, numCols() );
+            int j1 = clampToRangeExclusive( i + k + 1, 0, numCols() + 1 );
             for( int j = 0; j < j1; ++j )
             {
                 output( i, j ) = ( *this )( i, j );
@@ -222,7 +464,7 @@ FloatMatrix FloatMatrix::extractTriangle( MatrixTriangle triangle, int k ) const
     {
         for( int j = 0; j < numCols(); ++j )
         {
-            int i1 = MathUtils::clampToRangeInclusive( j - k + 1, 0, numRows() );
+            int i1 = clampToRangeExclusive( j - k + 1, 0, numRows() + 1 );
             for( int i = 0; i < i1; ++i )
             {
                 output( i, j ) = ( *this )( i, j );
@@ -241,7 +483,7 @@ void FloatMatrix::copyTriangle( const FloatMatrix& src, MatrixTriangle srcTriang
         {
             for( int i = 0; i < numRows(); ++i )
             {
-                int j1 = MathUtils::clampToRangeInclusive( i + k + 1, 0, numCols() );
+                int j1 = clampToRangeExclusive( i + k + 1, 0, numCols() + 1 );
                 for( int j = 0; j < j1; ++j )
                 {
                     ( *this )( i, j ) = src( i, j );
@@ -252,7 +494,7 @@ void FloatMatrix::copyTriangle( const FloatMatrix& src, MatrixTriangle srcTriang
         {
             for( int i = 0; i < numRows(); ++i )
             {
-                int j1 = MathUtils::clampToRangeInclusive( i + k + 1, 0, numCols() );
+                int j1 = clampToRangeExclusive( i + k + 1, 0, numCols() + 1 );
                 for( int j = 0; j < j1; ++j )
                 {
                     ( *this )( j, i ) = src( i, j );
@@ -266,7 +508,7 @@ void FloatMatrix::copyTriangle( const FloatMatrix& src, MatrixTriangle srcTriang
         {
             for( int j = 0; j < numCols(); ++j )
             {
-                int i1 = MathUtils::clampToRangeInclusive( j - k + 1, 0, numRows() );
+                int i1 = clampToRangeExclusive( j - k + 1, 0, numRows() + 1 );
                 for( int i = 0; i < i1; ++i )
                 {
                     ( *this )( i, j ) = src( i, j );
@@ -277,7 +519,7 @@ void FloatMatrix::copyTriangle( const FloatMatrix& src, MatrixTriangle srcTriang
         {
             for( int j = 0; j < numCols(); ++j )
             {
-                int i1 = MathUtils::clampToRangeInclusive( j - k + 1, 0, numRows() );
+                int i1 = clampToRangeExclusive( j - k + 1, 0, numRows() + 1 );
                 for( int i = 0; i < i1; ++i )
                 {
                     ( *this )( j, i ) = src( i, j );
@@ -362,10 +604,14 @@ FloatMatrix FloatMatrix::solve( const FloatMatrix& rhs, bool& succeeded ) const
     FloatMatrix A( *this );
     FloatMatrix B( rhs );
 
+#ifdef LIBCGT_USE_MKL
     std::vector< int > ipiv( n );
     int info;
 
     sgesv( &n, &nRHS, A.data(), &m, ipiv.data(), B.data(), &n, &info );
+#else
+    int info = gaussianEliminationSolve( A, B );
+#endif
 
     succeeded = ( info == 0 );
 
@@ -413,10 +659,14 @@ FloatMatrix FloatMatrix::solveSPD( const FloatMatrix& rhs, bool& succeeded, Matr
     FloatMatrix A( *this );
     FloatMatrix B( rhs );
 
+#ifdef LIBCGT_USE_MKL
     char uplo = ( storedTriangle == LOWER ) ? 'L' : 'U';
     int info;
 
     sposv( &uplo, &n, &nRHS, A.data(), &m, B.data(), &m, &info );
+#else
+    int info = choleskySolve( A, storedTriangle, B );
+#endif
 
     succeeded = ( info == 0 );
 
@@ -520,9 +770,11 @@ bool FloatMatrix::eigenvaluesSymmetric( FloatMatrix& eigenvalues, MatrixTriangle
         return false;
     }
 
+    eigenvalues.resize( n, 1 );
+
+#ifdef LIBCGT_USE_MKL
     // make a copy of this
     FloatMatrix A( *this );
-    eigenvalues.resize( n, 1 );
 
     char jobz = 'N'; // eigenvalues only
     char uplo = ( storedTriangle == LOWER ) ? 'L' : 'U';
@@ -538,6 +790,9 @@ bool FloatMatrix::eigenvaluesSymmetric( FloatMatrix& eigenvalues, MatrixTriangle
     std::vector< float > work( lWork );
 
     ssyev( &jobz, &uplo, &n, A.data(), &m, eigenvalues.data(), &workQuery, &lWork, &info );
+#else
+    int info = jacobiEigenvaluesSymmetric( *this, storedTriangle, eigenvalues );
+#endif
 
     if( info < 0 )
     {
@@ -555,8 +810,7 @@ bool FloatMatrix::eigenvaluesSymmetric( FloatMatrix& eigenvalues, MatrixTriangle
 FloatMatrix FloatMatrix::inverted( bool* pSucceeded ) const
 {
     FloatMatrix inv;
-    LUFactorization lu( *this );
-    bool succeeded = lu.inverse( inv );
+    bool succeeded = inverted( inv );
 
     if( pSucceeded != nullptr )
     {
@@ -568,8 +822,23 @@ FloatMatrix FloatMatrix::inverted( bool* pSucceeded ) const
 
 bool FloatMatrix::inverted( FloatMatrix& inv ) const
 {
+#ifdef LIBCGT_USE_MKL
     LUFactorization lu( *this );
     return lu.inverse( inv );
+#else
+    int n = numRows();
+    assert( numCols() == n );
+
+    FloatMatrix identity( n, n );
+    for( int i = 0; i < n; ++i )
+    {
+        identity( i, i ) = 1;
+    }
+
+    bool succeeded;
+    inv = solve( identity, succeeded );
+    return succeeded;
+#endif
 }
 
 void FloatMatrix::transposed( FloatMatrix& t ) const
@@ -603,27 +872,23 @@ float FloatMatrix::frobeniusNorm() const
 float FloatMatrix::frobeniusNormSquared() const
 {
     int m = numElements();
+#ifdef LIBCGT_USE_MKL
     int inc = 1;
     return sdot( &m, data(), &inc, data(), &inc );
+#else
+    float sum = 0;
+    for( int k = 0; k < m; ++k )
+    {
+        sum += m_data[ k ] * m_data[ k ];
+    }
+    return sum;
+#endif
 }
 
 // returns the maximum row sum
 float FloatMatrix::infinityNorm() const
 {
-    char whichNorm = 'i';
-    int m = numRows();
-    int n = numCols();
-
-    std::vector< float > work( m );
-
-    return slange
-    (
-        &whichNorm,
-        &m, &n,
-        data(),
-        &m,
-        work.data()
-    );
+    return norm( 'i' );
 }
 
 // returns the maximum column sum
@@ -658,8 +923,17 @@ float FloatMatrix::dot( const FloatMatrix& a, const FloatMatrix& b )
     assert( a.numElements() == b.numElements() );
 
     int m = a.numElements();
+#ifdef LIBCGT_USE_MKL
     int inc = 1;
     return sdot( &m, a.data(), &inc, b.data(), &inc );
+#else
+    float sum = 0;
+    for( int k = 0; k < m; ++k )
+    {
+        sum += a[ k ] * b[ k ];
+    }
+    return sum;
+#endif
 }
 
 // static
@@ -711,9 +985,17 @@ void FloatMatrix::scaledAdd( float alpha, const FloatMatrix& x, FloatMatrix& y )
 {
     int n = x.numElements();
     assert( n == y.numElements() );
+
+#ifdef LIBCGT_USE_MKL
     int inc = 1;
 
     saxpy( &n, &alpha, x.data(), &inc, y.data(), &inc );
+#else
+    for( int k = 0; k < n; ++k )
+    {
+        y[ k ] += alpha * x[ k ];
+    }
+#endif
 }
 
 // static
@@ -727,6 +1009,7 @@ void FloatMatrix::scaledMultiplyAdd( float alpha, const FloatMatrix& a, const Fl
 
     c.resize( m, p );
 
+#ifdef LIBCGT_USE_MKL
     char transa = 'n';
     char transb = 'n';
 
@@ -740,6 +1023,25 @@ void FloatMatrix::scaledMultiplyAdd( float alpha, const FloatMatrix& a, const Fl
         &beta,
         c.data(), &m
     );
+#else
+    // column by column, so that all three matrices are walked in storage order
+    for( int j = 0; j < p; ++j )
+    {
+        for( int i = 0; i < m; ++i )
+        {
+            c( i, j ) = ( beta == 0 ) ? 0 : beta * c( i, j );
+        }
+
+        for( int k = 0; k < n; ++k )
+        {
+            float bkj = alpha * b( k, j );
+            for( int i = 0; i < m; ++i )
+            {
+                c( i, j ) += a( i, k ) * bkj;
+            }
+        }
+    }
+#endif
 }
 
 #if 0
@@ -843,9 +1145,9 @@ float FloatMatrix::maximum() const
     return *( std::max_element( m_data.begin(), m_data.end() ) );
 }
 
-bool FloatMatrix::loadTXT( QString filename )
+bool FloatMatrix::loadTXT( const std::string& filename )
 {
-    FILE* fp = fopen( qPrintable( filename ), "r" );
+    FILE* fp = fopen( filename.c_str(), "r" );
     bool succeeded = ( fp != NULL );
 
     if( succeeded )
@@ -873,9 +1175,9 @@ bool FloatMatrix::loadTXT( QString filename )
     return succeeded;
 }
 
-bool FloatMatrix::saveTXT( QString filename )
+bool FloatMatrix::saveTXT( const std::string& filename )
 {
-    FILE* fp = fopen( qPrintable( filename ), "w" );
+    FILE* fp = fopen( filename.c_str(), "w" );
     bool succeeded = ( fp != NULL );
 
     if( succeeded )
@@ -918,19 +1220,21 @@ void FloatMatrix::print( const char* prefix, const char* suffix ) const
     }
 }
 
-QString FloatMatrix::toString()
+std::string FloatMatrix::toString()
 {
     int M = numRows();
     int N = numCols();
 
-    QString out;
+    std::string out;
+    char buffer[ 32 ];
 
     for( int i = 0; i < M; ++i )
     {
         for( int j = 0; j < N; ++j )
         {
             float val = ( *this )( i, j );
-            out.append( QString( "%1" ).arg( val, 10, 'g', 4 ) );
+            snprintf( buffer, sizeof( buffer ), "%10.4g", val );
+            out.append( buffer );
         }
         out.append( "\n" );
     }
@@ -946,14 +1250,60 @@ float FloatMatrix::norm( char whichNorm ) const
     int m = numRows();
     int n = numCols();
 
+#ifdef LIBCGT_USE_MKL
+    // ?lange only uses the work array for the infinity norm
+    std::vector< float > work( whichNorm == 'i' ? m : 0 );
+
     return slange
     (
         &whichNorm,
         &m, &n,
         data(),
         &m,
-        nullptr
+        work.data()
     );
+#else
+    float result = 0;
+    if( whichNorm == 'm' )
+    {
+        for( int k = 0; k < numElements(); ++k )
+        {
+            result = std::max( result, std::abs( m_data[ k ] ) );
+        }
+    }
+    else if( whichNorm == 'o' )
+    {
+        for( int j = 0; j < n; ++j )
+        {
+            float sum = 0;
+            for( int i = 0; i < m; ++i )
+            {
+                sum += std::abs( ( *this )( i, j ) );
+            }
+            result = std::max( result, sum );
+        }
+    }
+    else if( whichNorm == 'i' )
+    {
+        std::vector< float > rowSums( m, 0.0f );
+        for( int j = 0; j < n; ++j )
+        {
+            for( int i = 0; i < m; ++i )
+            {
+                rowSums[ i ] += std::abs( ( *this )( i, j ) );
+            }
+        }
+        for( int i = 0; i < m; ++i )
+        {
+            result = std::max( result, rowSums[ i ] );
+        }
+    }
+    else if( whichNorm == 'f' )
+    {
+        result = std::sqrt( frobeniusNormSquared() );
+    }
+    return result;
+#endif
 }
 
 FloatMatrix operator + ( const FloatMatrix& a, const FloatMatrix& b )
@@ -1,8 +1,8 @@
 #include "GaussNewton.h"
 
+#include <cassert>
 #include <cmath>
 #include <limits>
-#include <QtGlobal>
 
 #include "LinearLeastSquaresSolvers.h"
 
@@ -24,7 +24,8 @@ GaussNewton::GaussNewton( std::shared_ptr< Energy > pEnergy,
     m_delta.resize( n, 1 );
     m_r.resize( m, 1 );
 
-    Q_ASSERT_X( m >= n, "Gauss Newton", "Number of functions (m) must be greater than the number of parameters (n)." );
+    // the number of functions (m) must be at least the number of parameters (n)
+    assert( m >= n );
 }
 
 int GaussNewton::maxNumIterations() const
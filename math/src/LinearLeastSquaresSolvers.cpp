@@ -1,6 +1,5 @@
 #include "LinearLeastSquaresSolvers.h"
 
-#include <QtGlobal>
 #include <mkl.h>
 
 FloatMatrix LinearLeastSquaresSolvers::QRFullRank( const FloatMatrix& a, const FloatMatrix& b, bool* succeeded )
@@ -71,7 +71,7 @@ bool PointLineICP::align( const std::vector< Vector2f >& srcPoints,
             float ty = x[2];
 
             Matrix3f incremental =
-                Matrix3f::translation( tx, ty ) * Matrix3f::rotateZ( theta );
+                Matrix3f::translation( { tx, ty } ) * Matrix3f::rotateZ( theta );
 
             energy = updateSourcePointsAndEvaluateEnergy( incremental,
                 dstPoints, dstNormals,
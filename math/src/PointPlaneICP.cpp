@@ -95,7 +95,7 @@ bool PointPlaneICP::align( const std::vector< Vector3f >& srcPoints,
             float tz = x[5];
 
             Matrix4f incremental =
-                Matrix4f::translation( tx, ty, tz ) *
+                Matrix4f::translation( { tx, ty, tz } ) *
                 Matrix4f::rotateZ( gamma ) *
                 Matrix4f::rotateY( beta ) *
                 Matrix4f::rotateX( alpha );
@@ -1,185 +1,97 @@
-#if 0
 #include "SparseGaussNewton.h"
 
+#include <algorithm>
+#include <cassert>
 #include <cmath>
-#include <limits>
-#include <QtGlobal>
 
-#include <SuiteSparseQR.hpp>
+#include "ConjugateGradientSolver.h"
 
-void copyFloatMatrixToCholmodDense( const FloatMatrix& src, cholmod_dense* dst )
+namespace
 {
-    double* dstArray = reinterpret_cast< double* >( dst->x );
-    for( int k = 0; k < src.numElements(); ++k )
-    {
-        dstArray[k] = src[k];
-    }
-}
-
-void copyCholmodDenseToFloatMatrix( cholmod_dense* src, FloatMatrix& dst )
-{
-    double* srcArray = reinterpret_cast< double* >( src->x );
-    for( int k = 0; k < dst.numElements(); ++k )
-    {
-        dst[k] = srcArray[k];
-    }
-}
-
-void copyDoubleArrayToFloatMatrix( double* srcArray, FloatMatrix& dst )
-{
-    for( int k = 0; k < dst.numElements(); ++k )
-    {
-        dst[k] = srcArray[k];
-    }
-}
 
-void saveVector( const FloatMatrix& x, QString filename )
-{
-    FILE* fp = fopen( qPrintable( filename ), "w" );
-    for( int i = 0; i < x.numElements(); ++i )
-    {
-        fprintf( fp, "%f\n", x[i] );
-    }
-    fclose( fp );
-}
+// Levenberg-Marquardt damping is divided or multiplied by this factor after
+// each accepted or rejected step
+const float DAMPING_FACTOR = 10.0f;
 
-#define TIMING 0
-#define FACTORIZE 0 // spqr only
-#define SPLIT_FACTORIZATION 0 // spqr only
+// bounds on the damping once it's non-zero:
+// it never underflows to 0 (which would disable rejection),
+// and minimize() gives up once no step of any size decreases the energy
+const float MIN_DAMPING = 1e-10f;
+const float MAX_DAMPING = 1e10f;
 
-#if TIMING
-#include <time/StopWatch.h>
-#endif
+// relative residual for the default linear solver
+const float DEFAULT_SOLVER_TOLERANCE = 1e-4f;
 
+}
 
-SparseGaussNewton::SparseGaussNewton( std::shared_ptr< SparseEnergy > pEnergy, cholmod_common* pcc,
-    int maxNumIterations, float epsilon ) :
+SparseGaussNewton::SparseGaussNewton( std::shared_ptr< SparseEnergy > pEnergy,
+    int maxNumIterations, float epsilon,
+    std::shared_ptr< SparseLinearSolver > pLinearSolver ) :
 
     m_maxNumIterations( maxNumIterations ),
+    m_epsilon( epsilon ),
+    m_damping( 0 ),
 
-    m_pcc( pcc ),
-    m_J( nullptr ),
-    m_pFactorization( nullptr ),
-
-    m_r2( nullptr ),
-
+    m_cscJtJ( SYMMETRIC ),
 
-    m_L( nullptr ),
-    m_jtr2( nullptr ),
-
-    m_cscJtJ( SYMMETRIC )
+    m_alreadySetup( false )
 
 {
-    setEpsilon( epsilon );
-    setEnergy( pEnergy );
-}
-
-SparseGaussNewton::~SparseGaussNewton()
-{
-    if( m_r2 != nullptr )
+    if( pLinearSolver == nullptr )
     {
-        cholmod_l_free_dense( &m_r2, m_pcc );
+        // Gauss-Newton steps only need to be approximate, and a tighter
+        // tolerance is often out of reach in single precision when J'J is
+        // poorly conditioned
+        auto pCG = std::make_shared< ConjugateGradientSolver >(
+            ConjugateGradientSolver::CONJUGATE_GRADIENT,
+            ConjugateGradientSolver::INCOMPLETE_CHOLESKY );
+        pCG->setTolerance( DEFAULT_SOLVER_TOLERANCE );
+        pLinearSolver = pCG;
     }
-    if( m_pFactorization != nullptr )
-    {
-        SuiteSparseQR_free< double >( &m_pFactorization, m_pcc );
-    }
-    if( m_J != nullptr )
-    {
-        cholmod_l_free_triplet( &m_J, m_pcc );
-    }
-    m_pcc = nullptr;
+    setLinearSolver( pLinearSolver );
+    setEnergy( pEnergy );
 }
 
 void SparseGaussNewton::setEnergy( std::shared_ptr< SparseEnergy > pEnergy )
 {
-    printf( "resetting energy!\n" );
-
     m_pEnergy = pEnergy;
 
     int m = pEnergy->numFunctions();
     int n = pEnergy->numVariables();
-    Q_ASSERT_X( m >= n, "Gauss Newton", "Number of functions (m) must be greater than the number of parameters (n)." );
+    // the number of functions (m) must be at least the number of parameters (n)
+    assert( m >= n );
 
-    m_prevBeta.resize( n, 1 );
     m_currBeta.resize( n, 1 );
+    m_nextBeta.resize( n, 1 );
     m_delta.resize( n, 1 );
     m_r.resize( m, 1 );
+    m_jtr.resize( n, 1 );
 
-    int nzMax = pEnergy->maxNumNonZeroes();
-
-    // if m_r2 already exists
-    if( m_r2 != nullptr )
-    {
-        // and the sizes don't match
-        if( m_r2->nrow != m )
-        {
-            // then free it and re-allocate
-            cholmod_l_free_dense( &m_r2, m_pcc );
-            // TODO: use realloc instead?
-            m_r2 = cholmod_l_allocate_dense( m, 1, m, CHOLMOD_REAL, m_pcc );
-        }
-    }
-    else
-    {
-        m_r2 = cholmod_l_allocate_dense( m, 1, m, CHOLMOD_REAL, m_pcc );
-    }
-
-    if( m_J != nullptr )
-    {
-        if( m_J->nrow != m ||
-            m_J->ncol != n ||
-            m_J->nzmax != nzMax )
-        {
-            cholmod_l_free_triplet( &m_J, m_pcc );
-            // TODO: use realloc instead?
-            m_J = cholmod_l_allocate_triplet( m, n, nzMax, 0, CHOLMOD_REAL, m_pcc );
-        }
-    }
-    else
-    {
-        m_J = cholmod_l_allocate_triplet( m, n, nzMax, 0, CHOLMOD_REAL, m_pcc );
-    }
+    // one extra for the entry that fixes the size of J
+    int nzMax = pEnergy->maxNumNonZeroes() + 1;
+    m_coordJ.clear();
+    m_coordJ.reserve( nzMax );
 
-    if( m_pFactorization != nullptr )
-    {
-        SuiteSparseQR_free< double >( &m_pFactorization, m_pcc );
-    }
+    m_alreadySetup = false;
+}
 
-    // if m_jtr2 already exists
-    if( m_jtr2 != nullptr )
-    {
-        // and the sizes don't match
-        if( m_jtr2->nrow != n )
-        {
-            // then free it and re-allocate
-            cholmod_l_free_dense( &m_jtr2, m_pcc );
-            m_jtr2 = cholmod_l_allocate_dense( n, 1, n, CHOLMOD_REAL, m_pcc );
-        }
-    }
-    else
-    {
-        m_jtr2 = cholmod_l_allocate_dense( n, 1, n, CHOLMOD_REAL, m_pcc );
-    }
-    if( m_L != nullptr )
-    {
-        cholmod_l_free_factor( &m_L, m_pcc );
-    }
+std::shared_ptr< SparseLinearSolver > SparseGaussNewton::linearSolver() const
+{
+    return m_pLinearSolver;
+}
 
-    // try PARDISO
+void SparseGaussNewton::setLinearSolver( std::shared_ptr< SparseLinearSolver > pLinearSolver )
+{
+    m_pLinearSolver = pLinearSolver;
     m_alreadySetup = false;
-    m_coordJ.clear();
-    // HACK
-    m_coordJ.reserve( m * n );
-    m_jtr.resize( n, 1 );
 }
 
-uint32_t SparseGaussNewton::maxNumIterations() const
+int SparseGaussNewton::maxNumIterations() const
 {
     return m_maxNumIterations;
 }
 
-void SparseGaussNewton::setMaxNumIterations( uint32_t maxNumIterations )
+void SparseGaussNewton::setMaxNumIterations( int maxNumIterations )
 {
     m_maxNumIterations = maxNumIterations;
 }
@@ -192,205 +104,77 @@ float SparseGaussNewton::epsilon() const
 void SparseGaussNewton::setEpsilon( float epsilon )
 {
     m_epsilon = epsilon;
-    m_sqrtEpsilon = sqrtf( epsilon );
 }
 
-const FloatMatrix& SparseGaussNewton::minimize( float* pEnergyFound, int* pNumIterations )
+float SparseGaussNewton::damping() const
 {
-#if TIMING
-    float tR = 0;
-    float tCopy = 0;
-    float tConvert = 0;
-#if FACTORIZE
-    float tFactorize = 0;
-    float tQMult = 0;
-    float tSolve = 0;
-#else
-    float tQR = 0;
-#endif
-    StopWatch sw;
-#endif
+    return m_damping;
+}
 
+void SparseGaussNewton::setDamping( float damping )
+{
+    m_damping = damping;
+}
+
+const FloatMatrix& SparseGaussNewton::minimize( float* pEnergyFound, int* pNumIterations )
+{
     m_pEnergy->evaluateInitialGuess( m_currBeta );
+    float currEnergy = evaluate( m_currBeta );
+
+    float lambda = m_damping;
+    bool converged = !updateNormalEquations();
 
-#if TIMING
-    sw.reset();
-#endif
-    m_J->nnz = 0;
-    m_pEnergy->evaluateResidualAndJacobian( m_currBeta, m_r, m_J );
-#if TIMING
-    tR += sw.millisecondsElapsed();
-    sw.reset();
-#endif
-    copyFloatMatrixToCholmodDense( m_r, m_r2 );
-#if TIMING
-    tCopy += sw.millisecondsElapsed();
-#endif
-
-    float prevEnergy;
-    float currEnergy = FloatMatrix::dot( m_r, m_r );
-    float deltaEnergy;
-
-    bool deltaEnergyConverged;
-    bool deltaBetaConverged;
-    bool converged = false;
-
-    //printf( "initial energy = %f\n", currEnergy );
-
-    // check for convergence
     int nIterations = 0;
     while( ( nIterations < m_maxNumIterations ) &&
         !converged )
     {
-        // not converged
-        prevEnergy = currEnergy;
-        //m_prevBeta = m_currBeta;
-
-#if 0
-        if( nIterations == 0 )
+        // damp the diagonal: the rest of J'J is unchanged by a rejected step
+        auto& jtjValues = m_cscJtJ.values();
+        for( size_t i = 0; i < m_jtjDiagonalSlots.size(); ++i )
         {
-            //printf( "prev beta = %s\n", qPrintable( m_prevBeta.toString() ) );
-            //printf( "curr beta = %s\n", qPrintable( m_currBeta.toString() ) );
-            //printf( "curr residual =\n%s\n", qPrintable( m_r.toString() ) );
-            saveVector( m_r, "c:/tmp/r0.txt" );
+            int k = m_jtjDiagonalSlots[ i ];
+            if( k >= 0 )
+            {
+                jtjValues[ k ] = ( 1 + lambda ) * m_jtjDiagonal[ i ];
+            }
         }
-#endif
-
-#if TIMING
-        sw.reset();
-#endif
-        cholmod_sparse* jSparse = cholmod_l_triplet_to_sparse( m_J, m_J->nnz, m_pcc );
-#if TIMING
-        tConvert += sw.millisecondsElapsed();
-        sw.reset();
-#endif
-
-#if FACTORIZE
 
-#if SPLIT_FACTORIZATION // symbolic then numeric
-        if( m_pFactorization == nullptr )
+        if( !m_pLinearSolver->factorize( m_cscJtJ ) ||
+            !m_pLinearSolver->solve( m_jtr, m_delta ) )
         {
-            m_pFactorization = SuiteSparseQR_symbolic< double >( SPQR_ORDERING_DEFAULT, false, jSparse, m_pcc );
+            break;
         }
-        SuiteSparseQR_numeric< double >( SPQR_DEFAULT_TOL, jSparse, m_pFactorization, m_pcc );
-#else
-        // numeric directly
-        if( m_pFactorization == nullptr )
+
+        // m_r and m_coordJ are overwritten, but m_cscJ, J'J and J'r
+        // still describe m_currBeta until the step is accepted
+        m_nextBeta.copy( m_currBeta );
+        m_nextBeta -= m_delta;
+        float nextEnergy = evaluate( m_nextBeta );
+
+        if( lambda > 0 && !( nextEnergy < currEnergy ) )
         {
-            //printf( "factorization is null, factorizing...\n" );
-            //m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_DEFAULT, SPQR_DEFAULT_TOL, jSparse, m_pcc );
-            //m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_DEFAULT, 1e-3, jSparse, m_pcc );
-            //m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_CHOLMOD, 1e-3, jSparse, m_pcc );
-            m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_CHOLMOD, SPQR_DEFAULT_TOL, jSparse, m_pcc );
-            //m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_METIS, 1e-3, jSparse, m_pcc );
-            //m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_BEST, 1e-3, jSparse, m_pcc );
-            //m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_COLAMD, 1e-3, jSparse, m_pcc );
-            //m_pFactorization = SuiteSparseQR_factorize< double >( SPQR_ORDERING_AMD, 1e-3, jSparse, m_pcc );
+            // reject the step and try a smaller one
+            lambda *= DAMPING_FACTOR;
+            converged = ( lambda > MAX_DAMPING );
         }
         else
         {
-            //printf( "factorization exists, reusing...\n" );
-            SuiteSparseQR_numeric< double >( SPQR_DEFAULT_TOL, jSparse, m_pFactorization, m_pcc );
-            //SuiteSparseQR_numeric< double >( 1e-3, jSparse, m_pFactorization, m_pcc );
-        }
-#endif
-
-#if TIMING
-        tFactorize += sw.millisecondsElapsed();
-        sw.reset();
-#endif
-
-        auto y = SuiteSparseQR_qmult< double >( SPQR_QTX, m_pFactorization, m_r2, m_pcc );
-
-#if TIMING
-        tQMult += sw.millisecondsElapsed();
-        sw.reset();
-#endif
-        auto delta = SuiteSparseQR_solve< double >( SPQR_RETX_EQUALS_B, m_pFactorization, y, m_pcc );
-#if TIMING
-        tSolve += sw.millisecondsElapsed();
-#endif
-
-#else
-        auto delta = SuiteSparseQR< double >( jSparse, m_r2, m_pcc );
-#if TIMING
-        tQR += sw.millisecondsElapsed();
-#endif
-
-#endif
-
-#if TIMING
-        sw.reset();
-#endif
-        copyCholmodDenseToFloatMatrix( delta, m_delta );
-#if TIMING
-        tCopy += sw.millisecondsElapsed();
-#endif
-
-        m_J->nnz = 0; // reset sparse jacobian
-        cholmod_l_free_dense( &delta, m_pcc );
-#if FACTORIZE
-        cholmod_l_free_dense( &y, m_pcc );
-#endif
-        cholmod_l_free_sparse( &jSparse, m_pcc );
-
-        //m_currBeta = m_prevBeta - m_delta;
-        m_currBeta -= m_delta;
-
-#if 0
-        if( nIterations == 0 )
-        {
-            saveVector( m_delta, "c:/tmp/delta_0.txt" );
-            saveVector( m_prevBeta, "c:/tmp/m_prevBeta.txt" );
-            saveVector( m_currBeta, "c:/tmp/m_currBeta.txt" );
-            //printf( "initial delta =\n%s\n", qPrintable( m_delta.toString() ) );
-            //printf( "beta[1] =\n%s\n", qPrintable( m_currBeta.toString() ) );
+            std::swap( m_currBeta, m_nextBeta );
+
+            float deltaEnergy = std::abs( nextEnergy - currEnergy );
+            currEnergy = nextEnergy;
+            converged = ( deltaEnergy < m_epsilon * ( 1 + currEnergy ) ) ||
+                !updateNormalEquations();
+
+            if( lambda > 0 )
+            {
+                lambda = std::max( lambda / DAMPING_FACTOR, MIN_DAMPING );
+            }
         }
-#endif
-
-        // update energy
-#if TIMING
-        sw.reset();
-#endif
-        m_pEnergy->evaluateResidualAndJacobian( m_currBeta, m_r, m_J );
-#if TIMING
-        tR += sw.millisecondsElapsed();
-        sw.reset();
-#endif
-        copyFloatMatrixToCholmodDense( m_r, m_r2 );
-#if TIMING
-        tCopy += sw.millisecondsElapsed();
-#endif
-
-        currEnergy = FloatMatrix::dot( m_r, m_r );
-        deltaEnergy = std::abs( currEnergy - prevEnergy );
-
-        deltaEnergyConverged = ( deltaEnergy < m_epsilon * ( 1 + currEnergy ) );
-
-#if 0
-        //float deltaBetaMax = m_delta.maximum();
-        //deltaBetaConverged = ( deltaBetaMax < m_sqrtEpsilon * ( 1 + deltaBetaMax ) );
-        converged = deltaEnergyConverged && deltaBetaConverged;
-#else
-        converged = deltaEnergyConverged;
-
-        //printf( "k = %d, E[k] = %f, |deltaE| = %f, eps * ( 1 + E[k] ) = %f, converged = %d\n",
-        //  nIterations, currEnergy, deltaEnergy, m_epsilon * ( 1 + currEnergy ), (int)deltaEnergyConverged );
-
-#endif
+
         ++nIterations;
     }
 
-#if TIMING
-#if FACTORIZE
-    printf( "timing breakdown:\ntR = %f, tCopy = %f, tConvert = %f, tFactorize = %f, tQMult = %f, tSolve = %f\n",
-        tR, tCopy, tConvert, tFactorize, tQMult, tSolve );
-#else
-    printf( "timing breakdown:\ntR = %f, tCopy = %f, tConvert = %f, tQR = %f\n",
-        tR, tCopy, tConvert, tQR );
-#endif
-#endif
-
     if( pEnergyFound != nullptr )
     {
         *pEnergyFound = currEnergy;
@@ -400,360 +184,62 @@ const FloatMatrix& SparseGaussNewton::minimize( float* pEnergyFound, int* pNumIt
     {
         *pNumIterations = nIterations;
     }
+
     return m_currBeta;
 }
 
-void save_triplet( cholmod_triplet* A, const char* filename )
+float SparseGaussNewton::evaluate( const FloatMatrix& beta )
 {
-    FILE* fp = fopen( filename, "w" );
-
-    fprintf( fp, "%d\t%d\t-1\n", A->nrow, A->ncol );
-
-    __int64* i = ( __int64* )( A->i );
-    __int64* j = ( __int64* )( A->j );
-    double* x = ( double* )( A->x );
-    for( int k = 0; k < A->nnz; ++k )
-    {
-        int ii = ( int )(i[k]);
-        int jj = ( int )(j[k]);
-        fprintf( fp, "%d\t%d\t%lf\n", ii + 1, jj + 1, x[k] );
-    }
-
-    fclose( fp );
-}
+    m_coordJ.clear();
+    m_pEnergy->evaluateResidualAndJacobian( beta, m_r, m_coordJ );
 
-void save_sparse( cholmod_sparse* A, const char* filename, cholmod_common* cc )
-{
-    auto A_triplet = cholmod_l_sparse_to_triplet( A, cc );
-    save_triplet( A_triplet, filename );
-    cholmod_l_free_triplet( &A_triplet, cc );
-}
+    // fixes the size of J at m x n even if its last rows or columns are empty
+    // (compress() takes the size from the largest indices)
+    m_coordJ.append( m_pEnergy->numFunctions() - 1, m_pEnergy->numVariables() - 1, 0 );
 
-void save_dense( cholmod_dense* A, const char* filename )
-{
-    FILE* fp = fopen( filename, "w" );
-    double* x = ( double* )( A->x );
-    for( int i = 0; i < A->nrow; ++i )
-    {
-        fprintf( fp, "%lf\n", x[i] );
-    }
-    fclose( fp );
+    return FloatMatrix::dot( m_r, m_r );
 }
 
-void print_triplet( cholmod_triplet* A )
+bool SparseGaussNewton::updateNormalEquations()
 {
-    __int64* i = ( __int64* )( A->i );
-    __int64* j = ( __int64* )( A->j );
-    double* x = ( double* )( A->x );
-    for( int k = 0; k < A->nnz; ++k )
+    if( !m_alreadySetup ||
+        m_coordJ.numNonZeroes() != static_cast< int >( m_cscJ.numNonZeros() ) )
     {
-        int ii = ( int )(i[k]);
-        int jj = ( int )(j[k]);
-        printf( "(%d,%d): %lf\n", ii, jj, x[k] );
-    }
-}
-
-void print_sparse( cholmod_sparse* A, cholmod_common* cc )
-{
-    auto A_triplet = cholmod_l_sparse_to_triplet( A, cc );
-    print_triplet( A_triplet );
-    cholmod_l_free_triplet( &A_triplet, cc );
-}
-
-const FloatMatrix& SparseGaussNewton::minimize2( float* pEnergyFound, int* pNumIterations )
-{
-#if TIMING
-    StopWatch sw;
-    float tSSMult = 0;
-    float tFactorize = 0;
-    float tSolve = 0;
-#endif
-
-    double alpha[2] = { 1, 1 };
-    double beta[2] = { 0, 0 };
+        // symbolic: once per structure
+        m_coordJ.compress( m_cscJ, m_jIndexMap );
+        m_cscJ.buildRowMirror();
+        m_cscJ.multiplyTransposeStructure( m_cscJtJ );
 
-    m_pEnergy->evaluateInitialGuess( m_currBeta );
-
-    m_J->nnz = 0;
-    m_pEnergy->evaluateResidualAndJacobian( m_currBeta, m_r, m_J );
-    copyFloatMatrixToCholmodDense( m_r, m_r2 );
-#if 0
-    printf( "J is %d x %d\n", m_J->nrow, m_J->ncol );
-    QString jFilename = QString( "c:/tmp/j_%1.txt" ).arg( 0, 5, 10, QChar( '0' ) );
-    QString rFilename = QString( "c:/tmp/r_%1.txt" ).arg( 0, 5, 10, QChar( '0' ) );
-    printf( "saving: %s\n", qPrintable( jFilename ) );
-    save_triplet( m_J, qPrintable( jFilename ) );
-    printf( "saving: %s\n", qPrintable( rFilename ) );
-    save_dense( m_r2, qPrintable( rFilename ) );
-#endif
-
-    float prevEnergy;
-    float currEnergy = FloatMatrix::dot( m_r, m_r );
-    float deltaEnergy;
-
-    bool deltaEnergyConverged;
-    bool deltaBetaConverged;
-    bool converged = false;
-
-    // check for convergence
-    int nIterations = 0;
-    while( ( nIterations < m_maxNumIterations ) &&
-        !converged )
-    {
-        // not converged
-        prevEnergy = currEnergy;
-
-        cholmod_sparse* jSparse = cholmod_l_triplet_to_sparse( m_J, m_J->nnz, m_pcc );
-
-        // compute J'
-        cholmod_sparse* jtSparse = cholmod_l_transpose( jSparse, 1, m_pcc );
-
-        // compute J'J
-#if TIMING
-        sw.reset();
-#endif
-        cholmod_sparse* jtjSparse = cholmod_l_ssmult( jtSparse, jSparse, -1, true, true, m_pcc );
-#if TIMING
-        tSSMult += sw.millisecondsElapsed();
-#endif
-
-        // compute J' * r
-        cholmod_l_sdmult( jtSparse, 0, alpha, beta, m_r2, m_jtr2, m_pcc );
-
-        // analyze
-        if( m_L == nullptr )
+        int n = m_cscJtJ.numCols();
+        m_jtjDiagonalSlots.resize( n );
+        m_jtjDiagonal.resize( n );
+        for( int i = 0; i < n; ++i )
         {
-            m_L = cholmod_l_analyze( jtjSparse, m_pcc );
+            m_jtjDiagonalSlots[ i ] = m_cscJtJ.slot( i, i );
         }
-        // factorize
-#if TIMING
-        sw.reset();
-#endif
-        cholmod_l_factorize( jtjSparse, m_L, m_pcc );
-#if TIMING
-        tFactorize += sw.millisecondsElapsed();
-#endif
-        // solve using factorization
-#if TIMING
-        sw.reset();
-#endif
-        cholmod_dense* delta = cholmod_l_solve( CHOLMOD_A, m_L, m_jtr2, m_pcc );
-#if TIMING
-        tSolve += sw.millisecondsElapsed();
-#endif
-
-        copyCholmodDenseToFloatMatrix( delta, m_delta );
-
-        m_J->nnz = 0; // reset sparse jacobian
-        cholmod_l_free_dense( &delta, m_pcc );
-        cholmod_l_free_sparse( &jtjSparse, m_pcc );
-        cholmod_l_free_sparse( &jtSparse, m_pcc );
-        cholmod_l_free_sparse( &jSparse, m_pcc );
-
-        m_currBeta -= m_delta;
-        // update energy
-        m_pEnergy->evaluateResidualAndJacobian( m_currBeta, m_r, m_J );
-        copyFloatMatrixToCholmodDense( m_r, m_r2 );
-#if 0
-        QString jFilename = QString( "c:/tmp/j_%1.txt" ).arg( nIterations, 5, 10, QChar( '0' ) );
-        QString rFilename = QString( "c:/tmp/r_%1.txt" ).arg( nIterations, 5, 10, QChar( '0' ) );
-        printf( "saving: %s\n", qPrintable( jFilename ) );
-        save_triplet( m_J, qPrintable( jFilename ) );
-        printf( "saving: %s\n", qPrintable( rFilename ) );
-        save_dense( m_r2, qPrintable( rFilename ) );
-#endif
-        currEnergy = FloatMatrix::dot( m_r, m_r );
-        deltaEnergy = std::abs( currEnergy - prevEnergy );
-
-        deltaEnergyConverged = ( deltaEnergy < m_epsilon * ( 1 + currEnergy ) );
-
-#if 0
-        //float deltaBetaMax = m_delta.maximum();
-        //deltaBetaConverged = ( deltaBetaMax < m_sqrtEpsilon * ( 1 + deltaBetaMax ) );
-        converged = deltaEnergyConverged && deltaBetaConverged;
-#else
-        converged = deltaEnergyConverged;
-
-        //printf( "k = %d, E[k] = %f, |deltaE| = %f, eps * ( 1 + E[k] ) = %f, converged = %d\n",
-        //  nIterations, currEnergy, deltaEnergy, m_epsilon * ( 1 + currEnergy ), (int)deltaEnergyConverged );
-
-#endif
-        ++nIterations;
-    }
-#if 0
-    exit(0);
-#endif
-
-#if TIMING
-    printf( "sparse * sparse took %f ms\n", tSSMult );
-    printf( "factorize took %f ms\n", tFactorize );
-    printf( "solve took %f ms\n", tSolve );
-#endif
-
-    if( pEnergyFound != nullptr )
-    {
-        *pEnergyFound = currEnergy;
-    }
 
-    if( pNumIterations != nullptr )
-    {
-        *pNumIterations = nIterations;
-    }
-    return m_currBeta;
-}
-
-#if 1
-const FloatMatrix& SparseGaussNewton::minimize3( float* pEnergyFound, int* pNumIterations )
-{
-#if TIMING
-    StopWatch sw;
-    float tCompress0 = 0;
-    float tSSMult0 = 0;
-    float tSVMult = 0;
-    float tSSMult = 0;
-    float tFactorize = 0;
-    float tSolve = 0;
-#endif
-
-    m_pEnergy->evaluateInitialGuess( m_currBeta );
-
-    // TODO: only need to compress once and store index map
-    m_pEnergy->evaluateResidualAndJacobian( m_currBeta, m_r, m_coordJ );
-#if TIMING
-    sw.reset();
-#endif
-
-    m_coordJ.compress( m_cscJ, m_jIndexMap );
-    m_coordJ.compressTranspose( m_cscJt, m_jtIndexMap );
-#if TIMING
-    tCompress0 += sw.millisecondsElapsed();
-#endif
-
-#if TIMING
-    sw.reset();
-#endif
-    CompressedSparseMatrix< float >::multiply( m_cscJt, m_cscJ, m_cscJtJ );
-#if TIMING
-    tSSMult0 += sw.millisecondsElapsed();
-#endif
-
-    float prevEnergy;
-    float currEnergy = FloatMatrix::dot( m_r, m_r );
-    float deltaEnergy;
-
-    bool deltaEnergyConverged;
-    bool deltaBetaConverged;
-    bool converged = false;
-
-    // check for convergence
-    int nIterations = 0;
-    while( ( nIterations < m_maxNumIterations ) &&
-        !converged )
-    {
-        // not converged
-        prevEnergy = currEnergy;
-
-        // compute J' * r
-#if TIMING
-        sw.reset();
-#endif
-        m_cscJ.multiplyTransposeVector( m_r, m_jtr );
-#if TIMING
-        tSVMult += sw.millisecondsElapsed();
-#endif
-
-        // compute J'J
-#if TIMING
-        sw.reset();
-#endif
-
-        //m_r.saveTXT( QString( "c:/tmp/r_%1.txt" ).arg( nIterations ) );
-        //m_coordJ.saveTXT( QString( "c:/tmp/coordJ_%1.txt" ).arg( nIterations ) );
-
-        CompressedSparseMatrix< float >::multiply( m_cscJt, m_cscJ, m_cscJtJ );
-
-        //CompressedSparseMatrix< float >::multiply( m_cscJt, m_cscJ, m_cscJtJ );
-
-#if TIMING
-        tSSMult += sw.millisecondsElapsed();
-#endif
-
-
-
-        // analyze
+        m_alreadySetup = m_pLinearSolver->analyzePattern( m_cscJtJ );
         if( !m_alreadySetup )
         {
-            m_pardiso.analyzePattern( m_cscJtJ );
-            m_alreadySetup = true;
+            return false;
         }
-        // factorize
-#if TIMING
-        sw.reset();
-#endif
-        m_pardiso.factorize( m_cscJtJ );
-#if TIMING
-        tFactorize += sw.millisecondsElapsed();
-#endif
-        // solve using factorization
-#if TIMING
-        sw.reset();
-#endif
-        m_pardiso.solve( m_jtr, m_delta );
-#if TIMING
-        tSolve += sw.millisecondsElapsed();
-#endif
-
-        m_currBeta -= m_delta;
-        // update energy
-        m_pEnergy->evaluateResidualAndJacobian( m_currBeta, m_r, m_coordJ );
-
-        // TODO: can save one set of gathers if we do this at the top of the loop?
-        m_cscJ.gather( m_coordJ, m_jIndexMap );
-        m_cscJt.gather( m_coordJ, m_jtIndexMap );
-
-        currEnergy = FloatMatrix::dot( m_r, m_r );
-        deltaEnergy = std::abs( currEnergy - prevEnergy );
-
-        deltaEnergyConverged = ( deltaEnergy < m_epsilon * ( 1 + currEnergy ) );
-
-#if 0
-        //float deltaBetaMax = m_delta.maximum();
-        //deltaBetaConverged = ( deltaBetaMax < m_sqrtEpsilon * ( 1 + deltaBetaMax ) );
-        converged = deltaEnergyConverged && deltaBetaConverged;
-#else
-        converged = deltaEnergyConverged;
-
-        //printf( "k = %d, E[k] = %f, |deltaE| = %f, eps * ( 1 + E[k] ) = %f, converged = %d\n",
-        //  nIterations, currEnergy, deltaEnergy, m_epsilon * ( 1 + currEnergy ), (int)deltaEnergyConverged );
-
-#endif
-        ++nIterations;
     }
-
-#if TIMING
-
-    printf( "J'J is %d x %d\n", m_cscJtJ.numRows(), m_cscJtJ.numCols() );
-
-    printf( "compress0 took %f ms\n", tCompress0 );
-    printf( "ssmult0 took %f ms\n", tSSMult0 );
-    printf( "svMult took %f ms\n", tSVMult );
-
-    printf( "sparse * sparse took %f ms\n", tSSMult );
-    printf( "factorize took %f ms\n", tFactorize );
-    printf( "solve took %f ms\n", tSolve );
-#endif
-
-    if( pEnergyFound != nullptr )
+    else
     {
-        *pEnergyFound = currEnergy;
+        // numeric: only the values of J changed
+        m_cscJ.gather( m_coordJ, m_jIndexMap );
+        m_cscJ.updateRowMirrorValues();
     }
 
-    if( pNumIterations != nullptr )
+    m_cscJ.parallelMultiplyTranspose( m_cscJtJ );
+    m_cscJ.parallelMultiplyTransposeVector( m_r, m_jtr );
+
+    const auto& jtjValues = m_cscJtJ.values();
+    for( size_t i = 0; i < m_jtjDiagonalSlots.size(); ++i )
     {
-        *pNumIterations = nIterations;
+        int k = m_jtjDiagonalSlots[ i ];
+        m_jtjDiagonal[ i ] = ( k >= 0 ) ? jtjValues[ k ] : 0;
     }
 
-    return m_currBeta;
+    return true;
 }
-#endif
-#endif
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <math/Random.h>
+#include <time/TimeUtils.h>
+
+#include "CompressedSparseMatrix.h"
+#include "CoordinateSparseMatrix.h"
+#include "FloatMatrix.h"
+
+using libcgt::core::time::dtUS;
+
+namespace
+{
+
+// The Jacobian of a mesh deformation energy: 3 variables per vertex, 3
+// residuals for each of 4 neighbors per vertex (each depending on both
+// vertices), and 3 residuals for each data term (depending on one vertex).
+void makeJacobian( int nVertices, CompressedSparseMatrix< float >& J )
+{
+    Random rnd( 0 );
+    CoordinateSparseMatrix< float > coordJ;
+    coordJ.reserve( nVertices * ( 4 * 3 * 2 + 3 ) );
+
+    int row = 0;
+    for( int v = 0; v < nVertices; ++v )
+    {
+        for( int e = 1; e <= 4; ++e )
+        {
+            int w = std::min( v + e * e, nVertices - 1 );
+            for( int d = 0; d < 3; ++d )
+            {
+                coordJ.append( row, 3 * v + d, rnd.nextFloatRange( -1, 1 ) );
+                if( w != v )
+                {
+                    coordJ.append( row, 3 * w + d, rnd.nextFloatRange( -1, 1 ) );
+                }
+                ++row;
+            }
+        }
+
+        for( int d = 0; d < 3; ++d )
+        {
+            coordJ.append( row, 3 * v + d, rnd.nextFloatRange( -1, 1 ) );
+            ++row;
+        }
+    }
+
+    coordJ.compress( J );
+}
+
+double averageMilliseconds( int64_t us, int nIterations )
+{
+    return us / 1000.0 / nIterations;
+}
+
+float maxAbsDifference( const FloatMatrix& a, const FloatMatrix& b )
+{
+    float d = 0;
+    for( int k = 0; k < a.numElements(); ++k )
+    {
+        d = std::max( d, std::abs( a[ k ] - b[ k ] ) );
+    }
+    return d;
+}
+
+}
+
+void benchmarkSparseMatrixProducts()
+{
+    const int nVertices = 100000;
+    const int nRHS = 8;
+    const int nIterations = 20;
+
+    CompressedSparseMatrix< float > J( GENERAL );
+    makeJacobian( nVertices, J );
+    J.buildRowMirror();
+
+    int m = J.numRows();
+    int n = J.numCols();
+    printf( "J is %d x %d with %d non-zeros\n", m, n, J.numNonZeros() );
+
+    Random rnd( 1 );
+    FloatMatrix x( n, nRHS );
+    FloatMatrix xt( m, nRHS );
+    for( int k = 0; k < x.numElements(); ++k )
+    {
+        x[ k ] = rnd.nextFloatRange( -1, 1 );
+    }
+    for( int k = 0; k < xt.numElements(); ++k )
+    {
+        xt[ k ] = rnd.nextFloatRange( -1, 1 );
+    }
+
+    FloatMatrix x0( n, 1 );
+    FloatMatrix xt0( m, 1 );
+    std::copy( x.data(), x.data() + n, x0.data() );
+    std::copy( xt.data(), xt.data() + m, xt0.data() );
+
+    FloatMatrix y0;
+    FloatMatrix y1;
+    FloatMatrix yt0;
+    FloatMatrix yt1;
+
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < nIterations; ++i )
+    {
+        J.multiplyVector( x0, y0 );
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < nIterations; ++i )
+    {
+        J.parallelMultiplyVector( x0, y1 );
+    }
+    auto t2 = std::chrono::high_resolution_clock::now();
+    printf( "A x: %.3f ms, parallel: %.3f ms, max difference: %g\n",
+        averageMilliseconds( dtUS( t0, t1 ), nIterations ),
+        averageMilliseconds( dtUS( t1, t2 ), nIterations ),
+        maxAbsDifference( y0, y1 ) );
+
+    t0 = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < nIterations; ++i )
+    {
+        J.multiplyTransposeVector( xt0, yt0 );
+    }
+    t1 = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < nIterations; ++i )
+    {
+        J.parallelMultiplyTransposeVector( xt0, yt1 );
+    }
+    t2 = std::chrono::high_resolution_clock::now();
+    printf( "A' x: %.3f ms, parallel: %.3f ms, max difference: %g\n",
+        averageMilliseconds( dtUS( t0, t1 ), nIterations ),
+        averageMilliseconds( dtUS( t1, t2 ), nIterations ),
+        maxAbsDifference( yt0, yt1 ) );
+
+    // nRHS single-vector products against one SpMM.
+    FloatMatrix xc( n, 1 );
+    FloatMatrix yc;
+    FloatMatrix y( m, nRHS );
+    FloatMatrix yp;
+    t0 = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < nIterations; ++i )
+    {
+        for( int c = 0; c < nRHS; ++c )
+        {
+            std::copy( x.data() + c * n, x.data() + ( c + 1 ) * n,
+                xc.data() );
+            J.multiplyVector( xc, yc );
+            std::copy( yc.data(), yc.data() + m, y.data() + c * m );
+        }
+    }
+    t1 = std::chrono::high_resolution_clock::now();
+    for( int i = 0; i < nIterations; ++i )
+    {
+        J.parallelMultiplyMatrix( x, yp );
+    }
+    t2 = std::chrono::high_resolution_clock::now();
+    printf( "A X (%d columns): %.3f ms, parallel: %.3f ms, "
+        "max difference: %g\n",
+        nRHS, averageMilliseconds( dtUS( t0, t1 ), nIterations ),
+        averageMilliseconds( dtUS( t1, t2 ), nIterations ),
+        maxAbsDifference( y, yp ) );
+
+    t0 = std::chrono::high_resolution_clock::now();
+    J.updateRowMirrorValues();
+    t1 = std::chrono::high_resolution_clock::now();
+    printf( "updateRowMirrorValues: %.3f ms\n",
+        averageMilliseconds( dtUS( t0, t1 ), 1 ) );
+}
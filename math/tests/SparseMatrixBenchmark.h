@@ -0,0 +1,6 @@
+#pragma once
+
+// Times the single-threaded sparse-dense products in CompressedSparseMatrix
+// against the parallel ones, on a matrix shaped like a Gauss-Newton Jacobian,
+// and prints the times and the largest differences.
+void benchmarkSparseMatrixProducts();